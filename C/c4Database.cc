@@ -34,6 +34,7 @@
 #include "SecureSymmetricCrypto.hh"
 #include "StringUtil.hh"
 #include "PrebuiltCopier.hh"
+#include "ReaderPool.hh"
 #include <thread>
 
 using namespace fleece;
@@ -80,7 +81,9 @@ static C4DatabaseConfig newToOldConfig(const C4DatabaseConfig2 *config2) {
         config2->flags | kC4DB_AutoCompact | kC4DB_SharedKeys,
         NULL,
         kC4RevisionTrees,
-        config2->encryptionKey
+        config2->encryptionKey,
+        config2->cacheSize,
+        config2->mmapSize
     };
 }
 
@@ -286,6 +289,59 @@ bool c4db_endTransaction(C4Database* database,
 }
 
 
+C4TransactionStats c4db_getTransactionStats(C4Database* database) noexcept {
+    auto s = database->dataFile()->transactionStats();
+    return {s.commits, s.aborts, s.groupedCommits, s.waits, s.waitTime, s.commitTime,
+            s.maxCommitTime, s.checkpoints, s.deferredCheckpoints};
+}
+
+
+C4StatementCacheStats c4db_getStatementCacheStats(C4Database* database) noexcept {
+    auto stats = ((SQLiteDataFile*)database->dataFile())->statementCacheStats();
+    return {stats.hits, stats.misses, (uint32_t)stats.count};
+}
+
+
+C4DatabaseCacheStats c4db_getCacheStats(C4Database* database) noexcept {
+    auto s = ((SQLiteDataFile*)database->dataFile())->cacheStats();
+    return {s.cacheSize, s.mmapSize, s.cacheUsed, s.hits, s.misses, s.writes};
+}
+
+
+void c4_setDatabaseMemoryBudget(int64_t bytes) noexcept {
+    SQLiteDataFile::setMemoryBudget(bytes);
+}
+
+
+int64_t c4_releaseDatabaseMemory(void) noexcept {
+    return SQLiteDataFile::releaseMemory();
+}
+
+
+C4Database* c4db_borrowReader(C4Database *database, C4Error *outError) noexcept {
+    return tryCatch<C4Database*>(outError, [&]{
+        return retain(database->readerPool().borrow().get());
+    });
+}
+
+
+void c4db_returnReader(C4Database *database, C4Database *reader) noexcept {
+    if (!reader)
+        return;
+    try {
+        database->readerPool().giveBack(reader);
+    } catchExceptions()
+    release(reader);
+}
+
+
+bool c4db_setMaxReaders(C4Database *database, unsigned maxReaders, C4Error *outError) noexcept {
+    return tryCatch(outError, [&]{
+        database->readerPool().setCapacity(maxReaders);
+    });
+}
+
+
 void c4db_lock(C4Database *db) C4API {
     db->lockClientMutex();
 }
@@ -72,6 +72,31 @@ C4Document* c4doc_get(C4Database *database,
 }
 
 
+bool c4db_getDocuments(C4Database *database,
+                       const C4String docIDs[],
+                       size_t count,
+                       bool mustExist,
+                       C4Document* outDocs[],
+                       C4Error *outError) noexcept
+{
+    fill(outDocs, outDocs + count, nullptr);
+    try {
+        vector<slice> keys(docIDs, docIDs + count);
+        auto records = database->defaultKeyStore().getMany(keys, kEntireBody);
+        auto &factory = database->documentFactory();
+        vector<Retained<Document>> docs(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (records[i].exists() || !mustExist)
+                docs[i] = factory.newDocumentInstance(records[i]);
+        }
+        for (size_t i = 0; i < count; ++i)
+            outDocs[i] = retain(docs[i].get());
+        return true;
+    } catchError(outError)
+    return false;
+}
+
+
 C4Document* c4doc_getSingleRevision(C4Database *database,
                                     C4Slice docID,
                                     C4Slice revID,
@@ -541,6 +566,21 @@ C4Document* c4doc_create(C4Database *db,
 }
 
 
+bool c4db_bulkLoad(C4Database *database,
+                   const C4BulkDocument docs[],
+                   size_t count,
+                   C4Error *outError) noexcept
+{
+    if (!database->mustBeInTransaction(outError))
+        return false;
+    try {
+        database->bulkLoad(docs, count);
+        return true;
+    } catchError(outError);
+    return false;
+}
+
+
 C4Document* c4doc_update(C4Document *doc,
                          C4Slice revBody,
                          C4RevisionFlags revFlags,
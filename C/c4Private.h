@@ -66,6 +66,14 @@ void c4db_unlock(C4Database *db) C4API;
     and each result is an array of columns. */
 C4SliceResult c4db_rawQuery(C4Database *database C4NONNULL, C4String query, C4Error *outError) C4API;
 
+/** Returns the number of times query observers' queries have been run in the background,
+    in all databases. Only exposed for testing. */
+unsigned c4queryobs_getRunCount(void) C4API;
+
+/** Returns the number of times background index builds have yielded to other transactions,
+    in all databases. Only exposed for testing. */
+unsigned c4db_getIndexBuildInterruptionCount(void) C4API;
+
 /** Subroutine of c4doc_put that reads the current revision of the document.
     Only exposed for testing; see the unit test "Document GetForPut". */
 C4Document* c4doc_getForPut(C4Database *database C4NONNULL,
@@ -19,6 +19,7 @@
 #include "c4Index.h"
 #include "c4Observer.h"
 #include "c4Query.h"
+#include "c4Private.h"
 
 #include "c4ExceptionUtils.hh"
 #include "c4Query.hh"
@@ -26,6 +27,7 @@
 #include "c4QueryObserver.hh"
 
 #include "SQLiteDataFile.hh"
+#include "IndexBuilder.hh"
 
 
 using namespace std;
@@ -76,6 +78,12 @@ FLString c4query_columnTitle(C4Query *query, unsigned column) C4API {
 }
 
 
+C4QueryCacheStats c4db_getQueryCacheStats(C4Database *database) C4API {
+    auto stats = ((SQLiteDataFile*)database->dataFile())->queryCacheStats();
+    return {stats.hits, stats.misses, (uint32_t)stats.count};
+}
+
+
 void c4query_setParameters(C4Query *query, C4String encodedParameters) C4API {
     query->setParameters(encodedParameters);
 }
@@ -147,6 +155,14 @@ int64_t c4queryenum_getRowCount(C4QueryEnumerator *e,
     return -1;
 }
 
+C4SliceResult c4queryenum_getContinuationToken(C4QueryEnumerator *e,
+                                               C4Error *outError) noexcept
+{
+    return tryCatch<C4SliceResult>(outError, [&]{
+        clearError(outError);
+        return C4SliceResult(asInternal(e)->enumerator().continuationToken());
+    });
+}
 
 
 C4QueryEnumerator* c4queryenum_refresh(C4QueryEnumerator *e,
@@ -200,6 +216,10 @@ C4QueryEnumerator* c4queryobs_getEnumerator(C4QueryObserver *obs,
     return retain(obs->currentEnumerator(forget, outError).get());
 }
 
+unsigned c4queryobs_getRunCount(void) C4API {
+    return LiveQuerier::gNumQueryRuns;
+}
+
 
 #pragma mark - INDEXES:
 
@@ -214,10 +234,19 @@ bool c4db_createIndex(C4Database *database,
     static_assert(sizeof(C4IndexOptions) == sizeof(IndexSpec::Options),
                   "IndexSpec::Options types must match");
     return tryCatch(outError, [&]{
-        database->defaultKeyStore().createIndex(slice(name),
-                                                indexSpecJSON,
-                                                (IndexSpec::Type)indexType,
-                                                (const IndexSpec::Options*)indexOptions);
+        auto options = (const IndexSpec::Options*)indexOptions;
+        if (options && options->buildInBackground && indexType == kC4ValueIndex) {
+            database->indexBuilder().build({string(slice(name)),
+                                            IndexSpec::kValue,
+                                            alloc_slice(indexSpecJSON),
+                                            options});
+        } else {
+            database->indexBuilder().cancel(string(slice(name)));
+            database->defaultKeyStore().createIndex(slice(name),
+                                                    indexSpecJSON,
+                                                    (IndexSpec::Type)indexType,
+                                                    options);
+        }
     });
 }
 
@@ -227,15 +256,28 @@ bool c4db_deleteIndex(C4Database *database,
                       C4Error *outError) noexcept
 {
     return tryCatch(outError, [&]{
+        database->indexBuilder().cancel(toString(name));
         database->defaultKeyStore().deleteIndex(toString(name));
     });
 }
 
+unsigned c4db_getIndexBuildInterruptionCount(void) C4API {
+    return IndexBuilder::gNumInterruptions;
+}
+
 static C4SliceResult getIndexes(C4Database* database, bool fullInfo, C4Error* outError) noexcept {
     return tryCatch<C4SliceResult>(outError, [&]{
+        auto building = database->indexBuilder().unfinishedBuilds();
+        auto isBuilding = [&](const string &name) {
+            return find_if(building.begin(), building.end(),
+                           [&](auto &b) {return b.name == name;}) != building.end();
+        };
+
         Encoder enc;
         enc.beginArray();
         for (const auto &spec : database->defaultKeyStore().getIndexes()) {
+            if (isBuilding(spec.name))
+                continue;       // Being replaced; the unfinished build is listed below instead
             if (fullInfo) {
                 enc.beginDictionary();
                 enc.writeKey("name"); enc.writeString(spec.name);
@@ -246,6 +288,22 @@ static C4SliceResult getIndexes(C4Database* database, bool fullInfo, C4Error* ou
                 enc.writeString(spec.name);
             }
         }
+        for (const auto &b : building) {
+            if (fullInfo) {
+                enc.beginDictionary();
+                enc.writeKey("name"); enc.writeString(b.name);
+                enc.writeKey("type"); enc.writeInt(b.type);
+                enc.writeKey("expr"); enc.writeString(b.expressionJSON);
+                if (b.error.empty()) {
+                    enc.writeKey("progress"); enc.writeDouble(b.progress);
+                } else {
+                    enc.writeKey("error"); enc.writeString(b.error);
+                }
+                enc.endDictionary();
+            } else {
+                enc.writeString(b.name);
+            }
+        }
         enc.endArray();
         return C4SliceResult(enc.finish());
     });
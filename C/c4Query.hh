@@ -39,7 +39,11 @@ struct c4Query : public RefCounted, public fleece::InstanceCountedIn<c4Query>, L
     void setParameters(slice parameters)    {_parameters = parameters;}
 
     Retained<C4QueryEnumeratorImpl> createEnumerator(const C4QueryOptions *c4options, slice encodedParameters) {
-        Query::Options options(encodedParameters ? encodedParameters : _parameters);
+        Query::Options options(encodedParameters ? encodedParameters : _parameters, 0, 0,
+                               c4options && c4options->streaming,
+                               c4options ? c4options->parallelism : 0,
+                               c4options && c4options->paginate,
+                               alloc_slice(c4options ? c4options->continuationToken : nullslice));
         return wrapEnumerator( _query->createEnumerator(&options) );
     }
 
@@ -48,38 +52,59 @@ struct c4Query : public RefCounted, public fleece::InstanceCountedIn<c4Query>, L
     }
 
     void enableObserver(c4QueryObserver *obs, bool enable) {
-        LOCK(_mutex);
-        if (enable) {
-            _observers.insert(obs);
-            if (!_bgQuerier) {
-                _bgQuerier = new LiveQuerier(_database, _query, true, this);
-                _bgQuerier->start(_parameters);
-            }
-        } else {
-            _observers.erase(obs);
-            if (_observers.empty() && _bgQuerier) {
-                _bgQuerier->stop();
-                _bgQuerier = nullptr;
+        Retained<LiveQuerier> stoppedQuerier;
+        {
+            LOCK(_mutex);
+            if (enable)
+                _observers.insert(obs);
+            else
+                _observers.erase(obs);
+            bool haveObservers = !_observers.empty();
+            if (haveObservers && !_bgQuerier) {
+                _bgQuerier = _database->liveQueriers().addDelegate(_query, _parameters, this);
+            } else if (!haveObservers && _bgQuerier) {
+                _database->liveQueriers().removeDelegate(_bgQuerier, this);
+                stoppedQuerier = move(_bgQuerier);
             }
         }
+        if (!enable) {
+            // Wait for a callback in progress on another thread, but only after releasing
+            // _mutex, since the callback may itself enable or disable observers:
+            if (stoppedQuerier)
+                stoppedQuerier->waitForCallbacks();
+            lock_guard<recursive_mutex> lock(_callbackMutex);
+        }
     }
 
     // called on a background thread!
     void liveQuerierUpdated(QueryEnumerator *qe, C4Error err) override {
         Retained<C4QueryEnumeratorImpl> c4e = wrapEnumerator(qe);
-        LOCK(_mutex);
-        if (!_bgQuerier)
-            return;
-        for (auto &obs : _observers)
-            obs->notify(c4e, err);
+        // Observers are called without holding _mutex, since a callback may enable or disable
+        // observers (itself included); see enableObserver.
+        lock_guard<recursive_mutex> callbackLock(_callbackMutex);
+        set<c4QueryObserver*> observers;
+        {
+            LOCK(_mutex);
+            observers = _observers;
+        }
+        for (auto obs : observers) {
+            if (isEnabled(obs))     // (an earlier callback may have disabled it)
+                obs->notify(c4e, err);
+        }
     }
 
 private:
+    bool isEnabled(c4QueryObserver *obs) {
+        LOCK(_mutex);
+        return _observers.find(obs) != _observers.end();
+    }
+
     Retained<Database> _database;
     Retained<Query> _query;
     alloc_slice _parameters;
 
-    mutable mutex _mutex;
+    mutable mutex _mutex;                   // Guards _observers & _bgQuerier
+    recursive_mutex _callbackMutex;         // Held while calling observers
     Retained<LiveQuerier> _bgQuerier;
     set<c4QueryObserver*> _observers;
 };
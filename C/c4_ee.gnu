@@ -46,6 +46,14 @@ CBL {
 		c4db_beginTransaction;
 		c4db_endTransaction;
 		c4db_isInTransaction;
+		c4db_getTransactionStats;
+		c4db_getStatementCacheStats;
+		c4db_getCacheStats;
+		c4_setDatabaseMemoryBudget;
+		c4_releaseDatabaseMemory;
+		c4db_borrowReader;
+		c4db_returnReader;
+		c4db_setMaxReaders;
 		c4db_getSharedFleeceEncoder;
 		c4db_getFLSharedKeys;
 		c4db_encodeJSON;
@@ -58,6 +66,7 @@ CBL {
 		c4doc_retain;
 		c4doc_release;
 		c4doc_get;
+		c4db_getDocuments;
 		c4doc_getBySequence;
 		c4db_purgeDoc;
 		c4doc_selectRevision;
@@ -72,6 +81,7 @@ CBL {
 		c4doc_selectNextPossibleAncestorOf;
 		c4doc_put;
 		c4doc_create;
+		c4db_bulkLoad;
 		c4doc_update;
 		c4doc_resolveConflict;
 		c4doc_purgeRevision;
@@ -108,6 +118,7 @@ CBL {
 		c4query_setParameters;
 		c4query_columnCount;
 		c4query_columnTitle;
+		c4db_getQueryCacheStats;
 		c4query_run;
 		c4query_explain;
 
@@ -378,12 +389,15 @@ CBL {
 		kC4DefaultQueryOptions;
 
 		c4queryenum_getRowCount;
+		c4queryenum_getContinuationToken;
 
 		c4query_fullTextMatched;
 
 		c4queryobs_create;
 		c4queryobs_setEnabled;
 		c4queryobs_getEnumerator;
+		c4queryobs_getRunCount;
+		c4db_getIndexBuildInterruptionCount;
 		c4queryobs_free;
 
 		c4blob_computeKey;
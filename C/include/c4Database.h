@@ -62,11 +62,18 @@ extern "C" {
         uint8_t bytes[32];
     } C4EncryptionKey;
 
-    /** Main database configuration struct (version 2) for use with c4db_openNamed etc.. */
+    /** Main database configuration struct (version 2) for use with c4db_openNamed etc..
+        By default a database connection's SQLite page cache is a quarter of the file size,
+        between 2MB and 32MB, and twice the file size (at least 50MB) is memory-mapped, except on
+        macOS where memory-mapping is off. Both are recomputed as the file grows or shrinks; the
+        cache size is also limited by \ref c4_setDatabaseMemoryBudget. Nonzero `cacheSize` and
+        `mmapSize` override this. */
     typedef struct C4DatabaseConfig2 {
         C4Slice parentDirectory;        ///< Directory for databases
         C4DatabaseFlags flags;          ///< Create, ReadOnly, NoUpgrade (AutoCompact & SharedKeys always set)
         C4EncryptionKey encryptionKey;  ///< Encryption to use creating/opening the db
+        int64_t cacheSize;              ///< Max bytes of SQLite page cache, or 0 for automatic
+        int64_t mmapSize;               ///< Max bytes of file to memory-map; 0 = automatic, -1 = none
     } C4DatabaseConfig2;
 
 
@@ -266,7 +273,89 @@ extern "C" {
     /** Is a transaction active? */
     bool c4db_isInTransaction(C4Database* database C4NONNULL) C4API;
 
-    
+    /** Statistics of the transactions committed to a database file, by all C4Database
+        instances open on it. Only one instance can be in a transaction at a time; when others
+        are waiting to begin one, the WAL checkpoint that would follow a commit is postponed to
+        the last of them, so that the group of commits shares the disk sync. */
+    typedef struct {
+        uint64_t commits;               ///< Number of transactions committed
+        uint64_t aborts;                ///< Number of transactions aborted
+        uint64_t groupedCommits;        ///< Commits made while another writer was waiting
+        uint64_t waits;                 ///< Number of times a writer waited for another's transaction
+        double   waitTime;              ///< Total seconds writers spent waiting
+        double   commitTime;            ///< Total seconds spent committing
+        double   maxCommitTime;         ///< Longest time a commit took, in seconds
+        uint64_t checkpoints;           ///< Number of WAL checkpoints made after commits
+        uint64_t deferredCheckpoints;   ///< Number of checkpoints postponed for waiting writers
+    } C4TransactionStats;
+
+    /** Returns statistics of the transactions on the database's file, for monitoring. */
+    C4TransactionStats c4db_getTransactionStats(C4Database* database C4NONNULL) C4API;
+
+    /** Statistics of a database's cache of compiled SQLite statements, which is used for the
+        internal bookkeeping queries LiteCore makes, such as looking up tables and indexes. */
+    typedef struct {
+        uint64_t hits;          ///< Number of times a cached statement was reused
+        uint64_t misses;        ///< Number of times a statement had to be compiled
+        uint32_t count;         ///< Number of statements currently in the cache
+    } C4StatementCacheStats;
+
+    /** Returns statistics of the database's compiled-statement cache, for monitoring. */
+    C4StatementCacheStats c4db_getStatementCacheStats(C4Database* database C4NONNULL) C4API;
+
+    /** Statistics of a database connection's SQLite page cache. */
+    typedef struct {
+        int64_t cacheSize;      ///< Current limit of the page cache, in bytes
+        int64_t mmapSize;       ///< Current limit of memory-mapped reads, in bytes
+        int64_t cacheUsed;      ///< Heap bytes currently used by the page cache
+        int64_t hits;           ///< Number of page reads found in the cache
+        int64_t misses;         ///< Number of page reads that went to the file
+        int64_t writes;         ///< Number of pages written from the cache to the file
+    } C4DatabaseCacheStats;
+
+    /** Returns statistics of the database connection's page cache, for monitoring. */
+    C4DatabaseCacheStats c4db_getCacheStats(C4Database* database C4NONNULL) C4API;
+
+    /** Sets a limit on the heap memory used by all open databases together; 0 (the default)
+        means no limit. As it's approached, SQLite reuses cache pages instead of allocating more,
+        and the automatic cache size of a database is limited to an equal share of it. */
+    void c4_setDatabaseMemoryBudget(int64_t bytes) C4API;
+
+    /** Frees as much memory as possible from the caches of all open databases. Call this when
+        the OS warns of low memory. Returns the number of bytes freed. */
+    int64_t c4_releaseDatabaseMemory(void) C4API;
+
+
+    /** @} */
+    /** \name Concurrent Readers
+        @{ */
+
+
+    /** Borrows a read-only database instance from a pool of connections to the same file,
+        so that documents can be read, enumerated and queried on many threads at once without
+        serializing on `database`. A reader may only be used by one thread at a time, and only
+        sees committed changes (not those of a transaction in progress on `database`.)
+        If the maximum number of readers are already borrowed, this blocks until one is returned.
+        This function is thread-safe.
+        @param database  The database to read from.
+        @param outError  On failure, the error info will be stored here.
+        @return  A read-only database, which must be returned with \ref c4db_returnReader. */
+    C4Database* c4db_borrowReader(C4Database* database C4NONNULL,
+                                  C4Error *outError) C4API;
+
+    /** Returns a reader borrowed by \ref c4db_borrowReader to the pool, and releases the
+        caller's reference to it. Any documents, enumerators or queries created from the reader
+        must be freed first. This function is thread-safe. */
+    void c4db_returnReader(C4Database* database C4NONNULL,
+                           C4Database* reader) C4API;
+
+    /** Sets the maximum number of readers that can be borrowed from the database at once.
+        Defaults to the number of CPU cores (at least 2, at most 16.) */
+    bool c4db_setMaxReaders(C4Database* database C4NONNULL,
+                            unsigned maxReaders,
+                            C4Error *outError) C4API;
+
+
     /** @} */
     /** @} */
 
@@ -326,6 +415,8 @@ extern "C" {
         C4StorageEngine storageEngine;  ///< Which storage to use, or NULL for no preference
         C4DocumentVersioning versioning;///< Type of document versioning
         C4EncryptionKey encryptionKey;  ///< Encryption to use creating/opening the db
+        int64_t cacheSize;              ///< Max bytes of SQLite page cache, or 0 for automatic
+        int64_t mmapSize;               ///< Max bytes of file to memory-map; 0 = automatic, -1 = none
     } C4DatabaseConfig;
 
     C4_DEPRECATED("Use c4db_openNamed")
@@ -99,6 +99,25 @@ extern "C" {
                           bool mustExist,
                           C4Error *outError) C4API;
 
+    /** Gets multiple documents from the database at once, which is much faster than calling
+        \ref c4doc_get for each one. The documents are stored into `outDocs` in the same order as
+        the docIDs. A nonexistent document is stored as NULL if `mustExist` is true, else as an
+        empty C4Document, just as with \ref c4doc_get.
+        You must call `c4doc_release()` on each non-NULL document when finished with it.
+        @param database  The database to read from.
+        @param docIDs  An array of `count` document IDs.
+        @param count  The number of document IDs.
+        @param mustExist  If true, missing documents are stored as NULL.
+        @param outDocs  An array with room for `count` documents.
+        @param outError  On failure, error information is stored here.
+        @return  True on success, false on failure (in which case `outDocs` is filled with NULL.) */
+    bool c4db_getDocuments(C4Database *database C4NONNULL,
+                           const C4String docIDs[] C4NONNULL,
+                           size_t count,
+                           bool mustExist,
+                           C4Document* outDocs[] C4NONNULL,
+                           C4Error *outError) C4API;
+
     /** Gets a document from the database given its sequence number.
         You must call `c4doc_release()` when finished with the document.  */
     C4Document* c4doc_getBySequence(C4Database *database C4NONNULL,
@@ -372,6 +391,33 @@ extern "C" {
                              C4RevisionFlags revisionFlags,
                              C4Error *error) C4API;
 
+    /** A document to be saved by `c4db_bulkLoad`. */
+    typedef struct {
+        C4String docID;             ///< Document ID (required)
+        C4Slice body;               ///< Fleece-encoded body, as from `c4db_createFleeceEncoder`
+        C4RevisionFlags revFlags;   ///< Revision flags (deletion, attachments)
+    } C4BulkDocument;
+
+    /** Saves many new documents at once, as when initially populating a database. This is much
+        faster than calling `c4doc_create` for each one:
+        * Value indexes aren't updated as each document is saved; instead they're rebuilt when the
+          outermost transaction commits. (Full-text and array indexes are updated normally.)
+        * If there are no database or document observers, and the database file isn't open in
+          any other C4Database, change notifications aren't recorded.
+        A document that already exists is updated with a new revision, as by `c4doc_update`.
+        The bodies must be Fleece-encoded using the database's shared keys.
+        Must be called within a transaction; it's best to use one transaction for the entire
+        load, calling this function with batches of a few thousand documents.
+        @param db  The database to save the documents to.
+        @param docs  An array of documents to save.
+        @param count  The number of items in `docs`.
+        @param outError  On failure, the error will be stored here.
+        @return  True on success, false on failure. */
+    bool c4db_bulkLoad(C4Database *db C4NONNULL,
+                       const C4BulkDocument docs[] C4NONNULL,
+                       size_t count,
+                       C4Error *outError) C4API;
+
     /** Adds a revision to a document already in memory as a C4Document. This is more efficient
         than c4doc_put because it doesn't have to read from the database before writing; but if
         the C4Document doesn't have the current state of the document, it will fail with the error
@@ -68,6 +68,28 @@ extern "C" {
             To provide a custom list of words, use a string containing the words in lowercase
             separated by spaces. */
         const char *stopWords;
+
+        /** If true, a value index is built asynchronously on a background thread, instead of
+            blocking until it's complete; `c4db_createIndex` returns as soon as the build is
+            scheduled. Until the build finishes the index doesn't exist as far as queries are
+            concerned, and `c4db_getIndexesInfo` reports its progress.
+            The build periodically gets out of the way of transactions on other threads, so
+            they aren't blocked for long. Ignored for other index types. */
+        bool buildInBackground;
+
+        /** If true, a full-text index is stored in an SQLite FTS5 table instead of FTS4. FTS5
+            indexes are faster to update, since they merge their segments incrementally instead
+            of all at once, and can index word prefixes (see `prefixLengths`.) The language,
+            diacritics, stemming and stop-word options apply the same way, and queries use the
+            same `MATCH` and `RANK` functions, though FTS5's query syntax differs slightly: for
+            example `NEAR` takes the form `NEAR(word1 word2, 10)`.
+            Ignored for other index types. */
+        bool useFTS5;
+
+        /** FTS5 full-text indexes only: the lengths of word prefixes to index, as a string of
+            numbers separated by spaces, like "2 3". This makes prefix queries like `ma*` much
+            faster, at the cost of a bigger index. NULL means no prefix indexes. */
+        const char *prefixLengths;
     } C4IndexOptions;
 
 
@@ -107,6 +129,11 @@ extern "C" {
           expression is already an array, so there are two levels of nesting.)
         * `WHERE`: An optional expression. Including this creates a _partial index_: documents
           for which this expression returns `false` or `null` will be skipped.
+        * `INCLUDE`: (Value indexes only) An optional array of property expressions to store in
+          the index along with the `WHAT` properties. This creates a _covering index_: a query
+          that only uses these properties and document metadata (`_id`, `_sequence`, `_deleted`)
+          can be answered from the index alone, without reading any document bodies. Can't be
+          combined with `WHERE`.
 
         For backwards compatibility, `indexSpecJSON` may be an array; this is treated as if it were
         a dictionary with a `WHAT` key mapping to that array.
@@ -150,6 +177,10 @@ extern "C" {
     /** Returns information about all indexes in the database.
         The result is a Fleece-encoded array of dictionaries, one per index.
         Each dictionary has keys `"name"`, `"type"` (a `C4IndexType`), and `"expr"` (the source expression).
+        An index that's being built in the background (see `C4IndexOptions.buildInBackground`)
+        also has a `"progress"` key, whose value is the estimated fraction complete (0.0 to 1.0);
+        or if its build failed, an `"error"` key whose value is the error message. Such an index
+        can't yet be used by queries.
         @param database  The database to check
         @param outError  On failure, will be set to the error status.
         @return  A Fleece-encoded array of dictionaries, or NULL on failure. */
@@ -57,7 +57,9 @@ extern "C" {
 
     /** Returns a string describing the implementation of the compiled query.
         This is intended to be read by a developer for purposes of optimizing the query, especially
-        to add database indexes. */
+        to add database indexes. For a query with both ORDER_BY and LIMIT, it also states whether
+        the results are read in the order of an index (stopping after the LIMIT), or every matching
+        row is read and sorted. */
     C4StringResult c4query_explain(C4Query* C4NONNULL) C4API;
 
 
@@ -73,16 +75,57 @@ extern "C" {
     FLString c4query_columnTitle(C4Query* C4NONNULL, unsigned column) C4API;
 
 
+    /** Statistics of a database's cache of compiled queries. Queries created with
+        \ref c4query_new2 whose expressions are identical (ignoring formatting) share a single
+        compiled form, which is discarded when the database's indexes or schema change. */
+    typedef struct {
+        uint64_t hits;          ///< Number of times a cached compiled query was reused
+        uint64_t misses;        ///< Number of times a query had to be compiled
+        uint32_t count;         ///< Number of compiled queries currently in the cache
+    } C4QueryCacheStats;
+
+    /** Returns statistics of the database's compiled-query cache, for monitoring. */
+    C4QueryCacheStats c4db_getQueryCacheStats(C4Database* C4NONNULL) C4API;
+
+
     //////// RUNNING QUERIES:
 
 
     /** Options for running queries. */
     typedef struct {
         bool rankFullText_DEPRECATED;      ///< Ignored; use the `rank()` query function instead.
+        /** If true, rows are read from the database incrementally as \ref c4queryenum_next is
+            called, instead of all being collected before \ref c4query_run returns. This lowers
+            the latency of the first row and the memory usage of large result sets, but the
+            enumerator doesn't support \ref c4queryenum_seek or \ref c4queryenum_getRowCount.
+            While rows are being read, the database file's WAL can't be checkpointed, so if the
+            enumerator is still open after a few seconds (even if it's idle) it reads the
+            remaining rows into memory.
+            The enumerator should be closed (\ref c4queryenum_close) before the database is. */
+        bool streaming;
+        /** If greater than 1, a query that scans the documents may split the scan into up to
+            this many ranges of documents, and run them in parallel on separate threads and
+            database connections before combining their results. Only simple queries are run this
+            way: no DISTINCT, HAVING, JOIN, UNNEST, MATCH, COLLATE or nested SELECT, and any
+            aggregate function must be a whole result column. Other queries, small databases, and
+            streaming queries run normally. */
+        unsigned parallelism;
+        /** If true, the query is run for pagination: its enumerator provides a continuation
+            token (\ref c4queryenum_getContinuationToken) that can be passed back in
+            `continuationToken` to get the next page of results. A query with an `ORDER_BY` and
+            a `LIMIT` can be paged through this way at the same cost for each page, since it seeks
+            directly to the row after the previous page's last one instead of skipping `OFFSET`
+            rows. (The `OFFSET` only applies to the first page.) Not supported with DISTINCT,
+            GROUP_BY, aggregate functions, JOIN, UNNEST, MATCH or streaming. */
+        bool paginate;
+        /** A token returned by \ref c4queryenum_getContinuationToken from an earlier run of the
+            same query; the results will start after that run's last row. Implies `paginate`. */
+        C4Slice continuationToken;
     } C4QueryOptions;
 
 
-    /** Default query options. Has skip=0, limit=UINT_MAX, rankFullText=true. */
+    /** Default query options. Has skip=0, limit=UINT_MAX, rankFullText=true, streaming=false,
+        parallelism=0. */
 	CBL_CORE_API extern const C4QueryOptions kC4DefaultQueryOptions;
 
 
@@ -164,6 +207,15 @@ extern "C" {
     int64_t c4queryenum_getRowCount(C4QueryEnumerator *e C4NONNULL,
                                      C4Error *outError) C4API;
 
+    /** Returns a token representing the position after the last row of a query run with the
+        `paginate` option. Pass it as the `continuationToken` of the next run of the same query
+        to get the next page of results.
+        @param e  The query enumerator
+        @param outError  On failure, an error will be stored here.
+        @return  The token, or a null slice if the query isn't paginated or returned no rows. */
+    C4SliceResult c4queryenum_getContinuationToken(C4QueryEnumerator *e C4NONNULL,
+                                                   C4Error *outError) C4API;
+
     /** Jumps to a specific row. Not all query enumerators may support this (but the current
         implementation does.)
         @param e  The query enumerator
@@ -334,9 +334,19 @@ extern "C" {
     #define kC4ReplicatorOptionRemoteDBUniqueID "remoteDBUniqueID" ///< Stable ID for remote db with unstable URL (string)
     #define kC4ReplicatorOptionProgressLevel    "progress"  ///< If >=1, notify on every doc; if >=2, on every attachment (int)
     #define kC4ReplicatorOptionDisableDeltas    "noDeltas"   ///< Disables delta sync (bool)
+    #define kC4ReplicatorOptionDisableFleeceRevs "noFleeceRevs" ///< Always send revs as JSON (bool)
     #define kC4ReplicatorOptionMaxRetries       "maxRetries" ///< Max number of retry attempts (int)
     #define kC4ReplicatorOptionMaxRetryInterval "maxRetryInterval" ///< Max delay betw retries (secs)
 
+    // Flow-control options; each overrides a default that's otherwise chosen (or adjusted at
+    // runtime) by the replicator:
+    #define kC4ReplicatorOptionMaxRevsInFlight  "maxRevsInFlight" ///< Max 'rev' msgs being sent (int)
+    #define kC4ReplicatorOptionMaxRevBytesAwaitingReply "maxRevBytesAwaitingReply" ///< Max bytes of sent revs awaiting reply (int)
+    #define kC4ReplicatorOptionChangesBatchSize "changesBatchSize" ///< Changes per incoming 'changes' msg (int)
+    #define kC4ReplicatorOptionInsertionBatchSize "insertionBatchSize" ///< Max revs per insertion transaction (int)
+    #define kC4ReplicatorOptionInsertionDelay   "insertionDelay" ///< Max time a rev waits to be inserted (ms, int)
+    #define kC4ReplicatorOptionParserThreads    "parserThreads" ///< Min threads parsing incoming revs (int)
+
     // TLS options:
     #define kC4ReplicatorOptionRootCerts        "rootCerts"  ///< Trusted root certs (data)
     #define kC4ReplicatorOptionPinnedServerCert "pinnedCert"  ///< Cert or public key (data)
@@ -22,6 +22,7 @@
 #include "c4BlobStore.h"
 #include "FilePath.hh"
 #include "SecureRandomize.hh"
+#include <atomic>
 #include <cmath>
 #include <errno.h>
 #include <iostream>
@@ -165,6 +166,7 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database OpenBundle", "[Database][C][!th
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Transaction", "[Database][C]") {
     REQUIRE(c4db_getDocumentCount(db) == (C4SequenceNumber)0);
     REQUIRE(!c4db_isInTransaction(db));
+    C4TransactionStats stats0 = c4db_getTransactionStats(db);
     C4Error(error);
     REQUIRE(c4db_beginTransaction(db, &error));
     REQUIRE(c4db_isInTransaction(db));
@@ -181,6 +183,11 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Transaction", "[Database][C]")
     REQUIRE(c4db_endTransaction(db, false, &error));
     REQUIRE(!c4db_isInTransaction(db));
     CHECK(c4db_getDocumentCount(db) == 0);
+
+    C4TransactionStats stats = c4db_getTransactionStats(db);
+    CHECK(stats.commits == stats0.commits + 1);
+    CHECK(stats.aborts == stats0.aborts + 1);
+    CHECK(stats.groupedCommits == stats0.groupedCommits);
 }
 
 
@@ -534,6 +541,47 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BackgroundDB torture test", "[D
     c4log_setLevel(kC4DatabaseLog, oldLevel);
 }
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Concurrent Readers", "[Database][C]")
+{
+    createNumberedDocs(10);
+    C4Error error;
+    REQUIRE(c4db_setMaxReaders(db, 2, &error));
+    C4Database *reader1 = c4db_borrowReader(db, &error);
+    REQUIRE(reader1);
+    C4Database *reader2 = c4db_borrowReader(db, &error);
+    REQUIRE(reader2);
+    CHECK(reader1 != reader2);
+    CHECK(c4db_getDocumentCount(reader1) == 10);
+
+    // Readers don't see uncommitted changes:
+    {
+        TransactionHelper t(db);
+        createRev("doc-011"_sl, kRevID, kFleeceBody);
+        C4Document *doc = c4doc_get(reader1, "doc-011"_sl, true, &error);
+        CHECK(!doc);
+        CHECK(error.domain == LiteCoreDomain);
+        CHECK(error.code == kC4ErrorNotFound);
+    }
+    C4Document *doc = c4doc_get(reader2, "doc-011"_sl, true, &error);
+    REQUIRE(doc);
+    CHECK(doc->revID == kRevID);
+    c4doc_release(doc);
+
+    // Both readers are in use, so borrowing another one blocks until one is returned:
+    atomic<bool> borrowed {false};
+    thread other([&]{
+        C4Database *reader3 = c4db_borrowReader(db, nullptr);
+        borrowed = (reader3 != nullptr);
+        c4db_returnReader(db, reader3);
+    });
+    this_thread::sleep_for(chrono::milliseconds(200));
+    CHECK(!borrowed);
+    c4db_returnReader(db, reader1);
+    other.join();
+    CHECK(borrowed);
+    c4db_returnReader(db, reader2);
+}
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BlobStore", "[Database][C]")
 {
     C4Error err;
@@ -843,6 +891,18 @@ static void testOpeningOlderDBFixture(const string & dbPath,
     CHECK(error.code == 0);
     CHECK(i == 101);
 
+    if (!(withFlags & kC4DB_ReadOnly)) {
+        // Verify updating a document that was saved by the older version:
+        C4Test::createFleeceRev(db, "doc-001"_sl, "2-ffff"_sl, R"({"n":1,"updated":true})"_sl);
+        C4Document *doc = c4doc_get(db, "doc-001"_sl, true, &error);
+        REQUIRE(doc);
+        CHECK(slice(doc->revID) == "2-ffff"_sl);
+        alloc_slice json = c4doc_bodyAsJSON(doc, true, &error);
+        CHECK(json == R"({"n":1,"updated":true})"_sl);
+        CHECK(c4doc_selectParentRevision(doc));
+        c4doc_release(doc);
+    }
+
     CHECK(c4db_delete(db, &error));
     c4db_release(db);
 }
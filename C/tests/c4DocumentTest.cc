@@ -19,6 +19,8 @@
 #include "c4Test.hh"
 #include "c4Document+Fleece.h"
 #include "c4Private.h"
+#include "c4Index.h"
+#include "c4Query.h"
 #include "Benchmark.hh"
 #include "fleece/Fleece.hh"
 
@@ -386,6 +388,53 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document CreateMultipleRevisions", "[Database][C
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4Test, "Document Current Body Stored Separately", "[Document][C]") {
+    if (!isRevTrees()) return;
+
+    const auto kFleeceBody2 = json2fleece(("{'ok':'" + std::string(1000, 'x') + "'}").c_str());
+    const auto kFleeceBody3 = json2fleece("{'ubu':'roi'}");
+    createRev(kDocID, kRevID, kFleeceBody);
+    createRev(kDocID, kRev2ID, kFleeceBody2, kRevKeepBody);
+    createRev(kDocID, kRev3ID, kFleeceBody3);
+
+    // The record body holds only the current revision; the rest of the tree, including the
+    // (big) body of revision 2, is in the `extra` column:
+    C4Error error;
+    alloc_slice result = c4db_rawQuery(db, "SELECT length(body), length(extra) FROM kv_default"_sl,
+                                       &error);
+    REQUIRE(result);
+    Array row = Value::fromData(result).asArray()[0].asArray();
+    int64_t bodySize = row[0].asInt(), extraSize = row[1].asInt();
+    CHECK(bodySize > int64_t(kFleeceBody3.size));
+    CHECK(bodySize < int64_t(kFleeceBody2.size));
+    CHECK(extraSize > int64_t(kFleeceBody2.size));
+
+    // Reading the doc puts the two back together:
+    C4Document *doc = c4doc_get(db, kDocID, true, &error);
+    REQUIRE(doc);
+    CHECK(doc->selectedRev.revID == kRev3ID);
+    CHECK(doc->selectedRev.body == kFleeceBody3);
+    REQUIRE(c4doc_selectParentRevision(doc));
+    CHECK(doc->selectedRev.revID == kRev2ID);
+    CHECK(doc->selectedRev.body == kFleeceBody2);
+    REQUIRE(c4doc_selectParentRevision(doc));
+    CHECK(doc->selectedRev.revID == kRevID);
+    CHECK(!c4doc_hasRevisionBody(doc));
+    c4doc_release(doc);
+
+    // Queries see the current revision:
+    C4Query *query = c4query_new2(db, kC4N1QLQuery,
+                                  "SELECT META().id FROM _ WHERE ubu = 'roi'"_sl,
+                                  nullptr, &error);
+    REQUIRE(query);
+    C4QueryEnumerator *e = c4query_run(query, nullptr, nullslice, &error);
+    REQUIRE(e);
+    CHECK(c4queryenum_getRowCount(e, &error) == 1);
+    c4queryenum_release(e);
+    c4query_release(query);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4Test, "Document Get Single Revision", "[Document][C]") {
     if (!isRevTrees()) return;
 
@@ -421,6 +470,78 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document Get Single Revision", "[Document][C]")
     CHECK(error.code == kC4ErrorNotFound);
 }
 
+N_WAY_TEST_CASE_METHOD(C4Test, "Document Get Multiple", "[Document][C]") {
+    createNumberedDocs(100);
+    C4String docIDs[4] = {"doc-042"_sl, "doc-nope"_sl, "doc-001"_sl, "doc-042"_sl};
+    C4Document* docs[4];
+    C4Error error;
+    for (bool mustExist : {true, false}) {
+        REQUIRE(c4db_getDocuments(db, docIDs, 4, mustExist, docs, &error));
+        for (int i = 0; i < 4; i++) {
+            if (i == 1) {
+                if (mustExist) {
+                    CHECK(docs[i] == nullptr);
+                } else {
+                    REQUIRE(docs[i]);
+                    CHECK(!(docs[i]->flags & kDocExists));
+                    CHECK(docs[i]->docID == docIDs[i]);
+                }
+            } else {
+                REQUIRE(docs[i]);
+                CHECK(docs[i]->docID == docIDs[i]);
+                CHECK(docs[i]->revID == kRevID);
+                CHECK(docs[i]->selectedRev.body == kFleeceBody);
+            }
+            c4doc_release(docs[i]);
+        }
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4Test, "Document Bulk Load", "[Document][C]") {
+    C4Error error;
+    REQUIRE(c4db_createIndex(db, C4STR("byNum"), C4STR("[[\".num\"]]"),
+                             kC4ValueIndex, nullptr, &error));
+    createRev("c"_sl, kRevID, kFleeceBody);
+
+    alloc_slice bodies[3] = {json2fleece("{'num':1}"), json2fleece("{'num':2}"),
+                             json2fleece("{'num':3}")};
+    C4BulkDocument docs[3] = {
+        {"a"_sl, bodies[0], 0},
+        {"b"_sl, bodies[1], 0},
+        {"c"_sl, bodies[2], 0},       // already exists, so gets updated
+    };
+    CHECK(!c4db_bulkLoad(db, docs, 3, &error));     // not in a transaction
+    CHECK(error.code == kC4ErrorNotInTransaction);
+    {
+        TransactionHelper t(db);
+        REQUIRE(c4db_bulkLoad(db, docs, 3, &error));
+    }
+
+    CHECK(c4db_getDocumentCount(db) == 3);
+    for (int i = 0; i < 3; i++) {
+        C4Document *doc = c4doc_get(db, docs[i].docID, true, &error);
+        REQUIRE(doc);
+        CHECK(doc->selectedRev.body == bodies[i]);
+        CHECK(c4rev_getGeneration(doc->revID) == (i < 2 ? 1 : 2));
+        c4doc_release(doc);
+    }
+
+    // The index should have been rebuilt and be used by a query:
+    C4Query *query = c4query_new2(db, kC4N1QLQuery,
+                                  "SELECT META().id FROM _ WHERE num > 1 ORDER BY num"_sl,
+                                  nullptr, &error);
+    REQUIRE(query);
+    alloc_slice explanation = c4query_explain(query);
+    CHECK(explanation.asString().find("byNum") != std::string::npos);
+    C4QueryEnumerator *e = c4query_run(query, nullptr, nullslice, &error);
+    REQUIRE(e);
+    CHECK(c4queryenum_getRowCount(e, &error) == 2);
+    c4queryenum_release(e);
+    c4query_release(query);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4Test, "Document Purge", "[Database][C]") {
     const auto kFleeceBody2 = json2fleece("{'ok':'go'}");
     const auto kFleeceBody3 = json2fleece("{'ubu':'roi'}");
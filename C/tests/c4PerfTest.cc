@@ -252,7 +252,50 @@ public:
         fout << contents;
         fout.close();
     }
-    
+
+
+    // Like importJSONLines, but saves the docs with c4db_bulkLoad in batches.
+    unsigned bulkImportJSONLines(string path, double timeout =0.0, size_t batchSize =1000) {
+        C4Log("Reading %s ...  ", path.c_str());
+        Stopwatch st;
+        unsigned numDocs = 0;
+        vector<alloc_slice> docIDs, bodies;
+        vector<C4BulkDocument> batch;
+        auto flush = [&]() {
+            C4Error c4err;
+            REQUIRE(c4db_bulkLoad(db, batch.data(), batch.size(), &c4err));
+            docIDs.clear();
+            bodies.clear();
+            batch.clear();
+        };
+        {
+            TransactionHelper t(db);
+            readFileByLines(path, [&](FLSlice line) {
+                C4Error c4err;
+                alloc_slice body = c4db_encodeJSON(db, {line.buf, line.size}, &c4err);
+                REQUIRE(body.buf);
+                char docID[20];
+                sprintf(docID, "%07u", ++numDocs);
+                docIDs.emplace_back(slice(docID));
+                bodies.push_back(body);
+                batch.push_back({docIDs.back(), body, 0});
+                if (batch.size() >= batchSize) {
+                    flush();
+                    if (timeout > 0.0 && st.elapsed() >= timeout) {
+                        C4Warn("Stopping JSON import after %.3f sec  ", st.elapsed());
+                        return false;
+                    }
+                }
+                return true;
+            });
+            if (!batch.empty())
+                flush();
+            C4Log("Committing...");
+        }
+        st.printReport("Bulk importing", numDocs, "doc");
+        return numDocs;
+    }
+
 private:
     const char* _showFastDir {nullptr};
 };
@@ -312,6 +355,26 @@ N_WAY_TEST_CASE_METHOD(PerfTest, "Import names", "[Perf][C][.slow]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(PerfTest, "Bulk import names", "[Perf][C][.slow]") {
+    // Same data as "Import names", but with the index created first, and loaded with
+    // c4db_bulkLoad, which defers updating the index until the transaction commits.
+    C4Error error;
+    REQUIRE(c4db_createIndex(db, C4STR("byState"), C4STR("[[\".contact.address.state\"]]"),
+                             kC4ValueIndex, nullptr, &error));
+    Stopwatch st;
+    auto numDocs = bulkImportJSONLines(sFixturesDir + "names_300000.json", 30.0);
+    st.stop();
+    st.printReport("******** Bulk importing names w/index", numDocs, "doc");
+    string sf = generateShowfast((double)numDocs / st.elapsed(), "names_bulk_import");
+    writeShowFastToFile("names_bulk_import", sf);
+#ifdef NDEBUG
+    REQUIRE(numDocs == 300000);
+#endif
+    auto n = queryWhere("[\"=\", [\".contact.address.state\"], \"WA\"]");
+    if (numDocs == 300000) CHECK(n == 5053);
+}
+
+
 N_WAY_TEST_CASE_METHOD(PerfTest, "Import geoblocks", "[Perf][C][.slow]") {
     // Download https://github.com/arangodb/example-datasets/raw/master/IPRanges/geoblocks.json
     // to C/tests/data/ before running this test.
@@ -335,3 +398,123 @@ N_WAY_TEST_CASE_METHOD(PerfTest, "Import Wikipedia", "[Perf][C][.slow]") {
     reopenDB();
     readRandomDocs(numDocs, 100000);
 }
+
+
+N_WAY_TEST_CASE_METHOD(PerfTest, "Bulk import Wikipedia", "[Perf][C][.slow]") {
+    // See "Import Wikipedia" for where to get the data file.
+    Stopwatch st;
+    auto numDocs = bulkImportJSONLines(sFixturesDir + "en-wikipedia-articles-1000-1.json", 15.0);
+    st.stop();
+    st.printReport("******** Bulk importing Wikipedia", numDocs, "doc");
+    CHECK(c4db_getDocumentCount(db) == numDocs);
+
+    reopenDB();
+    readRandomDocs(numDocs, 100000);
+}
+
+
+N_WAY_TEST_CASE_METHOD(PerfTest, "Concurrent readers", "[Perf][C][.slow]") {
+    // Measures doc-read throughput as the number of threads, each using its own reader from
+    // c4db_borrowReader, increases. Ideally this scales with the number of CPU cores.
+    static constexpr unsigned kNumDocs = 20000, kReadsPerThread = 50000;
+    {
+        TransactionHelper t(db);
+        char docID[20];
+        for (unsigned i = 1; i <= kNumDocs; i++) {
+            sprintf(docID, "doc-%05u", i);
+            createRev(c4str(docID), kRevID, kFleeceBody);
+        }
+    }
+
+    unsigned maxThreads = max(thread::hardware_concurrency(), 2u);
+    REQUIRE(c4db_setMaxReaders(db, maxThreads, nullptr));
+    double baseRate = 0;
+    for (unsigned nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        Stopwatch st;
+        vector<thread> threads;
+        for (unsigned t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&] {
+                C4Database *reader = c4db_borrowReader(db, nullptr);
+                C4Assert(reader);
+                for (unsigned n = 0; n < kReadsPerThread; ++n) {
+                    char docID[20];
+                    sprintf(docID, "doc-%05u", litecore::RandomNumber(kNumDocs) + 1);
+                    C4Document *doc = c4doc_get(reader, c4str(docID), true, nullptr);
+                    C4Assert(doc);
+                    c4doc_release(doc);
+                }
+                c4db_returnReader(db, reader);
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        st.stop();
+
+        double rate = nThreads * kReadsPerThread / st.elapsed();
+        if (nThreads == 1)
+            baseRate = rate;
+        fprintf(stderr, "%2u threads: %8.0f docs/sec  (%.2fx)\n", nThreads, rate, rate / baseRate);
+        string title = "concurrent_reads_" + to_string(nThreads) + "_threads";
+        writeShowFastToFile(title, generateShowfast(round(rate), title));
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(PerfTest, "Concurrent writers", "[Perf][C][.slow]") {
+    // Measures commit throughput as the number of threads, each committing small transactions
+    // through its own instance of the database, increases. Commits are serialized, but the
+    // WAL checkpoints are shared by groups of waiting writers (see C4TransactionStats.)
+    static constexpr unsigned kTransactionsPerThread = 2000;
+    unsigned maxThreads = 8;
+    double baseRate = 0;
+    for (unsigned nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        vector<C4Database*> writers;
+        for (unsigned t = 0; t < nThreads; ++t)
+            writers.push_back(c4db_openAgain(db, nullptr));
+        C4TransactionStats stats0 = c4db_getTransactionStats(db);
+
+        Stopwatch st;
+        vector<thread> threads;
+        for (unsigned t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&, t] {
+                C4Database *writer = writers[t];
+                C4Assert(writer);
+                for (unsigned n = 0; n < kTransactionsPerThread; ++n) {
+                    char docID[40];
+                    sprintf(docID, "doc-%u-%u-%05u", nThreads, t, n);
+                    C4Assert(c4db_beginTransaction(writer, nullptr));
+                    C4DocPutRequest rq = {};
+                    rq.docID = c4str(docID);
+                    rq.body = kFleeceBody;
+                    rq.save = true;
+                    C4Document *doc = c4doc_put(writer, &rq, nullptr, nullptr);
+                    C4Assert(doc);
+                    c4doc_release(doc);
+                    C4Assert(c4db_endTransaction(writer, true, nullptr));
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        st.stop();
+
+        C4TransactionStats stats = c4db_getTransactionStats(db);
+        for (auto writer : writers)
+            c4db_release(writer);
+
+        uint64_t commits = stats.commits - stats0.commits;
+        double rate = commits / st.elapsed();
+        if (nThreads == 1)
+            baseRate = rate;
+        fprintf(stderr, "%2u threads: %8.0f commits/sec  (%.2fx); avg commit %.3fms, "
+                "avg wait %.3fms, %llu grouped, %llu checkpoints (%llu deferred)\n",
+                nThreads, rate, rate / baseRate,
+                (stats.commitTime - stats0.commitTime) / commits * 1000.0,
+                (stats.waitTime - stats0.waitTime) / commits * 1000.0,
+                (unsigned long long)(stats.groupedCommits - stats0.groupedCommits),
+                (unsigned long long)(stats.checkpoints - stats0.checkpoints),
+                (unsigned long long)(stats.deferredCheckpoints - stats0.deferredCheckpoints));
+        string title = "concurrent_writes_" + to_string(nThreads) + "_threads";
+        writeShowFastToFile(title, generateShowfast(round(rate), title));
+    }
+}
@@ -20,6 +20,7 @@
 #include "c4BlobStore.h"
 #include "c4Observer.h"
 #include "StringUtil.hh"
+#include <atomic>
 #include <thread>
 
 
@@ -982,6 +983,271 @@ N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query observer", "[Query][C][!throws]") {
     CHECK(c4queryenum_getRowCount(e2, &error) == 8);
 }
 
+N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query observer re-runs only for relevant changes", "[Query][C][!throws]") {
+    compile(json5("['=', ['.', 'contact', 'address', 'state'], 'CA']"));
+    C4Error error;
+    atomic<int> count {0};
+    auto callback = [](C4QueryObserver *obs, C4Query *query, void *context) {
+        ++*(atomic<int>*)context;
+    };
+    c4::ref<C4QueryObserver> obs = c4queryobs_create(query, callback, &count);
+    c4queryobs_setEnabled(obs, true);
+    WaitUntil(2000, [&]{return count > 0;});
+    REQUIRE(count == 1);
+
+    // A change to a doc that doesn't match, before or after, doesn't re-run the query:
+    count = 0;
+    unsigned runs = c4queryobs_getRunCount();
+    addPersonInState("after1", "AL");
+    this_thread::sleep_for(chrono::milliseconds(1000));
+    CHECK(c4queryobs_getRunCount() == runs);
+    CHECK(count == 0);
+
+    // A new doc that matches does:
+    addPersonInState("after2", "CA");
+    WaitUntil(2000, [&]{return count > 0;});
+    CHECK(count == 1);
+    CHECK(c4queryobs_getRunCount() - runs == 1);
+    c4::ref<C4QueryEnumerator> e = c4queryobs_getEnumerator(obs, true, &error);
+    REQUIRE(e);
+    CHECK(c4queryenum_getRowCount(e, &error) == 9);
+
+    // So does a change to a doc that matched, after which it no longer does:
+    count = 0;
+    runs = c4queryobs_getRunCount();
+    {
+        TransactionHelper t(db);
+        c4::ref<C4Document> doc = c4doc_get(db, C4STR("0000001"), true, &error);
+        REQUIRE(doc);
+        c4::ref<C4Document> updated = c4doc_update(doc,
+                                    json2fleece("{'contact':{'address':{'state':'AL'}}}"),
+                                    0, &error);
+        REQUIRE(updated);
+    }
+    WaitUntil(2000, [&]{return count > 0;});
+    CHECK(count == 1);
+    CHECK(c4queryobs_getRunCount() - runs == 1);
+    e = c4queryobs_getEnumerator(obs, true, &error);
+    REQUIRE(e);
+    CHECK(c4queryenum_getRowCount(e, &error) == 8);
+    c4queryobs_setEnabled(obs, false);
+}
+
+N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query observers of identical queries", "[Query][C][!throws]") {
+    // Two separate C4Queries with the same expression share a single LiveQuerier, but each
+    // observer still gets its own enumerator:
+    string queryStr = json5("['SELECT', {WHAT: [['._id']], WHERE: ['=', ['.', 'contact', 'address', 'state'], 'CA']}]");
+    compileSelect(queryStr);
+    C4Error error;
+    c4::ref<C4Query> query2 = c4query_new(db, c4str(queryStr.c_str()), &error);
+    REQUIRE(query2);
+
+    struct State {
+        c4::ref<C4QueryObserver> obs;
+        atomic<int> count = 0;
+    };
+    auto callback = [](C4QueryObserver *obs, C4Query *query, void *context) {
+        ++((State*)context)->count;
+    };
+    State state1, state2;
+    state1.obs = c4queryobs_create(query, callback, &state1);
+    state2.obs = c4queryobs_create(query2, callback, &state2);
+    unsigned runs = c4queryobs_getRunCount();
+    c4queryobs_setEnabled(state1.obs, true);
+    c4queryobs_setEnabled(state2.obs, true);
+
+    C4Log("---- Waiting for query observers...");
+    WaitUntil(2000, [&]{return state1.count > 0 && state2.count > 0;});
+    CHECK(state1.count == 1);
+    CHECK(state2.count == 1);
+    CHECK(c4queryobs_getRunCount() - runs == 1);    // the query only ran once
+
+    c4::ref<C4QueryEnumerator> e1 = c4queryobs_getEnumerator(state1.obs, true, &error);
+    c4::ref<C4QueryEnumerator> e2 = c4queryobs_getEnumerator(state2.obs, true, &error);
+    REQUIRE(e1);
+    REQUIRE(e2);
+    CHECK(e1 != e2);
+    // Interleaved iteration doesn't interfere:
+    int rows = 0;
+    while (c4queryenum_next(e1, &error)) {
+        REQUIRE(c4queryenum_next(e2, &error));
+        CHECK(FLValue_AsString(FLArrayIterator_GetValueAt(&e1->columns, 0)) ==
+              FLValue_AsString(FLArrayIterator_GetValueAt(&e2->columns, 0)));
+        ++rows;
+    }
+    CHECK(!c4queryenum_next(e2, &error));
+    CHECK(rows == 8);
+
+    // A change re-runs the shared query once, for both observers:
+    state1.count = state2.count = 0;
+    runs = c4queryobs_getRunCount();
+    addPersonInState("after1", "CA");
+    C4Log("---- Waiting for 2nd call of query observers...");
+    WaitUntil(2000, [&]{return state1.count > 0 && state2.count > 0;});
+    CHECK(state1.count == 1);
+    CHECK(state2.count == 1);
+    CHECK(c4queryobs_getRunCount() - runs == 1);
+
+    // Removing one observer doesn't stop the other:
+    c4queryobs_setEnabled(state1.obs, false);
+    state1.count = state2.count = 0;
+    addPersonInState("after2", "CA");
+
+    C4Log("---- Waiting for 3rd call of query observer...");
+    WaitUntil(2000, [&]{return state2.count > 0;});
+    CHECK(state2.count == 1);
+    CHECK(state1.count == 0);
+    e2 = c4queryobs_getEnumerator(state2.obs, true, &error);
+    REQUIRE(e2);
+    CHECK(c4queryenum_getRowCount(e2, &error) == 10);
+
+    // An observer's callback can disable and re-enable an observer of the other query, although
+    // they share a LiveQuerier, without deadlocking:
+    struct Toggler {
+        C4QueryObserver *other;
+        atomic<int> count = 0;
+    };
+    Toggler toggler {state2.obs};
+    auto toggle = [](C4QueryObserver *obs, C4Query *query, void *context) {
+        auto t = (Toggler*)context;
+        c4queryobs_setEnabled(t->other, (++t->count % 2) == 0);
+    };
+    c4::ref<C4QueryObserver> obs3 = c4queryobs_create(query, toggle, &toggler);
+    c4queryobs_setEnabled(obs3, true);
+    C4Log("---- Waiting for observer to disable the other...");
+    WaitUntil(2000, [&]{return toggler.count > 0;});
+    CHECK(toggler.count == 1);
+
+    state2.count = 0;
+    addPersonInState("after3", "CA");
+    C4Log("---- Waiting for observer to re-enable the other...");
+    WaitUntil(2000, [&]{return toggler.count > 1 && state2.count > 0;});
+    CHECK(toggler.count == 2);
+    CHECK(state2.count == 1);
+    c4queryobs_setEnabled(obs3, false);
+
+    // An observer's callback can also disable and re-enable the observer itself:
+    atomic<int> selfCount {0};
+    auto toggleSelf = [](C4QueryObserver *obs, C4Query *query, void *context) {
+        if (++*(atomic<int>*)context == 1) {
+            c4queryobs_setEnabled(obs, false);
+            c4queryobs_setEnabled(obs, true);   // so it's called again with the current results
+        }
+    };
+    c4::ref<C4QueryObserver> obs4 = c4queryobs_create(query, toggleSelf, &selfCount);
+    c4queryobs_setEnabled(obs4, true);
+    C4Log("---- Waiting for observer to toggle itself...");
+    WaitUntil(2000, [&]{return selfCount > 1;});
+    CHECK(selfCount == 2);
+    c4queryobs_setEnabled(obs4, false);
+}
+
+N_WAY_TEST_CASE_METHOD(C4QueryTest, "Background index build", "[Query][C]") {
+    C4Error err;
+    C4IndexOptions options = {};
+    options.buildInBackground = true;
+    REQUIRE(c4db_createIndex(db, C4STR("byState"), C4STR("[[\".contact.address.state\"]]"),
+                             kC4ValueIndex, &options, &err));
+    // Writes can proceed while the index is being built:
+    {
+        TransactionHelper t(db);
+        createRev("extra"_sl, kRevID, kFleeceBody);
+    }
+
+    // Wait for the build to finish:
+    bool building = true;
+    for (int tries = 0; building && tries < 100; ++tries) {
+        building = false;
+        Doc info(alloc_slice(c4db_getIndexesInfo(db, nullptr)));
+        for (Array::iterator i(info.asArray()); i; ++i) {
+            Dict index = i.value().asDict();
+            REQUIRE(!index["error"]);
+            if (index["progress"]) {
+                CHECK(index["progress"].asFloat() <= 1.0f);
+                building = true;
+            }
+        }
+        if (building)
+            this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    REQUIRE(!building);
+    CHECK(lookForIndex(db, "byState"_sl));
+
+    compile(json5("['=', ['.contact.address.state'], 'CA']"));
+    alloc_slice explanation = c4query_explain(query);
+    CHECK(string(explanation).find("byState") != string::npos);
+    CHECK(run() == (vector<string>{"0000001", "0000015", "0000036", "0000043", "0000053", "0000064", "0000072", "0000073"}));
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4QueryTest, "Background index build yields to writers", "[Query][C]") {
+    static constexpr int kNumDocs = 50000;
+    {
+        TransactionHelper t(db);
+        char docID[20], json[30];
+        for (int i = 0; i < kNumDocs; ++i) {
+            sprintf(docID, "doc-%05d", i);
+            sprintf(json, "{\"n\":%d}", i);
+            createFleeceRev(db, c4str(docID), kRevID, c4str(json));
+        }
+    }
+
+    // Keep committing on another connection while the index is built, until the build yields:
+    C4Error err;
+    unsigned interruptions = c4db_getIndexBuildInterruptionCount();
+    atomic<int> numWrites {0};
+    thread writer([&] {
+        C4Database *db2 = c4db_openAgain(db, nullptr);
+        if (!db2)
+            return;     // (caught below by checking numWrites)
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(20);
+        while (c4db_getIndexBuildInterruptionCount() == interruptions
+                    && chrono::steady_clock::now() < deadline) {
+            TransactionHelper t(db2);
+            char docID[20], json[30];
+            sprintf(docID, "extra-%05d", numWrites + 1);
+            sprintf(json, "{\"n\":%d}", -(numWrites + 1));
+            createFleeceRev(db2, c4str(docID), kRevID, c4str(json));
+            ++numWrites;
+        }
+        c4db_release(db2);
+    });
+
+    C4IndexOptions options = {};
+    options.buildInBackground = true;
+    REQUIRE(c4db_createIndex(db, C4STR("byN"), C4STR("[[\".n\"]]"),
+                             kC4ValueIndex, &options, &err));
+    writer.join();
+    CHECK(c4db_getIndexBuildInterruptionCount() > interruptions);
+    REQUIRE(numWrites > 0);
+
+    // Now that the writes have stopped, the build gets to finish:
+    bool building = true;
+    for (int tries = 0; building && tries < 300; ++tries) {
+        building = false;
+        Doc info(alloc_slice(c4db_getIndexesInfo(db, nullptr)));
+        for (Array::iterator i(info.asArray()); i; ++i) {
+            Dict index = i.value().asDict();
+            REQUIRE(!index["error"]);
+            if (index["progress"])
+                building = true;
+        }
+        if (building)
+            this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    REQUIRE(!building);
+    CHECK(lookForIndex(db, "byN"_sl));
+
+    // The index covers both the original docs and the ones written during the build:
+    compile(json5("['=', ['.n'], 12345]"));
+    alloc_slice explanation = c4query_explain(query);
+    CHECK(string(explanation).find("byN") != string::npos);
+    CHECK(run() == (vector<string>{"doc-12345"}));
+    compile(json5("['<', ['.n'], 0]"));
+    CHECK(run().size() == size_t(numWrites));
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4QueryTest, "Delete index", "[Query][C][!throws]") {
     C4Error err;
     C4String names[2] = { C4STR("length"), C4STR("byStreet") };
@@ -23,6 +23,9 @@
 #include "c4Document+Fleece.h"
 #include "BackgroundDB.hh"
 #include "Housekeeper.hh"
+#include "IndexBuilder.hh"
+#include "LiveQuerier.hh"
+#include "ReaderPool.hh"
 #include "DataFile.hh"
 #include "Record.hh"
 #include "SequenceTracker.hh"
@@ -116,7 +119,8 @@ namespace c4Internal {
                        FilePath &&dataFilePath)
     :_name(dataFilePath.dir().unextendedName())
     ,_parentDirectory(dataFilePath.dir().parentDir())
-    ,_config{slice(_parentDirectory), inConfig.flags, inConfig.encryptionKey}
+    ,_config{slice(_parentDirectory), inConfig.flags, inConfig.encryptionKey,
+             inConfig.cacheSize, inConfig.mmapSize}
     ,_configV1(inConfig)
     ,_encoder(new fleece::impl::Encoder())
     {
@@ -127,6 +131,8 @@ namespace c4Internal {
         options.writeable = (_config.flags & kC4DB_ReadOnly) == 0;
         options.upgradeable = (_config.flags & kC4DB_NoUpgrade) == 0;
         options.useDocumentKeys = true;
+        options.cacheSize = _config.cacheSize;
+        options.mmapSize = _config.mmapSize;
         options.encryptionAlgorithm = (EncryptionAlgorithm)_config.encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
 #ifdef COUCHBASE_ENTERPRISE
@@ -156,6 +162,7 @@ namespace c4Internal {
             default:                error::_throw(error::InvalidParameter);
         }
         _documentFactory.reset(factory);
+        _readerPool.reset(new ReaderPool(this));
 
         // Open the DataFile:
         try {
@@ -437,13 +444,32 @@ namespace c4Internal {
     }
 
 
+    LiveQuerierRegistry& Database::liveQueriers() {
+        if (!_liveQueriers)
+            _liveQueriers.reset(new LiveQuerierRegistry(this));
+        return *_liveQueriers;
+    }
+
+
+    IndexBuilder& Database::indexBuilder() {
+        if (!_indexBuilder)
+            _indexBuilder = new IndexBuilder(this);
+        return *_indexBuilder;
+    }
+
+
     void Database::stopBackgroundTasks() {
         if (_housekeeper) {
             _housekeeper->stop();
             _housekeeper = nullptr;
         }
+        if (_indexBuilder) {
+            _indexBuilder->stop();
+            _indexBuilder = nullptr;
+        }
         if (_backgroundDB)
             _backgroundDB->close();
+        _readerPool->close();
     }
 
 
@@ -543,6 +569,7 @@ namespace c4Internal {
         if (--_transactionLevel == 0) {
             auto t = _transaction;
             try {
+                defaultKeyStore().resumeIndexes(commit);
                 if (commit)
                     t->commit();
                 else
@@ -690,7 +717,7 @@ namespace c4Internal {
         // Conflicted documents are not eligible to be replicated,
         // so ignore them.  Later when the conflict is resolved
         // there will be logic to replicate them (see TreeDocument::resolveConflict)
-        if (_sequenceTracker && !(doc->selectedRev.flags & kRevIsConflict)) {
+        if (_sequenceTracker && _trackChanges && !(doc->selectedRev.flags & kRevIsConflict)) {
             _sequenceTracker->use([doc](SequenceTracker &st) {
                 Assert(doc->selectedRev.sequence == doc->sequence); // The new revision must be selected
                 st.documentChanged(doc->_docIDBuf,
@@ -714,6 +741,52 @@ namespace c4Internal {
     }
 
 
+    void Database::bulkLoad(const C4BulkDocument docs[], size_t count) {
+        if (!inTransaction())
+            error::_throw(error::NotInTransaction);
+        defaultKeyStore().suspendIndexes();
+
+        // Change tracking only matters if someone could be notified: an observer of this
+        // Database, or another DataFile on the same file (which gets notified on commit.)
+        bool track = false;
+        if (_sequenceTracker) {
+            track = _sequenceTracker->use<bool>([](SequenceTracker &st) {
+                return st.hasObservers();
+            });
+            _dataFile->forOtherDataFiles([&](DataFile *other) {
+                if (other->delegate())
+                    track = true;
+            });
+        }
+
+        _trackChanges = track;
+        try {
+            for (size_t i = 0; i < count; ++i) {
+                const C4BulkDocument &bulkDoc = docs[i];
+                C4DocPutRequest rq = {};
+                rq.docID = bulkDoc.docID;
+                rq.body = bulkDoc.body;
+                rq.revFlags = bulkDoc.revFlags;
+                rq.save = true;
+                // First try inserting a new record, as in c4doc_put; this fails without side
+                // effects if the document already exists, in which case it's updated normally.
+                Retained<Document> doc = documentFactory().newDocumentInstance(Record(bulkDoc.docID));
+                if (!doc->putNewRevision(rq)) {
+                    doc = documentFactory().newDocumentInstance(bulkDoc.docID);
+                    if (!doc->putNewRevision(rq))
+                        error::_throw(error::Conflict);
+                }
+            }
+        } catch (...) {
+            _trackChanges = true;
+            throw;
+        }
+        _trackChanges = true;
+        if (!track)
+            _dataFile->_logVerbose("Bulk-loaded %zu docs without change tracking", count);
+    }
+
+
     int64_t Database::purgeExpiredDocs() {
         if (_sequenceTracker) {
             return _sequenceTracker->use<int64_t>([&](SequenceTracker &st) {
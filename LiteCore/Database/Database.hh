@@ -40,6 +40,9 @@ namespace litecore {
     class BlobStore;
     class BackgroundDB;
     class Housekeeper;
+    class IndexBuilder;
+    class LiveQuerierRegistry;
+    class ReaderPool;
 }
 
 
@@ -123,6 +126,10 @@ namespace c4Internal {
         KeyStore& getKeyStore(const string &name) const;
 
         bool purgeDocument(slice docID);
+
+        /** Saves many new documents at once, with value indexes suspended until the transaction
+            ends. Must be called in a transaction. */
+        void bulkLoad(const C4BulkDocument docs[], size_t count);
         int64_t purgeExpiredDocs();
         bool setExpiration(slice docID, expiration_t);
         bool startHousekeeping();
@@ -154,6 +161,15 @@ namespace c4Internal {
         BackgroundDB* backgroundDatabase();
         void stopBackgroundTasks();
 
+        /** Shares continuous LiveQueriers between observers of identical queries. */
+        LiveQuerierRegistry& liveQueriers();
+
+        /** Builds indexes asynchronously; see C4IndexOptions.buildInBackground. */
+        IndexBuilder& indexBuilder();
+
+        /** Read-only Database instances on the same file, for concurrent reads. */
+        ReaderPool& readerPool()                            {return *_readerPool;}
+
 #if 0 // unused
         bool mustUseVersioning(C4DocumentVersioning, C4Error*) noexcept;
 #endif
@@ -192,9 +208,13 @@ namespace c4Internal {
         unique_ptr<access_lock<SequenceTracker>> _sequenceTracker; // Doc change tracker/notifier
         mutable unique_ptr<BlobStore> _blobStore;           // Blob storage
         uint32_t                    _maxRevTreeDepth {0};   // Max revision-tree depth
+        bool                        _trackChanges {true};   // False during untracked bulkLoad
         recursive_mutex             _clientMutex;           // Mutex for c4db_lock/unlock
         unique_ptr<BackgroundDB>    _backgroundDB;          // for background operations
+        unique_ptr<LiveQuerierRegistry> _liveQueriers;      // Shared continuous live queries
+        unique_ptr<ReaderPool>      _readerPool;            // Read-only connections
         Retained<Housekeeper>       _housekeeper;           // for expiration/cleanup tasks
+        Retained<IndexBuilder>      _indexBuilder;          // for background index builds
     };
 
 }
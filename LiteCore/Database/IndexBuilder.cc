@@ -0,0 +1,233 @@
+//
+// IndexBuilder.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "IndexBuilder.hh"
+#include "Database.hh"
+#include "BackgroundDB.hh"
+#include "SQLiteDataFile.hh"
+#include "KeyStore.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "Stopwatch.hh"
+#include <algorithm>
+
+namespace litecore {
+    using namespace std;
+    using namespace c4Internal;
+    using namespace actor;
+
+    // How often (in SQLite VM instructions) to update progress & check for waiting transactions
+    static constexpr int kProgressInterval = 10000;
+
+    // Rough number of SQLite VM instructions CREATE INDEX executes per row, per indexed column;
+    // used to estimate progress.
+    static constexpr uint64_t kOpsPerRow = 12, kOpsPerColumn = 4;
+
+    // Progress is an estimate, so never report a running build as complete:
+    static constexpr float kMaxEstimatedProgress = 0.99f;
+
+    // Delay before restarting an interrupted build; multiplied by the number of interruptions,
+    // up to kMaxRetryDelay.
+    static constexpr delay_t kRetryDelay = chrono::milliseconds(500);
+    static constexpr delay_t kMaxRetryDelay = chrono::seconds(10);
+
+
+    atomic<unsigned> IndexBuilder::gNumInterruptions;
+
+
+    IndexBuilder::IndexBuilder(Database *db)
+    :Actor("IndexBuilder")
+    ,_database(db)
+    { }
+
+
+    void IndexBuilder::build(IndexSpec &&spec) {
+        if (_database->config()->flags & kC4DB_ReadOnly)
+            error::_throw(error::NotWriteable);
+        if (spec.type != IndexSpec::kValue)
+            error::_throw(error::InvalidParameter, "Only value indexes can be built in the background");
+        // Check the spec now, since errors during the build can't be reported to the caller:
+        spec.validateName();
+        (void)spec.what();
+        (void)spec.where();
+
+        if (!_bgdb)
+            _bgdb = _database->backgroundDatabase();
+        cancel(spec.name);
+        auto newBuild = make_shared<Build>(move(spec));
+        {
+            LOCK(_mutex);
+            _builds.push_back(newBuild);
+        }
+        enqueue(&IndexBuilder::_build, newBuild);
+    }
+
+
+    void IndexBuilder::cancel(const string &name) {
+        unique_lock<mutex> lock(_mutex);
+        auto i = find_if(_builds.begin(), _builds.end(), [&](auto &b) {return b->spec.name == name;});
+        if (i == _builds.end())
+            return;
+        shared_ptr<Build> build = *i;
+        build->cancelled = true;
+        _builds.erase(i);
+        // A running build holds a transaction, so it can't be running if the caller has one open;
+        // otherwise wait for its progress handler to notice the cancellation and abort it:
+        _buildStopped.wait(lock, [&] {return !build->running;});
+    }
+
+
+    vector<IndexBuilder::Status> IndexBuilder::unfinishedBuilds() const {
+        vector<Status> result;
+        LOCK(_mutex);
+        for (auto &b : _builds)
+            result.push_back({b->spec.name, b->spec.type, b->spec.expressionJSON,
+                              b->progress, b->error});
+        return result;
+    }
+
+
+    void IndexBuilder::stop() {
+        _stopping = true;           // makes a running build's progress handler interrupt it
+        enqueue(&IndexBuilder::_stop);
+        waitTillCaughtUp();
+    }
+
+
+    void IndexBuilder::_stop() {
+        LOCK(_mutex);
+        for (auto &b : _builds)
+            b->cancelled = true;
+        _builds.clear();
+        LogToAt(QueryLog, Verbose, "IndexBuilder: stopped.");
+    }
+
+
+    void IndexBuilder::setRunning(Build &build, bool running) {
+        {
+            LOCK(_mutex);
+            build.running = running;
+        }
+        if (!running)
+            _buildStopped.notify_all();
+    }
+
+
+    void IndexBuilder::removeBuild(Build *build) {
+        LOCK(_mutex);
+        auto i = find_if(_builds.begin(), _builds.end(), [&](auto &b) {return b.get() == build;});
+        if (i != _builds.end())
+            _builds.erase(i);
+    }
+
+
+    void IndexBuilder::_build(shared_ptr<Build> build) {
+        if (_stopping || build->cancelled)
+            return;
+        const char *name = build->spec.name.c_str();
+        Stopwatch st;
+        bool completed;
+        try {
+            completed = runBuild(*build);
+        } catch (const exception &x) {
+            if (build->cancelled)
+                return;
+            error err = error::convertException(x);
+            LogToAt(QueryLog, Warning, "IndexBuilder: failed to build index '%s': %s",
+                    name, err.what());
+            LOCK(_mutex);
+            build->error = err.what();
+            return;
+        }
+
+        if (completed) {
+            removeBuild(build.get());
+            LogTo(QueryLog, "IndexBuilder: built index '%s' in %.3f sec", name, st.elapsed());
+        } else if (!build->cancelled && !_stopping) {
+            // Interrupted to let another transaction run; try again later:
+            build->progress = 0.0f;
+            ++build->interruptions;
+            ++gNumInterruptions;
+            LogToAt(QueryLog, Verbose, "IndexBuilder: yielded after %.3f sec building '%s' (%u)",
+                    st.elapsed(), name, build->interruptions);
+            enqueueAfter(min(kRetryDelay * build->interruptions, kMaxRetryDelay),
+                         &IndexBuilder::_build, build);
+        }
+    }
+
+
+    // Runs the CREATE INDEX on the background connection. Returns false if it was interrupted.
+    bool IndexBuilder::runBuild(Build &build) {
+        bool interrupted = false;
+        _bgdb->use([&](DataFile *dataFile) {
+            if (!dataFile) {
+                build.cancelled = true;     // BackgroundDB is closed
+                return;
+            }
+            auto sqliteFile = dynamic_cast<SQLiteDataFile*>(dataFile);
+            if (!sqliteFile)
+                error::_throw(error::Unimplemented);
+            KeyStore &keyStore = dataFile->defaultKeyStore();
+
+            uint64_t estimatedOps = max(keyStore.recordCount(), uint64_t(1))
+                                  * (kOpsPerRow + kOpsPerColumn * build.spec.what()->count());
+            uint64_t ops = 0;
+            sqliteFile->setProgressHandler([&]() {
+                // Once the index is committed, the database is optimized; that mustn't be
+                // interrupted, or the finished build would be retried.
+                if (!dataFile->inTransaction())
+                    return false;
+                ops += kProgressInterval;
+                build.progress = min(float(ops) / estimatedOps, kMaxEstimatedProgress);
+                if (_stopping || build.cancelled || dataFile->transactionWaiting())
+                    interrupted = true;
+                return interrupted;
+            }, kProgressInterval);
+            try {
+                Transaction t(dataFile);
+                // The build may have been cancelled while waiting for the transaction; checking
+                // under the mutex ensures cancel() either sees it running or it sees the cancel.
+                {
+                    LOCK(_mutex);
+                    if (build.cancelled) {
+                        t.abort();
+                        sqliteFile->setProgressHandler(nullptr);
+                        return;
+                    }
+                    build.running = true;
+                }
+                if (keyStore.createIndex(build.spec))
+                    t.commit();
+                else
+                    t.abort();
+            } catch (...) {
+                setRunning(build, false);
+                sqliteFile->setProgressHandler(nullptr);
+                if (interrupted)
+                    return;
+                throw;
+            }
+            setRunning(build, false);
+            sqliteFile->setProgressHandler(nullptr);
+            if (!build.cancelled)
+                sqliteFile->optimize();
+        });
+        return !interrupted && !build.cancelled;
+    }
+
+}
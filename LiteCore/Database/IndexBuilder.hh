@@ -0,0 +1,87 @@
+//
+// IndexBuilder.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Base.hh"
+#include "Actor.hh"
+#include "IndexSpec.hh"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace c4Internal {
+    class Database;
+}
+
+namespace litecore {
+    class BackgroundDB;
+
+    /** Builds value indexes on the BackgroundDB's connection, so the client doesn't have to wait.
+        SQLite can only populate an index with a single CREATE INDEX statement, during which the
+        file is locked against writes. So that other threads' transactions aren't blocked for
+        that long, the build is interrupted whenever one of them is waiting, and restarted after
+        a delay that grows (up to a limit) with each interruption, so it gets to run in the next
+        lull between writes.
+        The index isn't registered (and can't be used by queries) until the build completes. */
+    class IndexBuilder : public actor::Actor {
+    public:
+        explicit IndexBuilder(c4Internal::Database* NONNULL);
+
+        /// Validates the spec, then asynchronously builds the index.
+        /// Cancels any unfinished build of an index with the same name.
+        void build(IndexSpec&&);
+
+        /// Cancels an unfinished build of the named index, if there is one. If the build is
+        /// running, waits for it to stop, so the caller can then safely delete or replace the
+        /// index.
+        void cancel(const std::string &name);
+
+        struct Status {
+            std::string     name;
+            IndexSpec::Type type;
+            alloc_slice     expressionJSON;
+            float           progress;       ///< Estimated fraction completed, from 0 to 1
+            std::string     error;          ///< Error message, if the build failed
+        };
+
+        /// The status of every build that hasn't completed, including failed ones.
+        std::vector<Status> unfinishedBuilds() const;
+
+        /// Synchronously stops the IndexBuilder, abandoning unfinished builds.
+        void stop();
+
+        static std::atomic<unsigned> gNumInterruptions;     // For unit tests only
+
+    private:
+        struct Build {
+            explicit Build(IndexSpec &&s)           :spec(std::move(s)) { }
+
+            IndexSpec const         spec;
+            std::atomic<float>      progress {0.0f};
+            std::atomic<bool>       cancelled {false};
+            unsigned                interruptions {0};
+            bool                    running {false};        // protected by _mutex
+            std::string             error;                  // protected by _mutex
+        };
+
+        void _build(std::shared_ptr<Build>);
+        bool runBuild(Build&);
+        void setRunning(Build&, bool);
+        void removeBuild(Build*);
+        void _stop();
+
+        c4Internal::Database* const _database;
+        BackgroundDB*               _bgdb {nullptr};
+        mutable std::mutex          _mutex;
+        std::condition_variable     _buildStopped;          // Notified when a build stops running
+        std::vector<std::shared_ptr<Build>> _builds;        // Unfinished builds
+        std::atomic<bool>           _stopping {false};
+    };
+
+}
@@ -20,8 +20,10 @@
 #include "BackgroundDB.hh"
 #include "DataFile.hh"
 #include "Database.hh"
+#include "SequenceTracker.hh"
 #include "StringUtil.hh"
 #include "c4ExceptionUtils.hh"
+#include <algorithm>
 #include <inttypes.h>
 
 namespace litecore {
@@ -38,6 +40,17 @@ namespace litecore {
     static constexpr delay_t kShortDelay   = chrono::milliseconds(  0);
     static constexpr delay_t kLongDelay    = chrono::milliseconds(500);
 
+    // Max number of changed docs to check individually against the query's WHERE clause.
+    // If more docs than this changed, the query is just re-run.
+    static constexpr size_t kMaxChangesToCheck = 100;
+
+    // Max number of matching doc IDs to remember. Beyond this, tracking them costs too much
+    // memory, and most changes would be relevant anyway.
+    static constexpr size_t kMaxMatchingDocs = 10000;
+
+
+    atomic<unsigned> LiveQuerier::gNumQueryRuns;
+
 
     LiveQuerier::LiveQuerier(c4Internal::Database *db,
                              Query *query,
@@ -49,7 +62,7 @@ namespace litecore {
     ,_expression(query->expression())
     ,_language(query->language())
     ,_continuous(continuous)
-    ,_delegate(delegate)
+    ,_delegates{delegate}
     {
         logInfo("Created on Query %s", query->loggingName().c_str());
         // Note that we don't keep a reference to `_query`, because it's tied to `db`, but we
@@ -59,7 +72,7 @@ namespace litecore {
 
 
     LiveQuerier::~LiveQuerier() {
-        if (_query)
+        if (_query || _changeNotifier)
             _stop();
         logVerbose("Deleted");
     }
@@ -83,6 +96,49 @@ namespace litecore {
     }
 
 
+    void LiveQuerier::addDelegate(Delegate *delegate) {
+        Assert(_continuous);
+        {
+            lock_guard<mutex> lock(_delegatesMutex);
+            _delegates.push_back(delegate);
+            _newDelegates.insert(delegate);
+        }
+        enqueue(&LiveQuerier::_notifyNewDelegates);
+    }
+
+
+    size_t LiveQuerier::removeDelegate(Delegate *delegate) {
+        size_t remaining = detachDelegate(delegate);
+        waitForCallbacks();
+        return remaining;
+    }
+
+
+    // Removes a delegate, without waiting for a call to it in progress.
+    size_t LiveQuerier::detachDelegate(Delegate *delegate) {
+        lock_guard<mutex> lock(_delegatesMutex);
+        _delegates.erase(std::remove(_delegates.begin(), _delegates.end(), delegate),
+                         _delegates.end());
+        _newDelegates.erase(delegate);
+        return _delegates.size();
+    }
+
+
+    // Waits for any delegate call in progress on another thread. Delegates are called with
+    // _callbackMutex held, and they check they're still registered first, so once this returns
+    // a detached delegate won't be called again. The mutex is recursive so a delegate can remove
+    // delegates (itself included) from its callback.
+    void LiveQuerier::waitForCallbacks() {
+        lock_guard<recursive_mutex> lock(_callbackMutex);
+    }
+
+
+    bool LiveQuerier::hasDelegate(Delegate *delegate) {
+        lock_guard<mutex> lock(_delegatesMutex);
+        return std::find(_delegates.begin(), _delegates.end(), delegate) != _delegates.end();
+    }
+
+
     // Database change (transaction committed) notification
     void LiveQuerier::transactionCommitted() {
         enqueue(&LiveQuerier::_dbChanged, clock::now());
@@ -93,6 +149,7 @@ namespace litecore {
 
 
     void LiveQuerier::_stop() {
+        _stopObservingChanges();
         if (_query) {
             _backgroundDB->use([&](DataFile *df) {
                 _query = nullptr;
@@ -128,8 +185,19 @@ namespace litecore {
             return;
 
         _waitingToRun = false;
+
+        // Find out which docs have changed since the last run. (The first time, start observing
+        // changes; this has to happen before the query runs, so no change can be missed.)
+        vector<alloc_slice> changedDocIDs;
+        bool checkChanges = false;
+        if (!_query)
+            _startObservingChanges();
+        else if (_incremental && _currentEnumerator)
+            checkChanges = _readChangedDocIDs(changedDocIDs);
+
         logVerbose("Running query...");
         Retained<QueryEnumerator> newQE;
+        bool relevant = true;
         C4Error error = {};
         fleece::Stopwatch st;
         _backgroundDB->use([&](DataFile *df) {
@@ -140,12 +208,30 @@ namespace litecore {
                     if (_continuous)
                         _backgroundDB->addTransactionObserver(this);
                 }
+                // Update the matching docs in the same snapshot as the query, so they agree:
+                ReadOnlyTransaction t(df);
+                if (_incremental) {
+                    relevant = _updateMatchingDocs(df, options,
+                                                   (checkChanges ? &changedDocIDs : nullptr));
+                    if (!relevant)
+                        return;
+                }
                 // Now run the query:
+                ++gNumQueryRuns;
                 newQE = _query->createEnumerator(&options);
             } catchError(&error);
         });
         auto time = st.elapsedMS();
 
+        if (!_incremental)
+            _stopObservingChanges();
+
+        if (!relevant) {
+            logVerbose("None of %zu changed docs match the query; not re-running it (%.3fms)",
+                       changedDocIDs.size(), time);
+            return; // no delegate call
+        }
+
         if (!newQE)
             logError("Query failed with error %s", c4error_descriptionStr(error));
 
@@ -166,7 +252,191 @@ namespace litecore {
         if (_stopping)
             return;
         
-        _delegate->liveQuerierUpdated(newQE, error);
+        _notifyDelegates(newQE, error);
+    }
+
+
+    // Sends the current results to delegates added since the last notification.
+    // (Delegates are called without holding _delegatesMutex, since a callback may add or remove
+    // delegates; see waitForCallbacks.)
+    void LiveQuerier::_notifyNewDelegates() {
+        if (_stopping || !_currentEnumerator)
+            return;     // they'll be notified when the query finishes
+        lock_guard<recursive_mutex> callbackLock(_callbackMutex);
+        set<Delegate*> newDelegates;
+        {
+            lock_guard<mutex> lock(_delegatesMutex);
+            swap(newDelegates, _newDelegates);
+        }
+        for (auto delegate : newDelegates) {
+            if (!hasDelegate(delegate))
+                continue;       // removed by an earlier callback
+            Retained<QueryEnumerator> qe = _currentEnumerator->clone();
+            delegate->liveQuerierUpdated(qe, {});
+        }
+    }
+
+
+    void LiveQuerier::_notifyDelegates(QueryEnumerator *qe, C4Error error) {
+        lock_guard<recursive_mutex> callbackLock(_callbackMutex);
+        vector<Delegate*> delegates;
+        {
+            lock_guard<mutex> lock(_delegatesMutex);
+            _newDelegates.clear();
+            delegates = _delegates;
+        }
+        bool first = true;
+        for (auto delegate : delegates) {
+            if (!hasDelegate(delegate))
+                continue;       // removed by an earlier callback
+            // Each delegate gets its own enumerator, since they have independent iteration state:
+            Retained<QueryEnumerator> delegateQE = qe;
+            if (qe && !first)
+                delegateQE = qe->clone();
+            delegate->liveQuerierUpdated(delegateQE, error);
+            first = false;
+        }
+    }
+
+
+#pragma mark - INCREMENTAL UPDATES:
+
+
+    void LiveQuerier::_startObservingChanges() {
+        if (!_continuous || (_database->config()->flags & kC4DB_NonObservable))
+            return;
+        _database->sequenceTracker().use([&](SequenceTracker &st) {
+            _changeNotifier = make_unique<DatabaseChangeNotifier>(st, nullptr);
+        });
+        _incremental = true;
+    }
+
+
+    void LiveQuerier::_stopObservingChanges() {
+        if (_changeNotifier) {
+            _database->sequenceTracker().use([&](SequenceTracker &st) {
+                _changeNotifier.reset();
+            });
+        }
+        _matchingDocs.clear();
+        _incremental = false;
+    }
+
+
+    // Reads the IDs of the docs that changed since the last call. Returns false if they can't be
+    // checked individually, because there are too many or the database is in a transaction.
+    bool LiveQuerier::_readChangedDocIDs(vector<alloc_slice> &docIDs) {
+        return _database->sequenceTracker().use<bool>([&](SequenceTracker &st) {
+            if (st.inTransaction())
+                return false;   // Don't consume changes that aren't committed yet
+            SequenceTracker::Change changes[kMaxChangesToCheck];
+            bool external, tooMany = false;
+            size_t n;
+            while ((n = _changeNotifier->readChanges(changes, kMaxChangesToCheck, external)) > 0) {
+                tooMany = tooMany || (docIDs.size() + n > kMaxChangesToCheck);
+                if (!tooMany) {
+                    for (size_t i = 0; i < n; ++i)
+                        docIDs.push_back(changes[i].docID);
+                }
+            }
+            return !tooMany;
+        });
+    }
+
+
+    // Updates `_matchingDocs`, either just for the given changed docs, or (if that's null) by
+    // re-reading the entire set. Returns false if none of the changed docs matched either before
+    // or after the change, which means the query results can't have changed.
+    // On any failure, turns off incremental mode and returns true.
+    bool LiveQuerier::_updateMatchingDocs(DataFile *df, const Query::Options &options,
+                                          const vector<alloc_slice> *changedDocIDs)
+    {
+        try {
+            alloc_slice filterJSON = _query->docIDFilterExpression(changedDocIDs);
+            if (!filterJSON) {
+                logVerbose("Query is too complex for incremental updates");
+                _incremental = false;
+                return true;
+            }
+            // (Don't let one-off filters for specific docIDs churn the compiled-query cache.)
+            Retained<Query> filter = df->defaultKeyStore().compileQuery(filterJSON,
+                                                                       QueryLanguage::kJSON,
+                                                                       !changedDocIDs);
+            Query::Options filterOptions(options.paramBindings);
+            Retained<QueryEnumerator> e = filter->createEnumerator(&filterOptions);
+
+            bool relevant = false;
+            if (changedDocIDs) {
+                for (auto &docID : *changedDocIDs) {
+                    if (_matchingDocs.erase(docID) > 0)
+                        relevant = true;
+                }
+            } else {
+                _matchingDocs.clear();
+                relevant = true;
+            }
+            while (e->next()) {
+                _matchingDocs.emplace(e->columns()[0]->asString());
+                relevant = true;
+            }
+
+            if (_matchingDocs.size() > kMaxMatchingDocs) {
+                logVerbose("Too many matching docs for incremental updates");
+                _incremental = false;
+            }
+            return relevant;
+        } catch (const std::exception &x) {
+            warn("Couldn't check for changed docs matching the query: %s", x.what());
+            _incremental = false;
+            return true;
+        }
+    }
+
+
+
+#pragma mark - REGISTRY:
+
+
+    // The registry key combines the query language, expression and encoded parameters.
+    static string registryKey(Query *query, const alloc_slice &parameters) {
+        string key;
+        key += char('0' + int(query->language()));
+        key += string(query->expression());
+        key += '\0';
+        key += string(parameters);
+        return key;
+    }
+
+
+    Retained<LiveQuerier> LiveQuerierRegistry::addDelegate(Query *query,
+                                                           const alloc_slice &parameters,
+                                                           LiveQuerier::Delegate *delegate)
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto &querier = _queriers[registryKey(query, parameters)];
+        if (querier) {
+            querier->addDelegate(delegate);
+        } else {
+            querier = new LiveQuerier(_database, query, true, delegate);
+            querier->start(parameters);
+        }
+        return querier;
+    }
+
+
+    void LiveQuerierRegistry::removeDelegate(LiveQuerier *querier,
+                                             LiveQuerier::Delegate *delegate)
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (querier->detachDelegate(delegate) == 0) {
+            querier->stop();
+            for (auto i = _queriers.begin(); i != _queriers.end(); ++i) {
+                if (i->second == querier) {
+                    _queriers.erase(i);
+                    break;
+                }
+            }
+        }
     }
 
 }
@@ -14,15 +14,25 @@
 #include <atomic>
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace c4Internal {
     class Database;
 }
 
 namespace litecore {
+    class DatabaseChangeNotifier;
 
     /** Runs a query in the background, and optionally watches for the query results to change
-        as documents change. */
+        as documents change.
+        If the query is simple enough (see Query::docIDFilterExpression), a continuous LiveQuerier
+        remembers the IDs of the docs matching its WHERE clause, and when the database changes it
+        only re-runs the query if one of the changed docs matched before or matches now. */
     class LiveQuerier : public actor::Actor,
                         BackgroundDB::TransactionObserver,
                         Logging, fleece::InstanceCounted
@@ -44,23 +54,51 @@ namespace litecore {
 
         void stop();
 
+        /** Adds another delegate, which will be notified of the current results (if any) and of
+            subsequent changes. Only for continuous queriers. */
+        void addDelegate(Delegate* NONNULL);
+
+        /** Removes a delegate. After this returns, it will not be called again. (If the delegate
+            is being called on another thread, this waits for that call to return.) It's OK to
+            call this from a delegate callback. Returns the number of remaining delegates. */
+        size_t removeDelegate(Delegate* NONNULL);
+
+        /** Waits for a delegate call in progress on another thread, if any, to return. */
+        void waitForCallbacks();
+
+        static std::atomic<unsigned> gNumQueryRuns;     // For unit tests only
+
     protected:
         virtual ~LiveQuerier();
         virtual std::string loggingIdentifier() const override;
 
     private:
+        friend class LiveQuerierRegistry;
         using clock = std::chrono::steady_clock;
 
+        size_t detachDelegate(Delegate*);
+        bool hasDelegate(Delegate*);
+
         // TransactionObserver method:
         virtual void transactionCommitted() override;
 
         void _runQuery(Query::Options);
         void _stop();
         void _dbChanged(clock::time_point);
+        void _notifyNewDelegates();
+        void _notifyDelegates(QueryEnumerator*, C4Error);
+        void _startObservingChanges();
+        void _stopObservingChanges();
+        bool _readChangedDocIDs(std::vector<alloc_slice>&);
+        bool _updateMatchingDocs(DataFile*, const Query::Options&,
+                                 const std::vector<alloc_slice> *changedDocIDs);
 
         Retained<c4Internal::Database> _database;       // The database
         BackgroundDB* _backgroundDB;                    // Shadow DB on background thread
-        Delegate* _delegate;                            // Whom ya gonna call?
+        std::mutex _delegatesMutex;                     // Guards _delegates & _newDelegates
+        std::recursive_mutex _callbackMutex;            // Held while calling delegates
+        std::vector<Delegate*> _delegates;              // Whom ya gonna call?
+        std::set<Delegate*> _newDelegates;              // Delegates that haven't been called yet
         alloc_slice _expression;                        // The query text
         QueryLanguage _language;                        // The query language (JSON or N1QL)
         Retained<Query> _query;                         // Compiled query
@@ -69,6 +107,36 @@ namespace litecore {
         bool _continuous;                               // Do I keep running until stopped?
         bool _waitingToRun {false};                     // Is a call to _runQuery scheduled?
         std::atomic<bool> _stopping {false};            // Has stop() been called?
+        std::unique_ptr<DatabaseChangeNotifier> _changeNotifier; // Reports which docs changed
+        std::unordered_set<alloc_slice, fleece::sliceHash> _matchingDocs; // IDs matching WHERE
+        bool _incremental {false};                      // Am I tracking _matchingDocs?
+    };
+
+
+
+    /** Coalesces the continuous LiveQueriers of a Database, so that observers of identical
+        queries (same expression, language and parameters) share one LiveQuerier, which runs the
+        query once per change and notifies all of them. */
+    class LiveQuerierRegistry {
+    public:
+        explicit LiveQuerierRegistry(c4Internal::Database *db)     :_database(db) { }
+
+        /** Adds a delegate to the running LiveQuerier for this query and parameters, first
+            creating and starting one if necessary. Returns the LiveQuerier. */
+        Retained<LiveQuerier> addDelegate(Query* NONNULL,
+                                          const alloc_slice &parameters,
+                                          LiveQuerier::Delegate* NONNULL);
+
+        /** Removes a delegate added by `addDelegate`. When a LiveQuerier's last delegate is
+            removed, it's stopped. This doesn't wait for a call to the delegate in progress on
+            another thread; to do that, call the LiveQuerier's `waitForCallbacks` afterwards,
+            without holding any lock the delegate's callback might need. */
+        void removeDelegate(LiveQuerier* NONNULL, LiveQuerier::Delegate* NONNULL);
+
+    private:
+        c4Internal::Database* const _database;
+        std::mutex _mutex;
+        std::unordered_map<std::string, Retained<LiveQuerier>> _queriers;
     };
 
 }
@@ -0,0 +1,156 @@
+//
+// ReaderPool.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ReaderPool.hh"
+#include "Database.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include <algorithm>
+#include <thread>
+
+namespace litecore {
+    using namespace std;
+
+    static constexpr unsigned kMinDefaultCapacity = 2, kMaxDefaultCapacity = 16;
+
+
+    ReaderPool::ReaderPool(Database *db)
+    :_database(db)
+    ,_capacity(defaultCapacity())
+    { }
+
+
+    ReaderPool::~ReaderPool() {
+        close();
+    }
+
+
+    /*static*/ unsigned ReaderPool::defaultCapacity() {
+        unsigned cores = thread::hardware_concurrency();     // may be 0 if unknown
+        return min(max(cores, kMinDefaultCapacity), kMaxDefaultCapacity);
+    }
+
+
+    unsigned ReaderPool::capacity() const {
+        LOCK(_mutex);
+        return _capacity;
+    }
+
+
+    void ReaderPool::setCapacity(unsigned capacity) {
+        if (capacity == 0)
+            error::_throw(error::InvalidParameter, "Reader pool capacity must be nonzero");
+        vector<Retained<Database>> excess;
+        {
+            LOCK(_mutex);
+            _capacity = capacity;
+            while (_openCount > _capacity && !_idle.empty()) {
+                excess.push_back(move(_idle.back()));
+                _idle.pop_back();
+                --_openCount;
+            }
+        }
+        _cond.notify_all();
+        for (auto &reader : excess)
+            closeReader(reader);
+    }
+
+
+    Retained<Database> ReaderPool::borrow() {
+        unique_lock<mutex> lock(_mutex);
+        _cond.wait(lock, [&] {return !_idle.empty() || _openCount < _capacity;});
+
+        Retained<Database> reader;
+        if (!_idle.empty()) {
+            reader = move(_idle.back());
+            _idle.pop_back();
+        } else {
+            // Open a new reader, without holding the mutex since that takes a while:
+            ++_openCount;
+            lock.unlock();
+            try {
+                reader = openReader();
+            } catch (...) {
+                lock.lock();
+                --_openCount;
+                lock.unlock();
+                _cond.notify_one();
+                throw;
+            }
+            lock.lock();
+        }
+        _borrowed[reader] = _generation;
+        return reader;
+    }
+
+
+    void ReaderPool::giveBack(Database *reader) {
+        Retained<Database> toClose;
+        {
+            LOCK(_mutex);
+            auto i = _borrowed.find(reader);
+            if (i == _borrowed.end())
+                error::_throw(error::InvalidParameter, "Database is not a borrowed reader");
+            bool stale = (i->second != _generation);
+            _borrowed.erase(i);
+            if (stale || _openCount > _capacity) {
+                toClose = reader;
+                --_openCount;
+            } else {
+                _idle.emplace_back(reader);
+            }
+        }
+        _cond.notify_one();
+        if (toClose)
+            closeReader(toClose);
+    }
+
+
+    void ReaderPool::close() {
+        vector<Retained<Database>> idle;
+        {
+            LOCK(_mutex);
+            idle.swap(_idle);
+            _openCount -= unsigned(idle.size());
+            ++_generation;
+        }
+        _cond.notify_all();
+        for (auto &reader : idle)
+            closeReader(reader);
+    }
+
+
+    Retained<Database> ReaderPool::openReader() {
+        C4DatabaseConfig config = *_database->configV1();
+        config.flags &= ~kC4DB_Create;
+        config.flags |= kC4DB_ReadOnly | kC4DB_NonObservable;
+        Retained<Database> reader = new Database(_database->path().path(), config);
+        _database->dataFile()->_logVerbose("Opened pooled reader %p", reader.get());
+        return reader;
+    }
+
+
+    /*static*/ void ReaderPool::closeReader(Database *reader) {
+        try {
+            reader->close();
+        } catch (const exception &x) {
+            Warn("ReaderPool: error closing reader: %s", x.what());
+        }
+    }
+
+}
@@ -0,0 +1,66 @@
+//
+// ReaderPool.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Base.hh"
+#include "RefCounted.hh"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace c4Internal {
+    class Database;
+}
+
+namespace litecore {
+
+    /** A pool of read-only Database instances opened on the same file as a Database, so that
+        documents can be read, enumerated and queried on many threads at once.
+        Each reader has its own SQLite connection (sharing the file's DataFile::Shared state,
+        like any other DataFile on that file), and must only be used by one thread at a time.
+        Readers only see committed changes.
+        All methods are thread-safe. */
+    class ReaderPool {
+    public:
+        explicit ReaderPool(c4Internal::Database* NONNULL);
+        ~ReaderPool();
+
+        /// The maximum number of readers that can be open at once.
+        unsigned capacity() const;
+
+        /// Changes the capacity. If lowered, excess readers are closed as they're returned.
+        void setCapacity(unsigned);
+
+        /// The default capacity: the number of CPU cores, within reasonable limits.
+        static unsigned defaultCapacity();
+
+        /// Returns an idle reader, opening a new one if fewer than `capacity` are open;
+        /// otherwise blocks until another thread returns one.
+        Retained<c4Internal::Database> borrow();
+
+        /// Returns a reader obtained from \ref borrow to the pool.
+        void giveBack(c4Internal::Database* NONNULL);
+
+        /// Closes all idle readers. Readers currently borrowed are closed when they're returned.
+        /// The pool remains usable afterwards, opening new readers as needed.
+        void close();
+
+    private:
+        Retained<c4Internal::Database> openReader();
+        static void closeReader(c4Internal::Database*);
+
+        c4Internal::Database* const _database;
+        mutable std::mutex _mutex;
+        std::condition_variable _cond;
+        std::vector<Retained<c4Internal::Database>> _idle;      // Readers ready to be borrowed
+        std::unordered_map<c4Internal::Database*, unsigned> _borrowed; // Reader -> generation
+        unsigned _capacity;                                     // Max number of open readers
+        unsigned _openCount {0};                                // Number of open readers
+        unsigned _generation {0};                               // Incremented by close()
+    };
+
+}
@@ -62,6 +62,11 @@ namespace litecore {
 
         sequence_t lastSequence() const        {return _lastSequence;}
 
+        /** True if any database or document change notifiers are registered. */
+        bool hasObservers() const {
+            return hasDBChangeNotifiers() || _numDocObservers > 0;
+        }
+
         /** Tracks a document's current sequence. */
         struct Entry {
             alloc_slice const               docID;
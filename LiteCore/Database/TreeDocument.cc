@@ -581,54 +581,46 @@ namespace c4Internal {
         unordered_map<slice,slice> revMap(docIDs.size());
         for (ssize_t i = docIDs.size() - 1; i >= 0; --i)
             revMap[docIDs[i]] = revIDs[i];
-        stringstream result;
+        RevAncestry ancestry;
 
-        auto callback = [&](slice docID, slice docBody, sequence_t sequence) -> alloc_slice {
+        auto callback = [&](slice docID, slice docBody, slice extra, sequence_t sequence) -> alloc_slice {
             // --- This callback runs inside the SQLite query ---
             // --- It will be called once for each docID in the vector ---
             // Convert revID to encoded binary form:
             revidBuffer revID;
             revID.parse(revMap[docID]);
 
-            RevTree tree(docBody, 0);
+            // Scan the encoded tree; decoding it into a RevTree would be much slower:
+            RawRevision::findAncestors(docBody, extra, revID, maxAncestors, mustHaveBodies,
+                                       remoteDBID, ancestry);
 
             // Does it exist in the doc?
-            if (tree[revID]) {
-                if (remoteDBID) {
-                    const Rev *curRemoteRev = tree.latestRevisionOnRemote(remoteDBID);
-                    if (curRemoteRev && curRemoteRev->revID != revID) {
-                        return alloc_slice(kC4AncestorExistsButNotCurrent);
-                    }
-                }
+            if (ancestry.exists) {
                 static alloc_slice kAncestorExists = alloc_slice(kC4AncestorExists);
-                return kAncestorExists;
+                static alloc_slice kAncestorExistsButNotCurrent
+                                                = alloc_slice(kC4AncestorExistsButNotCurrent);
+                return ancestry.remoteHasOther ? kAncestorExistsButNotCurrent : kAncestorExists;
             }
 
-            // Find revs that could be ancestors of it and write them as a JSON array:
-            result.str("");
-            result << '[';
-            auto generation = revID.generation();
-            char expandedBuf[100];
-            unsigned n = 0;
-            for (auto rev : tree.allRevisions()) {
-                if (rev->revID.generation() < generation
-                            && !(mustHaveBodies && !rev->isBodyAvailable())) {
-                    slice expanded(expandedBuf, sizeof(expandedBuf));
-                    if (rev->revID.expandInto(expanded)) {
-                        if (n++ == 0)
-                            result << '"';
-                        else
-                            result << "\",\"";
-                        result << expanded;
-                        if (n >= maxAncestors)
-                            break;
-                    }
-                }
+            // Write the revs that could be ancestors of it as a JSON array:
+            size_t size = 2;
+            for (revid ancestor : ancestry.ancestors)
+                size += ancestor.expandedSize() + 3;
+            alloc_slice result(size);
+            auto dst = (char*)result.buf;
+            *dst++ = '[';
+            for (revid ancestor : ancestry.ancestors) {
+                if (dst[-1] != '[')
+                    *dst++ = ',';
+                *dst++ = '"';
+                slice expanded(dst, result.end());
+                ancestor.expandInto(expanded);
+                dst += expanded.size;
+                *dst++ = '"';
             }
-            if (n > 0)
-                result << '"';
-            result << ']';
-            return alloc_slice(result.str());
+            *dst++ = ']';
+            result.shorten(dst - (char*)result.buf);
+            return result;
         };
         return database()->dataFile()->defaultKeyStore().withDocBodies(docIDs, callback);
     }
@@ -69,5 +69,13 @@ namespace litecore {
         return nullptr;
     }
 
+    const Array* IndexSpec::include() const {
+        if (auto dict = doc()->asDict(); dict) {
+            if (auto includeVal = qp::getCaseInsensitive(dict, "INCLUDE"); includeVal)
+                return qp::requiredArray(includeVal, "Index INCLUDE term");
+        }
+        return nullptr;
+    }
+
 
 }
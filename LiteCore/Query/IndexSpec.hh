@@ -38,6 +38,9 @@ namespace litecore {
             bool ignoreDiacritics;  ///< True to strip diacritical marks/accents from letters
             bool disableStemming;   ///< Disables stemming
             const char* stopWords;  ///< NULL for default, or comma-delimited string, or empty
+            bool buildInBackground; ///< Value index: build it later on a background thread
+            bool useFTS5;           ///< Full-text index: use SQLite's FTS5 instead of FTS4
+            const char* prefixLengths; ///< FTS5: NULL, or prefix lengths to index, like "2 3"
         };
 
         IndexSpec(std::string name_,
@@ -66,6 +69,10 @@ namespace litecore {
         /** The optional WHERE clause: the condition for a partial index */
         const fleece::impl::Array* where() const;
 
+        /** The optional INCLUDE clause of a value index: extra properties to store with the
+            index, so queries that only use those properties don't have to read document bodies */
+        const fleece::impl::Array* include() const;
+
         std::string const            name;
         Type        const            type;
         alloc_slice const            expressionJSON;
@@ -63,4 +63,7 @@ namespace litecore {
     { }
 
 
+    double QueryEnumerator::gMaxStreamingSnapshotAge = 5.0;
+
+
 }
@@ -63,18 +63,36 @@ namespace litecore {
 
         virtual void close()                                            {_keyStore = nullptr;}
 
+        /** Returns the JSON of a query that returns just the IDs of the documents that match
+            this query's WHERE clause (ignoring WHAT, ORDER_BY, LIMIT, etc.), restricted to the
+            given docIDs if that's non-null. Returns a null slice if the results of this query
+            can depend on documents other than the matching ones, i.e. it has a JOIN, UNNEST or
+            MATCH, or if it has no WHERE clause at all.
+            This is used by LiveQuerier to ignore changes to irrelevant documents. */
+        virtual alloc_slice docIDFilterExpression(const std::vector<alloc_slice> *docIDs) const
+                                                                        {return nullslice;}
+
         struct Options {
             Options() { }
             
             Options(const Options &o)
-            :paramBindings(o.paramBindings), afterSequence(o.afterSequence) { }
+            :paramBindings(o.paramBindings), afterSequence(o.afterSequence)
+            ,purgeCount(o.purgeCount), streaming(o.streaming), parallelism(o.parallelism)
+            ,paged(o.paged), continuationToken(o.continuationToken) { }
 
             template <class T>
-            Options(T bindings, sequence_t afterSeq =0, uint64_t withPurgeCount =0)
-            :paramBindings(bindings), afterSequence(afterSeq), purgeCount(withPurgeCount) { }
-
-            Options after(sequence_t afterSeq) const {return Options(paramBindings, afterSeq, purgeCount);}
-            Options withPurgeCount(uint64_t purgeCnt) const {return Options(paramBindings, afterSequence, purgeCnt);}
+            Options(T bindings, sequence_t afterSeq =0, uint64_t withPurgeCount =0,
+                    bool stream =false, unsigned parallel =0,
+                    bool page =false, alloc_slice token =nullslice)
+            :paramBindings(bindings), afterSequence(afterSeq), purgeCount(withPurgeCount)
+            ,streaming(stream), parallelism(parallel)
+            ,paged(page || token), continuationToken(std::move(token)) { }
+
+            Options after(sequence_t afterSeq) const {return Options(paramBindings, afterSeq, purgeCount, streaming, parallelism, paged, continuationToken);}
+            Options withPurgeCount(uint64_t purgeCnt) const {return Options(paramBindings, afterSequence, purgeCnt, streaming, parallelism, paged, continuationToken);}
+            Options withStreaming(bool stream) const {return Options(paramBindings, afterSequence, purgeCount, stream, parallelism, paged, continuationToken);}
+            Options withParallelism(unsigned parallel) const {return Options(paramBindings, afterSequence, purgeCount, streaming, parallel, paged, continuationToken);}
+            Options withContinuation(alloc_slice token) const {return Options(paramBindings, afterSequence, purgeCount, streaming, parallelism, true, std::move(token));}
 
             bool notOlderThan(sequence_t afterSeq, uint64_t purgeCnt) const {
                 return afterSequence > 0 && afterSequence >= afterSeq && purgeCnt == purgeCount;
@@ -83,6 +101,10 @@ namespace litecore {
             alloc_slice const paramBindings;
             sequence_t const  afterSequence {0};
             uint64_t const purgeCount {0};
+            bool const streaming {false};   ///< Read rows lazily instead of pre-recording them
+            unsigned const parallelism {0}; ///< Max number of threads scanning ranges of the docs
+            bool const paged {false};       ///< Make the enumerator return a continuation token
+            alloc_slice const continuationToken; ///< Resume after the page that returned this
         };
 
         virtual QueryEnumerator* createEnumerator(const Options* =nullptr) =0;
@@ -114,10 +136,15 @@ namespace litecore {
         virtual uint64_t missingColumns() const noexcept =0;
         
         /** Random access to rows. May not be supported by all implementations, but does work with
-            the current SQLite query implementation. */
+            the current SQLite query implementation (except in streaming mode.) */
         virtual int64_t getRowCount() const         {return -1;}
         virtual void seek(int64_t rowIndex)         {error::_throw(error::UnsupportedOperation);}
 
+        /** If the query was run with Options::paged, returns an opaque token to pass as
+            Options::continuationToken to get the next page of results, or null if this page was
+            empty. */
+        virtual alloc_slice continuationToken() const           {return nullslice;}
+
         virtual bool hasFullText() const                        {return false;}
         virtual const FullTextTerms& fullTextTerms()            {return _fullTextTerms;}
 
@@ -127,6 +154,14 @@ namespace litecore {
 
         virtual bool obsoletedBy(const QueryEnumerator*) =0;
 
+        /** Returns a new enumerator on the same results, with its own iteration state.
+            Not supported in streaming mode. */
+        virtual QueryEnumerator* clone()            {error::_throw(error::UnsupportedOperation);}
+
+        /** Seconds a streaming enumerator may keep its read snapshot of the database before it
+            reads its remaining rows into memory. (Only unit tests should change this.) */
+        static double gMaxStreamingSnapshotAge;
+
     protected:
         QueryEnumerator(const Query::Options *options, sequence_t lastSeq, uint64_t purgeCount)
         :_options(options ? *options : Query::Options{})
@@ -0,0 +1,151 @@
+//
+// QueryParser+Keyset.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "Error.hh"
+#include "FleeceImpl.hh"
+#include "StringUtil.hh"
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+using namespace litecore::qp;
+
+namespace litecore {
+
+    /*
+     Keyset pagination ("seek method"): instead of skipping the rows of earlier pages with OFFSET,
+     which SQLite has to read and discard, the next page is queried with an extra WHERE condition
+     that only matches rows sorting after the last row of the previous page. If an index matches
+     the ORDER BY, SQLite seeks straight to that row, so every page is as fast as the first.
+
+     For this to work the sort order has to be total, so the docID is added as the last ORDER BY
+     term, and the values of the sort keys of each row have to be known, so they're added as extra
+     result columns. SQLiteQuery turns the keys of a page's last row into a continuation token.
+     */
+
+
+    void QueryParser::parseKeyset(const Value *expression, KeysetQuery &out) {
+        // Like parse(), but writeSelect() captures the clauses into `out`:
+        bool covered = false;
+        for (auto &coveringTable : _delegate.coveringTables()) {
+            out = KeysetQuery();
+            _keyset = &out;
+            if ((covered = parseCovered(expression, coveringTable)))
+                break;
+        }
+        if (!covered) {
+            out = KeysetQuery();
+            _keyset = &out;
+            parseSelect(expression);
+        }
+        _keyset = nullptr;
+
+        require(!_isAggregateQuery,
+                "Continuation tokens can't be used with DISTINCT, GROUP_BY or aggregate functions");
+        require(_ftsTables.empty(), "Continuation tokens can't be used with MATCH");
+        for (auto &alias : _aliases) {
+            require(alias.second == kDBAlias || alias.second == kResultAlias,
+                    "Continuation tokens can't be used with JOIN or UNNEST");
+        }
+        Assert(!out.keys.empty() && !out.selectSQL.empty());
+    }
+
+
+    // Called by writeSelect() after the WHAT clause: adds a result column for each sort key.
+    void QueryParser::writeKeysetColumns(KeysetQuery &keyset, const Dict *operands,
+                                         const string &tablePrefix) {
+        keyset.keys.clear();
+        if (auto orderBy = getCaseInsensitive(operands, "ORDER_BY"_sl); orderBy) {
+            auto orderList = requiredArray(orderBy, "ORDER BY parameter");
+            _context.push_back(&kExpressionListOperation);
+            for (Array::iterator i(orderList); i; ++i) {
+                const Value *expr = i.value();
+                bool descending = false;
+                if (auto op = expr->asArray(); op && op->count() == 2) {
+                    slice dir = op->get(0)->asString();
+                    if (dir.caseEquivalent("DESC"_sl) || dir.caseEquivalent("ASC"_sl)) {
+                        descending = dir.caseEquivalent("DESC"_sl);
+                        expr = op->get(1);
+                    }
+                }
+                _sql << ", ";
+                auto start = (size_t)_sql.tellp();
+                parseNode(expr);
+                string term = _sql.str().substr(start);
+                // SQLite doesn't let a result column refer to another one's alias:
+                for (auto &alias : _aliases) {
+                    require(alias.second != kResultAlias
+                                || term.find('"' + alias.first + '"') == string::npos,
+                            "Continuation tokens can't be used when ORDER_BY refers to a "
+                            "result alias ('%s')", alias.first.c_str());
+                }
+                keyset.keys.emplace_back(term, descending);
+            }
+            _context.pop_back();
+        }
+        string docIDKey = tablePrefix + "key";
+        _sql << ", " << docIDKey;
+        keyset.keys.emplace_back(docIDKey, false);
+    }
+
+
+    string QueryParser::keysetSeekSQL(const KeysetQuery &keyset, const vector<bool> &nullKeys) {
+        DebugAssert(nullKeys.size() == keyset.keys.size());
+        auto param = [](size_t i) {return CONCAT("$__key" << i);};
+
+        // Rows whose key `i` equals the previous row's:
+        auto equal = [&](size_t i) {
+            string expr = "(" + keyset.keys[i].first + ")";
+            return nullKeys[i] ? expr + " IS NULL" : expr + " = " + param(i);
+        };
+        // Rows whose key `i` sorts after the previous row's. (SQLite sorts nulls first.)
+        auto after = [&](size_t i) {
+            string expr = "(" + keyset.keys[i].first + ")";
+            if (keyset.keys[i].second)
+                return nullKeys[i] ? string("0") : "(" + expr + " < " + param(i)
+                                                       + " OR " + expr + " IS NULL)";
+            else
+                return nullKeys[i] ? expr + " IS NOT NULL" : expr + " > " + param(i);
+        };
+
+        stringstream sql;
+        // First, a range on the first key alone, which SQLite can use to seek in an index:
+        if (!nullKeys[0]) {
+            string expr = "(" + keyset.keys[0].first + ")";
+            if (keyset.keys[0].second)
+                sql << "(" << expr << " <= " << param(0) << " OR " << expr << " IS NULL) AND ";
+            else
+                sql << expr << " >= " << param(0) << " AND ";
+        }
+        // Then the exact condition: (k0 > v0) OR (k0 = v0 AND k1 > v1) OR ...
+        sql << "(";
+        for (size_t i = 0; i < keyset.keys.size(); ++i) {
+            if (i > 0)
+                sql << " OR ";
+            sql << "(";
+            for (size_t j = 0; j < i; ++j)
+                sql << equal(j) << " AND ";
+            sql << after(i) << ")";
+        }
+        sql << ")";
+        return sql.str();
+    }
+
+}
@@ -0,0 +1,381 @@
+//
+// QueryParser+Partition.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "FleeceImpl.hh"
+#include "StringUtil.hh"
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+using namespace litecore::qp;
+
+namespace litecore {
+
+    /*
+     A partitioned query runs in two steps:
+       1. The partition query runs once per range of document rowids, in parallel on separate
+          connections. It's the original query minus DISTINCT/ORDER BY/LIMIT, with a rowid range
+          added to the WHERE clause. In an aggregate query each aggregate is replaced by one that
+          can be combined across ranges: `avg(x)` becomes `sum(x), count(x)`. Extra columns are
+          added for the GROUP BY expressions (aggregate queries) or ORDER BY expressions (others.)
+       2. The rows of all ranges are inserted into a temporary table, and the merge query runs on
+          it: it groups the rows again and combines the aggregates (`count` becomes `sum`, `avg`
+          becomes sum/count), then applies the original ORDER BY, LIMIT and OFFSET.
+     */
+
+
+    // Aggregate functions whose results over ranges can be combined:
+    static constexpr slice kMergeableAggregates[] = {
+        "avg()"_sl, "count()"_sl, "max()"_sl, "min()"_sl, "sum()"_sl
+    };
+
+    // Operations whose results depend on more than one document row, or on state that isn't
+    // visible in the merge table:
+    static constexpr slice kUnpartitionableOps[] = {
+        "MATCH"_sl, "COLLATE"_sl, "SELECT"_sl, "prediction()"_sl, "rank()"_sl
+    };
+
+
+    static unsigned countNodes(const Value *root, slice op) {
+        return root ? findNodes(root, op, 0, [](const Array*) { }) : 0;
+    }
+
+
+    // If `expr` is a call to a mergeable aggregate function, returns its name without the "()".
+    static slice aggregateName(const Value *expr) {
+        auto op = expr->asArray();
+        if (!op || op->count() == 0)
+            return nullslice;
+        slice name = op->get(0)->asString();
+        for (slice fn : kMergeableAggregates) {
+            if (name.caseEquivalent(fn))
+                return slice(fn.buf, fn.size - 2);
+        }
+        return nullslice;
+    }
+
+
+    static bool containsAggregate(const Value *root) {
+        for (slice fn : kMergeableAggregates) {
+            if (countNodes(root, fn) > 0)
+                return true;
+        }
+        return false;
+    }
+
+
+    // Is this LIMIT/OFFSET value a number or a parameter, i.e. not dependent on a document?
+    static bool isConstant(const Value *value) {
+        if (value->type() == kNumber)
+            return true;
+        auto op = value->asArray();
+        return op && op->count() == 1 && op->get(0)->asString().hasPrefix('$');
+    }
+
+
+    // If `expr` is a property path consisting only of `alias`, returns true.
+    static bool referencesAlias(const Value *expr, const string &alias) {
+        if (alias.empty())
+            return false;
+        slice path = expr->asString();
+        if (auto op = expr->asArray(); op && op->count() == 1) {
+            path = op->get(0)->asString();
+            if (!path.hasPrefix('.'))
+                return false;
+            path.moveStart(1);
+        }
+        return path == slice(alias);
+    }
+
+
+    static void writeAggregateCall(Encoder &enc, slice fn, const Value *call) {
+        enc.beginArray();
+        enc.writeString(fn);
+        Array::iterator args(call->asArray());
+        for (++args; args; ++args)
+            enc.writeValue(args.value());
+        enc.endArray();
+    }
+
+
+    bool QueryParser::parsePartitioned(const Value *expression,
+                                       const string &mergeTable,
+                                       PartitionedQuery &out)
+    {
+        // Find the operands of the SELECT, the same way parseSelect() does:
+        const Value *where;
+        const Dict *operands = expression->asDict();
+        if (!operands) {
+            const Array *a = expression->asArray();
+            if (a && a->count() > 1 && a->get(0)->asString() == "SELECT"_sl) {
+                operands = a->get(1)->asDict();
+                if (!operands)
+                    return false;
+            }
+        }
+        if (operands) {
+            where = getCaseInsensitive(operands, "WHERE"_sl);
+        } else {
+            operands = Dict::kEmpty;
+            where = expression;
+        }
+
+        // Check whether the query can be partitioned:
+        auto distinct = getCaseInsensitive(operands, "DISTINCT"_sl);
+        if ((distinct && distinct->asBool()) || getCaseInsensitive(operands, "HAVING"_sl))
+            return false;
+        auto from = getCaseInsensitive(operands, "FROM"_sl);
+        if (from && (!from->asArray() || from->asArray()->count() > 1))
+            return false;       // JOIN or UNNEST
+        for (slice op : kUnpartitionableOps) {
+            if (countNodes(operands, op) > 0 || countNodes(where, op) > 0)
+                return false;
+        }
+        auto limit = getCaseInsensitive(operands, "LIMIT"_sl);
+        auto offset = getCaseInsensitive(operands, "OFFSET"_sl);
+        if ((limit && !isConstant(limit)) || (offset && !isConstant(offset)))
+            return false;
+
+        struct ResultItem {
+            const Value *source;        // WHAT item
+            const Value *expr;          // WHAT item minus any 'AS'
+            string alias;
+            slice aggregate;            // Name of aggregate function, if expr calls one
+            string mergeExpr;           // SQL that computes the result in the merge query
+        };
+        vector<ResultItem> results;
+        bool aggregated = false;
+        if (auto what = getCaseInsensitive(operands, "WHAT"_sl); what) {
+            auto whatList = what->asArray();
+            if (!whatList)
+                return false;
+            for (Array::iterator i(whatList); i; ++i) {
+                ResultItem item {i.value(), i.value()};
+                auto as = i.value()->asArray();
+                if (as && as->count() == 3 && as->get(0)->asString().caseEquivalent("AS"_sl)) {
+                    item.expr = as->get(1);
+                    item.alias = string(as->get(2)->asString());
+                }
+                item.aggregate = aggregateName(item.expr);
+                if (item.aggregate) {
+                    auto call = item.expr->asArray();
+                    if (call->count() > 2 || (call->count() == 2 && containsAggregate(call->get(1))))
+                        return false;
+                    aggregated = true;
+                } else if (containsAggregate(item.expr)) {
+                    return false;       // aggregate nested in an expression
+                }
+                results.push_back(move(item));
+            }
+        }
+
+        const Array *groupList = nullptr;
+        if (auto groupBy = getCaseInsensitive(operands, "GROUP_BY"_sl); groupBy) {
+            groupList = groupBy->asArray();
+            if (!groupList)
+                return false;
+            if (groupList->count() > 0)
+                aggregated = true;
+        }
+        if (aggregated && results.empty())
+            return false;
+
+        struct OrderItem {
+            const Value *expr;
+            bool descending;
+        };
+        vector<OrderItem> order;
+        if (auto orderBy = getCaseInsensitive(operands, "ORDER_BY"_sl); orderBy) {
+            auto orderList = orderBy->asArray();
+            if (!orderList)
+                return false;
+            for (Array::iterator i(orderList); i; ++i) {
+                OrderItem item {i.value(), false};
+                auto op = item.expr->asArray();
+                if (op && op->count() == 2) {
+                    slice dir = op->get(0)->asString();
+                    if (dir.caseEquivalent("DESC"_sl) || dir.caseEquivalent("ASC"_sl)) {
+                        item.descending = dir.caseEquivalent("DESC"_sl);
+                        item.expr = op->get(1);
+                    }
+                }
+                if (!aggregated && containsAggregate(item.expr))
+                    return false;
+                order.push_back(item);
+            }
+        }
+
+        auto column = [](unsigned n) {return CONCAT('c' << n);};
+
+        reset();
+        try {
+            parseFromClause(from);
+
+            // The partition query's result columns. Non-aggregate results are written the same
+            // way as in the regular query; aggregates lose their 'AS' and avg() is split:
+            Encoder whatEnc;
+            whatEnc.beginArray();
+            unsigned nColumns = 0;
+            for (auto &item : results) {
+                if (item.aggregate == "avg"_sl) {
+                    // An average of averages isn't the average, but a sum of sums is the sum:
+                    writeAggregateCall(whatEnc, "sum()"_sl, item.expr);
+                    writeAggregateCall(whatEnc, "count()"_sl, item.expr);
+                    item.mergeExpr = CONCAT("CAST(sum(" << column(nColumns) << ") AS REAL) / sum("
+                                            << column(nColumns + 1) << ")");
+                    nColumns += 2;
+                    continue;
+                } else if (item.aggregate) {
+                    whatEnc.writeValue(item.expr);
+                    slice fn = item.aggregate == "count"_sl ? "sum"_sl : item.aggregate;
+                    item.mergeExpr = CONCAT(fn << '(' << column(nColumns) << ')');
+                } else {
+                    whatEnc.writeValue(item.source);
+                    item.mergeExpr = column(nColumns);
+                }
+                ++nColumns;
+            }
+            whatEnc.endArray();
+            Retained<Doc> whatDoc = whatEnc.finishDoc();
+
+            _sql << "SELECT ";
+            if (results.empty()) {
+                string prefix;
+                if (_propertiesUseSourcePrefix)
+                    prefix = CONCAT('"' << _dbAlias << "\".");
+                _sql << prefix << "key, " << prefix << "sequence";
+                nColumns = 2;
+            } else {
+                Array::iterator items(whatDoc->asArray());
+                _context.push_back(&kExpressionListOperation);
+                _aggregatesOK = true;
+                handleOperation(&kResultListOperation, kResultListOperation.op, items);
+                _aggregatesOK = false;
+                _context.pop_back();
+            }
+
+            // The key columns the merge query groups or sorts by. An ORDER BY of a result alias
+            // uses that result's column instead.
+            vector<string> orderTerms(order.size());
+            Encoder keyEnc;
+            keyEnc.beginArray();
+            unsigned nKeys = 0;
+            if (aggregated && groupList) {
+                for (Array::iterator i(groupList); i; ++i)
+                    keyEnc.writeValue(i.value());
+                nKeys = groupList->count();
+            }
+            for (size_t i = 0; i < order.size(); ++i) {
+                for (auto &item : results) {
+                    if (referencesAlias(order[i].expr, item.alias)) {
+                        orderTerms[i] = item.mergeExpr;
+                        break;
+                    }
+                }
+                if (orderTerms[i].empty() && !aggregated) {
+                    keyEnc.writeValue(order[i].expr);
+                    orderTerms[i] = column(nColumns + nKeys++);
+                }
+            }
+            keyEnc.endArray();
+            Retained<Doc> keyDoc = keyEnc.finishDoc();
+            if (nKeys > 0) {
+                _sql << ", ";
+                Array::iterator keys(keyDoc->asArray());
+                _context.push_back(&kExpressionListOperation);
+                writeColumnList(keys);
+                _context.pop_back();
+            }
+
+            writeFromClause(from);
+            writeWhereClause(where);
+            _sql << " AND \"" << _dbAlias << "\".rowid BETWEEN $__rowid_lo AND $__rowid_hi";
+
+            if (aggregated) {
+                writeSelectListClause(operands, "GROUP_BY"_sl, " GROUP BY ");
+            } else if (limit) {
+                // Each range only has to produce the rows that could get past the LIMIT & OFFSET:
+                writeSelectListClause(operands, "ORDER_BY"_sl, " ORDER BY ", true);
+                _sql << " LIMIT MAX(0, ";
+                parseNode(limit);
+                _sql << ")";
+                if (offset) {
+                    _sql << " + MAX(0, ";
+                    parseNode(offset);
+                    _sql << ")";
+                }
+            }
+            out.partitionSQL = _sql.str();
+            out.partitionColumns = nColumns + nKeys;
+
+            // Now the merge query:
+            _sql.str(string());
+            _sql << "SELECT ";
+            if (results.empty()) {
+                _sql << column(0) << ", " << column(1);
+            } else {
+                int n = 0;
+                for (auto &item : results)
+                    _sql << (n++ ? ", " : "") << item.mergeExpr;
+            }
+            _sql << " FROM temp.\"" << mergeTable << '"';
+
+            if (aggregated && groupList && groupList->count() > 0) {
+                _sql << " GROUP BY ";
+                for (unsigned i = 0; i < groupList->count(); ++i)
+                    _sql << (i ? ", " : "") << column(nColumns + i);
+            }
+
+            if (!order.empty()) {
+                _sql << " ORDER BY ";
+                for (size_t i = 0; i < order.size(); ++i) {
+                    if (orderTerms[i].empty()) {
+                        // In an aggregate query, an ORDER BY has to be a GROUP BY expression or
+                        // a result; any other expression can't be computed from the merge table:
+                        for (unsigned g = 0; groupList && g < groupList->count(); ++g) {
+                            if (order[i].expr->isEqual(groupList->get(g))) {
+                                orderTerms[i] = column(nColumns + g);
+                                break;
+                            }
+                        }
+                        for (auto &item : results) {
+                            if (orderTerms[i].empty() && order[i].expr->isEqual(item.expr))
+                                orderTerms[i] = item.mergeExpr;
+                        }
+                        if (orderTerms[i].empty())
+                            return false;
+                    }
+                    _sql << (i ? ", " : "") << orderTerms[i] << (order[i].descending ? " DESC" : "");
+                }
+            }
+
+            if (!writeOrderOrLimitClause(operands, "LIMIT"_sl,  "LIMIT")) {
+                if (offset)
+                    _sql << " LIMIT -1";        // SQL does not allow OFFSET without LIMIT
+            }
+            writeOrderOrLimitClause(operands, "OFFSET"_sl, "OFFSET");
+            out.mergeSQL = _sql.str();
+        } catch (const FleeceException &) {
+            return false;
+        }
+        return true;
+    }
+
+}
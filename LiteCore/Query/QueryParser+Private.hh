@@ -30,6 +30,7 @@ namespace litecore { namespace qp {
     // Names of the SQLite functions we register for working with Fleece data,
     // in SQLiteFleeceFunctions.cc:
     constexpr slice kValueFnName = "fl_value"_sl;
+    constexpr slice kBoxedValueFnName = "fl_boxed_value"_sl;
     constexpr slice kNestedValueFnName = "fl_nested_value"_sl;
     constexpr slice kUnnestedValueFnName = "fl_unnested_value"_sl;
     constexpr slice kFTSValueFnName = "fl_fts_value"_sl;
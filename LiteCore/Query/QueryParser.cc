@@ -171,6 +171,7 @@ namespace litecore {
         _columnTitles.clear();
         _1stCustomResultCol = 0;
         _isAggregateQuery = _aggregatesOK = _propertiesUseSourcePrefix = _checkedExpiration = false;
+        _directResultColumn = _isTopKQuery = false;
 
         _aliases.insert({_dbAlias, kDBAlias});
     }
@@ -195,6 +196,41 @@ namespace litecore {
     
     
     void QueryParser::parse(const Value *expression) {
+        // If a covering index has all the properties the query uses, query its table instead of
+        // the documents, so the bodies don't have to be read:
+        for (auto &coveringTable : _delegate.coveringTables()) {
+            if (parseCovered(expression, coveringTable))
+                return;
+        }
+        parseSelect(expression);
+    }
+
+
+    bool QueryParser::parseCovered(const Value *expression, const CoveringTable &coveringTable) {
+        string tableName = _tableName;
+        _tableName = CONCAT('"' << coveringTable.tableName << '"');
+        _coveringTable = &coveringTable;
+        _coveringFailed = false;
+        try {
+            parseSelect(expression);
+        } catch (const std::exception &) {
+            _coveringFailed = true;     // let the regular parse report the error
+        }
+        _tableName = tableName;
+        _coveringTable = nullptr;
+
+        // Joins, UNNEST, MATCH and prediction() all need the document table:
+        for (auto &alias : _aliases) {
+            if (alias.second != kDBAlias && alias.second != kResultAlias)
+                _coveringFailed = true;
+        }
+        if (!_ftsTables.empty() || !_indexJoinTables.empty())
+            _coveringFailed = true;
+        return !_coveringFailed;
+    }
+
+
+    void QueryParser::parseSelect(const Value *expression) {
         reset();
         try {
             if (expression->asDict()) {
@@ -231,6 +267,9 @@ namespace litecore {
 
 
     void QueryParser::writeSelect(const Value *where, const Dict *operands) {
+        // parseKeyset() wants the clauses of this SELECT, but not of any nested ones:
+        KeysetQuery *keyset = std::exchange(_keyset, nullptr);
+
         // Find all the joins in the FROM clause first, to populate alias info. This has to be done
         // before writing the WHAT clause, because that will depend on the aliases.
         auto from = getCaseInsensitive(operands, "FROM"_sl);
@@ -271,12 +310,16 @@ namespace litecore {
             _columnTitles.push_back(string(kDocIDProperty));
             _columnTitles.push_back(string(kSequenceProperty));
         }
+        if (keyset)
+            writeKeysetColumns(*keyset, operands, defaultTablePrefix);
 
         // FROM clause:
         writeFromClause(from);
 
         // WHERE clause:
         writeWhereClause(where);
+        if (keyset)
+            keyset->selectSQL = _sql.str();
 
         // GROUP_BY clause:
         bool grouped = (writeSelectListClause(operands, "GROUP_BY"_sl, " GROUP BY ") > 0);
@@ -312,14 +355,30 @@ namespace litecore {
         }
 
         // ORDER_BY clause:
-        writeSelectListClause(operands, "ORDER_BY"_sl, " ORDER BY ", true);
+        auto orderPos = (size_t)_sql.tellp();
+        bool ordered = (writeSelectListClause(operands, "ORDER_BY"_sl, " ORDER BY ", true) > 0);
+        if (keyset)
+            _sql << (ordered ? ", " : " ORDER BY ") << keyset->keys.back().first;
 
         // LIMIT, OFFSET clauses:
-        if (!writeOrderOrLimitClause(operands, "LIMIT"_sl,  "LIMIT")) {
+        auto limitPos = (size_t)_sql.tellp();
+        bool limited = writeOrderOrLimitClause(operands, "LIMIT"_sl,  "LIMIT");
+        if (!limited) {
             if (getCaseInsensitive(operands, "OFFSET"_sl))
                 _sql << " LIMIT -1";            // SQL does not allow OFFSET without LIMIT
         }
+        auto offsetPos = (size_t)_sql.tellp();
         writeOrderOrLimitClause(operands, "OFFSET"_sl, "OFFSET");
+
+        if (keyset) {
+            string sql = _sql.str();
+            keyset->orderSQL = sql.substr(orderPos, limitPos - orderPos);
+            keyset->limitSQL = sql.substr(limitPos, offsetPos - limitPos);
+            keyset->offsetSQL = sql.substr(offsetPos);
+        }
+
+        // Sorting the rows, then keeping only the first few, makes this a "top-K" query:
+        _isTopKQuery = ordered && limited && !_isAggregateQuery;
     }
 
 
@@ -535,12 +594,15 @@ namespace litecore {
             _sql << " AS " << quoteTableName(_dbAlias);
         }
 
-        // Add joins to index tables (FTS, predictive):
+        // Add joins to index tables (FTS, predictive). FTS tables are keyed by rowid (FTS5 has
+        // no docid column); predictive tables are WITHOUT ROWID, keyed by docid:
         for (auto &ftsTable : _indexJoinTables) {
             auto &table = ftsTable.first;
             auto &alias = ftsTable.second;
+            bool isFTS = find(_ftsTables.begin(), _ftsTables.end(), table) != _ftsTables.end();
             _sql << " JOIN \"" << table << "\" AS " << alias
-                 << " ON " << alias << ".docid = " << quoteTableName(_dbAlias) << ".rowid";
+                 << " ON " << alias << (isFTS ? ".rowid" : ".docid") << " = "
+                 << quoteTableName(_dbAlias) << ".rowid";
         }
     }
 
@@ -723,6 +785,15 @@ namespace litecore {
     }
 
 
+    // Is this node (a WHAT item) just a property?
+    static bool isPropertyNode(const Value *node) {
+        if (node->type() == kString)
+            return true;
+        auto array = node->asArray();
+        return array && array->count() > 0 && array->get(0)->asString().hasPrefix('.');
+    }
+
+
     // Handles the WHAT clause (list of results)
     void QueryParser::resultOp(slice op, Array::iterator& operands) {
         int n = 0;
@@ -742,17 +813,21 @@ namespace litecore {
 
                 result = expr[1];
                 _sql << kResultFnName << "(";
+                _directResultColumn = isPropertyNode(result);
                 parseCollatableNode(result);
+                _directResultColumn = false;
                 _sql << ") AS \"" << title << '"';
                 addAlias(title, kResultAlias);
             } else {
                 _sql << kResultFnName << "(";
+                _directResultColumn = isPropertyNode(result);
                 if (result->type() == kString) {
                     // Convenience shortcut: interpret a string in a WHAT as a property path
                     writePropertyGetter(kValueFnName, Path(result->asString()));
                 } else {
                     parseCollatableNode(result);
                 }
+                _directResultColumn = false;
                 _sql << ")";
 
                 // Come up with a column title if there is no 'AS':
@@ -1302,6 +1377,10 @@ namespace litecore {
 
     // Writes a call to a Fleece SQL function, including the closing ")".
     void QueryParser::writePropertyGetter(slice fn, Path &&property, const Value *param) {
+        // Only the first getter written while parsing a result column can be the entire column:
+        bool directResultColumn = _directResultColumn;
+        _directResultColumn = false;
+
         string tablePrefix;
         string alias;
         auto iType = _aliases.end();
@@ -1365,6 +1444,8 @@ namespace litecore {
             } else if (meta == kExpirationProperty) {
                 writeMetaProperty(fn, tablePrefix, "expiration");
                 _checkedExpiration = true;
+                if (_coveringTable)
+                    _coveringFailed = true;
                 return;
             } else if (meta == kDeletedProperty) {
                 require(fn == kValueFnName, "can't use '_deleted' in this context");
@@ -1373,8 +1454,26 @@ namespace litecore {
                 return;
             } else if (meta == kRevIDProperty) {
                 _sql << kVersionFnName << "(" << tablePrefix << "version" << ")";
+                if (_coveringTable)
+                    _coveringFailed = true;
+                return;
+            }
+        }
+
+        if (_coveringTable) {
+            // Get the value from the covering table's column, if it has one:
+            auto i = _coveringTable->columns.find(string(property));
+            if (i != _coveringTable->columns.end() && fn == kValueFnName && !param) {
+                if (directResultColumn) {
+                    // Booleans, nulls, unsigned ints and data are stored separately, type-preserved:
+                    _sql << "coalesce(" << tablePrefix << "\"r" << i->second << "\", "
+                         << tablePrefix << "\"v" << i->second << "\")";
+                } else {
+                    _sql << tablePrefix << "\"v" << i->second << '"';
+                }
                 return;
             }
+            _coveringFailed = true;
         }
 
         // It's more efficent to get the doc root with fl_root than with fl_value:
@@ -20,6 +20,7 @@
 #include "Base.hh"
 #include "UnicodeCollator.hh"
 #include "Array.hh"
+#include <map>
 #include <memory>
 #include <set>
 #include <sstream>
@@ -38,6 +39,13 @@ namespace litecore {
 
     class QueryParser {
     public:
+        /** A table holding the values of a covering index's properties (see
+            SQLiteKeyStore+CoveringIndexes.cc), which can substitute for the document table. */
+        struct CoveringTable {
+            std::string tableName;
+            std::map<std::string, unsigned> columns;    // property path -> column number
+        };
+
         /** Delegate knows about the naming & existence of tables. */
         class delegate {
         public:
@@ -50,6 +58,26 @@ namespace litecore {
             virtual std::string predictiveTableName(const std::string &property) const =0;
 #endif
             virtual bool tableExists(const std::string &tableName) const =0;
+            virtual std::vector<CoveringTable> coveringTables() const  {return {};}
+        };
+
+        /** A query split into a part that can run independently on ranges of documents, and a
+            part that combines the results of those ranges (see QueryParser+Partition.cc.) */
+        struct PartitionedQuery {
+            std::string partitionSQL;       // Query of one range; has $__rowid_lo, $__rowid_hi
+            std::string mergeSQL;           // Query of the merge table holding all ranges' rows
+            unsigned partitionColumns {0};  // Number of columns in the partition query/merge table
+        };
+
+        /** A query that can resume after a given row, for paging by continuation tokens
+            (see QueryParser+Keyset.cc.) The SQL is split into clauses so that a condition on the
+            sort keys can be added to the WHERE clause. */
+        struct KeysetQuery {
+            std::string selectSQL;          // SELECT ... WHERE ...; ends with the WHERE clause
+            std::string orderSQL;           // ORDER BY clause, ending with the docID
+            std::string limitSQL;           // LIMIT clause, if any
+            std::string offsetSQL;          // OFFSET clause, if any (only for the first page)
+            std::vector<std::pair<std::string,bool>> keys; // SQL of each sort key, & descending?
         };
 
         QueryParser(const delegate &delegate)
@@ -64,6 +92,24 @@ namespace litecore {
 
         void parseJustExpression(const fleece::impl::Value *expression);
 
+        /** Splits a query into a PartitionedQuery whose merge query reads from the temporary table
+            `mergeTable`, with columns named c0, c1, ... Returns false if the query can't be split,
+            for instance if it has DISTINCT, HAVING, a JOIN or a MATCH. */
+        bool parsePartitioned(const fleece::impl::Value*,
+                              const std::string &mergeTable,
+                              PartitionedQuery&);
+
+        /** Parses a query into a KeysetQuery. Its result rows have an extra column per sort key
+            after the regular ones: the values of the ORDER BY expressions, then the docID, which
+            is added as the last sort key so the order is total. Throws an InvalidQuery error if
+            the query can't be paged this way, for instance if it has GROUP_BY, a JOIN or a MATCH. */
+        void parseKeyset(const fleece::impl::Value*, KeysetQuery&);
+
+        /** Returns a SQL condition that matches the rows sorting after the row whose sort key
+            values are bound to the parameters `$__key0`, `$__key1`... `nullKeys` tells which of
+            those values are null, since SQL comparisons with null don't work. */
+        static std::string keysetSeekSQL(const KeysetQuery&, const std::vector<bool> &nullKeys);
+
         void writeCreateIndex(const std::string &name,
                               fleece::impl::Array::iterator &whatExpressions,
                               const fleece::impl::Array *whereClause,
@@ -79,6 +125,7 @@ namespace litecore {
         const std::vector<std::string>& columnTitles() const        {return _columnTitles;}
 
         bool isAggregateQuery() const                               {return _isAggregateQuery;}
+        bool isTopKQuery() const                                    {return _isTopKQuery;}
         bool usesExpiration() const                                 {return _checkedExpiration;}
 
         std::string expressionSQL(const fleece::impl::Value*);
@@ -122,6 +169,8 @@ namespace litecore {
         QueryParser& operator=(const QueryParser&) =delete;
 
         void reset();
+        void parseSelect(const fleece::impl::Value*);
+        bool parseCovered(const fleece::impl::Value*, const CoveringTable&);
         void parseNode(const fleece::impl::Value*);
         void parseOpNode(const fleece::impl::Array*);
         void handleOperation(const Operation*, slice actualOperator, fleece::impl::Array::iterator& operands);
@@ -129,6 +178,7 @@ namespace litecore {
 
         void writeSelect(const fleece::impl::Dict *dict);
         void writeSelect(const fleece::impl::Value *where, const fleece::impl::Dict *operands);
+        void writeKeysetColumns(KeysetQuery&, const fleece::impl::Dict*, const std::string &prefix);
         unsigned writeSelectListClause(const fleece::impl::Dict *operands, slice key, const char *sql, bool aggregatesOK =false);
 
         void writeWhereClause(const fleece::impl::Value *where);
@@ -214,11 +264,16 @@ namespace litecore {
         unsigned _1stCustomResultCol {0};           // Index of 1st result after _baseResultColumns
         bool _aggregatesOK {false};                 // Are aggregate fns OK to call?
         bool _isAggregateQuery {false};             // Is this an aggregate query?
+        bool _isTopKQuery {false};                  // Non-aggregate query with ORDER BY and LIMIT?
         bool _checkedDeleted {false};               // Has query accessed _deleted meta-property?
         bool _checkedExpiration {false};            // Has query accessed _expiration meta-property?
         Collation _collation;                       // Collation in use during parse
         bool _collationUsed {true};                 // Emitted SQL "COLLATION" yet?
         bool _functionWantsCollation {false};       // The current function wants to receive collation in its argument list
+        const CoveringTable* _coveringTable {nullptr}; // Covering table replacing _tableName
+        bool _coveringFailed {false};               // Query needs something not in _coveringTable
+        KeysetQuery* _keyset {nullptr};             // Captures the clauses, in parseKeyset()
+        bool _directResultColumn {false};           // Next property getter is a whole result column
     };
 
 }
@@ -70,25 +70,25 @@ namespace litecore {
     void SQLiteDataFile::registerIndex(const litecore::IndexSpec &spec,
                                        const string &keyStoreName, const string &indexTableName)
     {
-        SQLite::Statement stmt(*this, "INSERT INTO indexes (name, type, keyStore, expression, indexTableName) "
-                                      "VALUES (?, ?, ?, ?, ?)");
-        stmt.bindNoCopy(1, spec.name);
-        stmt.bind(      2, spec.type);
-        stmt.bindNoCopy(3, keyStoreName);
-        stmt.bindNoCopy(4, (char*)spec.expressionJSON.buf, (int)spec.expressionJSON.size);
-        if (spec.type != IndexSpec::kValue)
-            stmt.bindNoCopy(5, indexTableName);
-        LogStatement(stmt);
-        stmt.exec();
+        auto stmt = cachedStatement("INSERT INTO indexes (name, type, keyStore, expression, indexTableName) "
+                                    "VALUES (?, ?, ?, ?, ?)");
+        stmt->bindNoCopy(1, spec.name);
+        stmt->bind(      2, spec.type);
+        stmt->bindNoCopy(3, keyStoreName);
+        stmt->bindNoCopy(4, (char*)spec.expressionJSON.buf, (int)spec.expressionJSON.size);
+        if (spec.type != IndexSpec::kValue || (!indexTableName.empty() && spec.include()))
+            stmt->bindNoCopy(5, indexTableName);     // (a covering value index has a table)
+        UsingStatement u(stmt);
+        stmt->exec();
     }
 
 
 
     void SQLiteDataFile::unregisterIndex(slice indexName) {
-        SQLite::Statement stmt(*this, "DELETE FROM indexes WHERE name=?");
-        stmt.bindNoCopy(1, (char*)indexName.buf, (int)indexName.size);
-        LogStatement(stmt);
-        stmt.exec();
+        auto stmt = cachedStatement("DELETE FROM indexes WHERE name=?");
+        stmt->bindNoCopy(1, (char*)indexName.buf, (int)indexName.size);
+        UsingStatement u(stmt);
+        stmt->exec();
     }
 
 
@@ -106,6 +106,8 @@ namespace litecore {
                 bool same;
                 if (spec.type == IndexSpec::kFullText)
                     same = schemaExistsWithSQL(indexTableName, "table", indexTableName, indexSQL);
+                else if (spec.type == IndexSpec::kValue && !existingSpec->indexTableName.empty())
+                    same = false;       // Existing index is a covering index
                 else
                     same = schemaExistsWithSQL(spec.name, "index", indexTableName, indexSQL);
                 if (same)
@@ -139,9 +141,10 @@ namespace litecore {
     // Drops unnested-array tables that no longer have any indexes on them.
     void SQLiteDataFile::garbageCollectIndexTable(const string &tableName) {
         {
-            SQLite::Statement stmt(*this, "SELECT name FROM indexes WHERE indexTableName=?");
-            stmt.bind(1, tableName);
-            if (stmt.executeStep())
+            auto stmt = cachedStatement("SELECT name FROM indexes WHERE indexTableName=?");
+            stmt->bind(1, tableName);
+            UsingStatement u(stmt);
+            if (stmt->executeStep())
                 return;
         }
 
@@ -164,12 +167,13 @@ namespace litecore {
     vector<SQLiteIndexSpec> SQLiteDataFile::getIndexes(const KeyStore *store) {
         if (indexTableExists()) {
             vector<SQLiteIndexSpec> indexes;
-            SQLite::Statement stmt(*this, "SELECT name, type, expression, keyStore, indexTableName "
-                                          "FROM indexes ORDER BY name");
-            while(stmt.executeStep()) {
-                string keyStoreName = stmt.getColumn(3);
+            auto stmt = cachedStatement("SELECT name, type, expression, keyStore, indexTableName "
+                                        "FROM indexes ORDER BY name");
+            UsingStatement u(stmt);
+            while(stmt->executeStep()) {
+                string keyStoreName = stmt->getColumn(3);
                 if (!store || keyStoreName == store->name())
-                    indexes.emplace_back(specFromStatement(stmt));
+                    indexes.emplace_back(specFromStatement(*stmt));
             }
             return indexes;
         } else {
@@ -215,11 +219,12 @@ namespace litecore {
     // Gets info of a single index. (Subroutine of create/deleteIndex.)
     optional<SQLiteIndexSpec> SQLiteDataFile::getIndex(slice name) {
         ensureIndexTableExists();
-        SQLite::Statement stmt(*this, "SELECT name, type, expression, keyStore, indexTableName "
-                                      "FROM indexes WHERE name=?");
-        stmt.bindNoCopy(1, (char*)name.buf, (int)name.size);
-        if (stmt.executeStep())
-            return specFromStatement(stmt);
+        auto stmt = cachedStatement("SELECT name, type, expression, keyStore, indexTableName "
+                                    "FROM indexes WHERE name=?");
+        stmt->bindNoCopy(1, (char*)name.buf, (int)name.size);
+        UsingStatement u(stmt);
+        if (stmt->executeStep())
+            return specFromStatement(*stmt);
         else
             return {};
     }
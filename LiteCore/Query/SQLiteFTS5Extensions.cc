@@ -0,0 +1,319 @@
+//
+// SQLiteFTS5Extensions.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SQLite_Internal.hh"
+#include "Logging.hh"
+#include <sqlite3.h>
+#include <sstream>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+namespace litecore {
+
+    /*
+     FTS5 doesn't support FTS3-style tokenizers or the FTS3 auxiliary functions, so to let an
+     FTS5 table stand in for an FTS4 one, this file registers with each connection's FTS5 module:
+       * a "unicodesn" tokenizer that forwards to the FTS3 "unicodesn" tokenizer (which does the
+         Snowball stemming and stop-word removal), taking the same arguments;
+       * an "offsets" function that returns the same format as FTS3's offsets(), which
+         SQLiteQuery uses to find the matched terms;
+       * a "matchinfo" function that returns the same blob as FTS3's matchinfo() with its default
+         "pcx" format, which is what the rank() function in SQLiteFTSRankFunction.cc consumes.
+     */
+
+
+#pragma mark - TOKENIZER:
+
+
+    // The FTS3 tokenizer interface, from SQLite's fts3_tokenizer.h:
+    namespace fts3 {
+        struct tokenizer;
+        struct tokenizer_cursor;
+
+        struct tokenizer_module {
+            int iVersion;
+            int (*xCreate)(int argc, const char *const*argv, tokenizer **ppTokenizer);
+            int (*xDestroy)(tokenizer *pTokenizer);
+            int (*xOpen)(tokenizer *pTokenizer, const char *pInput, int nBytes,
+                         tokenizer_cursor **ppCursor);
+            int (*xClose)(tokenizer_cursor *pCursor);
+            int (*xNext)(tokenizer_cursor *pCursor, const char **ppToken, int *pnBytes,
+                         int *piStartOffset, int *piEndOffset, int *piPosition);
+            int (*xLanguageid)(tokenizer_cursor *pCsr, int iLangid);
+        };
+
+        struct tokenizer        { const tokenizer_module *pModule; };
+        struct tokenizer_cursor { tokenizer *pTokenizer; };
+    }
+
+
+    // Looks up a registered FTS3 tokenizer module by name.
+    static const fts3::tokenizer_module* findFTS3Tokenizer(sqlite3 *db, const char *name) {
+        const fts3::tokenizer_module *module = nullptr;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, "SELECT fts3_tokenizer(?)", -1, &stmt, nullptr) != SQLITE_OK)
+            return nullptr;
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == sizeof(module))
+            memcpy(&module, sqlite3_column_blob(stmt, 0), sizeof(module));
+        sqlite3_finalize(stmt);
+        return module;
+    }
+
+
+    // An FTS5 tokenizer instance, wrapping an FTS3 one.
+    struct FTS5TokenizerAdapter {
+        const fts3::tokenizer_module *module;
+        fts3::tokenizer *tokenizer;
+    };
+
+
+    static int adapterCreate(void *context, const char **azArg, int nArg, Fts5Tokenizer **ppOut) {
+        auto module = (const fts3::tokenizer_module*)context;
+        fts3::tokenizer *tokenizer = nullptr;
+        int rc = module->xCreate(nArg, azArg, &tokenizer);
+        if (rc != SQLITE_OK)
+            return rc;
+        tokenizer->pModule = module;
+        *ppOut = (Fts5Tokenizer*) new FTS5TokenizerAdapter{module, tokenizer};
+        return SQLITE_OK;
+    }
+
+
+    static void adapterDelete(Fts5Tokenizer *t) {
+        auto adapter = (FTS5TokenizerAdapter*)t;
+        adapter->module->xDestroy(adapter->tokenizer);
+        delete adapter;
+    }
+
+
+    static int adapterTokenize(Fts5Tokenizer *t, void *pCtx, int flags,
+                               const char *pText, int nText,
+                               int (*xToken)(void*, int, const char*, int, int, int))
+    {
+        auto adapter = (FTS5TokenizerAdapter*)t;
+        fts3::tokenizer_cursor *cursor = nullptr;
+        int rc = adapter->module->xOpen(adapter->tokenizer, pText, nText, &cursor);
+        if (rc != SQLITE_OK)
+            return rc;
+        cursor->pTokenizer = adapter->tokenizer;
+        const char *token;
+        int nToken, start, end, position;
+        while (SQLITE_OK == (rc = adapter->module->xNext(cursor, &token, &nToken,
+                                                          &start, &end, &position))) {
+            rc = xToken(pCtx, 0, token, nToken, start, end);
+            if (rc != SQLITE_OK)
+                break;
+        }
+        adapter->module->xClose(cursor);
+        return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+
+
+#pragma mark - OFFSETS:
+
+
+    // Collects the byte ranges of the tokens of a column's text, in order of position.
+    static int collectTokenRange(void *context, int tflags, const char*, int, int start, int end) {
+        if (!(tflags & FTS5_TOKEN_COLOCATED))
+            ((vector<pair<int,int>>*)context)->emplace_back(start, end - start);
+        return SQLITE_OK;
+    }
+
+
+    // offsets(ftsTable) : Returns a string of space-separated integers in groups of four,
+    // one group per matched term: column number, term number, byte offset, byte length.
+    static void offsetsFunc(const Fts5ExtensionApi *api, Fts5Context *fts,
+                            sqlite3_context *ctx, int, sqlite3_value**)
+    {
+        int nInst;
+        int rc = api->xInstCount(fts, &nInst);
+        if (rc != SQLITE_OK) {
+            sqlite3_result_error_code(ctx, rc);
+            return;
+        }
+
+        // Term numbers count every token of every phrase, as in FTS3:
+        int nPhrase = api->xPhraseCount(fts);
+        vector<int> firstTerm(nPhrase);
+        for (int p = 0, term = 0; p < nPhrase; ++p) {
+            firstTerm[p] = term;
+            term += api->xPhraseSize(fts, p);
+        }
+
+        stringstream out;
+        int tokenizedCol = -1;
+        vector<pair<int,int>> tokenRanges;
+        for (int i = 0; i < nInst; ++i) {
+            int phrase, col, offset;
+            if ((rc = api->xInst(fts, i, &phrase, &col, &offset)) != SQLITE_OK)
+                break;
+            if (col != tokenizedCol) {
+                // Re-tokenize the column's text to map token positions to byte ranges:
+                const char *text;
+                int nText;
+                tokenRanges.clear();
+                if ((rc = api->xColumnText(fts, col, &text, &nText)) != SQLITE_OK
+                        || (rc = api->xTokenize(fts, text, nText, &tokenRanges,
+                                                collectTokenRange)) != SQLITE_OK)
+                    break;
+                tokenizedCol = col;
+            }
+            int phraseSize = api->xPhraseSize(fts, phrase);
+            for (int t = 0; t < phraseSize; ++t) {
+                if (offset + t >= (int)tokenRanges.size())
+                    break;
+                auto &range = tokenRanges[offset + t];
+                if (out.tellp() > 0)
+                    out << ' ';
+                out << col << ' ' << (firstTerm[phrase] + t) << ' '
+                    << range.first << ' ' << range.second;
+            }
+        }
+        if (rc != SQLITE_OK) {
+            sqlite3_result_error_code(ctx, rc);
+            return;
+        }
+        string result = out.str();
+        sqlite3_result_text(ctx, result.data(), (int)result.size(), SQLITE_TRANSIENT);
+    }
+
+
+#pragma mark - MATCHINFO:
+
+
+    // Per-query hit counts of each phrase in each column, across all rows.
+    struct GlobalHits {
+        int nCol;
+        vector<int32_t> hits;           // [phrase * nCol + col] -> total hits
+        vector<int32_t> docs;           // [phrase * nCol + col] -> number of rows with hits
+        int phrase;                     // (current phrase while collecting)
+    };
+
+
+    static int collectPhraseHits(const Fts5ExtensionApi *api, Fts5Context *fts, void *context) {
+        auto global = (GlobalHits*)context;
+        int nInst;
+        int rc = api->xInstCount(fts, &nInst);
+        if (rc != SQLITE_OK)
+            return rc;
+        vector<bool> seen(global->nCol);
+        for (int i = 0; i < nInst; ++i) {
+            int phrase, col, offset;
+            if ((rc = api->xInst(fts, i, &phrase, &col, &offset)) != SQLITE_OK)
+                return rc;
+            int cell = global->phrase * global->nCol + col;
+            ++global->hits[cell];
+            if (!seen[col]) {
+                seen[col] = true;
+                ++global->docs[cell];
+            }
+        }
+        return SQLITE_OK;
+    }
+
+
+    // matchinfo(ftsTable) : Returns the same blob as FTS3's matchinfo(ftsTable, 'pcx'): the
+    // number of phrases, the number of columns, then for each phrase and each column the
+    // number of hits in this row, the number of hits in all rows, and the number of rows with
+    // hits. (Any format argument is ignored.)
+    static void matchinfoFunc(const Fts5ExtensionApi *api, Fts5Context *fts,
+                              sqlite3_context *ctx, int, sqlite3_value**)
+    {
+        int nPhrase = api->xPhraseCount(fts);
+        int nCol = api->xColumnCount(fts);
+
+        // The totals across all rows only need to be computed once per query:
+        auto global = (GlobalHits*)api->xGetAuxdata(fts, false);
+        if (!global) {
+            global = new GlobalHits{nCol,
+                                    vector<int32_t>(nPhrase * nCol),
+                                    vector<int32_t>(nPhrase * nCol),
+                                    0};
+            int rc = api->xSetAuxdata(fts, global, [](void *p) {delete (GlobalHits*)p;});
+            if (rc != SQLITE_OK) {
+                sqlite3_result_error_code(ctx, rc);
+                return;
+            }
+            for (global->phrase = 0; global->phrase < nPhrase; ++global->phrase) {
+                rc = api->xQueryPhrase(fts, global->phrase, global, collectPhraseHits);
+                if (rc != SQLITE_OK) {
+                    sqlite3_result_error_code(ctx, rc);
+                    return;
+                }
+            }
+        }
+
+        vector<int32_t> info(2 + 3 * nPhrase * nCol);
+        info[0] = nPhrase;
+        info[1] = nCol;
+        int nInst;
+        int rc = api->xInstCount(fts, &nInst);
+        for (int i = 0; i < nInst && rc == SQLITE_OK; ++i) {
+            int phrase, col, offset;
+            if ((rc = api->xInst(fts, i, &phrase, &col, &offset)) == SQLITE_OK)
+                ++info[2 + 3 * (phrase * nCol + col)];
+        }
+        if (rc != SQLITE_OK) {
+            sqlite3_result_error_code(ctx, rc);
+            return;
+        }
+        for (int cell = 0; cell < nPhrase * nCol; ++cell) {
+            info[2 + 3 * cell + 1] = global->hits[cell];
+            info[2 + 3 * cell + 2] = global->docs[cell];
+        }
+        sqlite3_result_blob(ctx, info.data(), (int)(info.size() * sizeof(int32_t)),
+                            SQLITE_TRANSIENT);
+    }
+
+
+#pragma mark - REGISTRATION:
+
+
+    static fts5_api* getFTS5API(sqlite3 *db) {
+        fts5_api *api = nullptr;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, "SELECT fts5(?1)", -1, &stmt, nullptr) != SQLITE_OK)
+            return nullptr;
+        sqlite3_bind_pointer(stmt, 1, &api, "fts5_api_ptr", nullptr);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return api;
+    }
+
+
+    int RegisterFTS5Extensions(sqlite3 *db) {
+        fts5_api *api = getFTS5API(db);
+        if (!api)
+            return SQLITE_ERROR;
+        auto module = findFTS3Tokenizer(db, "unicodesn");
+        if (!module)
+            return SQLITE_ERROR;
+        fts5_tokenizer tokenizer = {adapterCreate, adapterDelete, adapterTokenize};
+        int rc = api->xCreateTokenizer(api, "unicodesn", (void*)module, &tokenizer, nullptr);
+        if (rc == SQLITE_OK)
+            rc = api->xCreateFunction(api, "offsets", nullptr, offsetsFunc, nullptr);
+        if (rc == SQLITE_OK)
+            rc = api->xCreateFunction(api, "matchinfo", nullptr, matchinfoFunc, nullptr);
+        return rc;
+    }
+
+}
@@ -65,6 +65,28 @@ namespace litecore {
         }
     }
 
+    // fl_boxed_value(body, propertyPath) -> fleeceData
+    // Returns a boolean, JSON null, unsigned integer or data as an encoded Fleece value, or SQL
+    // null for any other type.
+    // Covering index tables use this to store the values whose type wouldn't survive being
+    // stored in a SQL column, since the custom subtype tags don't.
+    static void fl_boxed_value(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
+        try {
+            QueryFleeceScope scope(ctx, argv);
+            if (scope.root) {
+                auto type = scope.root->type();
+                if (type == kBoolean || type == kNull || type == kData
+                        || (type == kNumber && scope.root->isUnsigned())) {
+                    setResultBlobFromEncodedValue(ctx, scope.root);
+                    return;
+                }
+            }
+            sqlite3_result_null(ctx);
+        } catch (const std::exception &) {
+            sqlite3_result_error(ctx, "fl_boxed_value: exception!", -1);
+        }
+    }
+
     // fl_version(version) -> propertyValue (string)
     static void fl_version(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
         try {
@@ -474,18 +496,19 @@ namespace litecore {
 #pragma mark - REVISION HISTORY:
 
 
-    // fl_callback(docID, body, sequence, callback) -> string
+    // fl_callback(docID, body, extra, sequence, callback) -> string
     static void fl_callback(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
         slice docID = valueAsSlice(argv[0]);
         slice body = valueAsSlice(argv[1]);
-        sequence_t sequence = sqlite3_value_int(argv[2]);
-        auto callback = (KeyStore::WithDocBodyCallback*)sqlite3_value_pointer(argv[3], kWithDocBodiesCallbackPointerType);
+        slice extra = valueAsSlice(argv[2]);
+        sequence_t sequence = sqlite3_value_int(argv[3]);
+        auto callback = (KeyStore::WithDocBodyCallback*)sqlite3_value_pointer(argv[4], kWithDocBodiesCallbackPointerType);
         if (!callback || !docID) {
             sqlite3_result_error(ctx, "Missing or invalid callback", -1);
             return;
         }
         try {
-            alloc_slice result = (*callback)(docID, body, sequence);
+            alloc_slice result = (*callback)(docID, body, extra, sequence);
             setResultTextFromSlice(ctx, result);
         } catch (const std::exception &) {
             sqlite3_result_error(ctx, "fl_callback: exception!", -1);
@@ -499,6 +522,7 @@ namespace litecore {
     const SQLiteFunctionSpec kFleeceFunctionsSpec[] = {
         { "fl_root",           1, fl_root },
         { "fl_value",          2, fl_value },
+        { "fl_boxed_value",    2, fl_boxed_value },
         { "fl_version",        1, fl_version },
         { "fl_nested_value",   2, fl_nested_value },
         { "fl_fts_value",      2, fl_fts_value },
@@ -511,7 +535,7 @@ namespace litecore {
         { "fl_bool",           1, fl_bool },
         { "array_of",         -1, array_of },
         { "dict_of",          -1, dict_of },
-        { "fl_callback",       4, fl_callback },
+        { "fl_callback",       5, fl_callback },
         { }
     };
 
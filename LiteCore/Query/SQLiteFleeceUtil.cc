@@ -36,23 +36,38 @@ namespace litecore {
     const char* const kFleeceValuePointerType = "FleeceValue";
 
 
-    static slice argAsDocBody(sqlite3_context* ctx, sqlite3_value *arg, bool &copied) {
-        copied = false;
+    // Extracts the Fleece data from a raw document body. If it has to be copied, the copy is
+    // stored in `copiedData`, which must stay alive as long as the result is in use.
+    static slice docBodyFleece(sqlite3_context* ctx, slice body, alloc_slice &copiedData) {
+        slice fleece = fleeceAccessor(ctx, body);
+        if (size_t(fleece.buf) & 1) {
+            // Fleece data at odd addresses used to be allowed, and CBL 2.0/2.1 didn't 16-bit-align
+            // revision data, so it could occur. Now that it's not allowed, we have to work around
+            // this by copying the data to an even address. (#589)
+            copiedData = alloc_slice(fleece);
+            fleece = copiedData;
+        }
+        return fleece;
+    }
+
+
+    static slice argAsDocBody(sqlite3_context* ctx, sqlite3_value *arg, alloc_slice &copiedData) {
         auto type = sqlite3_value_type(arg);
         if (type == SQLITE_NULL)
             return nullslice;             // No 'body' column; may be deleted doc
         Assert(type == SQLITE_BLOB);
         Assert(sqlite3_value_subtype(arg) == 0);
-        slice fleece = fleeceAccessor(ctx, valueAsSlice(arg));
+        return docBodyFleece(ctx, valueAsSlice(arg), copiedData);
+    }
 
-        if (size_t(fleece.buf) & 1) {
-            // Fleece data at odd addresses used to be allowed, and CBL 2.0/2.1 didn't 16-bit-align
-            // revision data, so it could occur. Now that it's not allowed, we have to work around
-            // this by copying the data to an even address. (#589)
-            fleece = fleece.copy();
-            copied = true;
+
+    static const Value* docBodyRoot(slice fleeceData) {
+        const Value *root = Value::fromTrustedData(fleeceData);
+        if (!root) {
+            Warn("Invalid Fleece data in SQLite table");
+            error::_throw(error::CorruptRevisionData);
         }
-        return fleece;
+        return root;
     }
 
 
@@ -125,29 +140,56 @@ namespace litecore {
     }
 
 
-    QueryFleeceScope::QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv)
-    :Scope(argAsDocBody(ctx, argv[0], _copied),
-           ((fleeceFuncContext*)sqlite3_user_data(ctx))->sharedKeys)
-    {
-        if (data()) {
-            root = Value::fromTrustedData(data());
-            if (!root) {
-                Warn("Invalid Fleece data in SQLite table");
-                error::_throw(error::CorruptRevisionData);
-            }
+    const Value* QueryFleeceCache::rootOf(sqlite3_context *ctx, sqlite3_value *arg) {
+        if (!enabled || sqlite3_value_type(arg) != SQLITE_BLOB)
+            return nullptr;
+        slice body = valueAsSlice(arg);
+        if (!body.buf || body.size > kMaxBodySize)
+            return nullptr;
+        if (_root && body == _body) {
+            ++hits;
+            return _root;
+        }
+
+        // Cache miss: decode a private copy of the body, so that the cached Scope stays valid
+        // after SQLite moves on to another row. The copy goes in a buffer that's reused for
+        // every miss, so it costs a memcpy but no allocation:
+        ++misses;
+        _root = nullptr;
+        _scope.reset();
+        _alignedData = nullslice;
+        if (!_buffer)
+            _buffer.reset(new uint8_t[kMaxBodySize]);
+        memcpy(_buffer.get(), body.buf, body.size);
+        _body = slice(_buffer.get(), body.size);
+        slice fleeceData = docBodyFleece(ctx, _body, _alignedData);
+        if (fleeceData) {
+            _scope.emplace(fleeceData, ((fleeceFuncContext*)sqlite3_user_data(ctx))->sharedKeys);
+            _root = docBodyRoot(fleeceData);
         } else {
-            root = Dict::kEmpty;             // No current revision body; may be deleted rev
+            _root = Dict::kEmpty;               // No current revision body; may be deleted rev
         }
-        if (sqlite3_value_type(argv[1]) != SQLITE_NULL)
-        root = evaluatePathFromArg(ctx, argv, 1, root);
+        return _root;
     }
 
 
-    QueryFleeceScope::~QueryFleeceScope() {
-        if (_copied) {
-            unregister();
-            data().free();
+    QueryFleeceScope::QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv)
+    :root(nullptr)
+    {
+        auto funcCtx = (fleeceFuncContext*)sqlite3_user_data(ctx);
+        if (funcCtx->bodyCache)
+            root = funcCtx->bodyCache->rootOf(ctx, argv[0]);
+        if (!root) {
+            slice fleeceData = argAsDocBody(ctx, argv[0], _copiedData);
+            if (fleeceData) {
+                _scope.emplace(fleeceData, funcCtx->sharedKeys);
+                root = docBodyRoot(fleeceData);
+            } else {
+                root = Dict::kEmpty;             // No current revision body; may be deleted rev
+            }
         }
+        if (sqlite3_value_type(argv[1]) != SQLITE_NULL)
+        root = evaluatePathFromArg(ctx, argv, 1, root);
     }
 
 
@@ -293,7 +335,9 @@ namespace litecore {
 
         // The functions registered below operate on virtual tables, not on the actual db,
         // so they should not use the db's Fleece accessor. That's why we clear it first.
+        // (The body cache holds accessor output, so it has to go too.)
         context.delegate = nullptr;
+        context.bodyCache = nullptr;
         registerFunctionSpecs(db, context, kFleeceNullAccessorFunctionsSpec);
     }
 
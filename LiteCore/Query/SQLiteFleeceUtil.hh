@@ -21,6 +21,8 @@
 #include "DataFile.hh"
 #include "SQLite_Internal.hh"
 #include "FleeceImpl.hh"
+#include <memory>
+#include <optional>
 #include <sqlite3.h>
 
 
@@ -41,15 +43,42 @@ namespace litecore {
         return (const fleece::impl::Value*) sqlite3_value_pointer(value, kFleeceValuePointerType);
     }
 
+    // Remembers the decoded Fleece root of the last document body passed to a query function,
+    // so that the fl_value/fl_exists/... calls made on the same row don't each have to run the
+    // DataFile::Delegate's fleeceAccessor and register a new Fleece Scope.
+    // SQLite may reuse a buffer address for a different row, so a hit requires the body's bytes
+    // to match a private copy, not just its address. One instance is shared by all the functions
+    // registered on a connection.
+    class QueryFleeceCache {
+    public:
+        // Bodies bigger than this aren't cached; comparing them costs about as much as decoding.
+        static constexpr size_t kMaxBodySize = 16 * 1024;
+
+        // Returns the root Value of the doc body in `arg`, or nullptr if it's not cacheable.
+        const fleece::impl::Value* rootOf(sqlite3_context*, sqlite3_value *arg);
+
+        bool enabled {true};
+        uint64_t hits {0}, misses {0};
+
+    private:
+        std::unique_ptr<uint8_t[]> _buffer;         // kMaxBodySize buffer, reused for each body
+        fleece::slice _body;                        // Copy of the raw body, in _buffer
+        fleece::alloc_slice _alignedData;           // Aligned copy of its Fleece data, if needed
+        std::optional<fleece::impl::Scope> _scope;  // Scope registering the Fleece data
+        const fleece::impl::Value* _root {nullptr}; // Root of the Fleece data
+    };
+
+
     // Takes a document body from argv[0] and key-path from argv[1].
-    // Establishes a scope for the Fleece data, and evaluates the path, setting `root`
-    class QueryFleeceScope : public fleece::impl::Scope {
+    // Establishes a scope for the Fleece data (or gets one from the context's QueryFleeceCache),
+    // and evaluates the path, setting `root`
+    class QueryFleeceScope {
     public:
         QueryFleeceScope(sqlite3_context *ctx, sqlite3_value **argv);
-        ~QueryFleeceScope();
         const fleece::impl::Value *root;
     private:
-        bool _copied;
+        fleece::alloc_slice _copiedData;            // Aligned copy of the data, if needed
+        std::optional<fleece::impl::Scope> _scope;  // Only used if the body wasn't cached
     };
 
 
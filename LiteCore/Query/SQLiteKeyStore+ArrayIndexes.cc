@@ -47,54 +47,90 @@ namespace litecore {
                             " body BLOB NOT NULL, "
                             " CONSTRAINT pk PRIMARY KEY (docid, i)) "
                             "WITHOUT ROWID");
+        QueryParser qp(*this);
+        qp.setBodyColumnName("new.body");
+        string eachExpr = qp.eachExpressionSQL(expression);
+
         if (!db().schemaExistsWithSQL(unnestTableName, "table", unnestTableName, sql)) {
             LogTo(QueryLog, "Creating UNNEST table '%s' on %s", unnestTableName.c_str(),
                   expression->toJSON(true).asString().c_str());
             db().exec(sql);
 
-            QueryParser qp(*this);
-            qp.setBodyColumnName("new.body");
-            string eachExpr = qp.eachExpressionSQL(expression);
-
             // Populate the index-table with data from existing documents:
             db().exec(CONCAT("INSERT INTO \"" << unnestTableName << "\" (docid, i, body) "
                              "SELECT new.rowid, _each.rowid, _each.value " <<
                              "FROM " << kvTableName << " as new, " << eachExpr << " AS _each "
                              "WHERE (new.flags & 1) = 0"));
-
-            // Set up triggers to keep the index-table up to date
-            // ...on insertion:
-            string insertTriggerExpr = CONCAT("INSERT INTO \"" << unnestTableName <<
-                                              "\" (docid, i, body) "
-                                              "SELECT new.rowid, _each.rowid, _each.value " <<
-                                              "FROM " << eachExpr << " AS _each ");
-            createTrigger(unnestTableName, "ins",
-                          "AFTER INSERT",
-                          "WHEN (new.flags & 1) = 0",
-                          insertTriggerExpr);
-
-            // ...on delete:
-            string deleteTriggerExpr = CONCAT("DELETE FROM \"" << unnestTableName << "\" "
-                                              "WHERE docid = old.rowid");
-            createTrigger(unnestTableName, "del",
-                          "BEFORE DELETE",
-                          "WHEN (old.flags & 1) = 0",
-                          deleteTriggerExpr);
-
-            // ...on update:
-            createTrigger(unnestTableName, "preupdate",
-                          "BEFORE UPDATE OF body, flags",
-                          "WHEN (old.flags & 1) = 0",
-                          deleteTriggerExpr);
-            createTrigger(unnestTableName, "postupdate",
-                          "AFTER UPDATE OF body, flags",
-                          "WHEN (new.flags & 1 = 0)",
-                          insertTriggerExpr);
+            createUnnestedTableTriggers(unnestTableName, eachExpr);
+        } else {
+            string triggerSQL;
+            if (!db().getSchema(unnestTableName + "::upd", "trigger", kvTableName, triggerSQL)) {
+                // Table was created by an earlier version, whose update triggers re-indexed the
+                // entire array on every change; replace them:
+                LogTo(QueryLog, "Upgrading triggers of UNNEST table '%s'", unnestTableName.c_str());
+                for (const char *suffix : {"ins", "del", "preupdate", "postupdate"})
+                    db().exec(CONCAT("DROP TRIGGER IF EXISTS \"" << unnestTableName << "::"
+                                     << suffix << "\""));
+                createUnnestedTableTriggers(unnestTableName, eachExpr);
+            }
         }
         return unnestTableName;
     }
 
 
+    // Sets up triggers to keep an unnested table up to date.
+    void SQLiteKeyStore::createUnnestedTableTriggers(const string &unnestTableName,
+                                                     const string &eachExpr)
+    {
+        // ...on insertion:
+        string insertTriggerExpr = CONCAT("INSERT INTO \"" << unnestTableName <<
+                                          "\" (docid, i, body) "
+                                          "SELECT new.rowid, _each.rowid, _each.value " <<
+                                          "FROM " << eachExpr << " AS _each ");
+        createTrigger(unnestTableName, "ins",
+                      "AFTER INSERT",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // ...on delete:
+        string deleteTriggerExpr = CONCAT("DELETE FROM \"" << unnestTableName << "\" "
+                                          "WHERE docid = old.rowid");
+        createTrigger(unnestTableName, "del",
+                      "BEFORE DELETE",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+
+        // ...on update that deletes or undeletes the document:
+        createTrigger(unnestTableName, "preupdate",
+                      "BEFORE UPDATE OF flags",
+                      "WHEN (old.flags & 1) = 0 AND (new.flags & 1) != 0",
+                      deleteTriggerExpr);
+        createTrigger(unnestTableName, "postupdate",
+                      "AFTER UPDATE OF flags",
+                      "WHEN (old.flags & 1) != 0 AND (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // ...on update of a live document's body. Arrays are usually changed by appending or
+        // editing a few items, so rather than re-indexing the whole array, compare it item-by-item
+        // with the existing rows and only write the ones that changed, then remove the rows of
+        // items past the new end of the array:
+        string diffTriggerExpr = CONCAT("INSERT OR REPLACE INTO \"" << unnestTableName <<
+                                        "\" (docid, i, body) "
+                                        "SELECT new.rowid, _each.rowid, _each.value "
+                                        "FROM " << eachExpr << " AS _each "
+                                        "WHERE NOT EXISTS (SELECT 1 FROM \"" << unnestTableName << "\" "
+                                            "WHERE docid = new.rowid AND i = _each.rowid "
+                                            "AND body IS _each.value); "
+                                        "DELETE FROM \"" << unnestTableName << "\" "
+                                        "WHERE docid = new.rowid "
+                                        "AND i >= (SELECT count(*) FROM " << eachExpr << ")");
+        createTrigger(unnestTableName, "upd",
+                      "AFTER UPDATE OF body",
+                      "WHEN (old.flags & 1) = 0 AND (new.flags & 1) = 0",
+                      diffTriggerExpr);
+    }
+
+
     string SQLiteKeyStore::unnestedTableName(const std::string &property) const {
         return tableName() + ":unnest:" + property;
     }
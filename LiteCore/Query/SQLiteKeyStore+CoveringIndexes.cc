@@ -0,0 +1,172 @@
+//
+// SQLiteKeyStore+CoveringIndexes.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SQLiteKeyStore.hh"
+#include "SQLiteDataFile.hh"
+#include "QueryParser.hh"
+#include "QueryParser+Private.hh"
+#include "Error.hh"
+#include "StringUtil.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+#include <algorithm>
+
+using namespace std;
+using namespace fleece;
+using namespace fleece::impl;
+
+namespace litecore {
+
+    /*
+     A covering index is a value index with an INCLUDE clause. Besides the regular SQL index named
+     `NAME` on the document table, it has:
+       * A SQL table named `kv_default:covering:NAME`, with a row per document holding its key,
+         sequence and flags, plus two columns per property in the WHAT and INCLUDE clauses:
+            - "vN" holds the value as returned by fl_value(), for use in expressions;
+            - "rN" holds, as Fleece data, the values whose type "vN" can't preserve: booleans,
+              nulls, unsigned integers and data (whose Fleece subtype tags SQLite doesn't store.)
+       * Triggers that keep that table up to date.
+       * A SQL index on that table containing all its columns, keyed by the WHAT properties.
+     The QueryParser can then run a query that uses only those properties (and the document
+     metadata) on the table instead of the documents, and SQLite can answer it with an
+     index-only scan without decoding any document bodies.
+     */
+
+
+    // Returns the paths of the properties covered by an index, in column order.
+    static vector<string> coveredProperties(const IndexSpec &spec, bool validate) {
+        vector<string> properties;
+        auto add = [&](const Array *expressions, bool mustBeProperties) {
+            for (Array::iterator i(expressions); i; ++i) {
+                string property = string(qp::propertyFromNode(i.value()));
+                if (property.empty()) {
+                    if (validate && mustBeProperties)
+                        error::_throw(error::InvalidQuery, "Index INCLUDE items must be properties");
+                    continue;       // WHAT expressions that aren't properties aren't covered
+                }
+                if (find(properties.begin(), properties.end(), property) == properties.end())
+                    properties.push_back(property);
+            }
+        };
+        add(spec.what(), false);
+        add(spec.include(), true);
+        return properties;
+    }
+
+
+    bool SQLiteKeyStore::createCoveringIndex(const IndexSpec &spec) {
+        if (spec.where())
+            error::_throw(error::InvalidQuery, "A covering index can't have a WHERE clause");
+        auto properties = coveredProperties(spec, true);
+        string coveringTable = coveringTableName(spec.name);
+
+        // The regular index on the document table, for queries the covering table can't handle:
+        QueryParser qp(*this);
+        Array::iterator expressions(spec.what());
+        qp.writeCreateIndex(spec.name, expressions, nullptr, false);
+        string indexSQL = qp.SQL();
+
+        if (auto existingSpec = db().getIndex(spec.name)) {
+            if (existingSpec->type == spec.type && existingSpec->keyStoreName == name()
+                    && existingSpec->indexTableName == coveringTable
+                    && existingSpec->expressionJSON == spec.expressionJSON
+                    && db().tableExists(coveringTable)
+                    && db().schemaExistsWithSQL(spec.name, "index", tableName(), indexSQL))
+                return false;       // This is a duplicate of an existing index; do nothing
+            db().deleteIndex(*existingSpec);
+        }
+
+        LogTo(QueryLog, "Creating covering table '%s' on %zu properties",
+              coveringTable.c_str(), properties.size());
+        stringstream tableColumns, columns, values, indexColumns;
+        tableColumns << "docid INTEGER PRIMARY KEY, key TEXT UNIQUE, sequence INTEGER, flags INTEGER";
+        columns << "docid, key, sequence, flags";
+        values << "new.rowid, new.key, new.sequence, new.flags";
+        for (unsigned n = 0; n < properties.size(); ++n) {
+            tableColumns << ", v" << n << ", r" << n;
+            columns << ", v" << n << ", r" << n;
+            values << ", " << kValueFnName << "(new.body, ";
+            QueryParser::writeSQLString(values, slice(properties[n]));
+            values << "), " << kBoxedValueFnName << "(new.body, ";
+            QueryParser::writeSQLString(values, slice(properties[n]));
+            values << ")";
+            indexColumns << 'v' << n << ", ";
+        }
+        for (unsigned n = 0; n < properties.size(); ++n)
+            indexColumns << 'r' << n << ", ";
+        indexColumns << "flags, key, sequence";
+
+        db().exec(CONCAT("CREATE TABLE \"" << coveringTable << "\" (" << tableColumns.str() << ")"));
+
+        // Populate the table with data from existing documents:
+        db().exec(CONCAT("INSERT INTO \"" << coveringTable << "\" (" << columns.str() << ") "
+                         "SELECT " << values.str() << " FROM " << tableName() << " AS new"));
+
+        // Set up triggers to keep the table up to date. (The REPLACE also removes the row of a
+        // document whose record was replaced by an INSERT OR REPLACE, which doesn't fire the
+        // delete trigger, since `key` is unique.)
+        // ...on insertion:
+        string insertTriggerExpr = CONCAT("INSERT OR REPLACE INTO \"" << coveringTable << "\" "
+                                          "(" << columns.str() << ") VALUES (" << values.str() << ")");
+        createTrigger(coveringTable, "ins", "AFTER INSERT", "", insertTriggerExpr);
+
+        // ...on delete:
+        createTrigger(coveringTable, "del", "BEFORE DELETE", "",
+                      CONCAT("DELETE FROM \"" << coveringTable << "\" WHERE docid = old.rowid"));
+
+        // ...on update:
+        createTrigger(coveringTable, "upd", "AFTER UPDATE OF key, sequence, flags, body", "",
+                      insertTriggerExpr);
+
+        db().exec(CONCAT("CREATE INDEX \"" << coveringTable << "::index\" ON \"" << coveringTable
+                         << "\" (" << indexColumns.str() << ")"));
+
+        LogTo(QueryLog, "Creating %s index: %s", spec.typeName(), indexSQL.c_str());
+        db().exec(indexSQL);
+        db().registerIndex(spec, name(), coveringTable);
+        return true;
+    }
+
+
+    string SQLiteKeyStore::coveringTableName(const std::string &indexName) const {
+        return tableName() + ":covering:" + indexName;
+    }
+
+
+    // Part of the QueryParser delegate API.
+    // The list is cached, since every query compile asks for it; it only changes with the schema.
+    vector<QueryParser::CoveringTable> SQLiteKeyStore::coveringTables() const {
+        int64_t schema = db().schemaCookie();
+        if (schema == _coveringTablesSchema)
+            return _coveringTables;
+        vector<QueryParser::CoveringTable> tables;
+        for (auto &spec : db().getIndexes(this)) {
+            if (spec.type != IndexSpec::kValue || spec.indexTableName.empty()
+                    || !spec.expressionJSON || !db().tableExists(spec.indexTableName))
+                continue;
+            QueryParser::CoveringTable table {spec.indexTableName, {}};
+            auto properties = coveredProperties(spec, false);
+            for (unsigned n = 0; n < properties.size(); ++n)
+                table.columns[properties[n]] = n;
+            tables.push_back(move(table));
+        }
+        _coveringTables = tables;
+        _coveringTablesSchema = schema;
+        return tables;
+    }
+
+}
@@ -34,7 +34,10 @@ using namespace fleece::impl;
 
 namespace litecore {
 
-    static void writeTokenizerOptions(stringstream &sql, const IndexSpec::Options*);
+    // FTS5 'automerge' setting: how many same-level segments accumulate before being merged
+    static constexpr int kFTS5AutomergeLevel = 2;
+
+    static vector<string> tokenizerArgs(const IndexSpec::Options*);
 
 
     // Creates a FTS index.
@@ -58,24 +61,51 @@ namespace litecore {
         string whereOldSQL = qp.whereClauseSQL(where, "old");
 
         // Build the SQL that creates an FTS table, including the tokenizer options:
+        auto options = spec.optionsPtr();
+        bool fts5 = options && options->useFTS5;
         {
+            // See https://www.sqlite.org/fts3.html#tokenizer and
+            // https://www.sqlite.org/fts5.html#tokenizers . 'unicodesn' is our custom tokenizer
+            // (SQLiteFTS5Extensions.cc adapts it to FTS5.)
+            stringstream tokenizer;
+            tokenizer << "unicodesn";
+            for (auto &arg : tokenizerArgs(options))
+                tokenizer << " \"" << arg << "\"";
+
             stringstream sql;
-            sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING fts4(" << columns << ", ";
-            writeTokenizerOptions(sql, spec.optionsPtr());
+            sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING ";
+            if (fts5) {
+                sql << "fts5(" << columns << ", tokenize=";
+                QueryParser::writeSQLString(sql, slice(tokenizer.str()), '\'');
+                if (options->prefixLengths && *options->prefixLengths) {
+                    sql << ", prefix=";
+                    QueryParser::writeSQLString(sql, slice(options->prefixLengths), '\'');
+                }
+            } else {
+                sql << "fts4(" << columns << ", tokenize=" << tokenizer.str();
+            }
             sql << ")";
             if (!db().createIndex(spec, this, ftsTableName, sql.str()))
                 return false;
         }
 
-        // Index the existing records:
-        db().exec(CONCAT("INSERT INTO \"" << ftsTableName << "\" (docid, " << columns << ") "
+        if (fts5) {
+            // Merge segments more eagerly than the default (4), so queries stay fast as the
+            // index is updated; SQLiteDataFile::optimize() also runs incremental merges.
+            db().exec(CONCAT("INSERT INTO \"" << ftsTableName << "\" (\"" << ftsTableName
+                             << "\", rank) VALUES ('automerge', " << kFTS5AutomergeLevel << ")"));
+        }
+
+        // Index the existing records. (The rowid of the FTS table is the record's rowid.
+        // FTS4 also calls it 'docid', but FTS5 doesn't.)
+        db().exec(CONCAT("INSERT INTO \"" << ftsTableName << "\" (rowid, " << columns << ") "
                          "SELECT rowid, " << exprs << " FROM kv_" << name() << " AS new "
                          << whereNewSQL));
 
         // Set up triggers to keep the FTS table up to date
         // ...on insertion:
         string insertNewSQL = CONCAT("INSERT INTO \"" << ftsTableName
-                                     << "\" (docid, " << columns << ") "
+                                     << "\" (rowid, " << columns << ") "
                                      "VALUES (new.rowid, " << exprs << ")");
         createTrigger(ftsTableName, "ins",
                       "AFTER INSERT",
@@ -83,7 +113,7 @@ namespace litecore {
                       insertNewSQL);
 
         // ...on delete:
-        string deleteOldSQL = CONCAT("DELETE FROM \"" << ftsTableName << "\" WHERE docid = old.rowid");
+        string deleteOldSQL = CONCAT("DELETE FROM \"" << ftsTableName << "\" WHERE rowid = old.rowid");
         createTrigger(ftsTableName, "del",
                       "AFTER DELETE",
                       whereOldSQL,
@@ -107,10 +137,9 @@ namespace litecore {
     }
 
 
-    // subroutine that generates the option string passed to the FTS tokenizer
-    static void writeTokenizerOptions(stringstream &sql, const IndexSpec::Options *options) {
-        // See https://www.sqlite.org/fts3.html#tokenizer . 'unicodesn' is our custom tokenizer.
-        sql << "tokenize=unicodesn";
+    // subroutine that generates the arguments passed to the FTS tokenizer
+    static vector<string> tokenizerArgs(const IndexSpec::Options *options) {
+        vector<string> args;
         if (options) {
             // Get the language code (options->language might have a country too, like "en_US")
             string languageCode;
@@ -124,22 +153,23 @@ namespace litecore {
                 string arg(options->stopWords);
                 replace(arg, '"', ' ');
                 replace(arg, ',', ' ');
-                sql << " \"stopwordlist=" << arg << "\"";
+                args.push_back("stopwordlist=" + arg);
             } else if (options->language) {
-                sql << " \"stopwords=" << languageCode << "\"";
+                args.push_back("stopwords=" + languageCode);
             }
             if (options->language && !options->disableStemming) {
                 if (unicodesn_isSupportedStemmer(languageCode.c_str())) {
-                    sql << " \"stemmer=" << languageCode << "\"";
+                    args.push_back("stemmer=" + languageCode);
                 } else {
                     Warn("FTS does not support stemming for language code '%s'; ignoring it",
                          options->language);
                 }
             }
             if (!options->ignoreDiacritics) {
-                sql << " \"remove_diacritics=0\"";
+                args.push_back("remove_diacritics=0");
             }
         }
+        return args;
     }
 
 }
@@ -36,6 +36,8 @@ namespace litecore {
     /*
      - A value index is a SQL index named 'NAME'.
      - A FTS index is a SQL virtual table named 'kv_default::NAME'
+     - A covering index (a value index with an INCLUDE clause) also has a SQL table named
+       `kv_default:covering:NAME`; see SQLiteKeyStore+CoveringIndexes.cc
      - An array index has two parts:
          * A SQL table named `kv_default:unnest:PATH`, where PATH is the property path
          * An index on that table named `NAME`
@@ -57,7 +59,11 @@ namespace litecore {
         spec.validateName();
 
         Stopwatch st;
-        Transaction t(db());
+        // If the caller already has a transaction open, the index is created in it and it's up
+        // to the caller to commit; otherwise this makes (and commits) its own:
+        optional<Transaction> t;
+        if (!db().inTransaction())
+            t.emplace(db());
         bool created;
         switch (spec.type) {
             case IndexSpec::kValue:      created = createValueIndex(spec); break;
@@ -70,8 +76,10 @@ namespace litecore {
         }
 
         if (created) {
-            t.commit();
-            db().optimize();
+            if (t) {
+                t->commit();
+                db().optimize();
+            }
             double time = st.elapsed();
             QueryLog.log((time < 3.0 ? LogLevel::Info : LogLevel::Warning),
                          "Created index '%s' in %.3f sec", spec.name.c_str(), time);
@@ -109,6 +117,48 @@ namespace litecore {
     }
 
 
+    // Drops the SQL indexes of value indexes, remembering their SQL so they can be recreated.
+    // (The index registry in the `indexes` table is left alone.)
+    void SQLiteKeyStore::suspendIndexes() {
+        Assert(db().inTransaction());
+        if (_indexesSuspended)
+            return;
+        for (auto &spec : db().getIndexes(this)) {
+            string sql;
+            if (spec.type == IndexSpec::kValue && db().getSchema(spec.name, "index", tableName(), sql)) {
+                LogTo(QueryLog, "Suspending index '%s' during bulk load", spec.name.c_str());
+                db().exec(CONCAT("DROP INDEX \"" << spec.name << "\""));
+                _suspendedIndexes.emplace_back(spec.name, sql);
+            }
+        }
+        _indexesSuspended = true;
+    }
+
+
+    void SQLiteKeyStore::resumeIndexes(bool rebuild) {
+        if (!_indexesSuspended)
+            return;
+        auto suspended = move(_suspendedIndexes);
+        _suspendedIndexes.clear();
+        _indexesSuspended = false;
+        if (!rebuild)
+            return;
+        Stopwatch st;
+        for (auto &[name, sql] : suspended) {
+            // Skip indexes that were deleted or replaced while suspended:
+            auto spec = db().getIndex(slice(name));
+            string currentSQL;
+            if (!spec || spec->type != IndexSpec::kValue
+                      || db().getSchema(name, "index", tableName(), currentSQL))
+                continue;
+            db().exec(sql);
+        }
+        if (!suspended.empty())
+            LogTo(QueryLog, "Rebuilt %zu suspended indexes in %.3f sec",
+                  suspended.size(), st.elapsed());
+    }
+
+
     // Creates the special by-sequence index
     void SQLiteKeyStore::createSequenceIndex() {
         if (!_createdSeqIndex) {
@@ -154,6 +204,8 @@ namespace litecore {
 
 
     bool SQLiteKeyStore::createValueIndex(const IndexSpec &spec) {
+        if (spec.include())
+            return createCoveringIndex(spec);
         Array::iterator expressions(spec.what());
         return createIndex(spec, tableName(), expressions);
     }
@@ -22,6 +22,7 @@
 #include "Logging.hh"
 #include "Query.hh"
 #include "QueryParser.hh"
+#include "QueryParser+Private.hh"
 #include "n1ql_parser.hh"
 #include "Error.hh"
 #include "StringUtil.hh"
@@ -29,10 +30,15 @@
 #include "MutableDict.hh"
 #include "Path.hh"
 #include "Stopwatch.hh"
+#include "Timer.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include <sqlite3.h>
+#include <deque>
 #include <sstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 extern "C" {
 #include "sqlite3_unicodesn_tokenizer.h"        // for unicodesn_tokenizerRunningQuery()
@@ -103,11 +109,17 @@ namespace litecore {
             
             _1stCustomResultColumn = qp.firstCustomResultColumn();
             _columnTitles = qp.columnTitles();
+
+            if (qp.isTopKQuery()) {
+                _topK = topKStrategy(_topKIndex);
+                logInfo("%s", describeTopK().c_str());
+            }
         }
 
 
         virtual void close() override {
             logInfo("Closing query (db is closing)");
+            lock_guard<recursive_mutex> lock(_mutex);
             _statement.reset();
             _matchedTextStatement.reset();
             Query::close();
@@ -130,9 +142,10 @@ namespace litecore {
                 error::_throw(error::NoSuchIndex);
             string expr = _ftsTables[0];    // TODO: Support for multiple matches in a query
 
+            lock_guard<recursive_mutex> lock(_mutex);
             if (!_matchedTextStatement) {
                 auto &df = (SQLiteDataFile&) keyStore().dataFile();
-                string sql = "SELECT * FROM \"" + expr + "\" WHERE docid=?";
+                string sql = "SELECT * FROM \"" + expr + "\" WHERE rowid=?";
                 _matchedTextStatement.reset(new SQLite::Statement(df, sql, true));
             }
 
@@ -158,6 +171,7 @@ namespace litecore {
 
 
         string explain() override {
+            lock_guard<recursive_mutex> lock(_mutex);
             stringstream result;
             // https://www.sqlite.org/eqp.html
             string query = statement()->getQuery();
@@ -172,13 +186,103 @@ namespace litecore {
                 result << " " << x.getColumn(3).getText() << "\n";
             }
 
+            if (_topK != TopKStrategy::kNone) {
+                // The plan may have changed since compiling, if indexes were created or deleted:
+                _topK = topKStrategy(_topKIndex);
+                result << '\n' << describeTopK() << '\n';
+            }
+
             result << '\n' << _json << '\n';
             return result.str();
         }
 
+        alloc_slice docIDFilterExpression(const vector<alloc_slice> *docIDs) const override {
+            if (!_ftsTables.empty())
+                return nullslice;       // MATCH results depend on the FTS index
+
+            // Find the operands of the SELECT, the same way QueryParser::parse does:
+            Retained<Doc> doc = Doc::fromJSON(_json);
+            const Value *where = doc->root(), *from = nullptr;
+            const Dict *operands = where->asDict();
+            if (!operands) {
+                const Array *a = where->asArray();
+                if (a && a->count() > 1 && a->get(0)->asString() == "SELECT"_sl)
+                    operands = a->get(1)->asDict();
+            }
+            if (operands) {
+                where = qp::getCaseInsensitive(operands, "WHERE"_sl);
+                from = qp::getCaseInsensitive(operands, "FROM"_sl);
+                // WHERE may refer to a result alias declared in WHAT, so don't drop those:
+                if (auto what = qp::getCaseInsensitive(operands, "WHAT"_sl); what && what->asArray()) {
+                    for (Array::iterator i(what->asArray()); i; ++i) {
+                        auto op = i.value()->asArray();
+                        if (op && op->count() > 0 && op->get(0)->asString().caseEquivalent("AS"_sl))
+                            return nullslice;
+                    }
+                }
+            }
+            if (!where)
+                return nullslice;       // every doc matches
+
+            string docIDProperty = "." + string(qp::kDocIDProperty);
+            if (from) {
+                auto fromArray = from->asArray();
+                if (!fromArray || fromArray->count() != 1 || !fromArray->get(0)->asDict())
+                    return nullslice;   // JOIN or UNNEST
+                auto alias = qp::getCaseInsensitive(fromArray->get(0)->asDict(), "AS"_sl);
+                if (!alias || !alias->asString())
+                    return nullslice;
+                docIDProperty = "." + string(alias->asString()) + docIDProperty;
+            }
+
+            Encoder enc;
+            enc.beginDictionary();
+            if (from) {
+                enc.writeKey("FROM"_sl);
+                enc.writeValue(from);
+            }
+            enc.writeKey("WHAT"_sl);
+            enc.beginArray();
+            enc.beginArray();
+            enc.writeString(docIDProperty);
+            enc.endArray();
+            enc.endArray();
+            enc.writeKey("WHERE"_sl);
+            if (docIDs) {
+                // ['AND', <where>, ['IN', ['._id'], ['[]', <docIDs...>]]]
+                enc.beginArray();
+                enc.writeString("AND"_sl);
+                enc.writeValue(where);
+                enc.beginArray();
+                enc.writeString("IN"_sl);
+                enc.beginArray();
+                enc.writeString(docIDProperty);
+                enc.endArray();
+                enc.beginArray();
+                enc.writeString("[]"_sl);
+                for (auto &docID : *docIDs)
+                    enc.writeString(slice(docID));
+                enc.endArray();
+                enc.endArray();
+                enc.endArray();
+            } else {
+                enc.writeValue(where);
+            }
+            enc.endDictionary();
+            alloc_slice filter = enc.finish();
+            return Value::fromTrustedData(filter)->toJSON();
+        }
+
         QueryEnumerator* createEnumerator(const Options *options) override;
 
+        QueryEnumerator* createParallelEnumerator(const Options *options,
+                                                  sequence_t curSeq, uint64_t purgeCnt);
+
+        QueryEnumerator* createKeysetEnumerator(const Options *options,
+                                                sequence_t curSeq, uint64_t purgeCnt);
+
         shared_ptr<SQLite::Statement> statement() const {
+            lock_guard<recursive_mutex> lock(_mutex);
             if (!_statement)
                 error::_throw(error::NotOpen);
             return _statement;
@@ -195,16 +299,109 @@ namespace litecore {
         string loggingClassName() const override    {return "Query";}
 
     private:
+        // How SQLite runs a "top-K" query, i.e. one with ORDER BY and LIMIT:
+        enum class TopKStrategy {
+            kNone,              // Not a top-K query
+            kIndexOrder,        // Reads rows in order from an index, stopping after the LIMIT
+            kBoundedSort,       // Reads all matching rows, keeping the first LIMIT in a sorter
+        };
+
+        TopKStrategy topKStrategy(string &indexName) const;
+        string describeTopK() const;
+
+        struct PartitionRows;
+        bool scanPartition(SQLiteDataFile &connection, const Options *options,
+                           int64_t minRowid, int64_t maxRowid,
+                           sequence_t curSeq, uint64_t purgeCnt, PartitionRows &rows);
+        QueryEnumerator* mergePartitions(SQLiteDataFile &connection, const Options *options,
+                                         sequence_t curSeq, uint64_t purgeCnt,
+                                         const vector<PartitionRows> &partitions);
+
+        // A cached query is shared by every caller that compiles the same expression, possibly on
+        // different threads, so its statements and lazily computed state below are guarded:
+        mutable recursive_mutex _mutex;
+
         alloc_slice _json;                                  // Original JSON form of the query
         shared_ptr<SQLite::Statement> _statement;           // Compiled SQLite statement
         unique_ptr<SQLite::Statement> _matchedTextStatement;// Gets the matched text
         vector<string> _columnTitles;                       // Titles of columns
+        optional<QueryParser::PartitionedQuery> _partitioned;// Parallel form, if there is one
+        bool _triedPartitioning {false};                    // Has _partitioned been computed?
+        optional<QueryParser::KeysetQuery> _keyset;         // Paged form, if it's been needed
+        uint32_t _keysetFingerprint {0};                    // Identifies _keyset in tokens
+        TopKStrategy _topK {TopKStrategy::kNone};           // How ORDER BY...LIMIT is run
+        string _topKIndex;                                  // Index used by kIndexOrder, if any
     };
 
 
+    // Finds the strategy of a top-K query from its query plan. SQLite avoids sorting if it can
+    // scan an index whose order matches the ORDER BY; then it stops as soon as it has produced
+    // LIMIT + OFFSET rows, so the time taken doesn't depend on the number of documents. Otherwise
+    // its sorter only keeps the best LIMIT + OFFSET rows seen so far, a bounded heap.
+    SQLiteQuery::TopKStrategy SQLiteQuery::topKStrategy(string &indexName) const {
+        auto &df = (SQLiteDataFile&) keyStore().dataFile();
+        SQLite::Statement plan(df, "EXPLAIN QUERY PLAN " + statement()->getQuery());
+        TopKStrategy strategy = TopKStrategy::kIndexOrder;
+        indexName.clear();
+        while (plan.executeStep()) {
+            string detail = plan.getColumn(3).getString();
+            if (detail.find("TEMP B-TREE") != string::npos && detail.find("ORDER BY") != string::npos) {
+                strategy = TopKStrategy::kBoundedSort;
+            } else if (indexName.empty()) {
+                for (const char *prefix : {"USING INDEX ", "USING COVERING INDEX "}) {
+                    if (auto pos = detail.find(prefix); pos != string::npos) {
+                        indexName = detail.substr(pos + strlen(prefix));
+                        indexName.resize(min(indexName.size(), indexName.find(" (")));
+                        break;
+                    }
+                }
+            }
+        }
+        if (strategy != TopKStrategy::kIndexOrder)
+            indexName.clear();
+        return strategy;
+    }
+
+
+    string SQLiteQuery::describeTopK() const {
+        switch (_topK) {
+            case TopKStrategy::kIndexOrder:
+                if (_topKIndex.empty())
+                    return "Top-K strategy: table order; the scan stops after LIMIT+OFFSET rows";
+                return "Top-K strategy: order of index '" + _topKIndex
+                            + "'; the scan stops after LIMIT+OFFSET rows";
+            case TopKStrategy::kBoundedSort:
+                return "Top-K strategy: bounded sort; no index matches the ORDER BY, so all "
+                       "matching rows are read and the best LIMIT+OFFSET of them kept";
+            default:
+                return "";
+        }
+    }
+
+
 #pragma mark - QUERY ENUMERATOR:
 
 
+    // Parses the FTS columns of a result row into a list of FullTextTerms.
+    static void getFullTextTerms(const Array *row, QueryEnumerator::FullTextTerms &terms) {
+        terms.clear();
+        uint64_t dataSource = row->get(kFTSRowidCol)->asInt();
+        // The offsets() function returns a string of space-separated numbers in groups of 4.
+        string offsets = row->get(kFTSOffsetsCol)->asString().asString();
+        const char *termStr = offsets.c_str();
+        while (*termStr) {
+            uint32_t n[4];
+            for (int i = 0; i < 4; ++i) {
+                char *next;
+                n[i] = (uint32_t)strtol(termStr, &next, 10);
+                termStr = next;
+            }
+            terms.push_back({dataSource, n[0], n[1], n[2], n[3]});
+            // {rowid, key #, term #, byte offset, byte length}
+        }
+    }
+
+
     // Query enumerator that reads from prerecorded Fleece data (generated by fastForward(), below)
     // Each array item is a row, which is itself an array of column values.
     class SQLiteQueryEnumerator : public QueryEnumerator, Logging {
@@ -227,6 +424,16 @@ namespace litecore {
                 query->objectRef(), rowCount, recording->data().size, elapsedTime*1000);
         }
 
+        SQLiteQueryEnumerator(const SQLiteQueryEnumerator &other)
+        :QueryEnumerator(&other._options, other._lastSequence, other._purgeCount)
+        ,Logging(QueryLog)
+        ,_recording(other._recording)
+        ,_iter(_recording->asArray())
+        ,_1stCustomResultColumn(other._1stCustomResultColumn)
+        ,_hasFullText(other._hasFullText)
+        ,_continuationToken(other._continuationToken)
+        { }
+
         ~SQLiteQueryEnumerator() {
             logInfo("Deleted");
         }
@@ -299,6 +506,10 @@ namespace litecore {
             }
         }
 
+        QueryEnumerator* clone() override {
+            return new SQLiteQueryEnumerator(*this);
+        }
+
         QueryEnumerator* refresh(Query *query) override {
             auto newOptions = _options.after(_lastSequence).withPurgeCount(_purgeCount);
             auto sqliteQuery = (SQLiteQuery*)query;
@@ -316,24 +527,18 @@ namespace litecore {
         }
 
         const FullTextTerms& fullTextTerms() override {
-            _fullTextTerms.clear();
-            uint64_t dataSource = _iter->asArray()->get(kFTSRowidCol)->asInt();
-            // The offsets() function returns a string of space-separated numbers in groups of 4.
-            string offsets = _iter->asArray()->get(kFTSOffsetsCol)->asString().asString();
-            const char *termStr = offsets.c_str();
-            while (*termStr) {
-                uint32_t n[4];
-                for (int i = 0; i < 4; ++i) {
-                    char *next;
-                    n[i] = (uint32_t)strtol(termStr, &next, 10);
-                    termStr = next;
-                }
-                _fullTextTerms.push_back({dataSource, n[0], n[1], n[2], n[3]});
-                // {rowid, key #, term #, byte offset, byte length}
-            }
+            getFullTextTerms(_iter->asArray(), _fullTextTerms);
             return _fullTextTerms;
         }
 
+        alloc_slice continuationToken() const override {
+            return _continuationToken;
+        }
+
+        void setContinuationToken(alloc_slice token) {
+            _continuationToken = move(token);
+        }
+
     protected:
         string loggingClassName() const override    {return "QueryEnum";}
 
@@ -343,6 +548,95 @@ namespace litecore {
         unsigned _1stCustomResultColumn;    // Column index of the 1st column declared in JSON
         bool _hasFullText;
         bool _first {true};
+        alloc_slice _continuationToken;     // Resumes after the last row (Options::paged)
+    };
+
+
+
+    // Binds query parameters, given as a JSON or Fleece dict, to a statement's `$_`-prefixed SQL
+    // parameters, and removes their names from `unbound` if it's non-null. If `lenient` is true,
+    // parameters the statement doesn't use are ignored; otherwise they're an error.
+    static void bindParameters(SQLite::Statement &statement, slice json,
+                               set<string> *unbound, bool lenient =false)
+    {
+        alloc_slice fleeceData;
+        if (json[0] == '{' && json[json.size-1] == '}')
+            fleeceData = JSONConverter::convertJSON(json);
+        else
+            fleeceData = json;
+        const Dict *root = Value::fromData(fleeceData)->asDict();
+        if (!root)
+            error::_throw(error::InvalidParameter);
+        for (Dict::iterator it(root); it; ++it) {
+            auto key = (string)it.keyString();
+            if (unbound)
+                unbound->erase(key);
+            auto sqlKey = string("$_") + key;
+            const Value *val = it.value();
+            try {
+                switch (val->type()) {
+                    case kNull:
+                        break;
+                    case kBoolean:
+                    case kNumber:
+                        if (val->isInteger() && !val->isUnsigned())
+                            statement.bind(sqlKey, (long long)val->asInt());
+                        else
+                            statement.bind(sqlKey, val->asDouble());
+                        break;
+                    case kString:
+                        statement.bind(sqlKey, (string)val->asString());
+                        break;
+                    default: {
+                        // Encode other types as a Fleece blob:
+                        Encoder enc;
+                        enc.writeValue(val);
+                        alloc_slice asFleece = enc.finish();
+                        statement.bind(sqlKey, asFleece.buf, (int)asFleece.size);
+                        break;
+                    }
+                }
+            } catch (const SQLite::Exception &x) {
+                if (x.getErrorCode() != SQLITE_RANGE)
+                    throw;
+                else if (!lenient)
+                    error::_throw(error::InvalidQueryParam,
+                                  "Unknown query property '%s'", key.c_str());
+            }
+        }
+    }
+
+
+
+    // A copy of a SQLite column value, for moving rows between connections, or keeping the
+    // sort keys of a row for a continuation token.
+    struct SQLiteCell {
+        explicit SQLiteCell(const SQLite::Column &col)
+        :type(col.getType())
+        {
+            switch (type) {
+                case SQLITE_INTEGER:    integer = col.getInt64(); break;
+                case SQLITE_FLOAT:      real = col.getDouble(); break;
+                case SQLITE_TEXT:
+                case SQLITE_BLOB:       data = alloc_slice(col.getBlob(), col.getBytes()); break;
+                default:                break;
+            }
+        }
+
+        void bind(SQLite::Statement &statement, int index) const {
+            switch (type) {
+                case SQLITE_INTEGER:    statement.bind(index, (long long)integer); break;
+                case SQLITE_FLOAT:      statement.bind(index, real); break;
+                case SQLITE_TEXT:       statement.bind(index, string(data)); break;
+                case SQLITE_BLOB:       statement.bind(index, data.buf, (int)data.size); break;
+                default:                statement.bind(index); break;
+            }
+        }
+
+        int type;
+        int64_t integer {0};
+        double real {0.0};
+        alloc_slice data;
     };
 
 
@@ -351,18 +645,22 @@ namespace litecore {
     // which is then used as the data source of a SQLiteQueryEnum.
     class SQLiteQueryRunner {
     public:
-        SQLiteQueryRunner(SQLiteQuery *query, const Query::Options *options, sequence_t lastSequence, uint64_t purgeCount)
+        SQLiteQueryRunner(SQLiteQuery *query, const Query::Options *options,
+                          sequence_t lastSequence, uint64_t purgeCount,
+                          shared_ptr<SQLite::Statement> statement,
+                          bool lenientBinding =false)
         :_query(query)
         ,_lastSequence(lastSequence)
         ,_purgeCount(purgeCount)
-        ,_statement(query->statement())
+        ,_statement(move(statement))
         ,_sk(query->keyStore().dataFile().documentKeys())
         ,_options(options ? *options : Query::Options())
         {
             _statement->clearBindings();
             _unboundParameters = query->_parameters;
             if (options && options->paramBindings.buf)
-                bindParameters(options->paramBindings);
+                bindParameters(*_statement, options->paramBindings, &_unboundParameters,
+                               lenientBinding);
             if (!_unboundParameters.empty()) {
                 stringstream msg;
                 for (const string &param : _unboundParameters)
@@ -374,58 +672,22 @@ namespace litecore {
             LogStatement(*_statement);
         }
 
+        // Makes the last `count` columns of the statement the sort keys of a KeysetQuery; they
+        // aren't part of the rows, but the last row's become the continuation token.
+        void setKeyColumns(unsigned count, uint32_t fingerprint) {
+            _keyColumns = count;
+            _keysetFingerprint = fingerprint;
+        }
+
         ~SQLiteQueryRunner() {
             try {
                 _statement->reset();
             } catch (...) { }
         }
 
-        void bindParameters(slice json) {
-            alloc_slice fleeceData;
-            if (json[0] == '{' && json[json.size-1] == '}')
-                fleeceData = JSONConverter::convertJSON(json);
-            else
-                fleeceData = json;
-            const Dict *root = Value::fromData(fleeceData)->asDict();
-            if (!root)
-                error::_throw(error::InvalidParameter);
-            for (Dict::iterator it(root); it; ++it) {
-                auto key = (string)it.keyString();
-                _unboundParameters.erase(key);
-                auto sqlKey = string("$_") + key;
-                const Value *val = it.value();
-                try {
-                    switch (val->type()) {
-                        case kNull:
-                            break;
-                        case kBoolean:
-                        case kNumber:
-                            if (val->isInteger() && !val->isUnsigned())
-                                _statement->bind(sqlKey, (long long)val->asInt());
-                            else
-                                _statement->bind(sqlKey, val->asDouble());
-                            break;
-                        case kString:
-                            _statement->bind(sqlKey, (string)val->asString());
-                            break;
-                        default: {
-                            // Encode other types as a Fleece blob:
-                            Encoder enc;
-                            enc.writeValue(val);
-                            alloc_slice asFleece = enc.finish();
-                            _statement->bind(sqlKey, asFleece.buf, (int)asFleece.size);
-                            break;
-                        }
-                    }
-                } catch (const SQLite::Exception &x) {
-                    if (x.getErrorCode() == SQLITE_RANGE)
-                        error::_throw(error::InvalidQueryParam,
-                                      "Unknown query property '%s'", key.c_str());
-                    else
-                        throw;
-                }
-            }
-        }
+        const Query::Options& options() const       {return _options;}
+        sequence_t lastSequence() const             {return _lastSequence;}
+        uint64_t purgeCount() const                 {return _purgeCount;}
 
         bool encodeColumn(Encoder &enc, int i) {
             SQLite::Column col = _statement->getColumn(i);
@@ -458,11 +720,40 @@ namespace litecore {
             return true;
         }
 
+        // Writes the current row as an array of column values, and returns a bit-map of which
+        // of the custom columns are missing/undefined.
+        uint64_t encodeRow(Encoder &enc) {
+            int nCols = _statement->getColumnCount() - _keyColumns;
+            int firstCustomCol = _query->_1stCustomResultColumn;
+            uint64_t missingCols = 0;
+            enc.beginArray(nCols);
+            for (int i = 0; i < nCols; ++i) {
+                int offsetColumn = i - firstCustomCol;
+                if (!encodeColumn(enc, i) && offsetColumn >= 0 && offsetColumn < 64) {
+                    missingCols |= (1ULL << offsetColumn);
+                }
+            }
+            enc.endArray();
+            return missingCols;
+        }
+
+        // Advances the statement to the next row; returns false at the end.
+        bool step() {
+            unicodesn_tokenizerRunningQuery(true);
+            try {
+                bool gotRow = _statement->executeStep();
+                unicodesn_tokenizerRunningQuery(false);
+                return gotRow;
+            } catch (...) {
+                unicodesn_tokenizerRunningQuery(false);
+                throw;
+            }
+        }
+
         // Collects all the (remaining) rows into a Fleece array of arrays,
         // and returns an enumerator impl that will replay them.
         SQLiteQueryEnumerator* fastForward() {
             fleece::Stopwatch st;
-            int nCols = _statement->getColumnCount();
             uint64_t rowCount = 0;
             // Give this encoder its own SharedKeys instead of using the database's DocumentKeys,
             // because the query results might include dicts with new keys that aren't in the
@@ -474,20 +765,17 @@ namespace litecore {
 
             unicodesn_tokenizerRunningQuery(true);
             try {
-                 auto firstCustomCol = _query->_1stCustomResultColumn;
-                 while (_statement->executeStep()) {
-                     uint64_t missingCols = 0;
-                     enc.beginArray(nCols);
-                     for (int i = 0; i < nCols; ++i) {
-                         int offsetColumn = i - firstCustomCol;
-                         if (!encodeColumn(enc, i) && offsetColumn >= 0 && offsetColumn < 64) {
-                             missingCols |= (1ULL << offsetColumn);
-                         }
-                    }
-                    enc.endArray();
+                while (_statement->executeStep()) {
+                    uint64_t missingCols = encodeRow(enc);
                     // Add an integer containing a bit-map of which columns are missing/undefined:
                     enc.writeUInt(missingCols);
                     ++rowCount;
+                    if (_keyColumns > 0) {
+                        _lastKeys.clear();
+                        int nCols = _statement->getColumnCount();
+                        for (int i = nCols - _keyColumns; i < nCols; ++i)
+                            _lastKeys.emplace_back(_statement->getColumn(i));
+                    }
                 }
             } catch (...) {
                 unicodesn_tokenizerRunningQuery(false);
@@ -497,8 +785,29 @@ namespace litecore {
 
             enc.endArray();
             Retained<Doc> recording = enc.finishDoc();
-            return new SQLiteQueryEnumerator(_query, &_options, _lastSequence, _purgeCount,
-                                             recording, rowCount, st.elapsed());
+            auto e = new SQLiteQueryEnumerator(_query, &_options, _lastSequence, _purgeCount,
+                                               recording, rowCount, st.elapsed());
+            if (_keyColumns > 0 && rowCount > 0)
+                e->setContinuationToken(continuationToken());
+            return e;
+        }
+
+        // Encodes the fingerprint of the KeysetQuery and the sort keys of the last row.
+        alloc_slice continuationToken() const {
+            Encoder enc;
+            enc.beginArray();
+            enc.writeUInt(_keysetFingerprint);
+            for (auto &cell : _lastKeys) {
+                switch (cell.type) {
+                    case SQLITE_INTEGER:    enc.writeInt(cell.integer); break;
+                    case SQLITE_FLOAT:      enc.writeDouble(cell.real); break;
+                    case SQLITE_TEXT:       enc.writeString(cell.data); break;
+                    case SQLITE_BLOB:       enc.writeData(cell.data); break;
+                    default:                enc.writeNull(); break;
+                }
+            }
+            enc.endArray();
+            return enc.finish();
         }
 
     private:
@@ -509,19 +818,254 @@ namespace litecore {
         shared_ptr<SQLite::Statement> _statement;
         set<string> _unboundParameters;
         SharedKeys* _sk;
+        int _keyColumns {0};            // Number of trailing sort-key columns (KeysetQuery)
+        uint32_t _keysetFingerprint {0};
+        vector<SQLiteCell> _lastKeys;   // Sort keys of the last row
     };
 
 
 
-    // The factory method that creates a SQLite Query.
-    Retained<Query> SQLiteKeyStore::compileQuery(slice selectorExpression, QueryLanguage language) {
-        return new SQLiteQuery(*this, selectorExpression, language);
+    // Query enumerator that reads rows one at a time from its own 'live' SQLite statement,
+    // instead of recording the whole result set up front like SQLiteQueryEnumerator.
+    // Each row is encoded into a small Fleece doc that's replaced by the next row, so memory use
+    // and the latency of the first row don't depend on the size of the result set.
+    // Random access (getRowCount, seek) is not supported.
+    //
+    // The live statement holds a read snapshot on the database's connection, and while it does,
+    // SQLite can't checkpoint the WAL past it, so the WAL keeps growing as others write. To bound
+    // that, once the snapshot is QueryEnumerator::gMaxStreamingSnapshotAge old -- whether or not
+    // the enumerator is being iterated -- it reads the remaining rows into memory and ends the
+    // statement, like a non-streaming enumerator would have.
+    class SQLiteStreamingQueryEnumerator : public QueryEnumerator, Logging {
+    public:
+        SQLiteStreamingQueryEnumerator(SQLiteQuery *query, unique_ptr<SQLiteQueryRunner> runner)
+        :QueryEnumerator(&runner->options(), runner->lastSequence(), runner->purgeCount())
+        ,Logging(QueryLog)
+        ,_query(query)
+        ,_runner(move(runner))
+        ,_sk(new SharedKeys)
+        ,_1stCustomResultColumn(query->_1stCustomResultColumn)
+        ,_hasFullText(!query->_ftsTables.empty())
+        {
+            // Step to the first row now, while the caller's read-only transaction is open, so the
+            // statement's read snapshot is consistent with lastSequence and purgeCount. SQLite
+            // keeps that snapshot until the statement is reset, i.e. until the last row is read
+            // (or until drain() reads the rest.)
+            _hasRow = _runner->step();
+            if (_hasRow) {
+                _timer.reset(new actor::Timer([this] {snapshotExpired();}));
+                _timer->fireAfter(chrono::duration_cast<actor::Timer::duration>(
+                                        chrono::duration<double>(gMaxStreamingSnapshotAge)));
+            } else {
+                _runner.reset();
+            }
+            logInfo("Created streaming enumerator on {Query#%u}", query->objectRef());
+        }
+
+        ~SQLiteStreamingQueryEnumerator() {
+            _timer.reset();         // waits for its callback, if it's running
+            logInfo("Deleted");
+        }
+
+        bool next() override {
+            lock_guard<mutex> lock(_mutex);
+            if (_rows.empty() && _runner) {
+                _query->keyStore();     // throws NotOpen if the database has been closed
+                if (_snapshotAge.elapsed() > gMaxStreamingSnapshotAge)
+                    drain();            // (in case the timer hasn't fired yet)
+                else
+                    readRows(1);
+            }
+            if (_rows.empty()) {
+                logVerbose("END");
+                _row = nullptr;
+                return false;
+            }
+            tie(_row, _missingColumns) = move(_rows.front());
+            _rows.pop_front();
+            if (willLog(LogLevel::Verbose)) {
+                alloc_slice json = _row->asArray()->toJSON();
+                logVerbose("--> %.*s", SPLAT(json));
+            }
+            return true;
+        }
+
+        Array::iterator columns() const noexcept override {
+            Array::iterator i(_row->asArray());
+            i += _1stCustomResultColumn;
+            return i;
+        }
+
+        uint64_t missingColumns() const noexcept override {
+            return _missingColumns;
+        }
+
+        // There's no recording to compare, so any change to the database counts as a change
+        // to the results.
+        virtual bool obsoletedBy(const QueryEnumerator *other) override {
+            if (!other)
+                return false;
+            return other->purgeCount() != _purgeCount || other->lastSequence() > _lastSequence;
+        }
+
+        QueryEnumerator* refresh(Query *query) override {
+            // createEnumerator returns null if the db hasn't changed since my lastSequence:
+            auto newOptions = _options.after(_lastSequence).withPurgeCount(_purgeCount);
+            return query->createEnumerator(&newOptions);
+        }
+
+        bool hasFullText() const override {
+            return _hasFullText;
+        }
+
+        const FullTextTerms& fullTextTerms() override {
+            getFullTextTerms(_row->asArray(), _fullTextTerms);
+            return _fullTextTerms;
+        }
+
+    protected:
+        string loggingClassName() const override    {return "QueryEnum";}
+
+    private:
+        // Encodes the statement's current row, returning it and its missing-columns bit-map.
+        pair<Retained<Doc>, uint64_t> encodeRow() {
+            Encoder enc;
+            enc.setSharedKeys(_sk);
+            uint64_t missingColumns = _runner->encodeRow(enc);
+            return {enc.finishDoc(), missingColumns};
+        }
+
+        // Moves up to `maxRows` rows from the statement to _rows. After the last row it resets
+        // the statement, releasing its read snapshot.
+        void readRows(size_t maxRows) {
+            for (; maxRows > 0 && _hasRow; --maxRows) {
+                _rows.push_back(encodeRow());
+                _hasRow = _runner->step();
+            }
+            if (!_hasRow)
+                _runner.reset();
+        }
+
+        // Reads all the remaining rows into _rows, ending the statement.
+        void drain() {
+            logInfo("Read snapshot is over %.1f sec old; reading the remaining rows now",
+                    gMaxStreamingSnapshotAge);
+            readRows(SIZE_MAX);
+        }
+
+        // Called on the Timer's thread once the snapshot has reached its maximum age.
+        void snapshotExpired() {
+            lock_guard<mutex> lock(_mutex);
+            if (!_runner)
+                return;
+            try {
+                _query->keyStore();     // throws NotOpen if the database has been closed
+                drain();
+            } catch (const exception &x) {
+                warn("Couldn't read the remaining rows: %s", x.what());   // next() will rethrow
+            }
+        }
+
+        Retained<SQLiteQuery> _query;
+        unique_ptr<SQLiteQueryRunner> _runner;  // Owns the live statement; null after the end
+        fleece::Stopwatch _snapshotAge;         // Time since the statement's snapshot began
+        deque<pair<Retained<Doc>, uint64_t>> _rows; // Rows read but not yet returned by next()
+        Retained<SharedKeys> _sk;               // SharedKeys for encoding rows
+        Retained<Doc> _row;                     // The current row, as a Fleece array
+        uint64_t _missingColumns {0};           // Bit-map of missing columns in the current row
+        unsigned _1stCustomResultColumn;        // Column index of the 1st column declared in JSON
+        bool _hasFullText;
+        bool _hasRow {false};                   // Is the statement positioned on an unread row?
+        mutex _mutex;                           // Guards the above, vs. the timer's thread
+        unique_ptr<actor::Timer> _timer;        // Calls snapshotExpired() (declared last, so it's
+                                                //   destroyed before the state it touches)
+    };
+
+
+
+    // Returns the key under which a compiled query is cached: the KeyStore name, the language,
+    // and the expression normalized so that formatting differences don't matter.
+    // Returns an empty string if the query can't be cached.
+    static string queryCacheKey(const string &keyStoreName, slice expression,
+                                QueryLanguage language)
+    {
+        string key = keyStoreName;
+        key += '\0';
+        key += char('0' + int(language));
+        switch (language) {
+            case QueryLanguage::kJSON: {
+                // Canonical JSON has no whitespace and sorted keys:
+                Retained<Doc> doc;
+                try {
+                    doc = Doc::fromJSON(expression);
+                } catch (const FleeceException&) {
+                    return "";      // let SQLiteQuery report the error
+                }
+                key += string(doc->root()->toJSON(true));
+                break;
+            }
+            case QueryLanguage::kN1QL: {
+                // Trim, and collapse runs of whitespace outside quotes. (If there are backslash
+                // escapes or comments, don't risk misinterpreting them; just trim.)
+                static constexpr const char* kWhitespace = " \t\r\n\f\v";
+                bool collapse = !expression.findByte('\\') && !expression.find("--"_sl)
+                                                        && !expression.find("/*"_sl);
+                string normalized;
+                char quote = 0;
+                bool pendingSpace = false;
+                for (size_t i = 0; i < expression.size; ++i) {
+                    char c = (char)expression[i];
+                    if (quote) {
+                        normalized += c;
+                        if (c == quote)
+                            quote = 0;
+                    } else if (isspace((unsigned char)c)) {
+                        pendingSpace = true;
+                        if (!collapse)
+                            normalized += c;
+                    } else {
+                        if (pendingSpace && collapse && !normalized.empty())
+                            normalized += ' ';
+                        pendingSpace = false;
+                        if (c == '\'' || c == '"' || c == '`')
+                            quote = c;
+                        normalized += c;
+                    }
+                }
+                auto start = normalized.find_first_not_of(kWhitespace);
+                if (start != string::npos)
+                    key += normalized.substr(start,
+                                             normalized.find_last_not_of(kWhitespace) + 1 - start);
+                break;
+            }
+        }
+        return key;
+    }
+
+
+    // The factory method that creates a SQLite Query, or returns an identical cached one.
+    Retained<Query> SQLiteKeyStore::compileQuery(slice selectorExpression, QueryLanguage language,
+                                                 bool cacheable)
+    {
+        string key;
+        if (cacheable)
+            key = queryCacheKey(name(), selectorExpression, language);
+        Retained<Query> query;
+        if (!key.empty())
+            query = db().cachedQuery(key);
+        if (!query) {
+            query = new SQLiteQuery(*this, selectorExpression, language);
+            if (!key.empty())
+                db().cacheQuery(key, query);
+        }
+        return query;
     }
 
 
     // The factory method that creates a SQLite QueryEnumerator, but only if the database has
     // changed since lastSeq.
     QueryEnumerator* SQLiteQuery::createEnumerator(const Options *options) {
+        lock_guard<recursive_mutex> lock(_mutex);   // the statement is shared; see _mutex
         // Start a read-only transaction, to ensure that the result of lastSequence() and purgeCount() will be
         // consistent with the query results.
         ReadOnlyTransaction t(keyStore().dataFile());
@@ -530,8 +1074,301 @@ namespace litecore {
         uint64_t purgeCnt = purgeCount();
         if(options && options->notOlderThan(curSeq, purgeCnt))
             return nullptr;
-        SQLiteQueryRunner recorder(this, options, curSeq, purgeCnt);
+        if (options && options->paged)
+            return createKeysetEnumerator(options, curSeq, purgeCnt);
+        if (options && options->streaming) {
+            // The streaming enumerator keeps its statement active after this returns, so give it
+            // its own copy instead of the Query's shared one:
+            shared_ptr<SQLite::Statement> stmt(
+                        ((SQLiteKeyStore&)keyStore()).compile(statement()->getQuery()));
+            auto runner = make_unique<SQLiteQueryRunner>(this, options, curSeq, purgeCnt, stmt);
+            return new SQLiteStreamingQueryEnumerator(this, move(runner));
+        }
+        // (A top-K query that's read in index order already stops early; splitting it into
+        // ranges would make every range read all its rows.)
+        if (options && options->parallelism > 1 && _topK != TopKStrategy::kIndexOrder) {
+            if (auto e = createParallelEnumerator(options, curSeq, purgeCnt); e)
+                return e;
+        }
+        SQLiteQueryRunner recorder(this, options, curSeq, purgeCnt, statement());
         return recorder.fastForward();
     }
 
+
+#pragma mark - PAGED QUERIES:
+
+
+    /*
+     A query run with `Options::paged` uses the form made by QueryParser::parseKeyset. The token
+     of each page is a Fleece array of a fingerprint of that query, then the sort keys of the
+     page's last row (see SQLiteQueryRunner::continuationToken.) Given a token, the next page is
+     queried with an extra WHERE condition matching only rows that sort after that row, instead
+     of with an OFFSET.
+     */
+
+    // Identifies a KeysetQuery, so a token from a different query can be detected.
+    static uint32_t keysetFingerprint(const QueryParser::KeysetQuery &keyset) {
+        uint32_t hash = 2166136261u;                // FNV-1a
+        for (const string *sql : {&keyset.selectSQL, &keyset.orderSQL}) {
+            for (char c : *sql) {
+                hash ^= (uint8_t)c;
+                hash *= 16777619u;
+            }
+        }
+        return hash;
+    }
+
+
+    static void bindKey(SQLite::Statement &statement, const string &name, const Value *key) {
+        switch (key->type()) {
+            case kBoolean:
+            case kNumber:
+                if (key->isInteger())
+                    statement.bind(name.c_str(), (long long)key->asInt());
+                else
+                    statement.bind(name.c_str(), key->asDouble());
+                break;
+            case kString:
+                statement.bind(name.c_str(), (string)key->asString());
+                break;
+            case kData: {
+                slice data = key->asData();
+                statement.bind(name.c_str(), data.buf, (int)data.size);
+                break;
+            }
+            default:
+                error::_throw(error::InvalidParameter, "Invalid continuation token");
+        }
+    }
+
+
+    QueryEnumerator* SQLiteQuery::createKeysetEnumerator(const Options *options,
+                                                         sequence_t curSeq, uint64_t purgeCnt)
+    {
+        if (options->streaming)
+            error::_throw(error::InvalidParameter,
+                          "Continuation tokens can't be used in streaming mode");
+        if (!_keyset) {
+            QueryParser qp((SQLiteKeyStore&)keyStore());
+            QueryParser::KeysetQuery keyset;
+            Retained<Doc> doc = Doc::fromJSON(_json);
+            qp.parseKeyset(doc->root(), keyset);
+            logInfo("Paged as %s%s", keyset.selectSQL.c_str(), keyset.orderSQL.c_str());
+            _keysetFingerprint = keysetFingerprint(keyset);
+            _keyset = move(keyset);
+        }
+        size_t nKeys = _keyset->keys.size();
+
+        string sql;
+        const Array *keys = nullptr;
+        if (options->continuationToken) {
+            const Value *token = Value::fromData(options->continuationToken);
+            keys = token ? token->asArray() : nullptr;
+            if (!keys || keys->count() != nKeys + 1
+                      || keys->get(0)->asUnsigned() != _keysetFingerprint)
+                error::_throw(error::InvalidParameter,
+                              "Continuation token is invalid or is from a different query");
+            vector<bool> nullKeys(nKeys);
+            for (size_t i = 0; i < nKeys; ++i)
+                nullKeys[i] = (keys->get(uint32_t(i + 1))->type() == kNull);
+            // A resumed query skips the earlier rows with the seek condition, not the OFFSET:
+            sql = _keyset->selectSQL + " AND (" + QueryParser::keysetSeekSQL(*_keyset, nullKeys)
+                    + ")" + _keyset->orderSQL + _keyset->limitSQL;
+        } else {
+            sql = _keyset->selectSQL + _keyset->orderSQL + _keyset->limitSQL + _keyset->offsetSQL;
+        }
+
+        shared_ptr<SQLite::Statement> stmt(((SQLiteKeyStore&)keyStore()).compile(sql));
+        SQLiteQueryRunner runner(this, options, curSeq, purgeCnt, stmt);
+        runner.setKeyColumns(unsigned(nKeys), _keysetFingerprint);
+        if (keys) {
+            for (size_t i = 0; i < nKeys; ++i) {
+                const Value *key = keys->get(uint32_t(i + 1));
+                if (key->type() != kNull)
+                    bindKey(*stmt, CONCAT("$__key" << i), key);
+            }
+        }
+        return runner.fastForward();
+    }
+
+
+#pragma mark - PARALLEL QUERIES:
+
+
+    /*
+     A query with `Options::parallelism` > 1 can run as parallel scans of ranges of the document
+     table's rowids, each on its own read-only connection (SQLiteDataFile::withScanConnections).
+     QueryParser::parsePartitioned splits the query into the SQL each range runs, and the SQL that
+     merges their rows (from a temporary table on the first scan connection) into the results.
+     Queries that can't be split, or that wouldn't benefit, run normally instead.
+     */
+
+    // Max number of ranges a query is split into.
+    static constexpr unsigned kMaxPartitions = 16;
+
+    // Min number of rows (as estimated from the range of rowids) in each range.
+    static constexpr int64_t kMinRowsPerPartition = 1000;
+
+    // Name of the temporary table holding the rows of all the ranges.
+    static constexpr const char* kMergeTableName = "litecore_merge";
+
+
+    // The rows returned by one range, stored in a flat array of cells.
+    struct SQLiteQuery::PartitionRows {
+        vector<SQLiteCell> cells;
+    };
+
+
+    QueryEnumerator* SQLiteQuery::createParallelEnumerator(const Options *options,
+                                                           sequence_t curSeq, uint64_t purgeCnt)
+    {
+        auto &dataFile = (SQLiteDataFile&)keyStore().dataFile();
+        if (dataFile.inTransaction())
+            return nullptr;     // other connections can't see this transaction's changes
+
+        if (!_triedPartitioning) {
+            _triedPartitioning = true;
+            QueryParser qp((SQLiteKeyStore&)keyStore());
+            QueryParser::PartitionedQuery partitioned;
+            Retained<Doc> doc = Doc::fromJSON(_json);
+            if (qp.parsePartitioned(doc->root(), kMergeTableName, partitioned)) {
+                logInfo("Partitioned as %s", partitioned.partitionSQL.c_str());
+                logInfo("...merged as %s", partitioned.mergeSQL.c_str());
+                _partitioned = move(partitioned);
+            } else {
+                logVerbose("Query can't run in parallel");
+            }
+        }
+        if (!_partitioned)
+            return nullptr;
+
+        // Split the range of rowids evenly:
+        int64_t minRowid, maxRowid;
+        {
+            SQLite::Statement range(dataFile, CONCAT("SELECT min(rowid), max(rowid) FROM "
+                                                     << ((SQLiteKeyStore&)keyStore()).tableName()));
+            if (!range.executeStep() || range.getColumn(0).isNull())
+                return nullptr;
+            minRowid = range.getColumn(0).getInt64();
+            maxRowid = range.getColumn(1).getInt64();
+        }
+        int64_t span = maxRowid - minRowid + 1;
+        auto n = unsigned(min(int64_t(min(options->parallelism, kMaxPartitions)),
+                              span / kMinRowsPerPartition));
+        if (n < 2)
+            return nullptr;
+
+        fleece::Stopwatch st;
+        QueryEnumerator *result = nullptr;
+        dataFile.withScanConnections(n, [&](const vector<SQLiteDataFile*> &connections) {
+            vector<PartitionRows> partitions(n);
+            vector<exception_ptr> errors(n);
+            atomic<bool> stale {false};
+            vector<thread> threads;
+            for (unsigned p = 0; p < n; ++p) {
+                int64_t lo = minRowid + span * p / n, hi = minRowid + span * (p + 1) / n - 1;
+                threads.emplace_back([&, p, lo, hi] {
+                    try {
+                        if (!scanPartition(*connections[p], options, lo, hi, curSeq, purgeCnt,
+                                           partitions[p]))
+                            stale = true;
+                    } catch (...) {
+                        errors[p] = current_exception();
+                    }
+                });
+            }
+            for (auto &t : threads)
+                t.join();
+            for (auto &error : errors) {
+                if (error)
+                    rethrow_exception(error);
+            }
+            if (stale) {
+                logVerbose("Scan connection's snapshot is out of date; running query serially");
+                return;
+            }
+            result = mergePartitions(*connections[0], options, curSeq, purgeCnt, partitions);
+        });
+        if (result)
+            logInfo("Ran query in %u parallel ranges in %.3fms", n, st.elapsedMS());
+        return result;
+    }
+
+
+    // Runs the partition query on one range of rowids, on a scan connection. Returns false if
+    // the connection's snapshot of the database isn't the same as the main connection's.
+    bool SQLiteQuery::scanPartition(SQLiteDataFile &connection, const Options *options,
+                                    int64_t minRowid, int64_t maxRowid,
+                                    sequence_t curSeq, uint64_t purgeCnt, PartitionRows &rows)
+    {
+        ReadOnlyTransaction t(connection);
+        KeyStore &store = connection.getKeyStore(keyStore().name());
+        if (store.lastSequence() != curSeq || store.purgeCount() != purgeCnt)
+            return false;
+
+        SQLite::Statement statement(connection, _partitioned->partitionSQL);
+        if (options->paramBindings.buf)
+            bindParameters(statement, options->paramBindings, nullptr, true);
+        statement.bind("$__rowid_lo", (long long)minRowid);
+        statement.bind("$__rowid_hi", (long long)maxRowid);
+        int nCols = statement.getColumnCount();
+        while (statement.executeStep()) {
+            for (int i = 0; i < nCols; ++i)
+                rows.cells.emplace_back(statement.getColumn(i));
+        }
+        return true;
+    }
+
+
+    // Copies the rows of all the ranges into a temporary table on a scan connection, then runs
+    // the merge query on that table and records its results.
+    QueryEnumerator* SQLiteQuery::mergePartitions(SQLiteDataFile &connection,
+                                                  const Options *options,
+                                                  sequence_t curSeq, uint64_t purgeCnt,
+                                                  const vector<PartitionRows> &partitions)
+    {
+        SQLite::Database &db = connection;
+        unsigned nCols = _partitioned->partitionColumns;
+        stringstream columns, placeholders;
+        for (unsigned i = 0; i < nCols; ++i) {
+            columns << (i ? ", " : "") << 'c' << i;
+            placeholders << (i ? ", " : "") << '?';
+        }
+        auto dropTable = [&] {
+            try {
+                db.exec(CONCAT("DROP TABLE IF EXISTS temp.\"" << kMergeTableName << '"'));
+            } catch (const SQLite::Exception &x) {
+                warn("Couldn't drop merge table: %s", x.what());
+            }
+        };
+
+        ReadOnlyTransaction t(connection);      // (SQLite allows writes to temp tables)
+        dropTable();
+        db.exec(CONCAT("CREATE TEMP TABLE \"" << kMergeTableName << "\" (" << columns.str() << ")"));
+        QueryEnumerator *result;
+        try {
+            {
+                SQLite::Statement insert(db, CONCAT("INSERT INTO temp.\"" << kMergeTableName
+                                                    << "\" VALUES (" << placeholders.str() << ")"));
+                for (auto &partition : partitions) {
+                    auto &cells = partition.cells;
+                    for (size_t row = 0; row + nCols <= cells.size(); row += nCols) {
+                        for (unsigned i = 0; i < nCols; ++i)
+                            cells[row + i].bind(insert, int(i + 1));
+                        insert.exec();
+                        insert.reset();
+                    }
+                }
+            }
+            auto merge = make_shared<SQLite::Statement>(db, _partitioned->mergeSQL);
+            SQLiteQueryRunner runner(this, options, curSeq, purgeCnt, merge, true);
+            result = runner.fastForward();
+        } catch (...) {
+            dropTable();
+            throw;
+        }
+        dropTable();
+        return result;
+    }
+
 }
@@ -71,13 +71,65 @@ namespace litecore {
     }
 
 
+    void RawRevision::findAncestors(slice body, slice extra,
+                                    revid revID,
+                                    unsigned maxAncestors,
+                                    bool mustHaveBodies,
+                                    RevTree::RemoteID remote,
+                                    RevAncestry &result)
+    {
+        result.exists = result.remoteHasOther = false;
+        result.ancestors.clear();
+
+        // If there's `extra`, it contains the tree, and the current rev's body is in `body`:
+        slice raw_tree = extra ? extra : body;
+        bool currentHasBody = extra ? getCurrentRevBody(body).buf != nullptr : false;
+        auto generation = revID.generation();
+
+        const RawRevision *rawRev = (const RawRevision*)raw_tree.buf;
+        unsigned index = 0, revIndex = 0;
+        for (; rawRev->isValid(); rawRev = rawRev->next(), ++index) {
+            if (result.exists)
+                continue;                   // just skipping to the remote entries
+            revid rawRevID(rawRev->revID, rawRev->revIDLen);
+            if (rawRevID == revID) {
+                result.exists = true;
+                result.ancestors.clear();
+                if (!remote)
+                    return;                 // no need to look at the remote entries
+                revIndex = index;
+            } else if (result.ancestors.size() < maxAncestors
+                            && rawRevID.generation() < generation) {
+                bool hasBody = (index == 0 && extra) ? currentHasBody
+                                                     : (rawRev->flags & kHasData) != 0;
+                if (hasBody || !mustHaveBodies)
+                    result.ancestors.push_back(rawRevID);
+            }
+        }
+
+        if (result.exists) {
+            auto entry = (const RemoteEntry*)offsetby(rawRev, sizeof(uint32_t));
+            for (; entry < raw_tree.end(); ++entry) {
+                auto entryIndex = endian::dec16(entry->revIndex_BE);
+                if (entry->remoteDBID_BE == 0 || entryIndex >= index)
+                    error::_throw(error::CorruptRevisionData);
+                if (endian::dec16(entry->remoteDBID_BE) == remote) {
+                    result.remoteHasOther = (entryIndex != revIndex);
+                    break;
+                }
+            }
+        }
+    }
+
+
     alloc_slice RawRevision::encodeTree(const vector<Rev*> &revs,
-                                        const RevTree::RemoteRevMap &remoteMap)
+                                        const RevTree::RemoteRevMap &remoteMap,
+                                        bool withCurrentBody)
     {
         // Allocate output buffer:
         size_t totalSize = sizeof(uint32_t);  // start with space for trailing 0 size
         for (Rev *rev : revs)
-            totalSize += sizeToWrite(*rev);
+            totalSize += sizeToWrite(*rev, withCurrentBody || rev != revs.front());
         totalSize += remoteMap.size() * sizeof(RemoteEntry);
 
         alloc_slice result(totalSize);
@@ -85,7 +137,7 @@ namespace litecore {
         // Write the raw revs:
         RawRevision *dst = (RawRevision*)result.buf;
         for (Rev *src : revs) {
-            dst = dst->copyFrom(*src);
+            dst = dst->copyFrom(*src, withCurrentBody || src != revs.front());
         }
         dst->size_BE = endian::enc32(0);   // write trailing 0 size marker
 
@@ -101,28 +153,39 @@ namespace litecore {
     }
 
 
-    size_t RawRevision::sizeToWrite(const Rev &rev) {
+    alloc_slice RawRevision::encodeRev(const Rev &rev) {
+        alloc_slice result(sizeToWrite(rev) + sizeof(uint32_t));
+        auto rawRev = (RawRevision*)result.buf;
+        RawRevision *dst = rawRev->copyFrom(rev);
+        rawRev->parentIndex_BE = endian::enc16(kNoParent);  // its parent isn't in this tree
+        dst->size_BE = endian::enc32(0);   // write trailing 0 size marker
+        return result;
+    }
+
+
+    size_t RawRevision::sizeToWrite(const Rev &rev, bool withBody) {
         return offsetof(RawRevision, revID)
              + rev.revID.size
              + SizeOfVarInt(rev.sequence)
-             + rev._body.size;
+             + (withBody ? rev._body.size : 0);
     }
 
-    RawRevision* RawRevision::copyFrom(const Rev &rev) {
-        size_t revSize = sizeToWrite(rev);
+    RawRevision* RawRevision::copyFrom(const Rev &rev, bool withBody) {
+        size_t revSize = sizeToWrite(rev, withBody);
         this->size_BE = endian::enc32((uint32_t)revSize);
         this->revIDLen = (uint8_t)rev.revID.size;
         memcpy(this->revID, rev.revID.buf, rev.revID.size);
         this->parentIndex_BE = endian::enc16(uint16_t(rev.parent ? rev.parent->index() : kNoParent));
 
         uint8_t dstFlags = rev.flags & ~kNonPersistentFlags;
-        if (rev._body)
+        if (withBody && rev._body)
             dstFlags |= RawRevision::kHasData;
         this->flags = (Rev::Flags)dstFlags;
 
         void *dstData = offsetby(&this->revID[0], rev.revID.size);
         dstData = offsetby(dstData, PutUVarInt(dstData, rev.sequence));
-        memcpy(dstData, rev._body.buf, rev._body.size);
+        if (withBody)
+            memcpy(dstData, rev._body.buf, rev._body.size);
 
         return (RawRevision*)offsetby(this, revSize);
     }
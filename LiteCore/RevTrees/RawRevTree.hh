@@ -27,6 +27,14 @@
 
 namespace litecore {
 
+    /** What an encoded rev tree says about one revision; see RawRevision::findAncestors. */
+    struct RevAncestry {
+        bool exists {false};                // True if the tree contains the revision
+        bool remoteHasOther {false};        // If it exists: a different rev is current on remote
+        std::vector<revid> ancestors;       // If not: revs with lower generations, in tree order
+    };
+
+
 #pragma pack(1)
 
     // Layout of a single revision in encoded form. Rev tree is stored as a sequence of these
@@ -34,6 +42,8 @@ namespace litecore {
     // Revs are stored in decending priority, with the current leaf rev(s) coming first.
     // Following the revs is a series of (remote DB ID, revision index) pairs that mark which
     // revision is the current one for every remote database.
+    // A tree can also be stored in two parts (see RevTree::encode): the current revision alone,
+    // with its body; and the whole tree minus the current revision's body.
     class RawRevision {
     public:
         static std::deque<Rev> decodeTree(slice raw_tree,
@@ -41,8 +51,27 @@ namespace litecore {
                                           RevTree *owner NONNULL,
                                           sequence_t curSeq);
 
+        /** Encodes a tree. If `withCurrentBody` is false, the body of the first (current) rev
+            is left out. */
         static alloc_slice encodeTree(const std::vector<Rev*> &revs,
-                                      const RevTree::RemoteRevMap &remoteMap);
+                                      const RevTree::RemoteRevMap &remoteMap,
+                                      bool withCurrentBody =true);
+
+        /** Encodes a single rev, with its body, as a tree by itself. */
+        static alloc_slice encodeRev(const Rev&);
+
+        /** Looks up `revID` in a tree encoded by RevTree::encode, without decoding it into a
+            RevTree. (`body` and `extra` are as in RevTree::decode.) If the rev exists, and
+            `remote` is nonzero, sets `remoteHasOther` if the remote's current rev is a different
+            one. Otherwise collects up to `maxAncestors` revs with lower generations, optionally
+            only ones that have bodies. The collected revids point into `body` and `extra`.
+            `result` is a parameter so its vector can be reused for many documents. */
+        static void findAncestors(slice body, slice extra,
+                                  revid revID,
+                                  unsigned maxAncestors,
+                                  bool mustHaveBodies,
+                                  RevTree::RemoteID remote,
+                                  RevAncestry &result);
 
         static inline slice getCurrentRevBody(slice raw_tree) noexcept {
             const RawRevision *rawRev = (const RawRevision*)raw_tree.buf;
@@ -86,9 +115,9 @@ namespace litecore {
             return count;
         }
 
-        static size_t sizeToWrite(const Rev&);
+        static size_t sizeToWrite(const Rev&, bool withBody =true);
         void copyTo(Rev &dst, const std::deque<Rev>&) const;
-        RawRevision* copyFrom(const Rev &rev);
+        RawRevision* copyFrom(const Rev &rev, bool withBody =true);
     };
 
 #pragma pack()
@@ -40,6 +40,10 @@ namespace litecore {
         decode(raw_tree, seq);
     }
 
+    RevTree::RevTree(slice body, slice extra, sequence_t seq) {
+        decode(body, extra, seq);
+    }
+
     RevTree::RevTree(const RevTree &other)
     :_insertedData(other._insertedData)
     ,_sorted(other._sorted)
@@ -71,6 +75,17 @@ namespace litecore {
         initRevs();
     }
 
+    void RevTree::decode(slice body, slice extra, sequence_t seq) {
+        if (!extra) {
+            decode(body, seq);
+            return;
+        }
+        _revsStorage = RawRevision::decodeTree(extra, _remoteRevs, this, seq);
+        if (!_revsStorage.empty())
+            _revsStorage.front()._body = RawRevision::getCurrentRevBody(body);
+        initRevs();
+    }
+
     void RevTree::initRevs() {
         _revs.resize(_revsStorage.size());
         auto i = _revs.begin();
@@ -85,6 +100,13 @@ namespace litecore {
         return RawRevision::encodeTree(_revs, _remoteRevs);
     }
 
+    alloc_slice RevTree::encode(alloc_slice &outExtra) {
+        sort();
+        Assert(!_revs.empty());
+        outExtra = RawRevision::encodeTree(_revs, _remoteRevs, false);
+        return RawRevision::encodeRev(*_revs[0]);
+    }
+
 #if DEBUG
     void Rev::dump(std::ostream& out) {
         out << "(" << sequence << ") " << (std::string)revID.expanded() << "  ";
@@ -93,13 +93,23 @@ namespace litecore {
     public:
         RevTree() { }
         RevTree(slice raw_tree, sequence_t seq);
+        RevTree(slice body, slice extra, sequence_t seq);
         RevTree(const RevTree&);
         virtual ~RevTree() { }
 
         void decode(slice raw_tree, sequence_t seq);
 
+        /** Decodes a tree encoded by `encode(alloc_slice&)`. If `extra` is null, `body` is
+            instead assumed to contain the entire tree. */
+        void decode(slice body, slice extra, sequence_t seq);
+
         alloc_slice encode();
 
+        /** Encodes the tree in two parts: returns the current revision by itself, with its body,
+            and sets `outExtra` to the rest of the tree, i.e. all the revisions (including
+            the current one's metadata) and any other bodies. */
+        alloc_slice encode(alloc_slice &outExtra);
+
         size_t size() const                             {return _revs.size();}
         const Rev* get(unsigned index) const;
         const Rev* get(revid) const;
@@ -64,7 +64,7 @@ namespace litecore {
         _unknown = false;
         updateScope();
         if (_rec.body().buf) {
-            RevTree::decode(_rec.body(), _rec.sequence());
+            RevTree::decode(_rec.body(), _rec.extra(), _rec.sequence());
             // The kSynced flag is set when the document's current revision is pushed to a server.
             // This is done instead of updating the doc body, for reasons of speed. So when loading
             // the document, detect that flag and belatedly update the current revision's flags.
@@ -83,6 +83,7 @@ namespace litecore {
     void VersionedDocument::updateScope() {
         Assert(_fleeceScopes.empty());
         addScope(_rec.body());
+        addScope(_rec.extra());
     }
 
     alloc_slice VersionedDocument::addScope(const alloc_slice &body) {
@@ -171,11 +172,19 @@ namespace litecore {
         bool createSequence;
         if (currentRevision()) {
             removeNonLeafBodies();
-            auto newBody = encode();
+            alloc_slice newBody, newExtra;
+            if (_store.supportsExtra()) {
+                // The record body is just the current revision, so that queries (which only look
+                // at the current revision) don't have to read the rest of the tree; that goes
+                // in `extra`:
+                newBody = encode(newExtra);
+            } else {
+                newBody = encode();
+            }
             createSequence = seq == 0 || hasNewRevisions();
             // (Don't call _rec.setBody(), because it'd invalidate all the inner pointers from
             // Revs into the existing body buffer.)
-            seq = _store.set(_rec.key(), _rec.version(), newBody, _rec.flags(),
+            seq = _store.set(_rec.key(), _rec.version(), newBody, newExtra, _rec.flags(),
                           transaction, &seq, createSequence);
             if (!seq)
                 return kConflict;               // Conflict
@@ -10,10 +10,12 @@
 #include "Error.hh"
 #include "Logging.hh"
 #include "InstanceCounted.hh"
+#include "Stopwatch.hh"
 #include <mutex>              // std::mutex, std::unique_lock
 #include <condition_variable> // std::condition_variable
 #include <unordered_map>
 #include <algorithm>
+#include <atomic>
 
 namespace litecore {
 
@@ -110,8 +112,16 @@ namespace litecore {
         void setTransaction(Transaction* t) {
             Assert(t);
             unique_lock<mutex> lock(_transactionMutex);
-            while (_transaction != nullptr)
-                _transactionCond.wait(lock);
+            if (_transaction != nullptr) {
+                fleece::Stopwatch st;
+                ++_transactionWaiters;
+                do {
+                    _transactionCond.wait(lock);
+                } while (_transaction != nullptr);
+                --_transactionWaiters;
+                ++_stats.waits;
+                _stats.waitTime += st.elapsed();
+            }
             _transaction = t;
         }
 
@@ -124,6 +134,40 @@ namespace litecore {
         }
 
 
+        /** The number of threads blocked waiting to begin a transaction. */
+        unsigned transactionWaiters() const {
+            return _transactionWaiters;
+        }
+
+
+        /** Records that a transaction was committed (taking `elapsed` seconds) or aborted.
+            Must be called by the thread holding the transaction, before it's unset. */
+        void transactionEnded(bool committed, double elapsed) {
+            unique_lock<mutex> lock(_transactionMutex);
+            if (committed) {
+                ++_stats.commits;
+                if (_transactionWaiters > 0)
+                    ++_stats.groupedCommits;
+                _stats.commitTime += elapsed;
+                _stats.maxCommitTime = max(_stats.maxCommitTime, elapsed);
+            } else {
+                ++_stats.aborts;
+            }
+        }
+
+
+        void checkpointed(bool deferred) {
+            unique_lock<mutex> lock(_transactionMutex);
+            ++(deferred ? _stats.deferredCheckpoints : _stats.checkpoints);
+        }
+
+
+        TransactionStats transactionStats() {
+            unique_lock<mutex> lock(_transactionMutex);
+            return _stats;
+        }
+
+
         Retained<RefCounted> sharedObject(const string &key) {
             lock_guard<mutex> lock(_mutex);
             auto i = _sharedObjects.find(key);
@@ -164,6 +208,8 @@ namespace litecore {
         mutex              _transactionMutex;       // Mutex for transactions
         condition_variable _transactionCond;        // For waiting on the mutex
         Transaction*       _transaction {nullptr};  // Currently active Transaction object
+        atomic<unsigned>   _transactionWaiters {0}; // # of threads waiting in setTransaction
+        TransactionStats   _stats;                  // Protected by _transactionMutex
         vector<DataFile*>  _dataFiles;              // Open DataFiles on this File
         unordered_map<string, Retained<RefCounted>> _sharedObjects;
         bool               _condemned {false};      // Prevents db from being opened or deleted
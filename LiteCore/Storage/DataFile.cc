@@ -193,6 +193,21 @@ namespace litecore {
     }
 
 
+    bool DataFile::transactionWaiting() const {
+        return _shared->transactionWaiters() > 0;
+    }
+
+
+    DataFile::TransactionStats DataFile::transactionStats() const {
+        return _shared->transactionStats();
+    }
+
+
+    void DataFile::noteCheckpoint(bool deferred) {
+        _shared->checkpointed(deferred);
+    }
+
+
     Retained<RefCounted> DataFile::sharedObject(const string &key) {
         return _shared->sharedObject(key);
     }
@@ -220,6 +235,8 @@ namespace litecore {
     {
         shared->condemn(true);
         try {
+            if (file)
+                file->closeHelperConnections();
             // Wait for other connections to close -- in multithreaded setups there may be races where
             // another thread takes a bit longer to close its connection.
             int n = 0;
@@ -394,6 +411,7 @@ namespace litecore {
         Stopwatch st;
         _db._endTransaction(this, true);
         auto elapsed = st.elapsed();
+        _db._shared->transactionEnded(true, elapsed);
         Signpost::end(Signpost::transaction, uintptr_t(this));
         if (elapsed >= 0.1)
             _db._logInfo("Committing transaction took %.3f sec", elapsed);
@@ -406,6 +424,7 @@ namespace litecore {
         _active = false;
         _db._logVerbose("abort transaction");
         _db._endTransaction(this, false);
+        _db._shared->transactionEnded(false, 0.0);
         Signpost::end(Signpost::transaction, uintptr_t(this));
     }
 
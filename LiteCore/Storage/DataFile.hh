@@ -68,6 +68,8 @@ namespace litecore {
             bool                upgradeable    :1;      ///< DB schema can be upgraded
             EncryptionAlgorithm encryptionAlgorithm;    ///< What encryption (if any)
             alloc_slice         encryptionKey;          ///< Encryption key, if encrypting
+            int64_t             cacheSize;              ///< Max page cache bytes; 0 = automatic
+            int64_t             mmapSize;               ///< Max bytes to memory-map; 0 = automatic, <0 = none
             static const Options defaults;
         };
 
@@ -114,6 +116,25 @@ namespace litecore {
 
         void forOtherDataFiles(function_ref<void(DataFile*)> fn);
 
+        /** True if another thread is waiting to begin a transaction on this file; used by
+            long-running background transactions to decide when to get out of the way. */
+        bool transactionWaiting() const;
+
+        /** Statistics of write transactions on this file, by all DataFile instances on it. */
+        struct TransactionStats {
+            uint64_t commits {0};           ///< Number of transactions committed
+            uint64_t aborts {0};            ///< Number of transactions aborted
+            uint64_t groupedCommits {0};    ///< Commits made while another writer was waiting
+            uint64_t waits {0};             ///< Number of times a writer had to wait for the lock
+            double   waitTime {0};          ///< Total secs writers spent waiting for the lock
+            double   commitTime {0};        ///< Total secs spent committing
+            double   maxCommitTime {0};     ///< Longest time a commit took, in secs
+            uint64_t checkpoints {0};       ///< Number of WAL checkpoints made after commits
+            uint64_t deferredCheckpoints {0};///< Checkpoints postponed because writers were waiting
+        };
+
+        TransactionStats transactionStats() const;
+
         /** Private API to run a raw (e.g. SQL) query, for diagnostic purposes only */
         virtual fleece::alloc_slice rawQuery(const std::string &query) =0;
 
@@ -202,6 +223,9 @@ namespace litecore {
         /** Override to close the actual database. (Called by close())*/
         virtual void _close(bool forDelete) =0;
 
+        /** Closes any other connections to the file that this DataFile opened for its own use. */
+        virtual void closeHelperConnections()                       { }
+
         /** Override to instantiate a KeyStore object. */
         virtual KeyStore* newKeyStore(const std::string &name, KeyStore::Capabilities) =0;
 
@@ -229,6 +253,10 @@ namespace litecore {
 
         void forOpenKeyStores(function_ref<void(KeyStore&)> fn);
 
+        /** Called by subclasses to record that a commit checkpointed the file's journal, or
+            postponed doing so; for \ref transactionStats. */
+        void noteCheckpoint(bool deferred);
+
         virtual Factory& factory() const =0;
 
     private:
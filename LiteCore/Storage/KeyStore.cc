@@ -45,6 +45,15 @@ namespace litecore {
         fn(rec);
     }
 
+    vector<Record> KeyStore::getMany(const vector<slice> &keys, ContentOption option) const {
+        // Subclasses can implement this with fewer database calls.
+        vector<Record> records;
+        records.reserve(keys.size());
+        for (slice key : keys)
+            records.push_back(get(key, option));
+        return records;
+    }
+
     void KeyStore::get(sequence_t seq, function_ref<void(const Record&)> fn) {
         fn(get(seq));
     }
@@ -54,6 +63,7 @@ namespace litecore {
             Record fullDoc = rec.sequence() ? get(rec.sequence())
                                             : get(rec.key(), kEntireBody);
             rec._body = fullDoc._body;
+            rec._extra = fullDoc._extra;
         }
     }
 
@@ -64,7 +74,8 @@ namespace litecore {
 #endif
     
     void KeyStore::write(Record &rec, Transaction &t, const sequence_t *replacingSequence) {
-        auto seq = set(rec.key(), rec.version(), rec.body(), rec.flags(), t, replacingSequence);
+        auto seq = set(rec.key(), rec.version(), rec.body(), rec.extra(), rec.flags(),
+                       t, replacingSequence);
         rec.setExists();
         rec.updateSequence(seq);
     }
@@ -77,6 +77,11 @@ namespace litecore {
         virtual void get(slice key, ContentOption, function_ref<void(const Record&)>);
         virtual void get(sequence_t, function_ref<void(const Record&)>);
 
+        /** Reads many records at once, returning them in the same order as the keys.
+            Records that don't exist are returned with exists()==false. */
+        virtual std::vector<Record> getMany(const std::vector<slice> &keys,
+                                            ContentOption = kEntireBody) const;
+
         /** Reads a record whose key() is already set. */
         virtual bool read(Record &rec, ContentOption = kEntireBody) const =0;
 
@@ -84,13 +89,17 @@ namespace litecore {
             Does nothing if the record's body is non-null. */
         virtual void readBody(Record &rec) const;
 
-        /** Creates a database query object. */
-        virtual Retained<Query> compileQuery(slice expr, QueryLanguage =QueryLanguage::kJSON) =0;
+        /** Creates a database query object. If `cacheable` is true, an identical query compiled
+            earlier may be returned instead. */
+        virtual Retained<Query> compileQuery(slice expr,
+                                             QueryLanguage =QueryLanguage::kJSON,
+                                             bool cacheable =true) =0;
 
-        using WithDocBodyCallback = std::function<alloc_slice(slice docID, slice body, sequence_t)>;
+        using WithDocBodyCallback = std::function<alloc_slice(slice docID, slice body,
+                                                              slice extra, sequence_t)>;
 
         /** Invokes the callback once for each document found in the database.
-            The callback is given the docID, body and sequence, and returns a string.
+            The callback is given the docID, body, extra and sequence, and returns a string.
             The return value is the collected strings, in the same order as the docIDs. */
         virtual std::vector<alloc_slice> withDocBodies(const std::vector<slice> &docIDs,
                                                        WithDocBodyCallback callback) =0;
@@ -99,13 +108,24 @@ namespace litecore {
 
         /** Core write method. If replacingSequence is not null, will only update the
             record if its existing sequence matches. (Or if the record doesn't already
-            exist, in the case where *replacingSequence == 0.) */
-        virtual sequence_t set(slice key, slice version, slice value,
+            exist, in the case where *replacingSequence == 0.)
+            `extra` is stored apart from the value (see \ref Record::extra); it must be null
+            unless \ref supportsExtra returns true. It's always written along with the value,
+            so callers must pass the current extra data even if it hasn't changed. */
+        virtual sequence_t set(slice key, slice version, slice value, slice extra,
                                DocumentFlags,
                                Transaction&,
                                const sequence_t *replacingSequence =nullptr,
                                bool newSequence =true) =0;
 
+        sequence_t set(slice key, slice version, slice value,
+                       DocumentFlags flags,
+                       Transaction &t,
+                       const sequence_t *replacingSequence =nullptr,
+                       bool newSequence =true) {
+            return set(key, version, value, nullslice, flags, t, replacingSequence, newSequence);
+        }
+
         sequence_t set(slice key, slice value, Transaction &t,
                        const sequence_t *replacingSequence =nullptr) {
             return set(key, nullslice, value, DocumentFlags::kNone, t, replacingSequence);
@@ -113,6 +133,10 @@ namespace litecore {
 
         void write(Record&, Transaction&, const sequence_t *replacingSequence =nullptr);
 
+        /** True if records can have extra data (see \ref Record::extra.) A database created by
+            an older version of LiteCore doesn't support this if it couldn't be upgraded. */
+        virtual bool supportsExtra() const                      {return false;}
+
         virtual bool del(slice key, Transaction&, sequence_t replacingSequence =0) =0;
         bool del(const Record &rec, Transaction &t)                 {return del(rec.key(), t);}
 
@@ -148,6 +172,9 @@ namespace litecore {
         //////// Indexing:
 
         virtual bool supportsIndexes(IndexSpec::Type) const                   {return false;}
+        /** Creates an index, returning false if an identical one already exists. If a transaction
+            is open, the index is created in it and the caller must commit; otherwise the index is
+            created in a transaction of its own. */
         virtual bool createIndex(const IndexSpec&) =0;
         bool createIndex(slice name,
                          slice expressionJSON,
@@ -156,6 +183,14 @@ namespace litecore {
         virtual void deleteIndex(slice name) =0;
         virtual std::vector<IndexSpec> getIndexes() const =0;
 
+        /** Stops maintaining value indexes until \ref resumeIndexes is called, for bulk loading.
+            Must be called in a transaction, and resumeIndexes must be called before it ends. */
+        virtual void suspendIndexes()                   { }
+
+        /** Ends \ref suspendIndexes. If `rebuild` is true the indexes are rebuilt; this should
+            be false only if the transaction is being aborted, which restores them anyway. */
+        virtual void resumeIndexes(bool rebuild)        { }
+
         // public for complicated reasons; clients should never call it
         virtual ~KeyStore()                             { }
 
@@ -40,6 +40,7 @@ namespace litecore {
     :_key(d._key),
      _version(d._version),
      _body(d._body),
+     _extra(d._extra),
      _bodySize(d._bodySize),
      _sequence(d._sequence),
      _flags(d._flags),
@@ -50,6 +51,7 @@ namespace litecore {
     :_key(move(d._key)),
      _version(move(d._version)),
      _body(move(d._body)),
+     _extra(move(d._extra)),
      _bodySize(d._bodySize),
      _sequence(d._sequence),
      _flags(d._flags),
@@ -59,6 +61,7 @@ namespace litecore {
     void Record::clearMetaAndBody() noexcept {
         setVersion(nullslice);
         setBody(nullslice);
+        setExtra(nullslice);
         _bodySize = _sequence = 0;
         _flags = DocumentFlags::kNone;
         _exists = false;
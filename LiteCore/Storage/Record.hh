@@ -49,7 +49,10 @@ namespace litecore {
 
 
     /** The unit of storage in a DataFile: a key, version and body (all opaque blobs);
-        and some extra metadata like flags and a sequence number. */
+        and some extra metadata like flags and a sequence number.
+        A record can also have an "extra" blob, which is stored apart from the body so that
+        reading the body (as queries do) doesn't also have to read the extra data. (Saving a
+        record still writes both: this saves reads, not writes.) */
     class Record {
     public:
         Record()                              { }
@@ -61,6 +64,7 @@ namespace litecore {
         const alloc_slice& key() const          {return _key;}
         const alloc_slice& version() const      {return _version;}
         const alloc_slice& body() const         {return _body;}
+        const alloc_slice& extra() const        {return _extra;}
 
         size_t bodySize() const                 {return _bodySize;}
 
@@ -79,6 +83,8 @@ namespace litecore {
             void setVersion(const T &vers)      {_version = vers;}
         template <typename T>
             void setBody(const T &body)         {_body = body; _bodySize = _body.size;}
+        template <typename T>
+            void setExtra(const T &extra)       {_extra = extra;}
 
         uint64_t bodyAsUInt() const noexcept;
         void setBodyAsUInt(uint64_t) noexcept;
@@ -90,7 +96,7 @@ namespace litecore {
         void clearMetaAndBody() noexcept;
 
         void updateSequence(sequence_t s)       {_sequence = s;}
-        void setUnloadedBodySize(size_t size)   {_body = nullslice; _bodySize = size;}
+        void setUnloadedBodySize(size_t size)   {_body = _extra = nullslice; _bodySize = size;}
         void setExists()                        {_exists = true;}
 
         // Only RecordEnumerator sets the expiration property
@@ -103,6 +109,7 @@ namespace litecore {
         friend class RecordEnumerator;
 
         alloc_slice     _key, _version, _body;  // The key, metadata and body of the record
+        alloc_slice     _extra;                 // Extra data stored apart from the body
         size_t          _bodySize {0};          // Size of body, if body wasn't loaded
         sequence_t      _sequence {0};          // Sequence number (if KeyStore supports sequences)
         expiration_t    _expiration {0};        // Expiration time (only set by RecordEnumerator)
@@ -26,6 +26,8 @@
 #include "SQLiteDataFile.hh"
 #include "SQLiteKeyStore.hh"
 #include "SQLite_Internal.hh"
+#include "SQLiteFleeceUtil.hh"
+#include "Query.hh"
 #include "Record.hh"
 #include "UnicodeCollator.hh"
 #include "Error.hh"
@@ -37,6 +39,8 @@
 #include "SecureRandomize.hh"
 #include "PlatformCompat.hh"
 #include "fleece/Fleece.hh"
+#include <atomic>
+#include <climits>
 #include <mutex>
 #include <sqlite3.h>
 #include <sstream>
@@ -81,24 +85,43 @@ namespace litecore {
     // SQLite page size
     static const int64_t kPageSize = 4096;
 
-    // SQLite cache size (per connection)
-    static const size_t kCacheSize = 10 * MB;
+    // Range of the automatic SQLite cache size (per connection), which is a fraction of the
+    // file size; and the least it can be cut down to by the memory budget
+    static const int64_t kMinCacheSize = 2 * MB, kMaxCacheSize = 32 * MB;
+    static const int64_t kCacheSizeDivisor = 4;
+    static const int64_t kMinBudgetedCacheSize = 100 * kPageSize;
 
     // Maximum size WAL journal will be left at after a commit
     static const int64_t kJournalSize = 5 * MB;
 
-    // Amount of file to memory-map
+    // Size of the WAL (in pages) at which a commit checkpoints it (SQLite's default)
+    static const int kCheckpointPages = 1000;
+
+    // Max size of the WAL (in pages) before a commit checkpoints it even if writers are waiting
+    static const int kMaxDeferredCheckpointPages = 4 * kCheckpointPages;
+
+    // Range of the automatic amount of file to memory-map, which is twice the file size so that
+    // it has room to grow
 #if TARGET_OS_OSX || TARGET_OS_SIMULATOR
-    static const int kMMapSize =  -1;    // Avoid possible file corruption hazard on macOS
+    static const bool kAutoMMap = false;     // Avoid possible file corruption hazard on macOS
 #else
-    static const int kMMapSize = 50 * MB;
+    static const bool kAutoMMap = true;
 #endif
+    static const int64_t kMinMMapSize = 50 * MB;
+    static const int64_t kMaxMMapSize = (sizeof(void*) > 4) ? 1024 * MB : 128 * MB;
+
+    // Process-wide SQLite heap budget (see setMemoryBudget), and number of open connections
+    static atomic<int64_t> sMemoryBudget {0};
+    static atomic<int> sConnectionCount {0};
 
     // If this fraction of the database is composed of free pages, vacuum it on close
     static const float kVacuumFractionThreshold = 0.25;
     // If the database has many bytes of free space, vacuum it on close
     static const int64_t kVacuumSizeThreshold = 10 * MB;
 
+    // Number of pages an FTS5 index incrementally merges when the database is optimized
+    static const int kFTS5MergePages = 500;
+
     // Database busy timeout; generally not needed since we have other arbitration that keeps
     // multiple threads from trying to start transactions at once, but another process might
     // open the database and grab the write lock.
@@ -184,19 +207,41 @@ namespace litecore {
     }
 
 
+    // Delegate of a scan connection: it reads record bodies and blobs the same way as its owner,
+    // but ignores commits, since the owner is already notified of those.
+    class SQLiteDataFile::ScanDelegate : public DataFile::Delegate {
+    public:
+        explicit ScanDelegate(Delegate *owner)          :_owner(owner) { }
+
+        slice fleeceAccessor(slice recordBody) const override {
+            return _owner->fleeceAccessor(recordBody);
+        }
+
+        alloc_slice blobAccessor(const fleece::impl::Dict *blob) const override {
+            return _owner->blobAccessor(blob);
+        }
+
+    private:
+        Delegate* const _owner;
+    };
+
+
     SQLiteDataFile::SQLiteDataFile(const FilePath &path, Delegate *delegate, const Options *options)
     :DataFile(path, delegate, options)
     {
+        ++sConnectionCount;
         reopen();
     }
 
 
     SQLiteDataFile::~SQLiteDataFile() {
         close();
+        --sConnectionCount;
     }
 
 
     void SQLiteDataFile::reopen() {
+        clearQueryCache();
         DataFile::reopen();
         reopenSQLiteHandle();
         decrypt();
@@ -215,11 +260,11 @@ namespace litecore {
                       "BEGIN; "
                       "CREATE TABLE IF NOT EXISTS "      // Table of metadata about KeyStores
                       "  kvmeta (name TEXT PRIMARY KEY, lastSeq INTEGER DEFAULT 0, purgeCnt INTEGER DEFAULT 0) WITHOUT ROWID; "
-                      "PRAGMA user_version=302; "
+                      "PRAGMA user_version=400; "
                       "END;"
                       );
                 Assert(intQuery("PRAGMA auto_vacuum") == 2, "Incremental vacuum was not enabled!");
-                _schemaVersion = SchemaVersion::WithPurgeCount;
+                _schemaVersion = SchemaVersion::WithExtraColumn;
                 // Create the default KeyStore's table:
                 (void)defaultKeyStore();
             } else if (_schemaVersion < SchemaVersion::MinReadable) {
@@ -246,14 +291,33 @@ namespace litecore {
                     }
                 }
             }
+
+            if (_schemaVersion < SchemaVersion::WithExtraColumn) {
+                // Schema upgrade: Add the `extra` column to the KeyStores' tables. Existing
+                // records don't change; but records written afterwards may keep data in `extra`
+                // that older versions would ignore, so this is backward-incompatible.
+                // The column is optional (see KeyStore::supportsExtra), so if the db can't be
+                // upgraded we just go on without it.
+                if (options().writeable && options().upgradeable) {
+                    try {
+                        addExtraColumns();
+                    } catch (const SQLite::Exception &x) {
+                        // Recover if the db file itself is read-only
+                        if (x.getErrorCode() != SQLITE_READONLY)
+                            throw;
+                    }
+                }
+            }
         });
 
-        _exec(format("PRAGMA cache_size=%d; "            // Memory cache
-                     "PRAGMA mmap_size=%d; "             // Memory-mapped reads
-                     "PRAGMA synchronous=normal; "       // Speeds up commits
+        _exec(format("PRAGMA synchronous=normal; "       // Speeds up commits
                      "PRAGMA journal_size_limit=%lld; "  // Limit WAL disk usage
                      "PRAGMA case_sensitive_like=true",  // Case sensitive LIKE, for N1QL compat
-                     -(int)kCacheSize/1024, kMMapSize, (long long)kJournalSize));
+                     (long long)kJournalSize));
+
+        // Memory cache and memory-mapped reads:
+        _cacheSize = _mmapSize = _cacheSizedForFile = -1;
+        adjustCacheSize();
 
 #if DEBUG
         // Deliberately make unordered queries unpredictable, to expose any LiteCore code that
@@ -272,12 +336,23 @@ namespace litecore {
         if (maxThreads > 0)
             sqlite3_limit(sqlite, SQLITE_LIMIT_WORKER_THREADS, maxThreads);
 
+        // Replace SQLite's automatic checkpointing, which runs inside COMMIT, with our own
+        // (see checkpointAfterCommit); the hook just remembers the WAL size after each commit.
+        _walPages = 0;
+        sqlite3_wal_hook(sqlite, [](void *context, sqlite3*, const char*, int nPages) {
+            ((SQLiteDataFile*)context)->_walPages = nPages;
+            return SQLITE_OK;
+        }, this);
+
         // Register collators, custom functions, and the FTS tokenizer:
         RegisterSQLiteUnicodeCollations(sqlite, _collationContexts);
-        RegisterSQLiteFunctions(sqlite, {delegate(), documentKeys()});
+        _queryFleeceCache = make_shared<QueryFleeceCache>();
+        RegisterSQLiteFunctions(sqlite, {delegate(), documentKeys(), _queryFleeceCache});
         int rc = register_unicodesn_tokenizer(sqlite);
         if (rc != SQLITE_OK)
             warn("Unable to register FTS tokenizer: SQLite err %d", rc);
+        else if ((rc = RegisterFTS5Extensions(sqlite)) != SQLITE_OK)
+            warn("Unable to register FTS5 tokenizer: SQLite err %d", rc);
     }
 
 
@@ -288,7 +363,8 @@ namespace litecore {
         _setLastSeqStmt.reset();
         _getPurgeCntStmt.reset();
         _setPurgeCntStmt.reset();
-        
+        clearStatementCache();
+
         int sqlFlags = options().writeable ? SQLite::OPEN_READWRITE : SQLite::OPEN_READONLY;
         if (options().create)
             sqlFlags |= SQLite::OPEN_CREATE;
@@ -307,6 +383,29 @@ namespace litecore {
     }
 
 
+    void SQLiteDataFile::addExtraColumns() {
+        vector<string> tables;
+        {
+            SQLite::Statement stmt(*_sqlDb, "SELECT name FROM sqlite_master WHERE type='table'"
+                                            " AND name GLOB 'kv_*' AND NOT name GLOB 'kv_*:*'");
+            while (stmt.executeStep())
+                tables.push_back(stmt.getColumn(0).getString());
+        }
+        _exec("BEGIN");
+        try {
+            for (auto &table : tables)
+                _exec("ALTER TABLE \"" + table + "\" ADD COLUMN extra BLOB");
+            _exec("PRAGMA user_version=400; END");
+        } catch (...) {
+            sqlite3_exec(_sqlDb->getHandle(), "ROLLBACK", nullptr, nullptr, nullptr);
+            throw;
+        }
+        _schemaVersion = SchemaVersion::WithExtraColumn;
+        LogTo(DBLog, "Upgraded database schema: added 'extra' column to %zu tables",
+              tables.size());
+    }
+
+
     bool SQLiteDataFile::isOpen() const noexcept {
         return _sqlDb != nullptr;
     }
@@ -314,15 +413,21 @@ namespace litecore {
 
     // Called by DataFile::close (the public method)
     void SQLiteDataFile::_close(bool forDelete) {
+        closeHelperConnections();
+        clearQueryCache();
         _getLastSeqStmt.reset();
         _setLastSeqStmt.reset();
         _getPurgeCntStmt.reset();
         _setPurgeCntStmt.reset();
+        _schemaCookieStmt.reset();
         if (_sqlDb) {
             if (options().writeable) {
+                if (!forDelete)
+                    mergeFTS5Indexes(false);
                 optimize();
                 vacuum(false);
             }
+            clearStatementCache();      // (after the above, which may have used it)
             // Close the SQLite database:
             if (!_sqlDb->closeUnlessStatementsOpen()) {
                 // There are still SQLite statements (queries) open, probably in QueryEnumerators
@@ -421,6 +526,7 @@ namespace litecore {
 
     void SQLiteDataFile::rekey(EncryptionAlgorithm alg, slice newKey) {
 #ifdef COUCHBASE_ENTERPRISE
+        closeHelperConnections();       // they'd have the old key
         if (!factory().encryptionEnabled(alg))
             error::_throw(error::UnsupportedEncryption);
 
@@ -488,6 +594,35 @@ namespace litecore {
         });
 
         exec(commit ? "COMMIT" : "ROLLBACK");
+        if (commit)
+            checkpointAfterCommit();
+    }
+
+
+    // Checkpointing the WAL is the only part of a commit that syncs the file (since we use
+    // `synchronous=normal`), and it's done while still holding the file's transaction lock.
+    // So when other writers are queued up waiting for the lock, the checkpoint is postponed and
+    // left to the last writer in the queue: the whole group of commits then shares one sync.
+    // The WAL can't grow past kMaxDeferredCheckpointPages, though.
+    void SQLiteDataFile::checkpointAfterCommit() {
+        if (_walPages < kCheckpointPages)
+            return;
+        if (transactionWaiting() && _walPages < kMaxDeferredCheckpointPages) {
+            noteCheckpoint(true);
+            return;
+        }
+        int walPages = _walPages, checkpointedPages = 0;
+        int rc = sqlite3_wal_checkpoint_v2(_sqlDb->getHandle(), nullptr,
+                                           SQLITE_CHECKPOINT_PASSIVE,
+                                           nullptr, &checkpointedPages);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+            warn("WAL checkpoint failed: SQLite err %d", rc);
+            return;
+        }
+        noteCheckpoint(false);
+        logVerbose("Checkpointed %d of %d WAL pages", checkpointedPages, walPages);
+        // In WAL mode the file only grows when checkpointed, so this is when to resize the cache:
+        adjustCacheSize();
     }
 
 
@@ -522,9 +657,243 @@ namespace litecore {
 
 
     int64_t SQLiteDataFile::intQuery(const char *query) {
-        SQLite::Statement st(*_sqlDb, query);
-        LogStatement(st);
-        return st.executeStep() ? st.getColumn(0) : 0;
+        auto st = cachedStatement(query);
+        UsingStatement u(st);
+        return st->executeStep() ? st->getColumn(0) : 0;
+    }
+
+
+#pragma mark - MEMORY:
+
+
+    // Sets the page cache and mmap sizes, unless they were given in the Options, in proportion to
+    // the file size. Does nothing if the file size hasn't changed much since the last call.
+    void SQLiteDataFile::adjustCacheSize() {
+        int64_t fileSize = intQuery("PRAGMA page_count") * intQuery("PRAGMA page_size");
+        if (_cacheSizedForFile >= 0 && fileSize < 2 * _cacheSizedForFile
+                                    && 2 * fileSize > _cacheSizedForFile)
+            return;
+        _cacheSizedForFile = fileSize;
+
+        int64_t cacheSize = options().cacheSize;
+        if (cacheSize <= 0) {
+            cacheSize = max(kMinCacheSize, min(fileSize / kCacheSizeDivisor, kMaxCacheSize));
+            if (int64_t budget = sMemoryBudget; budget > 0) {
+                int64_t share = budget / max(1, sConnectionCount.load());
+                cacheSize = max(kMinBudgetedCacheSize, min(cacheSize, share));
+            }
+        }
+
+        int64_t mmapSize = options().mmapSize;
+        if (mmapSize == 0)
+            mmapSize = kAutoMMap ? max(kMinMMapSize, min(2 * fileSize, kMaxMMapSize)) : 0;
+        else if (mmapSize < 0)
+            mmapSize = 0;
+
+        if (cacheSize == _cacheSize && mmapSize == _mmapSize)
+            return;
+        logVerbose("File size is %lld; setting cache_size to %lldKB and mmap_size to %lldKB",
+                   (long long)fileSize, (long long)cacheSize / 1024, (long long)mmapSize / 1024);
+        _exec(format("PRAGMA cache_size=%lld; PRAGMA mmap_size=%lld",
+                     -(long long)cacheSize / 1024, (long long)mmapSize));
+        _cacheSize = cacheSize;
+        _mmapSize = mmapSize;
+    }
+
+
+    SQLiteDataFile::CacheStats SQLiteDataFile::cacheStats() const {
+        checkOpen();
+        auto status = [&](int op) -> int64_t {
+            int current = 0, highwater = 0;
+            sqlite3_db_status(_sqlDb->getHandle(), op, &current, &highwater, false);
+            return current;
+        };
+        CacheStats stats;
+        stats.cacheSize = _cacheSize;
+        stats.mmapSize  = _mmapSize;
+        stats.cacheUsed = status(SQLITE_DBSTATUS_CACHE_USED);
+        stats.hits      = status(SQLITE_DBSTATUS_CACHE_HIT);
+        stats.misses    = status(SQLITE_DBSTATUS_CACHE_MISS);
+        stats.writes    = status(SQLITE_DBSTATUS_CACHE_WRITE);
+        return stats;
+    }
+
+
+    void SQLiteDataFile::setMemoryBudget(int64_t bytes) {
+        bytes = max(bytes, int64_t(0));
+        sMemoryBudget = bytes;
+        sqlite3_soft_heap_limit64(bytes);
+        LogTo(DBLog, "SQLite memory budget set to %lld bytes", (long long)bytes);
+    }
+
+
+    int64_t SQLiteDataFile::memoryBudget() {
+        return sMemoryBudget;
+    }
+
+
+    int64_t SQLiteDataFile::releaseMemory() {
+        int64_t freed = sqlite3_release_memory(INT_MAX);
+        LogTo(DBLog, "Released %lld bytes of SQLite memory", (long long)freed);
+        return freed;
+    }
+
+
+#pragma mark - SCAN CONNECTIONS:
+
+
+    void SQLiteDataFile::withScanConnections(unsigned count,
+                                             function_ref<void(const vector<SQLiteDataFile*>&)> callback)
+    {
+        checkOpen();
+        lock_guard<mutex> lock(_scanMutex);
+        if (!_scanDelegate)
+            _scanDelegate.reset(new ScanDelegate(delegate()));
+        while (_scanConnections.size() < count) {
+            Options scanOptions = options();
+            scanOptions.create = scanOptions.writeable = scanOptions.upgradeable = false;
+            _scanConnections.emplace_back(factory().openFile(filePath(), _scanDelegate.get(),
+                                                             &scanOptions));
+            logVerbose("Opened scan connection #%zu", _scanConnections.size());
+        }
+        vector<SQLiteDataFile*> connections;
+        for (unsigned i = 0; i < count; ++i)
+            connections.push_back(_scanConnections[i].get());
+        callback(connections);
+    }
+
+
+    size_t SQLiteDataFile::scanConnectionCount() const {
+        lock_guard<mutex> lock(_scanMutex);
+        return _scanConnections.size();
+    }
+
+
+    void SQLiteDataFile::closeHelperConnections() {
+        lock_guard<mutex> lock(_scanMutex);
+        if (!_scanConnections.empty())
+            logVerbose("Closing %zu scan connections", _scanConnections.size());
+        _scanConnections.clear();       // (deleting a DataFile closes it)
+    }
+
+
+#pragma mark - QUERY CACHE:
+
+
+    // SQLite's schema cookie, which is incremented by every schema change by any connection.
+    int64_t SQLiteDataFile::schemaCookie() const {
+        compile(_schemaCookieStmt, "PRAGMA schema_version");
+        UsingStatement u(_schemaCookieStmt);
+        return _schemaCookieStmt->executeStep() ? (int64_t)_schemaCookieStmt->getColumn(0) : 0;
+    }
+
+
+    // Returns the cached query with the given key, or null. Since a query's compiled SQL depends
+    // on which index tables exist, the cache is cleared whenever the schema has changed.
+    Retained<Query> SQLiteDataFile::cachedQuery(const string &key) {
+        auto schema = schemaCookie();
+        if (schema != _queryCacheSchema) {
+            if (!_queryCache.empty())
+                logVerbose("Schema changed; clearing %zu cached queries", _queryCache.size());
+            clearQueryCache();
+            _queryCacheSchema = schema;
+        }
+
+        auto i = _queryCacheIndex.find(key);
+        if (i == _queryCacheIndex.end()) {
+            ++_queryCacheStats.misses;
+            return nullptr;
+        }
+        ++_queryCacheStats.hits;
+        _queryCache.splice(_queryCache.begin(), _queryCache, i->second);   // move to front
+        return i->second->second;
+    }
+
+
+    void SQLiteDataFile::cacheQuery(const string &key, Query *query) {
+        // Compiling the query may itself have changed the schema (e.g. by adding an expiration
+        // column), in which case the older entries are no longer trustworthy:
+        auto schema = schemaCookie();
+        if (schema != _queryCacheSchema) {
+            clearQueryCache();
+            _queryCacheSchema = schema;
+        }
+
+        _queryCache.emplace_front(key, query);
+        _queryCacheIndex[key] = _queryCache.begin();
+        if (_queryCache.size() > kQueryCacheCapacity) {
+            _queryCacheIndex.erase(_queryCache.back().first);
+            _queryCache.pop_back();
+        }
+    }
+
+
+    void SQLiteDataFile::clearQueryCache() {
+        _queryCacheIndex.clear();
+        _queryCache.clear();
+        _queryCacheSchema = -1;
+    }
+
+
+    SQLiteDataFile::QueryCacheStats SQLiteDataFile::queryCacheStats() const {
+        QueryCacheStats stats = _queryCacheStats;
+        stats.count = _queryCache.size();
+        return stats;
+    }
+
+
+#pragma mark - STATEMENT CACHE:
+
+
+    shared_ptr<SQLite::Statement> SQLiteDataFile::cachedStatement(const string &sql) const {
+        checkOpen();
+        // The use_count check must be made under the lock, so that two threads can't both
+        // decide they're the sole user of the same statement:
+        lock_guard<mutex> lock(_stmtCacheMutex);
+        auto i = _stmtCacheIndex.find(sql);
+        if (i != _stmtCacheIndex.end()) {
+            shared_ptr<SQLite::Statement> stmt = i->second->second;
+            if (stmt.use_count() == 2) {            // i.e. only the cache and `stmt` own it
+                ++_stmtCacheStats.hits;
+                _stmtCache.splice(_stmtCache.begin(), _stmtCache, i->second);  // move to front
+                stmt->reset();
+                stmt->clearBindings();
+                return stmt;
+            }
+        }
+
+        ++_stmtCacheStats.misses;
+        shared_ptr<SQLite::Statement> stmt;
+        try {
+            stmt = make_shared<SQLite::Statement>(*_sqlDb, sql, true);
+        } catch (const SQLite::Exception &x) {
+            warn("SQLite error compiling statement \"%s\": %s", sql.c_str(), x.what());
+            throw;
+        }
+        if (i == _stmtCacheIndex.end()) {
+            _stmtCache.emplace_front(sql, stmt);
+            _stmtCacheIndex[sql] = _stmtCache.begin();
+            if (_stmtCache.size() > kStatementCacheCapacity) {
+                _stmtCacheIndex.erase(_stmtCache.back().first);
+                _stmtCache.pop_back();
+            }
+        }
+        return stmt;
+    }
+
+
+    void SQLiteDataFile::clearStatementCache() {
+        lock_guard<mutex> lock(_stmtCacheMutex);
+        _stmtCacheIndex.clear();
+        _stmtCache.clear();
+    }
+
+
+    SQLiteDataFile::StatementCacheStats SQLiteDataFile::statementCacheStats() const {
+        lock_guard<mutex> lock(_stmtCacheMutex);
+        StatementCacheStats stats = _stmtCacheStats;
+        stats.count = _stmtCache.size();
+        return stats;
     }
 
 
@@ -550,15 +919,15 @@ namespace litecore {
                                    const string &tableName,
                                    string &outSQL) const
     {
-        SQLite::Statement check(*_sqlDb, "SELECT sql FROM sqlite_master "
-                                         "WHERE name = ? AND type = ? AND tbl_name = ?");
-        check.bind(1, name);
-        check.bind(2, type);
-        check.bind(3, tableName);
-        LogStatement(check);
-        if (!check.executeStep())
+        auto check = cachedStatement("SELECT sql FROM sqlite_master "
+                                     "WHERE name = ? AND type = ? AND tbl_name = ?");
+        check->bind(1, name);
+        check->bind(2, type);
+        check->bind(3, tableName);
+        UsingStatement u(check);
+        if (!check->executeStep())
             return false;
-        outSQL = check.getColumn(0).getString();
+        outSQL = check->getColumn(0).getString();
         return true;
     }
 
@@ -658,6 +1027,55 @@ namespace litecore {
     }
 
 
+    // FTS5 indexes accumulate segments as they're updated. Automerge keeps their number down,
+    // but an explicit 'merge' does a bounded amount of extra merging, and 'optimize' merges
+    // everything into a single segment. <https://sqlite.org/fts5.html#the_merge_command>
+    // Does nothing if there are no FTS5 tables, or if called inside a transaction.
+    void SQLiteDataFile::mergeFTS5Indexes(bool full) {
+        if (inTransaction())
+            return;
+        try {
+            vector<string> tables;
+            {
+                SQLite::Statement stmt(*_sqlDb, "SELECT name FROM sqlite_master WHERE type='table'"
+                                                " AND sql LIKE 'CREATE VIRTUAL TABLE % USING fts5(%'");
+                while (stmt.executeStep())
+                    tables.push_back(stmt.getColumn(0).getString());
+            }
+            if (tables.empty())
+                return;
+            // Merging writes to the index, so it takes the file's transaction lock like any write:
+            Transaction t(this);
+            for (auto &table : tables) {
+                fleece::Stopwatch st;
+                if (full)
+                    _exec(CONCAT("INSERT INTO \"" << table << "\" (\"" << table << "\") "
+                                 "VALUES ('optimize')"));
+                else
+                    _exec(CONCAT("INSERT INTO \"" << table << "\" (\"" << table << "\", rank) "
+                                 "VALUES ('merge', " << kFTS5MergePages << ")"));
+                logVerbose("%s FTS5 index '%s' in %.3f sec",
+                           (full ? "Optimized" : "Merged"), table.c_str(), st.elapsed());
+            }
+            t.commit();
+        } catch (const exception &x) {
+            warn("Caught SQLite exception while merging FTS5 indexes: %s", x.what());
+        }
+    }
+
+
+    void SQLiteDataFile::setProgressHandler(ProgressHandler handler, int interval) {
+        _progressHandler = move(handler);
+        if (_progressHandler) {
+            sqlite3_progress_handler(_sqlDb->getHandle(), interval, [](void *context) -> int {
+                return ((SQLiteDataFile*)context)->_progressHandler();
+            }, this);
+        } else {
+            sqlite3_progress_handler(_sqlDb->getHandle(), 0, nullptr, nullptr);
+        }
+    }
+
+
     void SQLiteDataFile::vacuum(bool always) {
         // <https://blogs.gnome.org/jnelson/2015/01/06/sqlite-vacuum-and-auto_vacuum/>
         try {
@@ -729,6 +1147,7 @@ namespace litecore {
         switch (what) {
             case kCompact:
                 checkOpen();
+                mergeFTS5Indexes(true);
                 optimize();
                 vacuum(true);
                 break;
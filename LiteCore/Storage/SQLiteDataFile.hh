@@ -21,7 +21,11 @@
 #include "DataFile.hh"
 #include "IndexSpec.hh"
 #include "UnicodeCollator.hh"
+#include <functional>
+#include <list>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
 
 namespace SQLite {
     class Database;
@@ -33,6 +37,7 @@ namespace SQLite {
 namespace litecore {
 
     class SQLiteKeyStore;
+    class QueryFleeceCache;
     struct SQLiteIndexSpec;
 
 
@@ -47,10 +52,19 @@ namespace litecore {
 
         uint64_t fileSize() override;
         void optimize();
+        void mergeFTS5Indexes(bool full);
         void vacuum(bool always);
         void integrityCheck();
         void maintenance(MaintenanceType) override;
 
+        /** A callback that SQLite calls periodically while running a statement; if it returns
+            true the statement is interrupted, failing with SQLITE_INTERRUPT. */
+        using ProgressHandler = std::function<bool()>;
+
+        /** Registers a ProgressHandler to be called about every `interval` SQLite virtual-machine
+            instructions, or unregisters it if `handler` is null. */
+        void setProgressHandler(ProgressHandler handler, int interval =1000);
+
         static void shutdown() { }
 
         operator SQLite::Database&() {return *_sqlDb;}
@@ -86,10 +100,78 @@ namespace litecore {
                           int64_t &outRowCount,
                           alloc_slice *outRows =nullptr);
 
+        /** The cache of decoded document bodies used by query functions like fl_value. */
+        QueryFleeceCache& queryFleeceCache() const          {return *_queryFleeceCache;}
+
+        /** Statistics of the cache of compiled queries used by SQLiteKeyStore::compileQuery. */
+        struct QueryCacheStats {
+            uint64_t hits {0};          ///< Number of times a cached query was reused
+            uint64_t misses {0};        ///< Number of times a query had to be compiled
+            size_t count {0};           ///< Number of queries currently cached
+        };
+
+        QueryCacheStats queryCacheStats() const;
+
+        /** Max number of compiled queries kept in the cache. */
+        static constexpr size_t kQueryCacheCapacity = 50;
+
+        /** Returns a compiled statement for `sql` from a cache of recently used statements, or
+            compiles (and caches) it. Its parameter bindings are cleared. Reset it when done, as
+            UsingStatement does, so it's ready for its next user. If the cached statement is still
+            in use, such as by a caller further up the stack, a new uncached one is returned.
+            Statements that a SQLiteKeyStore runs on every call are kept in its own members. */
+        std::shared_ptr<SQLite::Statement> cachedStatement(const std::string &sql) const;
+
+        /** Statistics of the cache of compiled statements used by `cachedStatement`. */
+        struct StatementCacheStats {
+            uint64_t hits {0};          ///< Number of times a cached statement was reused
+            uint64_t misses {0};        ///< Number of times a statement had to be compiled
+            size_t count {0};           ///< Number of statements currently cached
+        };
+
+        StatementCacheStats statementCacheStats() const;
+
+        /** Max number of compiled statements kept by `cachedStatement`. */
+        static constexpr size_t kStatementCacheCapacity = 50;
+
+        /** Statistics of this connection's SQLite page cache, from `sqlite3_db_status`. */
+        struct CacheStats {
+            int64_t cacheSize {0};      ///< Current limit of the page cache, in bytes
+            int64_t mmapSize {0};       ///< Current limit of memory-mapped reads, in bytes
+            int64_t cacheUsed {0};      ///< Heap bytes currently used by the page cache
+            int64_t hits {0};           ///< Number of page reads found in the cache
+            int64_t misses {0};         ///< Number of page reads that went to the file
+            int64_t writes {0};         ///< Number of pages written from the cache to the file
+        };
+
+        CacheStats cacheStats() const;
+
+        /** Sets a process-wide limit on the heap memory SQLite uses, shared by all open databases;
+            0 means no limit. SQLite recycles cache pages as the limit is approached, and the
+            automatic cache size of a database opened or resized afterwards is at most an equal
+            share of the budget. */
+        static void setMemoryBudget(int64_t bytes);
+        static int64_t memoryBudget();
+
+        /** Frees as much memory as possible from the page caches of all open databases; call this
+            when the OS reports memory pressure. Returns the number of bytes freed. */
+        static int64_t releaseMemory();
+
+        /** Calls `callback` with `count` read-only connections to the same file, for scanning
+            ranges of documents in parallel (see SQLiteQuery.) The connections are opened as
+            needed and kept open until this DataFile closes. Each can be used by a different thread,
+            but only until the callback returns; calls on different threads are serialized. */
+        void withScanConnections(unsigned count,
+                                 function_ref<void(const std::vector<SQLiteDataFile*>&)> callback);
+
+        /** The number of scan connections currently open. */
+        size_t scanConnectionCount() const;
+
     protected:
         std::string loggingClassName() const override       {return "DB";}
         void logKeyStoreOp(SQLiteKeyStore&, const char *op, slice key);
         void _close(bool forDelete) override;
+        void closeHelperConnections() override;
         void reopen() override;
         void rekey(EncryptionAlgorithm, slice newKey) override;
         void _beginTransaction(Transaction*) override;
@@ -129,14 +211,25 @@ namespace litecore {
         enum class SchemaVersion {
             None            = 0,    // Newly created database
             MinReadable     = 201,  // Cannot open earlier versions than this (CBL 2.0)
-            MaxReadable     = 399,  // Cannot open versions newer than this
+            MaxReadable     = 499,  // Cannot open versions newer than this
 
             WithIndexTable  = 301,  // Added 'indexes' table (CBL 2.5)
             WithPurgeCount  = 302,  // Added 'purgeCnt' column to KeyStores (CBL 2.7)
+            WithExtraColumn = 400,  // Added 'extra' column to KeyStore tables
         };
 
+        bool hasExtraColumn() const     {return _schemaVersion >= SchemaVersion::WithExtraColumn;}
+
         void reopenSQLiteHandle();
         void ensureSchemaVersionAtLeast(SchemaVersion);
+        void addExtraColumns();
+        void checkpointAfterCommit();
+        void adjustCacheSize();
+        int64_t schemaCookie() const;
+        Retained<Query> cachedQuery(const std::string &key);
+        void cacheQuery(const std::string &key, Query*);
+        void clearQueryCache();
+        void clearStatementCache();
         void decrypt();
         bool _decrypt(EncryptionAlgorithm, slice key);
         int _exec(const std::string &sql);
@@ -154,8 +247,36 @@ namespace litecore {
         std::unique_ptr<SQLite::Database>    _sqlDb;         // SQLite database object
         std::unique_ptr<SQLite::Statement>   _getLastSeqStmt, _setLastSeqStmt;
         std::unique_ptr<SQLite::Statement>   _getPurgeCntStmt, _setPurgeCntStmt;
+        std::unique_ptr<SQLite::Statement>   _schemaCookieStmt;
         CollationContextVector               _collationContexts;
+        std::shared_ptr<QueryFleeceCache>    _queryFleeceCache;
         SchemaVersion                        _schemaVersion {SchemaVersion::None};
+
+        // Compiled-query cache, most recently used first, indexed by key:
+        using QueryCacheList = std::list<std::pair<std::string, Retained<Query>>>;
+        QueryCacheList                       _queryCache;
+        std::unordered_map<std::string, QueryCacheList::iterator> _queryCacheIndex;
+        int64_t                              _queryCacheSchema {-1}; // schema_version of cache
+        QueryCacheStats                      _queryCacheStats;
+
+        // Compiled-statement cache (see cachedStatement), most recently used first, indexed by SQL:
+        using StatementCacheList = std::list<std::pair<std::string,
+                                                       std::shared_ptr<SQLite::Statement>>>;
+        mutable StatementCacheList           _stmtCache;
+        mutable std::unordered_map<std::string, StatementCacheList::iterator> _stmtCacheIndex;
+        mutable StatementCacheStats          _stmtCacheStats;
+        mutable std::mutex                   _stmtCacheMutex;    // Guards the above 3
+
+        ProgressHandler                      _progressHandler;
+        int                                  _walPages {0};  // WAL size after last commit
+        int64_t                              _cacheSize {-1};// Current cache_size, in bytes
+        int64_t                              _mmapSize {-1}; // Current mmap_size
+        int64_t                              _cacheSizedForFile {-1}; // File size at last resize
+
+        class ScanDelegate;
+        std::unique_ptr<ScanDelegate>        _scanDelegate;
+        std::vector<std::unique_ptr<SQLiteDataFile>> _scanConnections; // see withScanConnections
+        mutable std::mutex                   _scanMutex;
     };
 
 
@@ -36,8 +36,10 @@ namespace litecore {
 
    class SQLiteEnumerator : public RecordEnumerator::Impl {
     public:
-        SQLiteEnumerator(SQLite::Statement *stmt, ContentOption content)
-        :_stmt(stmt),
+        SQLiteEnumerator(const SQLiteKeyStore &store, SQLite::Statement *stmt,
+                         ContentOption content)
+        :_store(store),
+         _stmt(stmt),
          _content(content)
         {
             LogTo(SQL, "Enumerator: %s", _stmt->getQuery().c_str());
@@ -51,12 +53,15 @@ namespace litecore {
             rec.updateSequence((int64_t)_stmt->getColumn(0));
             rec.setFlags((DocumentFlags)(int)_stmt->getColumn(1));
             rec.setKey(SQLiteKeyStore::columnAsSlice(_stmt->getColumn(2)));
-            rec.setExpiration(_stmt->getColumn(5));
+            rec.setExpiration(_stmt->getColumn(6));
             SQLiteKeyStore::setRecordMetaAndBody(rec, *_stmt.get(), _content);
+            if (_content == kEntireBody)
+                _store.readLargeBody(rec, *_stmt.get(), 7);
             return true;
         }
 
     private:
+        const SQLiteKeyStore &_store;
         unique_ptr<SQLite::Statement> _stmt;
         ContentOption _content;
     };
@@ -76,12 +81,15 @@ namespace litecore {
         }
 
         stringstream sql;
-        const char* kBodyItem[3] = {"body", "fl_root(body)", "length(body)"};
-        sql << "SELECT sequence, flags, key, version, " << kBodyItem[options.contentOption];
+        const string kBodyItem[3] = {entireBodyColumns(), "fl_root(body), NULL", "length(body), NULL"};
+        sql << "SELECT sequence, flags, key, version, "
+            << subst(kBodyItem[options.contentOption].c_str());
         if (mayHaveExpiration())
             sql << ", expiration";
         else
             sql << ", 0";
+        if (options.contentOption == kEntireBody)
+            sql << ", " << kLargeBodyColumns;
         sql << " FROM kv_" << name();
         
         bool writeAnd = false;
@@ -129,7 +137,7 @@ namespace litecore {
 
         if (bySequence)
             stmt->bind(1, (long long)since);
-        return new SQLiteEnumerator(stmt, options.contentOption);
+        return new SQLiteEnumerator(*this, stmt, options.contentOption);
     }
 
 }
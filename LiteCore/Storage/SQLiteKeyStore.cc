@@ -24,6 +24,7 @@
 #include "StringUtil.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "FleeceImpl.hh"
+#include <sqlite3.h>
 #include <sstream>
 
 using namespace std;
@@ -65,8 +66,10 @@ namespace litecore {
 
 
     void SQLiteKeyStore::createTable() {
-        // Here's the table schema. The body comes last because it may be very large, and it's
-        // more efficient in SQLite to keep large columns at the end of a row.
+        // Here's the table schema. The body and extra come last because they may be very large,
+        // and it's more efficient in SQLite to keep large columns at the end of a row. (Extra is
+        // last so that reading the body doesn't have to page through it. But SQLite rewrites a
+        // whole row on any update, so saving a record writes its extra data too.)
         // Create the sequence and flags columns regardless of options, otherwise it's too
         // complicated to customize all the SQL queries to conditionally use them...
         db().execWithLock(subst("CREATE TABLE IF NOT EXISTS kv_@ ("
@@ -74,7 +77,8 @@ namespace litecore {
                                 "  sequence INTEGER,"
                                 "  flags INTEGER DEFAULT 0,"
                                 "  version BLOB,"
-                                "  body BLOB)"));
+                                "  body BLOB,"
+                                "  extra BLOB)"));
         _existence = db().inTransaction() ? kUncommitted : kCommitted;
     }
 
@@ -88,6 +92,9 @@ namespace litecore {
         _getBySeqStmt.reset();
         _getCurBySeqStmt.reset();
         _getMetaBySeqStmt.reset();
+        _getManyStmt.reset();
+        _getManyCurStmt.reset();
+        _getManyMetaStmt.reset();
         _setStmt.reset();
         _insertStmt.reset();
         _replaceStmt.reset();
@@ -113,6 +120,9 @@ namespace litecore {
     string SQLiteKeyStore::subst(const char *sqlTemplate) const {
         string sql(sqlTemplate);
         size_t pos;
+        // '$' stands for the `extra` column, which a database that hasn't been upgraded lacks:
+        while(string::npos != (pos = sql.find('$')))
+            sql.replace(pos, 1, db().hasExtraColumn() ? "extra" : "NULL");
         while(string::npos != (pos = sql.find('@')))
             sql.replace(pos, 1, name());
         return sql;
@@ -207,6 +217,8 @@ namespace litecore {
 
         _lastSequence = -1;
         _purgeCountValid = false;
+        if (!commit)
+            _coveringTablesSchema = -1;     // schema_version may be reused after a rollback
 
         if (!commit && _uncommittedExpirationColumn)
             _hasExpirationColumn = false;
@@ -238,7 +250,8 @@ namespace litecore {
     // alloc_slice (not just slice).
 
 
-    // Gets flags from col 1, version from col 3, and body (or its length) from col 4
+    // Gets flags from col 1, version from col 3, body (or its length) from col 4,
+    // and extra from col 5 if the entire body was read
     /*static*/ void SQLiteKeyStore::setRecordMetaAndBody(Record &rec,
                                                          SQLite::Statement &stmt,
                                                          ContentOption content)
@@ -246,13 +259,54 @@ namespace litecore {
         rec.setExists();
         rec.setFlags((DocumentFlags)(int)stmt.getColumn(1));
         rec.setVersion(columnAsSlice(stmt.getColumn(3)));
-        if (content == kMetaOnly)
+        if (content == kMetaOnly) {
             rec.setUnloadedBodySize((ssize_t)stmt.getColumn(4));
-        else
+        } else {
             rec.setBody(columnAsSlice(stmt.getColumn(4)));
+            rec.setExtra(content == kEntireBody ? columnAsSlice(stmt.getColumn(5)) : nullslice);
+        }
     }
     
 
+    // Bodies bigger than this are read with incremental blob I/O (see readBlob).
+    static constexpr int64_t kMinBlobReadSize = 32 * 1024;
+
+
+    // The body and extra columns of a kEntireBody statement. A body over kMinBlobReadSize comes
+    // back as NULL; the statement must then also select kLargeBodyColumns, for readLargeBody.
+    /*static*/ string SQLiteKeyStore::entireBodyColumns() {
+        return "CASE WHEN length(body) <= " + to_string(kMinBlobReadSize) + " THEN body END, $";
+    }
+
+
+    // Reads the body that entireBodyColumns() left out, if it was too large. `col` is the index
+    // of the first of the kLargeBodyColumns.
+    void SQLiteKeyStore::readLargeBody(Record &rec, SQLite::Statement &stmt, int col) const {
+        if (int64_t size = stmt.getColumn(col + 1).getInt64(); size > kMinBlobReadSize)
+            rec.setBody(readBlob("body", stmt.getColumn(col).getInt64(), size));
+    }
+
+
+    // Reads a column value straight from the database pages into a new buffer. Reading a large
+    // value as a statement column instead makes SQLite assemble it in a temporary buffer from its
+    // overflow pages, which would then be copied again into the Record.
+    alloc_slice SQLiteKeyStore::readBlob(const char *column, int64_t rowid, int64_t size) const {
+        SQLite::Database &sqlDb = db();
+        sqlite3 *sqlite = sqlDb.getHandle();
+        sqlite3_blob *blob = nullptr;
+        int rc = sqlite3_blob_open(sqlite, "main", tableName().c_str(), column, rowid, 0, &blob);
+        alloc_slice result;
+        if (rc == SQLITE_OK) {
+            result = alloc_slice(size_t(size));
+            rc = sqlite3_blob_read(blob, (void*)result.buf, int(size), 0);
+        }
+        sqlite3_blob_close(blob);   // (An open blob handle holds a read transaction, like a statement)
+        if (rc != SQLITE_OK)
+            error::_throw(error::SQLite, rc);
+        return result;
+    }
+
+
     bool SQLiteKeyStore::read(Record &rec, ContentOption content) const {
         SQLite::Statement *stmt;
         switch (content) {
@@ -266,7 +320,8 @@ namespace litecore {
                 break;
             case kEntireBody:
                 stmt = &compile(_getByKeyStmt,
-                        "SELECT sequence, flags, 0, version, body FROM kv_@ WHERE key=?");
+                        ("SELECT sequence, flags, 0, version, " + entireBodyColumns() + ", "
+                         + kLargeBodyColumns + " FROM kv_@ WHERE key=?").c_str());
                 break;
             default:
                 return false;
@@ -282,11 +337,91 @@ namespace litecore {
             sequence_t seq = (int64_t)stmt->getColumn(0);
             rec.updateSequence(seq);
             setRecordMetaAndBody(rec, *stmt, content);
+            if (content == kEntireBody)
+                readLargeBody(rec, *stmt, 6);
         }
         return true;
     }
 
 
+    // Number of keys looked up by each execution of a getMany statement.
+    static constexpr size_t kGetManyBatchSize = 64;
+
+
+    vector<Record> SQLiteKeyStore::getMany(const vector<slice> &keys,
+                                           ContentOption content) const
+    {
+        const unique_ptr<SQLite::Statement> *stmtRef;
+        string columns;
+        switch (content) {
+            case kMetaOnly:
+                stmtRef = &_getManyMetaStmt;
+                columns = "SELECT sequence, flags, key, version, length(body)";
+                break;
+            case kCurrentRevOnly:
+                stmtRef = &_getManyCurStmt;
+                columns = "SELECT sequence, flags, key, version, fl_root(body)";
+                break;
+            case kEntireBody:
+                stmtRef = &_getManyStmt;
+                columns = "SELECT sequence, flags, key, version, " + entireBodyColumns() + ", "
+                          + kLargeBodyColumns;
+                break;
+            default:
+                error::_throw(error::InvalidParameter);
+        }
+        if (!*stmtRef) {
+            // The statement looks up a fixed number of keys; a short batch repeats its last key.
+            stringstream sql;
+            sql << columns << " FROM kv_@ WHERE key IN (?";
+            for (size_t i = 1; i < kGetManyBatchSize; ++i)
+                sql << ",?";
+            sql << ")";
+            compile(*stmtRef, sql.str().c_str());
+        }
+        SQLite::Statement &stmt = **stmtRef;
+
+        vector<Record> records;
+        records.reserve(keys.size());
+        unordered_map<slice, size_t> indices;      // maps key -> index of its first occurrence
+        indices.reserve(keys.size());
+        for (slice key : keys) {
+            indices.emplace(key, records.size());
+            records.emplace_back(key);
+        }
+
+        lock_guard<mutex> lock(_stmtMutex);
+        for (size_t start = 0; start < keys.size(); start += kGetManyBatchSize) {
+            size_t end = min(start + kGetManyBatchSize, keys.size());
+            for (size_t i = 0; i < kGetManyBatchSize; ++i) {
+                slice key = keys[min(start + i, end - 1)];
+                stmt.bindNoCopy(int(i + 1), (const char*)key.buf, (int)key.size);
+            }
+            UsingStatement u(stmt);
+            while (stmt.executeStep()) {
+                auto i = indices.find(columnAsSlice(stmt.getColumn(2)));
+                if (i == indices.end())
+                    continue;       // (can't happen)
+                Record &rec = records[i->second];
+                rec.updateSequence((int64_t)stmt.getColumn(0));
+                setRecordMetaAndBody(rec, stmt, content);
+                if (content == kEntireBody)
+                    readLargeBody(rec, stmt, 6);
+            }
+        }
+
+        if (indices.size() < keys.size()) {
+            // Some keys were duplicated; copy the records read for their first occurrences:
+            vector<Record> result;
+            result.reserve(keys.size());
+            for (slice key : keys)
+                result.emplace_back(records[indices[key]]);
+            return result;
+        }
+        return records;
+    }
+
+
     Record SQLiteKeyStore::get(sequence_t seq /*, ContentOptions content*/) const {
         constexpr ContentOption content = kEntireBody;  // this used to be a param but not used
         Assert(_capabilities.sequences);
@@ -303,7 +438,8 @@ namespace litecore {
                 break;
             case kEntireBody:
                 stmt = &compile(_getBySeqStmt,
-                        "SELECT 0, flags, key, version, body FROM kv_@ WHERE sequence=?");
+                        ("SELECT 0, flags, key, version, " + entireBodyColumns() + ", "
+                         + kLargeBodyColumns + " FROM kv_@ WHERE sequence=?").c_str());
                 break;
             default:
                 error::_throw(error::UnexpectedError);
@@ -315,46 +451,65 @@ namespace litecore {
             rec.setKey(columnAsSlice(stmt->getColumn(2)));
             rec.updateSequence(seq);
             setRecordMetaAndBody(rec, *stmt, content);
+            if (content == kEntireBody)
+                readLargeBody(rec, *stmt, 6);
         }
         return rec;
     }
 
 
-    sequence_t SQLiteKeyStore::set(slice key, slice vers, slice body, DocumentFlags flags,
+    bool SQLiteKeyStore::supportsExtra() const {
+        return db().hasExtraColumn();
+    }
+
+
+    sequence_t SQLiteKeyStore::set(slice key, slice vers, slice body, slice extra,
+                                   DocumentFlags flags,
                                    Transaction&,
                                    const sequence_t *replacingSequence,
                                    bool newSequence)
     {
+        // (Parameter 6 is the `extra` column, which a database that hasn't been upgraded lacks.)
+        bool withExtra = supportsExtra();
+        Assert(withExtra || !extra);
         const char *opName;
         SQLite::Statement *stmt;
         if (replacingSequence == nullptr) {
             // Default:
-            compile(_setStmt,
-                    "INSERT OR REPLACE INTO kv_@ (version, body, flags, sequence, key)"
-                    " VALUES (?, ?, ?, ?, ?)");
+            compile(_setStmt, withExtra
+                    ? "INSERT OR REPLACE INTO kv_@ (version, body, flags, sequence, key, extra)"
+                      " VALUES (?1, ?2, ?3, ?4, ?5, ?6)"
+                    : "INSERT OR REPLACE INTO kv_@ (version, body, flags, sequence, key)"
+                      " VALUES (?1, ?2, ?3, ?4, ?5)");
             stmt = _setStmt.get();
             opName = "set";
         } else if (*replacingSequence == 0) {
             // Insert only:
-            compile(_insertStmt,
-                    "INSERT OR IGNORE INTO kv_@ (version, body, flags, sequence, key)"
-                    " VALUES (?, ?, ?, ?, ?)");
+            compile(_insertStmt, withExtra
+                    ? "INSERT OR IGNORE INTO kv_@ (version, body, flags, sequence, key, extra)"
+                      " VALUES (?1, ?2, ?3, ?4, ?5, ?6)"
+                    : "INSERT OR IGNORE INTO kv_@ (version, body, flags, sequence, key)"
+                      " VALUES (?1, ?2, ?3, ?4, ?5)");
             stmt = _insertStmt.get();
             opName = "insert";
         } else {
             // Replace only:
             Assert(_capabilities.sequences);
-            compile(_replaceStmt,
-                    "UPDATE kv_@ SET version=?, body=?, flags=?, sequence=?"
-                    " WHERE key=? AND sequence=?");
+            compile(_replaceStmt, withExtra
+                    ? "UPDATE kv_@ SET version=?1, body=?2, flags=?3, sequence=?4, extra=?6"
+                      " WHERE key=?5 AND sequence=?7"
+                    : "UPDATE kv_@ SET version=?1, body=?2, flags=?3, sequence=?4"
+                      " WHERE key=?5 AND sequence=?7");
             stmt = _replaceStmt.get();
-            stmt->bind(6, (long long)*replacingSequence);
+            stmt->bind(7, (long long)*replacingSequence);
             opName = "update";
         }
         stmt->bindNoCopy(1, vers.buf, (int)vers.size);
         stmt->bindNoCopy(2, body.buf, (int)body.size);
         stmt->bind(3, (int)flags);
         stmt->bindNoCopy(5, (const char*)key.buf, (int)key.size);
+        if (withExtra)
+            stmt->bindNoCopy(6, extra.buf, (int)extra.size);
 
         sequence_t seq = 0;
         if (_capabilities.sequences) {
@@ -451,7 +606,8 @@ namespace litecore {
 
         // Construct SQL query with a big "IN (...)" clause for all the docIDs:
         stringstream sql;
-        sql << "SELECT key, fl_callback(key, body, sequence, ?) FROM kv_" << name()
+        sql << "SELECT key, fl_callback(key, body, " << (db().hasExtraColumn() ? "extra" : "NULL")
+            << ", sequence, ?) FROM kv_" << name()
             << " WHERE key IN ('";
         unsigned n = 0;
         for (slice docID : docIDs) {
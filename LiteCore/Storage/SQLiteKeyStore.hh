@@ -43,12 +43,17 @@ namespace litecore {
 
         Record get(sequence_t) const override;
         bool read(Record &rec, ContentOption) const override;
+        std::vector<Record> getMany(const std::vector<slice> &keys,
+                                    ContentOption) const override;
 
-        sequence_t set(slice key, slice meta, slice value, DocumentFlags,
+        using KeyStore::set;
+        sequence_t set(slice key, slice meta, slice value, slice extra, DocumentFlags,
                        Transaction&,
                        const sequence_t *replacingSequence =nullptr,
                        bool newSequence =true) override;
 
+        bool supportsExtra() const override;
+
         bool del(slice key, Transaction&, sequence_t s) override;
 
         bool setDocumentFlag(slice key, sequence_t, DocumentFlags, Transaction&) override;
@@ -65,6 +70,8 @@ namespace litecore {
 
         void deleteIndex(slice name) override;
         std::vector<IndexSpec> getIndexes() const override;
+        void suspendIndexes() override;
+        void resumeIndexes(bool rebuild) override;
 
         virtual std::vector<alloc_slice> withDocBodies(const std::vector<slice> &docIDs,
                                                        WithDocBodyCallback callback) override;
@@ -81,13 +88,14 @@ namespace litecore {
         virtual std::string predictiveTableName(const std::string &property) const override;
 #endif
         virtual bool tableExists(const std::string &tableName) const override;
+        virtual std::vector<QueryParser::CoveringTable> coveringTables() const override;
 
 
     protected:
         RecordEnumerator::Impl* newEnumeratorImpl(bool bySequence,
                                                   sequence_t since,
                                                   RecordEnumerator::Options) override;
-        Retained<Query> compileQuery(slice expression, QueryLanguage) override;
+        Retained<Query> compileQuery(slice expression, QueryLanguage, bool cacheable) override;
 
         SQLite::Statement* compile(const std::string &sql) const;
         SQLite::Statement& compile(const std::unique_ptr<SQLite::Statement>& ref,
@@ -102,6 +110,9 @@ namespace litecore {
         static void setRecordMetaAndBody(Record &rec,
                                          SQLite::Statement &stmt,
                                          ContentOption);
+        static std::string entireBodyColumns();
+        static constexpr const char* kLargeBodyColumns = "rowid, length(body)";
+        void readLargeBody(Record &rec, SQLite::Statement &stmt, int col) const;
         virtual bool mayHaveExpiration() override;
 
     private:
@@ -113,6 +124,7 @@ namespace litecore {
         void createTable();
         SQLiteDataFile& db() const                    {return (SQLiteDataFile&)dataFile();}
         std::string subst(const char *sqlTemplate) const;
+        alloc_slice readBlob(const char *column, int64_t rowid, int64_t size) const;
         void setLastSequence(sequence_t seq);
         void incrementPurgeCount();
         void createTrigger(string_view triggerName,
@@ -128,6 +140,10 @@ namespace litecore {
         bool createFTSIndex(const IndexSpec&);
         bool createArrayIndex(const IndexSpec&);
         std::string createUnnestedTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
+        void createUnnestedTableTriggers(const std::string &unnestTableName,
+                                         const std::string &eachExpr);
+        bool createCoveringIndex(const IndexSpec&);
+        std::string coveringTableName(const std::string &indexName) const;
         void addExpiration();
 
 #ifdef COUCHBASE_ENTERPRISE
@@ -140,6 +156,7 @@ namespace litecore {
         std::unique_ptr<SQLite::Statement> _recCountStmt;
         std::unique_ptr<SQLite::Statement> _getByKeyStmt, _getCurByKeyStmt, _getMetaByKeyStmt;
         std::unique_ptr<SQLite::Statement> _getBySeqStmt, _getCurBySeqStmt, _getMetaBySeqStmt;
+        std::unique_ptr<SQLite::Statement> _getManyStmt, _getManyCurStmt, _getManyMetaStmt;
         std::unique_ptr<SQLite::Statement> _setStmt, _insertStmt, _replaceStmt, _updateBodyStmt;
         std::unique_ptr<SQLite::Statement> _delByKeyStmt, _delBySeqStmt, _delByBothStmt;
         std::unique_ptr<SQLite::Statement> _setFlagStmt, _withDocBodiesStmt;
@@ -153,9 +170,13 @@ namespace litecore {
         mutable bool _purgeCountValid {false};      // TODO: Use optional class from C++17
         mutable int64_t _lastSequence {-1};
         mutable std::atomic<uint64_t> _purgeCount {0};
+        bool _indexesSuspended {false};
+        std::vector<std::pair<std::string,std::string>> _suspendedIndexes; // name, SQL
         bool _hasExpirationColumn {false};
         bool _uncommittedExpirationColumn {false};
         mutable std::mutex _stmtMutex;
+        mutable std::vector<QueryParser::CoveringTable> _coveringTables;   // cached
+        mutable int64_t _coveringTablesSchema {-1}; // schema_version of _coveringTables
         Existence _existence;
     };
 
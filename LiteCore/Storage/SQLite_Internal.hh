@@ -35,6 +35,8 @@ namespace fleece { namespace impl {
 
 namespace litecore {
 
+    class QueryFleeceCache;
+
     extern LogDomain SQL;
 
     void LogStatement(const SQLite::Statement &st);
@@ -52,6 +54,10 @@ namespace litecore {
         :UsingStatement(*stmt.get())
         { }
 
+        UsingStatement(const std::shared_ptr<SQLite::Statement> &stmt) noexcept
+        :UsingStatement(*stmt.get())
+        { }
+
         ~UsingStatement();
 
     private:
@@ -62,14 +68,20 @@ namespace litecore {
     // What the user_data of a registered function points to
     struct fleeceFuncContext {
         fleeceFuncContext(DataFile::Delegate *d,
-                          fleece::impl::SharedKeys *sk)
-        :delegate(d), sharedKeys(sk)
+                          fleece::impl::SharedKeys *sk,
+                          std::shared_ptr<QueryFleeceCache> cache =nullptr)
+        :delegate(d), sharedKeys(sk), bodyCache(move(cache))
         { }
 
         DataFile::Delegate* delegate;
         fleece::impl::SharedKeys* const sharedKeys;
+        std::shared_ptr<QueryFleeceCache> bodyCache;    // Per-connection decoded-body cache
     };
 
 
     void RegisterSQLiteFunctions(sqlite3 *db, fleeceFuncContext);
+
+    // Registers the FTS5 "unicodesn" tokenizer and FTS3-compatible offsets/matchinfo functions.
+    // Must be called after the FTS3 "unicodesn" tokenizer is registered.
+    int RegisterFTS5Extensions(sqlite3 *db);
 }
@@ -55,7 +55,8 @@ namespace litecore { namespace actor {
 
             if (!_items) {
                 _items.reset(new std::vector<Retained<ITEM>>);
-                _items->reserve(_capacity ? _capacity : 200);
+                size_t capacity = _capacity;
+                _items->reserve(capacity ? capacity : 200);
             }
             _items->push_back(item);
             if (!_scheduled) {
@@ -63,14 +64,24 @@ namespace litecore { namespace actor {
                 _scheduled = true;
                 _processLater(_generation);
             }
-            if (_latency > Timer::duration(0) && _capacity > 0 && _items->size() == _capacity) {
-                // I'm full -- schedule a pop NOW
+            if (_latency.load() > Timer::duration(0) && _capacity > 0
+                        && _items->size() >= _capacity && !_scheduledNow) {
+                // I'm full -- schedule a pop NOW. (Compare with `>=`, since the capacity may
+                // have been lowered since items were added, but only do this once per batch.)
                 LogVerbose(SyncLog, "Batcher scheduling immediate pop");
+                _scheduledNow = true;
                 _processNow(_generation);
             }
         }
 
 
+        /** The delay before processing, and the queue size that triggers processing immediately.
+            These can be changed at any time; the changes apply to the next items pushed. */
+        Timer::duration latency() const             {return _latency;}
+        void setLatency(Timer::duration latency)    {_latency = latency;}
+        size_t capacity() const                     {return _capacity;}
+        void setCapacity(size_t capacity)           {_capacity = capacity;}
+
         /** Removes & returns all the items from  the queue, in the order they were added,
             or nullptr if nothing has been added to the queue.
             Thread-safe. */
@@ -79,19 +90,20 @@ namespace litecore { namespace actor {
 
             if (gen < _generation)
                 return {};
-            _scheduled = false;
+            _scheduled = _scheduledNow = false;
             ++_generation;
             return move(_items);
         }
 
     private:
         std::function<void(int gen)> _processNow, _processLater;
-        Timer::duration _latency;
-        size_t _capacity;
+        std::atomic<Timer::duration> _latency;
+        std::atomic<size_t> _capacity;
         std::mutex _mutex;
         Items _items;
         int _generation {0};
         bool _scheduled {false};
+        bool _scheduledNow {false};
     };
 
 
@@ -112,7 +124,9 @@ namespace litecore { namespace actor {
                      Timer::duration latency ={},
                      size_t capacity = 0)
         :Batcher<ITEM>([=](int gen) {actor->enqueue(processor, gen);},
-                       [=](int gen) {actor->enqueueAfter(latency, processor, gen);},
+                       [this, actor, processor](int gen) {
+                           actor->enqueueAfter(this->latency(), processor, gen);
+                       },
                        latency,
                        capacity)
         { }
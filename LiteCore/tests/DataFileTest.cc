@@ -17,6 +17,7 @@
 //
 
 #include "DataFile.hh"
+#include "SQLiteDataFile.hh"
 #include "RecordEnumerator.hh"
 #include "Error.hh"
 #include "FilePath.hh"
@@ -26,6 +27,7 @@
 #ifndef _MSC_VER
 #include <sys/stat.h>
 #endif
+#include <thread>
 
 #include "LiteCoreTest.hh"
 
@@ -131,6 +133,42 @@ static void createNumberedDocs(KeyStore *store, int n =100, bool withAssertions
 }
 
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile GetMany", "[DataFile]") {
+    {
+        Transaction t(db);
+        for (int i = 1; i <= 200; i++) {
+            string docID = stringWithFormat("rec-%03d", i);
+            string body = stringWithFormat("body of %d", i);
+            store->set(slice(docID), nullslice, slice(body), DocumentFlags::kNone, t);
+        }
+        t.commit();
+    }
+
+    // Enough keys to need several batches, in random order, with duplicates and missing keys:
+    vector<string> docIDs;
+    for (int i = 0; i < 150; i++)
+        docIDs.push_back(stringWithFormat("rec-%03d", (i * 37) % 250 + 1));
+    docIDs.push_back("rec-005");
+    docIDs.push_back("rec-005");
+    vector<slice> keys(docIDs.begin(), docIDs.end());
+
+    for (ContentOption content : {kMetaOnly, kEntireBody}) {
+        vector<Record> records = store->getMany(keys, content);
+        REQUIRE(records.size() == keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            INFO("key " << docIDs[i]);
+            Record expected = store->get(keys[i], content);
+            CHECK(records[i].key() == keys[i]);
+            CHECK(records[i].exists() == expected.exists());
+            CHECK(records[i].sequence() == expected.sequence());
+            CHECK(records[i].bodySize() == expected.bodySize());
+            CHECK(records[i].body() == expected.body());
+        }
+    }
+    CHECK(store->getMany({}).empty());
+}
+
+
 N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile EnumerateDocs", "[DataFile]") {
     {
         INFO("Enumerate empty db");
@@ -233,6 +271,127 @@ N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile TransactionsThenIterate",
 }
 
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Concurrent Writers", "[DataFile]") {
+    // Several DataFiles on the same file, each committing lots of small transactions:
+    static constexpr unsigned kNWriters = 4, kNTransactions = 100, kNDocs = 10;
+    auto stats0 = db->transactionStats();
+    string body(2000, 'x');
+
+    vector<unique_ptr<DataFile>> writers;
+    vector<thread> threads;
+    for (unsigned w = 0; w < kNWriters; ++w)
+        writers.emplace_back(newDatabase(db->filePath()));
+    for (unsigned w = 0; w < kNWriters; ++w) {
+        threads.emplace_back([&, w] {
+            KeyStore &writerStore = writers[w]->defaultKeyStore();
+            for (unsigned t = 0; t < kNTransactions; ++t) {
+                Transaction trans(writers[w]);
+                for (unsigned d = 0; d < kNDocs; ++d) {
+                    string docID = stringWithFormat("%u-%03u-%u", w, t, d);
+                    writerStore.set(slice(docID), slice(body), trans);
+                }
+                trans.commit();
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    CHECK(store->recordCount() == kNWriters * kNTransactions * kNDocs);
+
+    // The writers, being queued up, may have deferred every checkpoint. If so, their ~8MB of
+    // writes left the WAL over the checkpoint size, so a commit with no one waiting makes one:
+    {
+        Transaction t(db);
+        store->set("last"_sl, slice(body), t);
+        t.commit();
+    }
+
+    // Stats are shared by all DataFiles on the file:
+    auto stats = db->transactionStats();
+    CHECK(stats.commits - stats0.commits == kNWriters * kNTransactions + 1);
+    CHECK(stats.aborts == stats0.aborts);
+    CHECK(stats.groupedCommits <= stats.commits);
+    CHECK(stats.commitTime >= stats0.commitTime);
+    CHECK(stats.maxCommitTime <= stats.commitTime);
+    CHECK(stats.checkpoints > stats0.checkpoints);
+    Log("Concurrent writers: %llu commits (%llu grouped), %llu waits, %.3f sec waiting, "
+        "%llu checkpoints (%llu deferred)",
+        (unsigned long long)(stats.commits - stats0.commits),
+        (unsigned long long)(stats.groupedCommits - stats0.groupedCommits),
+        (unsigned long long)(stats.waits - stats0.waits), stats.waitTime - stats0.waitTime,
+        (unsigned long long)(stats.checkpoints - stats0.checkpoints),
+        (unsigned long long)(stats.deferredCheckpoints - stats0.deferredCheckpoints));
+    auto stats2 = writers[0]->transactionStats();
+    CHECK(stats2.commits == stats.commits);
+}
+
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Large Body", "[DataFile]") {
+    // Bodies above 32KB are read a different way than smaller ones:
+    for (size_t size : {size_t(32 * 1024), size_t(32 * 1024 + 1), size_t(1000000)}) {
+        alloc_slice body(size);
+        for (size_t i = 0; i < size; ++i)
+            ((uint8_t*)body.buf)[i] = uint8_t(i % 251);
+        {
+            Transaction t(db);
+            store->set("big"_sl, "1-aa"_sl, body, DocumentFlags::kNone, t);
+            t.commit();
+        }
+        Record rec = store->get("big"_sl);
+        REQUIRE(rec.exists());
+        CHECK(rec.version() == "1-aa"_sl);
+        CHECK(rec.body() == body);
+        CHECK(rec.bodySize() == size);
+
+        // getMany and enumerators read large bodies the same way:
+        vector<Record> recs = store->getMany({"big"_sl});
+        REQUIRE(recs.size() == 1);
+        CHECK(recs[0].body() == body);
+        RecordEnumerator e(*store);
+        REQUIRE(e.next());
+        CHECK(e->body() == body);
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Cache Size", "[DataFile]") {
+    static constexpr int64_t MB = 1024 * 1024;
+    {
+        Transaction t(db);
+        for (int i = 0; i < 100; ++i)
+            store->set(slice(stringWithFormat("doc-%03d", i)), "body"_sl, t);
+        t.commit();
+    }
+    // The automatic cache size of a small database is the minimum:
+    auto stats = dynamic_cast<SQLiteDataFile&>(*db).cacheStats();
+    CHECK(stats.cacheSize == 2 * MB);
+    for (int i = 0; i < 100; ++i)
+        CHECK(store->get(slice(stringWithFormat("doc-%03d", i))).exists());
+    auto stats2 = dynamic_cast<SQLiteDataFile&>(*db).cacheStats();
+    CHECK(stats2.hits > stats.hits);
+    CHECK(stats2.cacheUsed > 0);
+
+    // An explicit size overrides it:
+    DataFile::Options options = db->options();
+    options.cacheSize = 5 * MB;
+    options.mmapSize = -1;
+    reopenDatabase(&options);
+    stats = dynamic_cast<SQLiteDataFile&>(*db).cacheStats();
+    CHECK(stats.cacheSize == 5 * MB);
+    CHECK(stats.mmapSize == 0);
+
+    // A memory budget limits the automatic size:
+    options.cacheSize = options.mmapSize = 0;
+    SQLiteDataFile::setMemoryBudget(MB);
+    reopenDatabase(&options);
+    stats = dynamic_cast<SQLiteDataFile&>(*db).cacheStats();
+    CHECK(stats.cacheSize <= MB);
+    CHECK(SQLiteDataFile::releaseMemory() >= 0);
+    SQLiteDataFile::setMemoryBudget(0);
+}
+
+
 N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile DeleteKey", "[DataFile]") {
     slice key("a");
     {
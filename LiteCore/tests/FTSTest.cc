@@ -19,6 +19,7 @@
 #include "DataFile.hh"
 #include "Query.hh"
 #include "Error.hh"
+#include "Benchmark.hh"
 #include "StringUtil.hh"
 
 #include "LiteCoreTest.hh"
@@ -497,3 +498,112 @@ TEST_CASE_METHOD(FTSTest, "Missing FTS columns", "[FTS][Query]") {
         expectedMissing = 0;
     }
 }
+
+
+TEST_CASE_METHOD(FTSTest, "Query Full-Text FTS5", "[Query][FTS]") {
+    IndexSpec::Options options {"english", true};
+    options.useFTS5 = true;
+    options.prefixLengths = "2 3";
+    createIndex(options);
+    testQuery(
+        "['SELECT', {'WHERE': ['MATCH', 'sentence', 'search'],\
+                    ORDER_BY: [['DESC', ['rank()', 'sentence']]],\
+                        WHAT: [['.sentence']]}]",
+              {1, 2, 0, 4},
+              {3, 3, 1, 1});
+
+    // Prefix query, using the prefix index:
+    testQuery(
+        "['SELECT', {'WHERE': ['MATCH', 'sentence', 'adv*'],\
+                        WHAT: [['.sentence']]}]",
+              {4},
+              {1});
+
+    // Index stays up to date as documents change:
+    {
+        Transaction t(store->dataFile());
+        createDoc(t, 4, "Nothing to see here");
+        createDoc(t, 5, "A grand adventure");
+        store->del("rec-000"_sl, t);
+        t.commit();
+    }
+    testQuery(
+        "['SELECT', {'WHERE': ['MATCH', 'sentence', 'adv*'],\
+                        WHAT: [['.sentence']]}]",
+              {5},
+              {1});
+    testQuery(
+        "['SELECT', {'WHERE': ['MATCH', 'sentence', 'search'],\
+                    ORDER_BY: [['DESC', ['rank()', 'sentence']]],\
+                        WHAT: [['.sentence']]}]",
+              {1, 2},
+              {3, 3});
+
+    // Compacting merges the FTS5 index into a single segment:
+    store->dataFile().maintenance(DataFile::kCompact);
+    testQuery(
+        "['SELECT', {'WHERE': ['MATCH', 'sentence', 'search'],\
+                    ORDER_BY: [['DESC', ['rank()', 'sentence']]],\
+                        WHAT: [['.sentence']]}]",
+              {1, 2},
+              {3, 3});
+}
+
+
+TEST_CASE_METHOD(FTSTest, "Query Full-Text FTS4 vs FTS5 benchmark", "[Query][FTS][Perf][.slow]") {
+    static constexpr int kNumDocs = 50000, kWordsPerDoc = 20, kNumUpdates = 5000, kNumQueries = 200;
+    static const char* const kWords[] = {
+        "apple", "banana", "cherry", "delta", "echo", "falcon", "garden", "harbor", "island",
+        "jungle", "kettle", "lemon", "marble", "nectar", "orange", "pepper", "quartz", "river",
+        "saddle", "timber", "umbrella", "velvet", "walnut", "xylophone", "yellow", "zephyr"};
+    static constexpr int kNumWords = sizeof(kWords) / sizeof(kWords[0]);
+    auto sentence = [](int seed) {
+        string s;
+        for (int w = 0; w < kWordsPerDoc; ++w) {
+            s += kWords[(seed * 7919 + w * 104729) % kNumWords];
+            s += ' ';
+        }
+        return s;
+    };
+
+    bool fts5 = false;
+    SECTION("FTS4") { }
+    SECTION("FTS5") {fts5 = true;}
+    const char *engine = fts5 ? "FTS5" : "FTS4";
+    {
+        Transaction t(store->dataFile());
+        for (int i = 0; i < kNumDocs; ++i)
+            createDoc(t, i, sentence(i));
+        t.commit();
+    }
+    IndexSpec::Options options {"en", true};
+    options.useFTS5 = fts5;
+    options.prefixLengths = "2";
+    {
+        Stopwatch st;
+        createIndex(options);
+        st.printReport(stringWithFormat("%s: Creating index", engine).c_str(), kNumDocs, "doc");
+    }
+    {
+        Stopwatch st;
+        Transaction t(store->dataFile());
+        for (int i = 0; i < kNumUpdates; ++i)
+            createDoc(t, (i * 31) % kNumDocs, sentence(i + kNumDocs));
+        t.commit();
+        st.printReport(stringWithFormat("%s: Updating indexed docs", engine).c_str(),
+                       kNumUpdates, "doc");
+    }
+    Retained<Query> query{ store->compileQuery(json5(
+                "['SELECT', {'WHERE': ['MATCH', 'sentence', ['$word']], WHAT: [['._id']]}]")) };
+    {
+        Stopwatch st;
+        for (int i = 0; i < kNumQueries; ++i) {
+            string prefix = string(kWords[i % kNumWords], 2) + "*";
+            Query::Options queryOptions(alloc_slice(json5("{word: '" + prefix + "'}")));
+            Retained<QueryEnumerator> e(query->createEnumerator(&queryOptions));
+            CHECK(e->getRowCount() > 0);
+        }
+        st.printReport(stringWithFormat("%s: Prefix queries", engine).c_str(),
+                       kNumQueries, "query");
+    }
+}
@@ -19,6 +19,10 @@
 #include "QueryParserTest.hh"
 #include "FleeceImpl.hh"
 #include "Error.hh"
+#include "SQLiteDataFile.hh"
+#include "SQLiteKeyStore.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+#include <map>
 #include <vector>
 #include <iostream>
 
@@ -223,7 +227,57 @@ TEST_CASE_METHOD(QueryParserTest, "QueryParser SELECT", "[Query]") {
 TEST_CASE_METHOD(QueryParserTest, "QueryParser SELECT FTS", "[Query][FTS]") {
     CHECK(parseWhere("['SELECT', {\
                      WHERE: ['MATCH', 'bio', 'mobile']}]")
-          == "SELECT _doc.rowid, offsets(fts1.\"kv_default::bio\"), key, sequence FROM kv_default AS _doc JOIN \"kv_default::bio\" AS fts1 ON fts1.docid = _doc.rowid WHERE (fts1.\"kv_default::bio\" MATCH 'mobile') AND (_doc.flags & 1 = 0)");
+          == "SELECT _doc.rowid, offsets(fts1.\"kv_default::bio\"), key, sequence FROM kv_default AS _doc JOIN \"kv_default::bio\" AS fts1 ON fts1.rowid = _doc.rowid WHERE (fts1.\"kv_default::bio\" MATCH 'mobile') AND (_doc.flags & 1 = 0)");
+}
+
+
+TEST_CASE_METHOD(DataFileTestFixture, "QueryParser SELECT FTS5", "[Query][FTS]") {
+    // Parse against a real FTS5 index, rather than the stub delegate, since the FTS5 table's
+    // schema and the functions registered for it are what differ from FTS4:
+    {
+        Transaction t(db);
+        writeDoc("a"_sl, DocumentFlags::kNone, t, [](fleece::impl::Encoder &enc) {
+            enc.writeKey("bio");
+            enc.writeString("Mobile developer");
+        });
+        writeDoc("b"_sl, DocumentFlags::kNone, t, [](fleece::impl::Encoder &enc) {
+            enc.writeKey("bio");
+            enc.writeString("Works on mobiles");
+        });
+        writeDoc("c"_sl, DocumentFlags::kNone, t, [](fleece::impl::Encoder &enc) {
+            enc.writeKey("bio");
+            enc.writeString("Gardener");
+        });
+        t.commit();
+    }
+    IndexSpec::Options options {"en", true};
+    options.useFTS5 = true;
+    options.prefixLengths = "2 3";
+    store->createIndex("bio", "[[\".bio\"]]", IndexSpec::kFullText, &options);
+
+    // The table uses FTS5, with the unicodesn tokenizer adapted to it, and prefix indexes:
+    auto &sqliteDB = dynamic_cast<SQLiteDataFile&>(*db);
+    string schema;
+    REQUIRE(sqliteDB.getSchema("kv_default::bio", "table", "kv_default::bio", schema));
+    CHECK(schema == "CREATE VIRTUAL TABLE \"kv_default::bio\" USING fts5(\"bio\", "
+                    "tokenize='unicodesn \"stopwords=en\" \"stemmer=en\"', prefix='2 3')");
+
+    // FTS5 tables have no docid column, so the FTS table is joined by rowid; offsets() and
+    // rank(matchinfo()) are the FTS5 versions registered by SQLiteFTS5Extensions.cc:
+    QueryParser qp(dynamic_cast<SQLiteKeyStore&>(*store));
+    alloc_slice fleece = fleece::impl::JSONConverter::convertJSON(json5(
+                            "['SELECT', {WHAT: [['._id']], WHERE: ['MATCH', 'bio', 'mob*'],\
+                                         ORDER_BY: [['DESC', ['rank()', 'bio']]]}]"));
+    qp.parse(fleece::impl::Value::fromTrustedData(fleece));
+    string sql = qp.SQL();
+    CHECK(sql == "SELECT _doc.rowid, offsets(fts1.\"kv_default::bio\"), fl_result(_doc.key) FROM kv_default AS _doc JOIN \"kv_default::bio\" AS fts1 ON fts1.rowid = _doc.rowid WHERE (fts1.\"kv_default::bio\" MATCH 'mob*') AND (_doc.flags & 1 = 0) ORDER BY rank(matchinfo(fts1.\"kv_default::bio\")) DESC");
+
+    // ...and they work: the offsets locate the matched prefix in each doc's text:
+    SQLite::Statement st(sqliteDB, sql);
+    map<string, string> offsets;
+    while (st.executeStep())
+        offsets[st.getColumn(2).getString()] = st.getColumn(1).getString();
+    CHECK(offsets == (map<string, string>{{"a", "0 0 0 6"}, {"b", "0 0 9 7"}}));
 }
 
 
@@ -18,8 +18,12 @@
 
 #include "QueryTest.hh"
 #include "SQLiteDataFile.hh"
+#include "SQLiteFleeceUtil.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
 #include <time.h>
 #include <float.h>
+#include <atomic>
+#include <thread>
 
 using namespace fleece::impl;
 
@@ -146,6 +150,101 @@ TEST_CASE_METHOD(QueryTest, "Partial Index with NOT MISSING", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Covering Index", "[Query]") {
+    addNumberedDocs(1, 100);
+
+    CHECK_THROWS_AS(store->createIndex("nums"_sl, R"({"WHAT":[[".num"]], "INCLUDE":[[".type"]],
+                                                      "WHERE":["=",[".type"],"number"]})"_sl),
+                    error);
+    CHECK(store->createIndex("nums"_sl, R"({"WHAT":[[".num"]], "INCLUDE":[[".type"]]})"_sl));
+    CHECK(!store->createIndex("nums"_sl, R"({"WHAT":[[".num"]], "INCLUDE":[[".type"]]})"_sl));
+
+    {
+        Transaction t(store->dataFile());
+        writeDoc("rec-200"_sl, DocumentFlags::kNone, t, [=](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeInt(200);
+            enc.writeKey("type");
+            enc.writeBool(true);
+        });
+        t.commit();
+    }
+
+    auto checkResults = [&](Query *query, int expectedRows) {
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        CHECK(e->getRowCount() == expectedRows);
+        for (int num = 95; num <= 100; ++num) {
+            REQUIRE(e->next());
+            CHECK(e->columns()[0]->asString() == slice(stringWithFormat("rec-%03d", num)));
+            CHECK(e->columns()[1]->asString() == "number"_sl);
+            CHECK(e->columns()[2]->asInt() == num);
+        }
+        if (expectedRows > 6) {
+            REQUIRE(e->next());
+            CHECK(e->columns()[1]->type() == kBoolean);
+            CHECK(e->columns()[1]->asBool() == true);
+        }
+    };
+
+    // A query that only uses covered properties reads the covering table, not the docs:
+    Retained<Query> query = store->compileQuery(json5(
+        "{'WHAT': [['._id'], ['.type'], ['.num']], 'WHERE': ['>=', ['.num'], 95], 'ORDER_BY': [['.num']]}"));
+    string explanation = query->explain();
+    Log("%s", explanation.c_str());
+    CHECK(explanation.find("kv_default:covering:nums") != string::npos);
+    CHECK(explanation.find("fl_value") == string::npos);
+    checkResults(query, 7);
+
+    // The triggers keep the table up to date:
+    deleteDoc("rec-200"_sl, false);
+    checkResults(query, 6);
+    undeleteDoc("rec-200"_sl);
+    checkResults(query, 7);
+    deleteDoc("rec-200"_sl, true);
+    checkResults(query, 6);
+
+    // A query that uses any other property reads the docs:
+    query = store->compileQuery(json5(
+        "{'WHAT': [['._id'], ['.type'], ['.num'], ['.str']], 'WHERE': ['>=', ['.num'], 95], 'ORDER_BY': [['.num']]}"));
+    CHECK(query->explain().find("covering") == string::npos);
+    checkResults(query, 6);
+
+    // Unsigned ints and data keep their Fleece types when read from the covering table:
+    {
+        Transaction t(store->dataFile());
+        writeDoc("rec-201"_sl, DocumentFlags::kNone, t, [=](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeInt(201);
+            enc.writeKey("type");
+            enc.writeUInt(UINT64_MAX);
+        });
+        writeDoc("rec-202"_sl, DocumentFlags::kNone, t, [=](Encoder &enc) {
+            enc.writeKey("num");
+            enc.writeInt(202);
+            enc.writeKey("type");
+            enc.writeData("\x01\x02\xff blob"_sl);
+        });
+        t.commit();
+    }
+    query = store->compileQuery(json5("{'WHAT': [['.type']], 'WHERE': ['>=', ['.num'], 201], "
+                                      "'ORDER_BY': [['.num']]}"));
+    CHECK(query->explain().find("kv_default:covering:nums") != string::npos);
+    {
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        REQUIRE(e->next());
+        CHECK(e->columns()[0]->isUnsigned());
+        CHECK(e->columns()[0]->asUnsigned() == UINT64_MAX);
+        REQUIRE(e->next());
+        CHECK(e->columns()[0]->type() == kData);
+        CHECK(e->columns()[0]->asData() == "\x01\x02\xff blob"_sl);
+        CHECK(!e->next());
+    }
+
+    store->deleteIndex("nums"_sl);
+    CHECK(!((SQLiteDataFile&)store->dataFile()).tableExists("kv_default:covering:nums"));
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query SELECT", "[Query]") {
     addNumberedDocs();
     // Use a (SQL) query based on the Fleece "num" property:
@@ -182,6 +281,51 @@ TEST_CASE_METHOD(QueryTest, "Query SELECT", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Query wide projection benchmark", "[Query][Perf][.slow]") {
+    static constexpr int kNumDocs = 50000, kNumProps = 10;
+    {
+        Transaction t(db);
+        for (int i = 0; i < kNumDocs; i++) {
+            writeDoc(slice(stringWithFormat("doc-%05d", i)), DocumentFlags::kNone, t,
+                     [=](Encoder &enc) {
+                for (int p = 0; p < kNumProps; p++) {
+                    enc.writeKey(slice(stringWithFormat("prop%d", p)));
+                    enc.writeInt(i * p);
+                }
+            });
+        }
+        t.commit();
+    }
+    stringstream what;
+    for (int p = 0; p < kNumProps; p++)
+        what << (p ? ", " : "") << "'.prop" << p << "'";
+    Retained<Query> query = store->compileQuery(json5("{WHAT: [" + what.str() + "]}"));
+
+    QueryFleeceCache &cache = ((SQLiteDataFile*)db.get())->queryFleeceCache();
+    for (bool useCache : {false, true}) {
+        cache.enabled = useCache;
+        cache.hits = cache.misses = 0;
+        Stopwatch st;
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        REQUIRE(e->getRowCount() == kNumDocs);
+        st.printReport(useCache ? "Wide query, cached bodies" : "Wide query, uncached bodies",
+                       kNumDocs, "row");
+        while (e->next()) {
+            auto cols = e->columns();
+            int64_t i = cols[1]->asInt();
+            CHECK(cols[kNumProps - 1]->asInt() == i * (kNumProps - 1));
+        }
+        if (useCache) {
+            CHECK(cache.misses <= kNumDocs);
+            CHECK(cache.hits + cache.misses == kNumDocs * kNumProps);
+        } else {
+            CHECK(cache.hits + cache.misses == 0);
+        }
+    }
+    cache.enabled = true;
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query SELECT WHAT", "[Query][N1QL]") {
     addNumberedDocs();
     Retained<Query> query;
@@ -322,6 +466,388 @@ TEST_CASE_METHOD(QueryTest, "Query refresh", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Query streaming", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+                     "{WHAT: ['.num', ['*', ['.num'], ['.num']]], WHERE: ['>', ['.num'], 10], ORDER_BY: ['.num']}")) };
+    Query::Options options = Query::Options().withStreaming(true);
+    Retained<QueryEnumerator> e(query->createEnumerator(&options));
+    CHECK(e->getRowCount() == -1);
+    CHECK_THROWS_AS(e->seek(0), error);
+
+    // A recording enumerator can run while the streaming one is still active:
+    Retained<QueryEnumerator> recorded(query->createEnumerator());
+    CHECK(recorded->getRowCount() == 90);
+
+    int num = 11;
+    while (e->next()) {
+        auto cols = e->columns();
+        REQUIRE(cols.count() == 2);
+        CHECK(cols[0]->asInt() == num);
+        CHECK(cols[1]->asInt() == num * num);
+        CHECK(e->missingColumns() == 0);
+        ++num;
+    }
+    CHECK(num == 101);
+    CHECK(!e->next());
+
+    CHECK(e->refresh(query) == nullptr);
+    {
+        Transaction t(db);
+        writeNumberedDoc(101, nullslice, t);
+        t.commit();
+    }
+    Retained<QueryEnumerator> e2(e->refresh(query));
+    REQUIRE(e2 != nullptr);
+    CHECK(e2->options().streaming);
+    num = 11;
+    while (e2->next())
+        ++num;
+    CHECK(num == 102);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query streaming idle snapshot", "[Query]") {
+    addNumberedDocs(1, 100);
+    auto savedMaxAge = QueryEnumerator::gMaxStreamingSnapshotAge;
+    QueryEnumerator::gMaxStreamingSnapshotAge = 0.25;
+
+    // Returns true if a checkpoint could copy the whole WAL into the database:
+    auto checkpointCompletes = [&] {
+        SQLite::Database &sqlDb = (SQLiteDataFile&)store->dataFile();
+        int walFrames = -1, checkpointed = -1;
+        REQUIRE(sqlite3_wal_checkpoint_v2(sqlDb.getHandle(), nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                          &walFrames, &checkpointed) == SQLITE_OK);
+        return checkpointed == walFrames;
+    };
+
+    Retained<Query> query = store->compileQuery(json5(
+        "{WHAT: ['.num'], WHERE: ['>', ['.num'], 10], ORDER_BY: [['.num']]}"));
+    Query::Options options = Query::Options().withStreaming(true);
+    Retained<QueryEnumerator> e(query->createEnumerator(&options));
+    REQUIRE(e->next());
+    CHECK(e->columns()[0]->asInt() == 11);
+
+    // While the enumerator's snapshot is open, later commits can't be checkpointed:
+    {
+        Transaction t(db);
+        writeNumberedDoc(101, nullslice, t);
+        t.commit();
+    }
+    CHECK(!checkpointCompletes());
+
+    // Left idle, the enumerator gives up its snapshot on its own...
+    this_thread::sleep_for(chrono::milliseconds(750));
+    CHECK(checkpointCompletes());
+
+    // ...but still returns the rest of its original results:
+    int num = 12;
+    while (e->next())
+        CHECK(e->columns()[0]->asInt() == num++);
+    CHECK(num == 101);
+
+    QueryEnumerator::gMaxStreamingSnapshotAge = savedMaxAge;
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query parallel scan", "[Query]") {
+    // Enough docs that a query is split into several ranges:
+    {
+        Transaction t(store->dataFile());
+        for (int i = 1; i <= 5000; i++) {
+            string str = numberString(i % 10);
+            writeNumberedDoc(i, slice(str), t);
+        }
+        t.commit();
+    }
+
+    auto run = [&](const char *json, unsigned parallelism, slice bindings =nullslice) {
+        Retained<Query> query{ store->compileQuery(json5(json)) };
+        Query::Options options(alloc_slice(bindings), 0, 0, false, parallelism);
+        Retained<QueryEnumerator> e(query->createEnumerator(&options));
+        vector<string> rows;
+        while (e->next()) {
+            string row;
+            for (Array::iterator i = e->columns(); i; ++i)
+                row += i.value()->toJSONString() + " ";
+            rows.push_back(row);
+        }
+        return rows;
+    };
+
+    size_t expectedConnections = 4;
+    SECTION("Scan") {
+        const char *json = "{WHAT: ['._id', '.num'], WHERE: ['>', ['.num'], 100]}";
+        auto serial = run(json, 0), parallel = run(json, 4);
+        CHECK(serial.size() == 4900);
+        sort(serial.begin(), serial.end());
+        sort(parallel.begin(), parallel.end());
+        CHECK(parallel == serial);
+    }
+    SECTION("Group by") {
+        const char *json = "{WHAT: [['.str'], ['count()', ['.num']], ['sum()', ['.num']],"
+                                  " ['avg()', ['.num']], ['min()', ['.num']], ['max()', ['.num']]],"
+                           " GROUP_BY: [['.str']], ORDER_BY: [['DESC', ['.str']]]}";
+        auto serial = run(json, 0);
+        CHECK(serial.size() == 10);
+        CHECK(run(json, 4) == serial);
+    }
+    SECTION("Aggregate without grouping") {
+        const char *json = "{WHAT: [['count()', ['.num']], ['avg()', ['.num']], ['max()', ['.str']]],"
+                           " WHERE: ['<', ['.num'], 4000]}";
+        auto serial = run(json, 0);
+        CHECK(serial.size() == 1);
+        CHECK(run(json, 4) == serial);
+    }
+    SECTION("Order by and limit") {
+        const char *json = "{WHAT: ['.num', ['AS', ['.str'], 'name']],"
+                           " ORDER_BY: [['.name'], ['DESC', ['.num']]], LIMIT: 10, OFFSET: 5}";
+        auto serial = run(json, 0);
+        CHECK(serial.size() == 10);
+        CHECK(run(json, 4) == serial);
+    }
+    SECTION("Parameters") {
+        const char *json = "{WHAT: ['.num'], WHERE: ['<', ['.num'], ['$max']],"
+                           " ORDER_BY: [['.num']], LIMIT: ['$limit']}";
+        auto bindings = "{\"max\": 3000, \"limit\": 20}"_sl;
+        auto serial = run(json, 0, bindings);
+        CHECK(serial.size() == 20);
+        CHECK(run(json, 4, bindings) == serial);
+    }
+    SECTION("Not partitionable") {
+        const char *json = "{WHAT: ['.str'], DISTINCT: true, ORDER_BY: [['.str']]}";
+        auto serial = run(json, 0);
+        CHECK(serial.size() == 10);
+        CHECK(run(json, 4) == serial);
+        expectedConnections = 0;
+    }
+
+    CHECK(dynamic_cast<SQLiteDataFile&>(store->dataFile()).scanConnectionCount() == expectedConnections);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query top-K", "[Query]") {
+    addNumberedDocs(1, 200);
+    auto check = [&](const char *expectedStrategy) {
+        Retained<Query> query{ store->compileQuery(json5(
+            "{WHAT: [['.num']], WHERE: ['>', ['.num'], 10], ORDER_BY: [['DESC', ['.num']]], LIMIT: 5}")) };
+        string explanation = query->explain();
+        Log("%s", explanation.c_str());
+        CHECK(explanation.find(expectedStrategy) != string::npos);
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        CHECK(e->getRowCount() == 5);
+        for (int i = 200; e->next(); --i)
+            CHECK(e->columns()[0]->asInt() == i);
+    };
+
+    check("Top-K strategy: bounded sort");
+    store->createIndex("nums"_sl, "[[\".num\"]]"_sl);
+    check("Top-K strategy: order of index 'nums'");
+
+    // A query without a LIMIT isn't top-K:
+    Retained<Query> query{ store->compileQuery(json5(
+        "{WHAT: [['.num']], ORDER_BY: [['DESC', ['.num']]]}")) };
+    CHECK(query->explain().find("Top-K") == string::npos);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query keyset pagination", "[Query]") {
+    addNumberedDocs(1, 100);
+    Retained<Query> query;
+    vector<int64_t> expected;
+    SECTION("Unique sort key") {
+        query = store->compileQuery(json5(
+            "{WHAT: [['.num']], WHERE: ['>', ['.num'], 10], ORDER_BY: [['DESC', ['.num']]], LIMIT: 7}"));
+        for (int64_t i = 100; i > 10; --i)
+            expected.push_back(i);
+    }
+    SECTION("Duplicate sort keys") {
+        // Many rows have the same key, so pages have to continue from the right doc ID:
+        query = store->compileQuery(json5(
+            "{WHAT: [['.num']], ORDER_BY: [['DESC', ['%', ['.num'], 4]]], LIMIT: 7}"));
+        for (int64_t mod = 3; mod >= 0; --mod)
+            for (int64_t i = 1; i <= 100; ++i)
+                if (i % 4 == mod)
+                    expected.push_back(i);
+    }
+
+    vector<int64_t> results;
+    alloc_slice token;
+    int pages = 0;
+    do {
+        // The first page has no token, but withContinuation() still turns on paging:
+        Query::Options options = Query::Options().withContinuation(token);
+        Retained<QueryEnumerator> e(query->createEnumerator(&options));
+        CHECK(e->getRowCount() <= 7);
+        while (e->next()) {
+            CHECK(e->columns().count() == 1);       // sort keys aren't visible
+            results.push_back(e->columns()[0]->asInt());
+        }
+        token = e->continuationToken();
+        REQUIRE(++pages <= 20);
+    } while (token);
+    CHECK(results == expected);
+
+    // A token from a different query is rejected:
+    Retained<Query> other{ store->compileQuery(json5(
+        "{WHAT: [['.num']], ORDER_BY: [['.num']], LIMIT: 7}")) };
+    Query::Options options = Query::Options().withContinuation(nullslice);
+    Retained<QueryEnumerator> e(other->createEnumerator(&options));
+    token = e->continuationToken();
+    REQUIRE(token);
+    Query::Options badOptions = Query::Options().withContinuation(token);
+    ExpectException(error::Domain::LiteCore, error::LiteCoreError::InvalidParameter, [&]{
+        Retained<QueryEnumerator> e2(query->createEnumerator(&badOptions));
+    });
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query doc ID filter", "[Query]") {
+    addNumberedDocs();
+    vector<alloc_slice> docIDs;
+    for (auto docID : {"rec-005", "rec-095", "rec-099", "nonexistent"})
+        docIDs.emplace_back(slice(docID));
+
+    auto matchingDocIDs = [&](slice filterJSON) {
+        Retained<Query> filter{ store->compileQuery(filterJSON) };
+        Retained<QueryEnumerator> e(filter->createEnumerator());
+        vector<string> result;
+        while (e->next())
+            result.push_back(e->columns()[0]->asString().asString());
+        sort(result.begin(), result.end());
+        return result;
+    };
+
+    Retained<Query> query;
+    SECTION("JSON") {
+        query = store->compileQuery(json5(
+                    "{WHAT: ['.num'], WHERE: ['>', ['.num'], 90], ORDER_BY: [['.num']], LIMIT: 3}"));
+    }
+    SECTION("JSON with FROM alias") {
+        query = store->compileQuery(json5(
+                    "{WHAT: ['.d.num'], FROM: [{AS: 'd'}], WHERE: ['>', ['.d.num'], 90]}"));
+    }
+    SECTION("N1QL") {
+        query = store->compileQuery("SELECT num WHERE num > 90 ORDER BY num LIMIT 3"_sl,
+                                    QueryLanguage::kN1QL);
+    }
+
+    // The filter ignores ORDER_BY and LIMIT, and only returns the docs that match WHERE:
+    alloc_slice filterJSON = query->docIDFilterExpression(&docIDs);
+    REQUIRE(filterJSON);
+    CHECK(matchingDocIDs(filterJSON) == (vector<string>{"rec-095", "rec-099"}));
+
+    filterJSON = query->docIDFilterExpression(nullptr);
+    REQUIRE(filterJSON);
+    CHECK(matchingDocIDs(filterJSON).size() == 10);
+
+    // Queries whose results can't be checked one doc at a time:
+    CHECK(!store->compileQuery(json5(
+                "{WHAT: ['.num']}"))->docIDFilterExpression(&docIDs));
+    CHECK(!store->compileQuery(json5(
+                "{WHAT: [['AS', ['.num'], 'n']], WHERE: ['>', ['.n'], 90]}"))->docIDFilterExpression(&docIDs));
+    CHECK(!store->compileQuery(json5(
+                "{WHAT: [['.a.num']], FROM: [{AS: 'a'}, {AS: 'b', ON: ['=', ['.a.num'], ['.b.num']]}],"
+                " WHERE: ['>', ['.a.num'], 90]}"))->docIDFilterExpression(&docIDs));
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query cache", "[Query]") {
+    auto &sqlite = (SQLiteDataFile&)store->dataFile();
+    auto stats0 = sqlite.queryCacheStats();
+
+    // Expressions that differ only in formatting share a compiled query:
+    Retained<Query> q1 = store->compileQuery(json5("{WHAT: ['.num'], WHERE: ['>', ['.num'], 5]}"));
+    Retained<Query> q2 = store->compileQuery("{\"WHERE\":[\">\",[\".num\"],5],  \"WHAT\":[\".num\"]}"_sl);
+    CHECK(q1 == q2);
+    Retained<Query> n1 = store->compileQuery("SELECT num WHERE num > 5"_sl, QueryLanguage::kN1QL);
+    Retained<Query> n2 = store->compileQuery("SELECT  num\n WHERE num >  5 "_sl, QueryLanguage::kN1QL);
+    CHECK(n1 == n2);
+    CHECK(n1 != q1);
+
+    auto stats = sqlite.queryCacheStats();
+    CHECK(stats.hits == stats0.hits + 2);
+    CHECK(stats.misses == stats0.misses + 2);
+    CHECK(stats.count == 2);
+
+    // Uncacheable compilation always creates a new query:
+    Retained<Query> q3 = store->compileQuery(json5("{WHAT: ['.num'], WHERE: ['>', ['.num'], 5]}"),
+                                             QueryLanguage::kJSON, false);
+    CHECK(q3 != q1);
+    CHECK(sqlite.queryCacheStats().hits == stats.hits);
+
+    // Changing the schema invalidates the cache:
+    store->createIndex("num"_sl, "[[\".num\"]]"_sl);
+    Retained<Query> q4 = store->compileQuery(json5("{WHAT: ['.num'], WHERE: ['>', ['.num'], 5]}"));
+    CHECK(q4 != q1);
+    stats = sqlite.queryCacheStats();
+    CHECK(stats.misses == stats0.misses + 3);
+    CHECK(stats.count == 1);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query cache shared by threads", "[Query]") {
+    addNumberedDocs(1, 100);
+    // Each thread compiles its own handle, but the cache gives them the same Query object:
+    const char *queryJSON = "{WHAT: ['.num'], WHERE: ['>', ['.num'], 50], ORDER_BY: [['.num']]}";
+    Retained<Query> handles[2];
+    for (auto &handle : handles)
+        handle = store->compileQuery(json5(queryJSON));
+    REQUIRE(handles[0] == handles[1]);
+
+    atomic<int> failures {0};
+    vector<thread> threads;
+    for (auto &handle : handles) {
+        threads.emplace_back([&failures, query = handle] {
+            for (int i = 0; i < 50; ++i) {
+                Retained<QueryEnumerator> e(query->createEnumerator());
+                int64_t expected = 51;
+                while (e->next()) {
+                    if (e->columns()[0]->asInt() != expected++)
+                        ++failures;
+                }
+                if (expected != 101)
+                    ++failures;
+                query->explain();
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    CHECK(failures == 0);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Statement cache", "[Query]") {
+    auto &sqlite = (SQLiteDataFile&)store->dataFile();
+    auto stats0 = sqlite.statementCacheStats();
+
+    // Repeated internal lookups reuse the same compiled statement:
+    for (int i = 0; i < 10; ++i)
+        CHECK(!sqlite.tableExists("nonexistent"));
+    auto stats = sqlite.statementCacheStats();
+    CHECK(stats.misses <= stats0.misses + 1);
+    CHECK(stats.hits >= stats0.hits + 9);
+    CHECK(stats.count >= 1);
+    CHECK(stats.count <= SQLiteDataFile::kStatementCacheCapacity);
+
+    // A statement that's still in use isn't handed out again:
+    string sql = "SELECT count(*) FROM sqlite_master";
+    auto s1 = sqlite.cachedStatement(sql);
+    auto s2 = sqlite.cachedStatement(sql);
+    CHECK(s1 != s2);
+    SQLite::Statement *cached = s1.get();
+    s1 = s2 = nullptr;
+    CHECK(sqlite.cachedStatement(sql).get() == cached);
+
+    // Index bookkeeping uses the cache, and still sees schema changes:
+    store->createIndex("num"_sl, "[[\".num\"]]"_sl);
+    CHECK(store->getIndexes().size() == 1);
+    store->deleteIndex("num"_sl);
+    CHECK(store->getIndexes().size() == 0);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query boolean", "[Query]") {
     {
         Transaction t(store->dataFile());
@@ -1355,6 +1881,128 @@ TEST_CASE_METHOD(ArrayQueryTest, "Query UNNEST expression", "[Query]") {
     checkQuery(22, 2);
 }
 
+
+class ArrayUpdateQueryTest : public QueryTest {
+protected:
+    // Writes a doc {"items": [...]}; if `replacing` is given, updates it in place.
+    sequence_t writeItemsDoc(slice docID, const vector<int> &items, Transaction &t,
+                             sequence_t replacing =0, DocumentFlags flags =DocumentFlags::kNone)
+    {
+        Encoder enc;
+        enc.beginDictionary();
+        enc.writeKey("items");
+        enc.beginArray();
+        for (int item : items)
+            enc.writeInt(item);
+        enc.endArray();
+        enc.endDictionary();
+        return store->set(docID, nullslice, enc.finish(), flags, t,
+                          (replacing ? &replacing : nullptr));
+    }
+
+    int64_t itemsAtLeast(int min) {
+        return rowsInQuery(json5(CONCAT("{WHAT: [['.item']], "
+                                        "FROM: [{AS: 'doc'}, {AS: 'item', UNNEST: ['.doc.items']}], "
+                                        "WHERE: ['>=', ['.item'], " << min << "]}")));
+    }
+
+    // Number of rows in the array index's UNNEST table, including any belonging to deleted docs
+    int64_t indexRowCount() {
+        alloc_slice result = store->dataFile().rawQuery(
+                                        "SELECT count(*) FROM \"kv_default:unnest:items\"");
+        return Value::fromTrustedData(result)->asArray()->get(0)->asArray()->get(0)->asInt();
+    }
+};
+
+
+TEST_CASE_METHOD(ArrayUpdateQueryTest, "Array index incremental update", "[Query]") {
+    store->createIndex("items"_sl, "[[\".items\"]]"_sl, IndexSpec::kArray);
+    sequence_t seq;
+    {
+        Transaction t(store->dataFile());
+        seq = writeItemsDoc("doc"_sl, {1, 2, 3, 4}, t);
+        t.commit();
+    }
+    CHECK(indexRowCount() == 4);
+
+    auto update = [&](const vector<int> &items, DocumentFlags flags =DocumentFlags::kNone) {
+        Transaction t(store->dataFile());
+        seq = writeItemsDoc("doc"_sl, items, t, seq, flags);
+        REQUIRE(seq > 0);
+        t.commit();
+    };
+
+    update({1, 20, 3, 4});              // change an item
+    CHECK(indexRowCount() == 4);
+    CHECK(itemsAtLeast(20) == 1);
+    update({1, 20, 3, 4, 50, 60});      // append items
+    CHECK(indexRowCount() == 6);
+    CHECK(itemsAtLeast(20) == 3);
+    update({1, 20});                    // truncate
+    CHECK(indexRowCount() == 2);
+    CHECK(itemsAtLeast(20) == 1);
+    update({});
+    CHECK(indexRowCount() == 0);
+    update({1, 2, 3});
+    CHECK(indexRowCount() == 3);
+
+    update({7, 8}, DocumentFlags::kDeleted);
+    CHECK(indexRowCount() == 0);
+    update({7, 8, 9});                  // undelete
+    CHECK(indexRowCount() == 3);
+    CHECK(itemsAtLeast(7) == 3);
+}
+
+
+TEST_CASE_METHOD(ArrayUpdateQueryTest, "Query array index update benchmark", "[Query][Perf][.slow]") {
+    static constexpr int kNumDocs = 2000, kNumItems = 300, kNumRounds = 5;
+    vector<sequence_t> sequences(kNumDocs);
+    vector<int> items(kNumItems);
+    for (int i = 0; i < kNumItems; i++)
+        items[i] = i;
+    {
+        Transaction t(store->dataFile());
+        for (int d = 0; d < kNumDocs; d++)
+            sequences[d] = writeItemsDoc(slice(stringWithFormat("doc-%05d", d)), items, t);
+        t.commit();
+    }
+    {
+        Stopwatch st;
+        store->createIndex("items"_sl, "[[\".items\"]]"_sl, IndexSpec::kArray);
+        st.printReport("Creating array index", kNumDocs * kNumItems, "item");
+    }
+
+    // Each round changes one item of every doc:
+    for (int round = 1; round <= kNumRounds; round++) {
+        Stopwatch st;
+        Transaction t(store->dataFile());
+        for (int d = 0; d < kNumDocs; d++) {
+            vector<int> newItems = items;
+            newItems[d % kNumItems] = 1000 * round + d % kNumItems;
+            sequences[d] = writeItemsDoc(slice(stringWithFormat("doc-%05d", d)), newItems, t,
+                                         sequences[d]);
+        }
+        t.commit();
+        st.printReport("Updating one item per doc", kNumDocs, "doc");
+        CHECK(itemsAtLeast(1000) == kNumDocs);
+    }
+
+    // Appending an item to every doc:
+    {
+        Stopwatch st;
+        Transaction t(store->dataFile());
+        vector<int> newItems = items;
+        newItems.push_back(999);
+        for (int d = 0; d < kNumDocs; d++)
+            sequences[d] = writeItemsDoc(slice(stringWithFormat("doc-%05d", d)), newItems, t,
+                                         sequences[d]);
+        t.commit();
+        st.printReport("Appending one item per doc", kNumDocs, "doc");
+        CHECK(itemsAtLeast(999) == kNumDocs);
+    }
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query nested ANY of dict", "[Query]") {        // CBL-1248
     Transaction t(store->dataFile());
 
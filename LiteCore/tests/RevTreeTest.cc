@@ -17,6 +17,9 @@
 //
 
 #include "RevTree.hh"
+#include "RawRevTree.hh"
+#include "Benchmark.hh"
+#include "StringUtil.hh"
 
 #include "LiteCoreTest.hh"
 
@@ -50,3 +53,147 @@ TEST_CASE("RevID Parsing") {
     CHECK(!r.tryParse("1-aa "_sl));
     CHECK(!r.tryParse(" 1-aa"_sl));
 }
+
+
+static revidBuffer makeRevID(unsigned generation, unsigned branch =0) {
+    return revidBuffer(slice(format("%u-%08x%04x", generation, generation * 2654435761u, branch)));
+}
+
+
+// Builds a tree `depth` generations deep, with a conflicting branch off the middle, and encodes
+// it in two parts the way TreeDocument saves it.
+static void makeTree(unsigned depth, alloc_slice &body, alloc_slice &extra) {
+    RevTree tree;
+    alloc_slice revBody("{\"foo\":true}"_sl);
+    int httpStatus;
+    const Rev *rev = nullptr, *middle = nullptr;
+    for (unsigned gen = 1; gen <= depth; ++gen) {
+        rev = tree.insert(makeRevID(gen), revBody, Rev::kNoFlags, rev, false, false, httpStatus);
+        REQUIRE(rev);
+        if (gen == depth / 2)
+            middle = rev;
+    }
+    REQUIRE(tree.insert(makeRevID(depth / 2 + 1, 1), revBody, Rev::kNoFlags, middle,
+                        true, true, httpStatus));
+    tree.setLatestRevisionOnRemote(RevTree::kDefaultRemoteID, tree[makeRevID(depth - 2)]);
+    tree.removeNonLeafBodies();
+    body = tree.encode(extra);
+}
+
+
+// The equivalent of RawRevision::findAncestors, using a decoded RevTree:
+static void findAncestorsInTree(slice body, slice extra, revid revID, unsigned maxAncestors,
+                                bool mustHaveBodies, RevTree::RemoteID remote,
+                                RevAncestry &result)
+{
+    RevTree tree(body, extra, 0);
+    result = {};
+    if (auto rev = tree[revID]; rev) {
+        result.exists = true;
+        if (remote) {
+            auto remoteRev = tree.latestRevisionOnRemote(remote);
+            result.remoteHasOther = (remoteRev && remoteRev != rev);
+        }
+        return;
+    }
+    for (auto rev : tree.allRevisions()) {
+        if (rev->revID.generation() < revID.generation()
+                    && !(mustHaveBodies && !rev->isBodyAvailable())) {
+            // (The RevTree points into `body` and `extra` too, so these revids stay valid.)
+            result.ancestors.push_back(rev->revID);
+            if (result.ancestors.size() >= maxAncestors)
+                break;
+        }
+    }
+}
+
+
+TEST_CASE("RevTree findAncestors") {
+    alloc_slice body, extra;
+    makeTree(20, body, extra);
+    RevAncestry ancestry, expected;
+
+    auto check = [&](revid revID, unsigned maxAncestors, bool mustHaveBodies,
+                     RevTree::RemoteID remote) {
+        RawRevision::findAncestors(body, extra, revID, maxAncestors, mustHaveBodies, remote,
+                                   ancestry);
+        findAncestorsInTree(body, extra, revID, maxAncestors, mustHaveBodies, remote, expected);
+        CHECK(ancestry.exists == expected.exists);
+        CHECK(ancestry.remoteHasOther == expected.remoteHasOther);
+        CHECK(ancestry.ancestors == expected.ancestors);
+    };
+
+    // Revs that exist, and whether they're current on the remote:
+    for (unsigned gen : {1, 10, 18, 20}) {
+        RawRevision::findAncestors(body, extra, makeRevID(gen), 10, false,
+                                   RevTree::kNoRemoteID, ancestry);
+        CHECK(ancestry.exists);
+        CHECK(!ancestry.remoteHasOther);
+        CHECK(ancestry.ancestors.empty());
+        check(makeRevID(gen), 10, false, RevTree::kDefaultRemoteID);
+    }
+    RawRevision::findAncestors(body, extra, makeRevID(18), 10, false,
+                               RevTree::kDefaultRemoteID, ancestry);
+    CHECK(!ancestry.remoteHasOther);
+    RawRevision::findAncestors(body, extra, makeRevID(20), 10, false,
+                               RevTree::kDefaultRemoteID, ancestry);
+    CHECK(ancestry.remoteHasOther);
+    check(makeRevID(11, 1), 10, false, RevTree::kDefaultRemoteID);
+
+    // Revs that don't exist:
+    RawRevision::findAncestors(body, extra, makeRevID(21), 5, false, RevTree::kNoRemoteID,
+                               ancestry);
+    CHECK(!ancestry.exists);
+    CHECK(ancestry.ancestors.size() == 5);
+    for (unsigned gen : {1, 5, 12, 21, 30}) {
+        for (unsigned maxAncestors : {1, 5, 100}) {
+            for (bool bodies : {false, true}) {
+                check(makeRevID(gen, 2), maxAncestors, bodies, RevTree::kNoRemoteID);
+                check(makeRevID(gen, 2), maxAncestors, bodies, RevTree::kDefaultRemoteID);
+            }
+        }
+    }
+    RawRevision::findAncestors(body, extra, makeRevID(30), 100, true, RevTree::kNoRemoteID,
+                               ancestry);
+    CHECK(ancestry.ancestors.size() == 2);      // only the leaves have bodies
+
+    // A tree encoded in one piece:
+    RevTree tree(body, extra, 0);
+    alloc_slice whole = tree.encode();
+    RawRevision::findAncestors(whole, nullslice, makeRevID(30), 100, true,
+                               RevTree::kNoRemoteID, ancestry);
+    CHECK(ancestry.ancestors.size() == 2);
+    RawRevision::findAncestors(whole, nullslice, makeRevID(20), 100, false,
+                               RevTree::kDefaultRemoteID, ancestry);
+    CHECK(ancestry.exists);
+    CHECK(ancestry.remoteHasOther);
+}
+
+
+TEST_CASE("RevTree findAncestors benchmark", "[Perf][.slow]") {
+    static constexpr unsigned kDepth = 100, kRepeat = 200000;
+    alloc_slice body, extra;
+    makeTree(kDepth, body, extra);
+    revidBuffer missing = makeRevID(kDepth + 1), existing = makeRevID(kDepth / 2);
+    RevAncestry ancestry;
+    size_t total = 0;
+    {
+        Stopwatch st;
+        for (unsigned i = 0; i < kRepeat; ++i) {
+            findAncestorsInTree(body, extra, (i % 2) ? missing : existing, 20, true,
+                                RevTree::kDefaultRemoteID, ancestry);
+            total += ancestry.ancestors.size();
+        }
+        st.printReport("findAncestors with RevTree", kRepeat, "doc");
+    }
+    {
+        Stopwatch st;
+        for (unsigned i = 0; i < kRepeat; ++i) {
+            RawRevision::findAncestors(body, extra, (i % 2) ? missing : existing, 20, true,
+                                       RevTree::kDefaultRemoteID, ancestry);
+            total -= ancestry.ancestors.size();
+        }
+        st.printReport("findAncestors with RawRevision", kRepeat, "doc");
+    }
+    CHECK(total == 0);
+}
@@ -155,8 +155,66 @@ namespace litecore { namespace REST {
         int64_t limit = rq.intQuery("limit", INT64_MAX);
         // TODO: Implement startkey, endkey, etc.
 
-        // Create enumerator:
         C4Error err;
+        string keysJSON = rq.query("keys");
+        if (!keysJSON.empty()) {
+            // Look up only the docIDs in the `keys` array, in that order:
+            FLError flErr;
+            Doc keysDoc = Doc::fromJSON(slice(keysJSON), &flErr);
+            Array keys = keysDoc ? keysDoc.asArray() : Array();
+            if (!keys)
+                return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid 'keys' parameter");
+            vector<C4String> docIDs;
+            for (Array::iterator i(keys); i; ++i) {
+                if (!i->asString())
+                    return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid 'keys' parameter");
+                docIDs.push_back(i->asString());
+            }
+            vector<C4Document*> rawDocs(docIDs.size());
+            if (!c4db_getDocuments(db, docIDs.data(), docIDs.size(), true, rawDocs.data(), &err))
+                return rq.respondWithError(err);
+            vector<c4::ref<C4Document>> docs(rawDocs.begin(), rawDocs.end());
+
+            auto &json = rq.jsonEncoder();
+            json.beginDict();
+            json.writeKey("rows"_sl);
+            json.beginArray();
+            for (size_t i = 0; i < docs.size(); ++i) {
+                json.beginDict();
+                json.writeKey("key"_sl);
+                json.writeString(docIDs[i]);
+                C4Document *doc = docs[i];
+                if (!doc) {
+                    json.writeKey("error"_sl);
+                    json.writeString("not_found"_sl);
+                } else {
+                    json.writeKey("id"_sl);
+                    json.writeString(docIDs[i]);
+                    json.writeKey("value"_sl);
+                    json.beginDict();
+                    json.writeKey("rev"_sl);
+                    json.writeString(doc->revID);
+                    if (doc->flags & kDocDeleted) {
+                        json.writeKey("deleted"_sl);
+                        json.writeBool(true);
+                    }
+                    json.endDict();
+                    if (includeDocs && !(doc->flags & kDocDeleted)) {
+                        alloc_slice docBody = c4doc_bodyAsJSON(doc, false, &err);
+                        if (!docBody)
+                            return rq.respondWithError(err);
+                        json.writeKey("doc"_sl);
+                        json.writeRaw(docBody);
+                    }
+                }
+                json.endDict();
+            }
+            json.endArray();
+            json.endDict();
+            return;
+        }
+
+        // Create enumerator:
         c4::ref<C4DocEnumerator> e = c4db_enumerateAllDocs(db, &options, &err);
         if (!e)
             return rq.respondWithError(err);
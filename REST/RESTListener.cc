@@ -87,11 +87,11 @@ namespace litecore { namespace REST {
             addDBHandler(Method::POST,  "/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleModifyDoc);
 
             // Database-level special handlers:
-            addDBHandler(Method::GET,   "/[^_][^/]*/_all_docs",  &RESTListener::handleGetAllDocs);
+            addDBReaderHandler(Method::GET, "/[^_][^/]*/_all_docs", &RESTListener::handleGetAllDocs);
             addDBHandler(Method::POST,  "/[^_][^/]*/_bulk_docs", &RESTListener::handleBulkDocs);
 
             // Document:
-            addDBHandler(Method::GET,   "/[^_][^/]*/[^_].*",      &RESTListener::handleGetDoc);
+            addDBReaderHandler(Method::GET, "/[^_][^/]*/[^_].*",    &RESTListener::handleGetDoc);
             addDBHandler(Method::PUT,   "/[^_][^/]*/[^_].*",      &RESTListener::handleModifyDoc);
             addDBHandler(Method::DELETE,"/[^_][^/]*/[^_].*",      &RESTListener::handleModifyDoc);
         }
@@ -348,6 +348,25 @@ namespace litecore { namespace REST {
         });
     }
 
+    void RESTListener::addDBReaderHandler(Method method, const char *uri, DBHandlerMethod handler) {
+        _server->addHandler(method, uri, [this,handler](RequestResponse &rq) {
+            c4::ref<C4Database> db = databaseFor(rq);
+            if (db) {
+                C4Error err;
+                C4Database *reader = c4db_borrowReader(db, &err);
+                if (!reader)
+                    return rq.respondWithError(err);
+                try {
+                    (this->*handler)(rq, reader);
+                } catch (...) {
+                    c4db_returnReader(db, reader);
+                    throw;
+                }
+                c4db_returnReader(db, reader);
+            }
+        });
+    }
+
     
     c4::ref<C4Database> RESTListener::databaseFor(RequestResponse &rq) {
         string dbName = rq.path(0);
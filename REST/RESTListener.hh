@@ -111,6 +111,9 @@ namespace litecore { namespace REST {
 
         void addHandler(net::Method, const char *uri, HandlerMethod);
         void addDBHandler(net::Method, const char *uri, DBHandlerMethod);
+        /** Like addDBHandler, but for read-only handlers, which are given a pooled reader
+            database instead of locking the database, so they can run concurrently. */
+        void addDBReaderHandler(net::Method, const char *uri, DBHandlerMethod);
         
         std::vector<net::Address> _addresses(C4Database *dbOrNull =nullptr,
                                             C4ListenerAPIs api = kC4RESTAPI) const;
@@ -468,6 +468,18 @@ TEST_CASE_METHOD(C4RESTTest, "REST _all_docs", "[REST][Listener][C]") {
     CHECK(row["key"].asString() == "foo"_sl);
     row = rows[1].asDict();
     CHECK(row["key"].asString() == "mydocument"_sl);
+
+    // Look up specific docIDs with `keys`:
+    r = request("GET", "/db/_all_docs?keys=%5B%22mydocument%22,%22nope%22%5D", HTTPStatus::OK);
+    body = r->bodyAsJSON().asDict();
+    rows = body["rows"].asArray();
+    REQUIRE(rows.count() == 2);
+    CHECK(rows[0].asDict()["id"].asString() == "mydocument"_sl);
+    CHECK(rows[1].asDict()["error"].asString() == "not_found"_sl);
+
+    request("GET", "/db/_all_docs?keys=%5B%22foo%22", HTTPStatus::BadRequest);
+    request("GET", "/db/_all_docs?keys=%5B17%5D", HTTPStatus::BadRequest);
+    request("GET", "/db/_all_docs?keys=foo", HTTPStatus::BadRequest);
 }
 
 
@@ -43,6 +43,7 @@ namespace litecore { namespace repl {
     ,Logging(SyncLog)
     ,_blobStore(c4db_getBlobStore(db, nullptr))
     ,_disableBlobSupport(disableBlobSupport)
+    ,_deltaCache(DeltaCache::forDatabase(string(alloc_slice(c4db_getPath(db)))))
     ,_revsToMarkSynced(bind(&DBAccess::markRevsSyncedNow, this),
                        bind(&DBAccess::markRevsSyncedLater, this),
                        tuning::kInsertionDelay)
@@ -21,6 +21,7 @@
 #include "c4Database.h"
 #include "c4Document.h"
 #include "Batcher.hh"
+#include "DeltaCache.hh"
 #include "Logging.hh"
 #include "Timer.hh"
 #include "access_lock.hh"
@@ -114,6 +115,10 @@ namespace litecore { namespace repl {
         /** True if the DB should store `_attachments` properties */
         bool disableBlobSupport() const                 {return _disableBlobSupport;}
 
+        /** The cache of deltas computed by Pushers, shared with other replicators of this
+            database file. Thread-safe. */
+        DeltaCache& deltaCache() const                  {return *_deltaCache;}
+
         using FindBlobCallback = fleece::function_ref<void(FLDeepIterator,
                                                            Dict blob,
                                                            const C4BlobKey &key)>;
@@ -205,6 +210,7 @@ namespace litecore { namespace repl {
         unsigned _tempSharedKeysInitialCount {0};           // Count when copied from db's keys
         C4RemoteID _remoteDBID {0};                         // ID # of remote DB in revision store
         bool const _disableBlobSupport;                     // Does replicator support blobs?
+        std::shared_ptr<DeltaCache> const _deltaCache;      // Deltas computed for this DB file
         actor::Batcher<ReplicatedRev> _revsToMarkSynced;    // Pending revs to be marked as synced
         actor::Timer _timer;                                // Implements Batcher delay
         bool _inTransaction {false};                        // True while in a transaction
@@ -0,0 +1,139 @@
+//
+// DeltaCache.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "DeltaCache.hh"
+#include "ReplicatorTuning.hh"
+
+using namespace std;
+using namespace fleece;
+
+namespace litecore { namespace repl {
+
+    // Approximate memory overhead of an entry, besides its key and delta:
+    static constexpr size_t kEntryOverhead = 100;
+
+
+    shared_ptr<DeltaCache> DeltaCache::forDatabase(const string &path) {
+        static mutex sMutex;
+        static unordered_map<string, weak_ptr<DeltaCache>> sCaches;
+
+        lock_guard<mutex> lock(sMutex);
+        auto &weak = sCaches[path];
+        auto cache = weak.lock();
+        if (!cache) {
+            // Forget caches of databases that no replicator is using any more:
+            for (auto i = sCaches.begin(); i != sCaches.end(); ) {
+                if (i->second.expired() && i->first != path)
+                    i = sCaches.erase(i);
+                else
+                    ++i;
+            }
+            cache = make_shared<DeltaCache>(tuning::kDeltaCacheCapacity);
+            weak = cache;
+        }
+        return cache;
+    }
+
+
+    DeltaCache::DeltaCache(size_t capacity)
+    :_capacity(capacity)
+    { }
+
+
+    string DeltaCache::makeKey(slice docID, slice fromRevID, slice toRevID, bool legacy) {
+        string key;
+        key.reserve(docID.size + fromRevID.size + toRevID.size + 4);
+        key.append((const char*)docID.buf, docID.size);
+        key += '\0';
+        key.append((const char*)fromRevID.buf, fromRevID.size);
+        key += '\0';
+        key.append((const char*)toRevID.buf, toRevID.size);
+        key += '\0';
+        key += (legacy ? 'L' : 'J');
+        return key;
+    }
+
+
+    optional<alloc_slice> DeltaCache::get(slice docID, slice fromRevID, slice toRevID,
+                                          bool legacyAttachments)
+    {
+        string key = makeKey(docID, fromRevID, toRevID, legacyAttachments);
+        lock_guard<mutex> lock(_mutex);
+        auto i = _index.find(key);
+        if (i == _index.end()) {
+            ++_misses;
+            return nullopt;
+        }
+        ++_hits;
+        _entries.splice(_entries.begin(), _entries, i->second);
+        return i->second->second;
+    }
+
+
+    void DeltaCache::put(slice docID, slice fromRevID, slice toRevID, bool legacyAttachments,
+                         alloc_slice delta)
+    {
+        string key = makeKey(docID, fromRevID, toRevID, legacyAttachments);
+        size_t size = key.size() + delta.size + kEntryOverhead;
+        lock_guard<mutex> lock(_mutex);
+        if (size > _capacity)
+            return;
+        if (auto i = _index.find(key); i != _index.end()) {
+            // Another replicator got here first; the delta will be the same.
+            _entries.splice(_entries.begin(), _entries, i->second);
+            return;
+        }
+        _entries.emplace_front(key, move(delta));
+        _index.emplace(move(key), _entries.begin());
+        _bytes += size;
+        trim();
+    }
+
+
+    void DeltaCache::setCapacity(size_t capacity) {
+        lock_guard<mutex> lock(_mutex);
+        _capacity = capacity;
+        trim();
+    }
+
+
+    // Evicts the least recently used entries until the cache fits its capacity.
+    void DeltaCache::trim() {
+        while (_bytes > _capacity && !_entries.empty()) {
+            auto &entry = _entries.back();
+            _bytes -= entry.first.size() + entry.second.size + kEntryOverhead;
+            _index.erase(entry.first);
+            _entries.pop_back();
+        }
+    }
+
+
+    void DeltaCache::clear() {
+        lock_guard<mutex> lock(_mutex);
+        _entries.clear();
+        _index.clear();
+        _bytes = 0;
+    }
+
+
+    DeltaCache::Stats DeltaCache::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return {_hits, _misses, _entries.size(), _bytes};
+    }
+
+} }
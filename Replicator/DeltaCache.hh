@@ -0,0 +1,83 @@
+//
+// DeltaCache.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/slice.hh"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace litecore { namespace repl {
+
+    /** An LRU cache of the JSON deltas the Pusher has computed, keyed by docID, the revID the
+        delta is from, and the revID it's to. When several peers pull the same documents from one
+        database, each delta only has to be computed once.
+        The cache is shared by all the replicators of a database file, and holds at most a given
+        number of bytes of keys and deltas. It also remembers when a delta wasn't worth using, so
+        that isn't recomputed either. Thread-safe. */
+    class DeltaCache {
+    public:
+        /** Returns the cache shared by all replicators of the database at this path. */
+        static std::shared_ptr<DeltaCache> forDatabase(const std::string &path);
+
+        explicit DeltaCache(size_t capacity);
+
+        /** Looks up a delta. Returns nullopt if it's not cached; or a null slice if no delta should
+            be used (because it would be larger than the revision.) */
+        std::optional<fleece::alloc_slice> get(fleece::slice docID,
+                                               fleece::slice fromRevID,
+                                               fleece::slice toRevID,
+                                               bool legacyAttachments);
+
+        /** Adds a delta, or a null slice if no delta should be used. */
+        void put(fleece::slice docID, fleece::slice fromRevID, fleece::slice toRevID,
+                 bool legacyAttachments, fleece::alloc_slice delta);
+
+        size_t capacity() const                     {return _capacity;}
+        void setCapacity(size_t capacity);
+
+        void clear();
+
+        struct Stats {
+            uint64_t hits;                          ///< Number of lookups that found a delta
+            uint64_t misses;                        ///< Number of lookups that didn't
+            size_t   count;                         ///< Number of cached deltas
+            size_t   bytes;                         ///< Memory used by cached deltas & keys
+        };
+
+        Stats stats() const;
+
+    private:
+        static std::string makeKey(fleece::slice docID, fleece::slice fromRevID,
+                                   fleece::slice toRevID, bool legacyAttachments);
+        void trim();
+
+        using Entry = std::pair<std::string, fleece::alloc_slice>;
+
+        mutable std::mutex _mutex;
+        std::list<Entry> _entries;                  // Most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+        size_t _capacity;
+        size_t _bytes {0};
+        uint64_t _hits {0}, _misses {0};
+    };
+
+} }
@@ -0,0 +1,164 @@
+//
+// FlowControl.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "FlowControl.hh"
+#include "ReplicatorTuning.hh"
+#include <algorithm>
+
+using namespace std;
+using namespace fleece;
+
+namespace litecore { namespace repl {
+
+    // Reads a positive integer option, returning 0 if it's missing.
+    static int64_t limitOption(const Options &options, const char *name) {
+        return max(options.properties[name].asInt(), int64_t(0));
+    }
+
+
+    FlowControl::FlowControl(const Options &options) {
+        auto revs = limitOption(options, kC4ReplicatorOptionMaxRevsInFlight);
+        _fixedRevsInFlight = (revs > 0);
+        _maxRevsInFlight = revs > 0 ? unsigned(revs) : tuning::kMaxRevsInFlight;
+
+        auto bytes = limitOption(options, kC4ReplicatorOptionMaxRevBytesAwaitingReply);
+        _fixedRevBytes = (bytes > 0);
+        _maxRevBytesAwaitingReply = bytes > 0 ? size_t(bytes) : tuning::kMaxRevBytesAwaitingReply;
+
+        auto changes = limitOption(options, kC4ReplicatorOptionChangesBatchSize);
+        _changesBatchSize = changes > 0 ? unsigned(changes) : tuning::kChangesBatchSize;
+
+        auto batch = limitOption(options, kC4ReplicatorOptionInsertionBatchSize);
+        _fixedBatchSize = (batch > 0);
+        _insertionBatchSize = batch > 0 ? size_t(batch) : tuning::kInsertionBatchSize;
+
+        auto delay = limitOption(options, kC4ReplicatorOptionInsertionDelay);
+        _fixedDelay = (delay > 0);
+        _insertionDelay = delay > 0 ? actor::Timer::duration(chrono::milliseconds(delay))
+                                    : actor::Timer::duration(tuning::kInsertionDelay);
+    }
+
+
+    bool FlowControl::revAcknowledged(size_t bytes, double rtt, double now) {
+        lock_guard<mutex> lock(_mutex);
+        rtt = max(rtt, 1.0e-4);
+        _srtt = _srtt ? (7 * _srtt + rtt) / 8 : rtt;
+
+        // The minimum RTT is the latency of an idle link. It's taken over the current and previous
+        // periods, so that it follows changes of route or peer:
+        if (now - _minRTTWindowStart >= tuning::kMinRTTWindow) {
+            _minRTT = _windowMinRTT;
+            _windowMinRTT = 0;
+            _minRTTWindowStart = now;
+        }
+        _windowMinRTT = _windowMinRTT ? min(_windowMinRTT, rtt) : rtt;
+        _minRTT = _minRTT ? min(_minRTT, rtt) : rtt;
+
+        // Measure the rate at which bytes are acknowledged, over about one round trip:
+        if (_sampleStart < 0)
+            _sampleStart = now - rtt;
+        _sampleBytes += bytes;
+        double elapsed = now - _sampleStart;
+        if (elapsed < max(_srtt, tuning::kFlowSampleInterval))
+            return false;
+        double rate = _sampleBytes / elapsed;
+        _bytesPerSec = _bytesPerSec ? (3 * _bytesPerSec + rate) / 4 : rate;
+        _sampleStart = now;
+        _sampleBytes = 0;
+
+        bool changed = false;
+        if (!_fixedRevBytes) {
+            // Allow twice the bandwidth-delay product to be awaiting replies. While the window is
+            // what limits throughput, this lets it double every round trip; once the link (or the
+            // peer) is the limit, the rate stops growing and so does the window. The window grows
+            // by at most 2x per sample, and never shrinks below the default.
+            size_t current = _maxRevBytesAwaitingReply;
+            double bdp = _bytesPerSec * _minRTT;
+            size_t target = size_t(min(2 * bdp, double(2 * current)));
+            target = clamp(target, size_t(tuning::kMaxRevBytesAwaitingReply),
+                           size_t(tuning::kMaxRevBytesAwaitingReplyLimit));
+            if (target != current) {
+                _maxRevBytesAwaitingReply = target;
+                changed = true;
+            }
+        }
+        if (!_fixedRevsInFlight) {
+            // Transmit more revs at once in proportion to the window, so it can be filled:
+            auto window = double(_maxRevBytesAwaitingReply);
+            auto revs = unsigned(tuning::kMaxRevsInFlight * window
+                                 / tuning::kMaxRevBytesAwaitingReply);
+            revs = clamp(revs, tuning::kMaxRevsInFlight, tuning::kMaxRevsInFlightLimit);
+            if (revs != _maxRevsInFlight) {
+                _maxRevsInFlight = revs;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+
+    bool FlowControl::batchInserted(size_t count, double time, double commitTime) {
+        lock_guard<mutex> lock(_mutex);
+        _commitTime = _commitTime ? (3 * _commitTime + commitTime) / 4 : commitTime;
+
+        bool changed = false;
+        if (!_fixedBatchSize) {
+            size_t current = _insertionBatchSize, batchSize = current;
+            if (time > tuning::kMaxInsertionBatchTime) {
+                // The transaction held the database too long; use smaller ones:
+                batchSize = max(current / 2, tuning::kMinInsertionBatchSize);
+            } else if (count >= current && commitTime > tuning::kMaxCommitFraction * time) {
+                // Full batches, dominated by the commit; amortize it over more revs:
+                batchSize = min(current * 2, tuning::kMaxInsertionBatchSize);
+            }
+            if (batchSize != current) {
+                _insertionBatchSize = batchSize;
+                changed = true;
+            }
+        }
+        if (!_fixedDelay) {
+            // Waiting for more revs saves a commit at best, so wait about as long as one takes:
+            auto delay = chrono::duration_cast<actor::Timer::duration>(
+                                                    chrono::duration<double>(2 * _commitTime));
+            delay = clamp(delay, actor::Timer::duration(tuning::kMinInsertionDelay),
+                                 actor::Timer::duration(tuning::kMaxInsertionDelay));
+            // Ignore small changes, to avoid constantly resetting the Inserter's batcher:
+            auto current = _insertionDelay.load();
+            if (delay > current * 5 / 4 || delay < current * 3 / 4) {
+                _insertionDelay = delay;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+
+    FlowControl::Stats FlowControl::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return {_maxRevsInFlight,
+                _maxRevBytesAwaitingReply,
+                _changesBatchSize,
+                _insertionBatchSize,
+                chrono::duration<double>(_insertionDelay.load()).count(),
+                _srtt,
+                _minRTT,
+                _bytesPerSec,
+                _commitTime};
+    }
+
+} }
@@ -0,0 +1,99 @@
+//
+// FlowControl.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "ReplicatorOptions.hh"
+#include "Stopwatch.hh"
+#include "Timer.hh"
+#include <atomic>
+#include <mutex>
+
+namespace litecore { namespace repl {
+
+    /** Adjusts the replicator's flow-control limits at runtime, starting from the defaults in
+        ReplicatorTuning.hh:
+        - The Pusher's window of `rev` messages awaiting a reply is sized from the bandwidth-delay
+          product: the rate at which revs are acknowledged, times the minimum round-trip time.
+          On a high-latency link this lets the window grow until the link is full.
+        - The Inserter's batch size and delay are sized from the time its transactions take to
+          commit. Waiting to fill a batch only pays off if it saves commits, so on a fast
+          database revs are inserted almost immediately.
+        A limit given in the replicator options is used as-is and never adjusted.
+        The Pusher and Inserter update this object on their own threads; the limits and stats
+        can be read from any thread. */
+    class FlowControl {
+    public:
+        explicit FlowControl(const Options&);
+
+        /** Seconds since this object was created; the clock used by the methods below. */
+        double now() const                          {return _clock.elapsed();}
+
+        //---- Current limits:
+
+        unsigned maxRevsInFlight() const            {return _maxRevsInFlight;}
+        size_t maxRevBytesAwaitingReply() const     {return _maxRevBytesAwaitingReply;}
+        unsigned changesBatchSize() const           {return _changesBatchSize;}
+        size_t insertionBatchSize() const           {return _insertionBatchSize;}
+        actor::Timer::duration insertionDelay() const {return _insertionDelay;}
+
+        //---- Measurements:
+
+        /** Called by the Pusher when a `rev` message of `bytes` bytes gets its reply, `rtt`
+            seconds after it finished being sent. Returns true if the push limits changed. */
+        bool revAcknowledged(size_t bytes, double rtt, double now);
+
+        /** Called by the Inserter after inserting a batch of `count` revs, which took `time`
+            seconds including a commit of `commitTime` seconds.
+            Returns true if the insertion limits changed. */
+        bool batchInserted(size_t count, double time, double commitTime);
+
+        struct Stats {
+            unsigned maxRevsInFlight;               ///< Max `rev` messages being transmitted
+            size_t   maxRevBytesAwaitingReply;      ///< Max bytes of `rev`s awaiting reply
+            unsigned changesBatchSize;              ///< Changes requested per `changes` message
+            size_t   insertionBatchSize;            ///< Revs per insertion transaction
+            double   insertionDelay;                ///< Max secs a rev waits to be inserted
+            double   revRoundTripTime;              ///< Smoothed `rev` round-trip time (secs)
+            double   minRevRoundTripTime;           ///< Minimum `rev` round-trip time (secs)
+            double   pushBytesPerSec;               ///< Rate of acknowledged `rev` bytes
+            double   commitTime;                    ///< Smoothed insertion commit time (secs)
+        };
+
+        Stats stats() const;
+
+    private:
+        fleece::Stopwatch       _clock;
+        bool                    _fixedRevsInFlight {false}, _fixedRevBytes {false};
+        bool                    _fixedBatchSize {false}, _fixedDelay {false};
+
+        std::atomic<unsigned>   _maxRevsInFlight;
+        std::atomic<size_t>     _maxRevBytesAwaitingReply;
+        unsigned                _changesBatchSize;
+        std::atomic<size_t>     _insertionBatchSize;
+        std::atomic<actor::Timer::duration> _insertionDelay;
+
+        mutable std::mutex      _mutex;             // Protects the estimates below
+        double                  _srtt {0}, _minRTT {0}, _windowMinRTT {0};
+        double                  _minRTTWindowStart {0};
+        double                  _sampleStart {-1};
+        size_t                  _sampleBytes {0};
+        double                  _bytesPerSec {0};
+        double                  _commitTime {0};
+    };
+
+} }
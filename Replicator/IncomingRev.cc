@@ -18,13 +18,16 @@
 
 #include "IncomingRev.hh"
 #include "Puller.hh"
+#include "Replicator.hh"
 #include "DBAccess.hh"
+#include "PullPipeline.hh"
 #include "Increment.hh"
 #include "StringUtil.hh"
 #include "c4BlobStore.h"
 #include "c4Document+Fleece.h"
 #include "Instrumentation.hh"
 #include "BLIP.hh"
+#include "c4ExceptionUtils.hh"
 #include <atomic>
 #include <deque>
 #include <set>
@@ -42,9 +45,17 @@ namespace litecore { namespace repl {
         return json.containsBytes("\"digest\""_sl);
     }
 
+    // (A Fleece body sent by the peer has no SharedKeys, so its keys appear as plain strings.)
+    static inline bool fleeceMightContainBlobs(slice fleece) {
+        return fleece.containsBytes("digest"_sl);
+    }
+
+    atomic<unsigned> IncomingRev::gNumFleeceRevsReceived;
+
     IncomingRev::IncomingRev(Puller *puller)
     :Worker(puller, "inc")
     ,_puller(puller)
+    ,_pipeline(puller->replicator()->pullPipeline())
     {
         _passive = _options.pull <= kC4Passive;
         _important = false;
@@ -75,6 +86,7 @@ namespace litecore { namespace repl {
                                _revMessage->boolProperty("noconflicts"_sl)
                                    || _options.noIncomingConflicts());
         _rev->deltaSrcRevID = _revMessage->property("deltaSrc"_sl);
+        _fleeceBody = !_rev->deltaSrcRevID && _revMessage->boolProperty("fleece"_sl);
         slice sequenceStr = _revMessage->property(slice("sequence"));
         _remoteSequence = RemoteSequence(sequenceStr);
 
@@ -102,36 +114,71 @@ namespace litecore { namespace repl {
         if (!_rev->historyBuf && c4rev_getGeneration(_rev->revID) > 1)
             warn("Server sent no history with '%.*s' #%.*s", SPLAT(_rev->docID), SPLAT(_rev->revID));
 
-        auto jsonBody = _revMessage->extractBody();
+        auto body = _revMessage->extractBody();
         if (_revMessage->noReply())
             _revMessage = nullptr;
 
-        // Decide whether to continue now (on the Puller thread) or asynchronously on my own:
-        if (_options.pullValidator|| jsonBody.size > kMaxImmediateParseSize
-                                  || jsonMightContainBlobs(jsonBody))
-            enqueue(&IncomingRev::parseAndInsert, move(jsonBody));
-        else
-            parseAndInsert(move(jsonBody));
+        // Decide whether to parse now (on the Puller thread), or hand the body to a parser thread:
+        bool mightContainBlobs = _fleeceBody ? fleeceMightContainBlobs(body)
+                                             : jsonMightContainBlobs(body);
+        _pipeline->parsing.enqueued();
+        auto queuedAt = PipelineStage::now();
+        if (_options.pullValidator|| body.size > kMaxImmediateParseSize || mightContainBlobs) {
+            increment(_pendingCallbacks);
+            Retained<IncomingRev> retainSelf = this;
+            _pipeline->parse([this, retainSelf, body, queuedAt] {
+                enqueue(&IncomingRev::_bodyParsed, parseBodyInStage(body, queuedAt));
+            });
+        } else {
+            processParsedBody(parseBodyInStage(move(body), queuedAt));
+        }
+    }
+
+
+    // Runs parseBody, updating the pipeline's counters. (Runs on the Puller thread or a parser
+    // thread.)
+    C4Error IncomingRev::parseBodyInStage(alloc_slice body, PipelineStage::time queuedAt) {
+        auto startedAt = PipelineStage::now();
+        _pipeline->parsing.started(queuedAt, startedAt);
+        C4Error err = {};
+        try {
+            err = parseBody(move(body));
+        } catch (const exception &x) {
+            c4Internal::recordException(x, &err);
+        }
+        _pipeline->parsing.finished(startedAt);
+        return err;
     }
 
 
-    void IncomingRev::parseAndInsert(alloc_slice jsonBody) {
+    // Converts the body to Fleece in `_rev->doc` (unless it's a delta that can be applied later),
+    // finds its blobs, and validates it.
+    // This doesn't run on my Actor queue; but nothing else touches my state until it returns.
+    C4Error IncomingRev::parseBody(alloc_slice body) {
         // First create a Fleece document:
         Doc fleeceDoc;
         C4Error err = {};
-        if (_rev->deltaSrcRevID == nullslice) {
+        if (_fleeceBody) {
+            // The body is already Fleece; it only needs to be validated, not parsed:
+            fleeceDoc = Doc(body, kFLUntrusted);
+            if (!fleeceDoc.root().asDict())
+                return c4error_make(FleeceDomain, kFLInvalidData,
+                                    "Incoming rev has invalid Fleece body"_sl);
+            ++gNumFleeceRevsReceived;
+
+        } else if (_rev->deltaSrcRevID == nullslice) {
             // It's not a delta. Convert body to Fleece and process:
             FLError encodeErr;
-            fleeceDoc = _db->tempEncodeJSON(jsonBody, &encodeErr);
+            fleeceDoc = _db->tempEncodeJSON(body, &encodeErr);
             if (!fleeceDoc)
-                err = c4error_make(FleeceDomain, (int)encodeErr, "Incoming rev failed to encode"_sl);
+                return c4error_make(FleeceDomain, (int)encodeErr, "Incoming rev failed to encode"_sl);
 
-        } else if (_options.pullValidator || jsonMightContainBlobs(jsonBody)) {
+        } else if (_options.pullValidator || jsonMightContainBlobs(body)) {
             // It's a delta, but we need the entire document body now because either it has to be
             // passed to the validation function, or it may contain new blobs to download.
             logVerbose("Need to apply delta immediately for '%.*s' #%.*s ...",
                        SPLAT(_rev->docID), SPLAT(_rev->revID));
-            fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, jsonBody, &err);
+            fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, body, &err);
             if (!fleeceDoc && err.domain==LiteCoreDomain && err.code==kC4ErrorDeltaBaseUnknown) {
                 // Don't have the body of the source revision. This might be because I'm in
                 // no-conflict mode and the peer is trying to push me a now-obsolete revision.
@@ -139,17 +186,13 @@ namespace litecore { namespace repl {
                     err = {WebSocketDomain, 409};
             }
             _rev->deltaSrcRevID = nullslice;
+            if (!fleeceDoc)
+                return err;
 
         } else {
             // It's a delta, but it can be applied later while inserting.
-            _rev->deltaSrc = jsonBody;
-            insertRevision();
-            return;
-        }
-
-        if (!fleeceDoc) {
-            failWithError(err);
-            return;
+            _rev->deltaSrc = body;
+            return {};
         }
 
         // Note: fleeceDoc is _not_ yet suitable for inserting into the
@@ -167,10 +210,8 @@ namespace litecore { namespace repl {
         if (c4doc_hasOldMetaProperties(root) && !_db->disableBlobSupport()) {
             auto sk = fleeceDoc.sharedKeys();
             alloc_slice body = c4doc_encodeStrippingOldMetaProperties(root, sk, nullptr);
-            if (!body) {
-                failWithError(WebSocketDomain, 500, "invalid legacy attachments"_sl);
-                return;
-            }
+            if (!body)
+                return c4error_make(WebSocketDomain, 500, "invalid legacy attachments"_sl);
             _rev->doc = Doc(body, kFLTrusted, sk);
             root = _rev->doc.root().asDict();
         } else {
@@ -192,17 +233,30 @@ namespace litecore { namespace repl {
         if (_options.pullValidator) {
             if (!_options.pullValidator(_rev->docID, _rev->revID, _rev->flags, root,
                                         _options.callbackContext)) {
-                failWithError(WebSocketDomain, 403, "rejected by validation function"_sl);
                 _pendingBlobs.clear();
                 _blob = _pendingBlobs.end();
-                return;
+                return c4error_make(WebSocketDomain, 403, "rejected by validation function"_sl);
             }
         }
+        return {};
+    }
+
+
+    // Called on my Actor queue after a parser thread has parsed the body.
+    void IncomingRev::_bodyParsed(C4Error err) {
+        decrement(_pendingCallbacks);
+        processParsedBody(err);
+    }
+
 
-        // Request the first blob, or if there are none, insert the revision into the DB:
-        if (!_pendingBlobs.empty()) {
+    void IncomingRev::processParsedBody(C4Error err) {
+        if (err.code != 0) {
+            failWithError(err);
+        } else if (!_pendingBlobs.empty()) {
+            // Request the first blob:
             fetchNextBlob();
         } else {
+            // If there are no blobs, insert the revision into the DB:
             insertRevision();
         }
     }
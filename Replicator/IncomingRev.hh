@@ -20,6 +20,7 @@
 #include "Worker.hh"
 #include "ReplicatorTypes.hh"
 #include "RemoteSequence.hh"
+#include "PullPipeline.hh"
 #include "Timer.hh"
 #include "c4.hh"
 #include <atomic>
@@ -46,16 +47,19 @@ namespace litecore { namespace repl {
         void revisionProvisionallyInserted();
         void revisionInserted();
 
+        static std::atomic<unsigned> gNumFleeceRevsReceived;   // For unit tests only
+
     protected:
         ActivityLevel computeActivityLevel() const override;
 
     private:
-        void parseAndInsert(alloc_slice jsonBody);
         bool nonPassive() const                 {return _options.pull > kC4Passive;}
         void _handleRev(Retained<blip::MessageIn>);
         void gotDeltaSrc(alloc_slice deltaSrcBody);
-        fleece::Doc parseBody(alloc_slice jsonBody);
-        void processFleeceBody(fleece::Doc);
+        C4Error parseBodyInStage(alloc_slice body, PipelineStage::time queuedAt);
+        C4Error parseBody(alloc_slice body);
+        void _bodyParsed(C4Error);
+        void processParsedBody(C4Error);
         void insertRevision();
         void _revisionInserted();
         void failWithError(C4Error);
@@ -72,12 +76,14 @@ namespace litecore { namespace repl {
         void closeBlobWriter();
 
         Puller*                     _puller;
+        std::shared_ptr<PullPipeline> _pipeline;
         Retained<blip::MessageIn>   _revMessage;
         Retained<RevToInsert>       _rev;
         unsigned                    _pendingCallbacks {0};
         int                         _peerError {0};
         RemoteSequence              _remoteSequence;
         uint32_t                    _serialNumber {0};
+        bool                        _fleeceBody {false};     // Is the body Fleece, not JSON?
         std::atomic<bool>           _provisionallyInserted {false};
         // blob stuff:
         std::vector<PendingBlob>    _pendingBlobs;
@@ -19,6 +19,8 @@
 #include "Inserter.hh"
 #include "Replicator.hh"
 #include "ReplicatorTuning.hh"
+#include "FlowControl.hh"
+#include "PullPipeline.hh"
 #include "IncomingRev.hh"
 #include "DBAccess.hh"
 #include "fleece/Fleece.hh"
@@ -40,14 +42,18 @@ namespace litecore { namespace repl {
 
     Inserter::Inserter(Replicator *repl)
     :Worker(repl, "Insert")
+    ,_flowControl(repl->flowControl())
+    ,_pipeline(repl->pullPipeline())
     ,_revsToInsert(this, &Inserter::_insertRevisionsNow,
-                   tuning::kInsertionDelay, tuning::kInsertionBatchSize)
+                   _flowControl->insertionDelay(), _flowControl->insertionBatchSize())
     {
         _passive = _options.pull <= kC4Passive;
     }
 
 
     void Inserter::insertRevision(RevToInsert *rev) {
+        _pipeline->inserting.enqueued();
+        rev->insertQueuedAt = PipelineStage::now();
         _revsToInsert.push(rev);
     }
 
@@ -59,6 +65,9 @@ namespace litecore { namespace repl {
             return;
 
         logVerbose("Inserting %zu revs:", revs->size());
+        auto startedAt = PipelineStage::now();
+        for (RevToInsert *rev : *revs)
+            _pipeline->inserting.started(rev->insertQueuedAt, startedAt);
         Stopwatch st;
         double commitTime = 0;
 
@@ -91,11 +100,12 @@ namespace litecore { namespace repl {
             Stopwatch stCommit;
             if (transaction.commit(&transactionErr))
                 transactionErr = {};
-            commitTime = st.elapsed();
+            commitTime = stCommit.elapsed();
         }
 
         if (transactionErr.code != 0)
             warn("Transaction failed!");
+        _pipeline->inserting.finished(startedAt, unsigned(revs->size()));
 
         // Notify owners of all revs that didn't already fail:
         for (auto rev : *revs) {
@@ -111,6 +121,13 @@ namespace litecore { namespace repl {
             double t = st.elapsed();
             logInfo("Inserted %3zu revs in %6.2fms (%5.0f/sec) of which %4.1f%% was commit",
                     revs->size(), t*1000, revs->size()/t, commitTime/t*100);
+            if (_flowControl->batchInserted(revs->size(), t, commitTime)) {
+                _revsToInsert.setCapacity(_flowControl->insertionBatchSize());
+                _revsToInsert.setLatency(_flowControl->insertionDelay());
+                logVerbose("Insertion batch size is now %zu, delay %.1fms",
+                           _revsToInsert.capacity(),
+                           chrono::duration<double, milli>(_revsToInsert.latency()).count());
+            }
         }
     }
 
@@ -21,6 +21,8 @@
 #include "Batcher.hh"
 
 namespace litecore { namespace repl {
+    class FlowControl;
+    class PullPipeline;
     class Replicator;
     class RevToInsert;
 
@@ -38,6 +40,8 @@ namespace litecore { namespace repl {
                                          C4Slice deltaJSON,
                                          C4Error *outError);
 
+        std::shared_ptr<FlowControl> _flowControl;               // Adjusts the batch size & delay
+        std::shared_ptr<PullPipeline> _pipeline;                 // Counts queue depth & latency
         actor::ActorBatcher<Inserter,RevToInsert> _revsToInsert; // Pending revs to be added to db
     };
 
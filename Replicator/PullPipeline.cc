@@ -0,0 +1,145 @@
+//
+// PullPipeline.cc
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PullPipeline.hh"
+#include "ReplicatorOptions.hh"
+#include "ReplicatorTuning.hh"
+#include "Channel.hh"
+#include "Logging.hh"
+#include "ThreadUtil.hh"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace litecore { namespace repl {
+
+#pragma mark - STAGE:
+
+
+    void PipelineStage::enqueued() {
+        unsigned depth = ++_queueDepth;
+        unsigned maxDepth = _maxQueueDepth;
+        while (depth > maxDepth && !_maxQueueDepth.compare_exchange_weak(maxDepth, depth))
+            ;
+    }
+
+
+    void PipelineStage::started(time queuedAt, time startedAt) {
+        --_queueDepth;
+        ++_startedCount;
+        _waitMicros += chrono::duration_cast<chrono::microseconds>(startedAt - queuedAt).count();
+    }
+
+
+    void PipelineStage::finished(time startedAt, unsigned count) {
+        _count += count;
+        _busyMicros += chrono::duration_cast<chrono::microseconds>(now() - startedAt).count();
+    }
+
+
+    PipelineStage::Stats PipelineStage::stats() const {
+        uint64_t count = _count, startedCount = _startedCount;
+        return {count,
+                _queueDepth,
+                _maxQueueDepth,
+                startedCount ? _waitMicros / 1.0e6 / startedCount : 0.0,
+                count ? _busyMicros / 1.0e6 / count : 0.0};
+    }
+
+
+#pragma mark - PARSER THREADS:
+
+
+    // A process-wide pool of threads that run parsing tasks. Like the Actor Scheduler, it's
+    // created on first use and never destroyed.
+    class ParserPool {
+    public:
+        static ParserPool* shared() {
+            static ParserPool* sPool = new ParserPool;
+            return sPool;
+        }
+
+        void ensureThreads(unsigned n) {
+            lock_guard<mutex> lock(_mutex);
+            while (_threads.size() < n) {
+                auto id = unsigned(_threads.size() + 1);
+                _threads.emplace_back([this, id] {run(id);});
+                _threads.back().detach();
+            }
+        }
+
+        unsigned threadCount() const {
+            lock_guard<mutex> lock(_mutex);
+            return unsigned(_threads.size());
+        }
+
+        void enqueue(function<void()> task) {
+            _queue.push(move(task));
+        }
+
+    private:
+        void run(unsigned id) {
+            char name[100];
+            sprintf(name, "Rev parser #%u (Couchbase Lite Core)", id);
+            SetThreadName(name);
+            function<void()> task;
+            while ((task = _queue.pop())) {
+                try {
+                    task();
+                } catch (const exception &x) {
+                    Warn("Caught exception in rev parser thread: %s", x.what());
+                }
+                task = nullptr;
+            }
+        }
+
+        actor::Channel<function<void()>> _queue;
+        mutable mutex _mutex;
+        vector<thread> _threads;
+    };
+
+
+#pragma mark - PIPELINE:
+
+
+    PullPipeline::PullPipeline(const Options &options) {
+        auto threads = options.properties[kC4ReplicatorOptionParserThreads].asInt();
+        if (threads <= 0)
+            threads = max(thread::hardware_concurrency() / 2, tuning::kMinParserThreads);
+        ParserPool::shared()->ensureThreads(min(unsigned(threads), tuning::kMaxParserThreads));
+    }
+
+
+    void PullPipeline::parse(function<void()> task) {
+        ParserPool::shared()->enqueue(move(task));
+    }
+
+
+    unsigned PullPipeline::parserThreads() const {
+        return ParserPool::shared()->threadCount();
+    }
+
+
+    PullPipeline::Stats PullPipeline::stats() const {
+        return {waiting.stats(), parsing.stats(), inserting.stats(), parserThreads()};
+    }
+
+} }
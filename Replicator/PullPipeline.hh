@@ -0,0 +1,94 @@
+//
+// PullPipeline.hh
+//
+// Copyright © 2019 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace litecore { namespace repl {
+    struct Options;
+
+
+    /** Counters for one stage of the PullPipeline. Thread-safe. */
+    class PipelineStage {
+    public:
+        using clock = std::chrono::steady_clock;
+        using time = clock::time_point;
+
+        static time now()                           {return clock::now();}
+
+        /** An item was added to the stage's queue. */
+        void enqueued();
+
+        /** An item that was queued at `queuedAt` was taken off the queue at `startedAt`. */
+        void started(time queuedAt, time startedAt =now());
+
+        /** `count` items finished being processed, which began at `startedAt`. */
+        void finished(time startedAt, unsigned count =1);
+
+        struct Stats {
+            uint64_t count;                         ///< Number of items processed
+            unsigned queueDepth;                    ///< Number of items queued now
+            unsigned maxQueueDepth;                 ///< Most items that have been queued at once
+            double   avgWaitTime;                   ///< Average time an item was queued (secs)
+            double   avgProcessTime;                ///< Average processing time per item (secs)
+        };
+
+        Stats stats() const;
+
+    private:
+        std::atomic<uint64_t> _count {0}, _startedCount {0};
+        std::atomic<uint64_t> _waitMicros {0}, _busyMicros {0};
+        std::atomic<unsigned> _queueDepth {0}, _maxQueueDepth {0};
+    };
+
+
+    /** The stages an incoming revision passes through on its way from a `rev` message into the
+        database:
+        1. `waiting`:  `rev` messages the Puller holds back while too many revs are in progress.
+        2. `parsing`:  converting the body to Fleece (from JSON, or by applying a delta), then
+                       finding its blobs and validating it. Large bodies, and ones that need blobs
+                       or validation, are parsed on a pool of threads dedicated to this, so the
+                       work spreads across cores instead of competing for the Actor scheduler's
+                       threads with BLIP and the other workers.
+        3. `inserting`: the Inserter's queue; a single writer saves its revs in batched
+                       transactions.
+        Each stage has counters, which show where a pull is bottlenecked. */
+    class PullPipeline {
+    public:
+        explicit PullPipeline(const Options&);
+
+        /** Runs a parsing task on one of the parser threads. */
+        void parse(std::function<void()> task);
+
+        /** The number of parser threads. The pool is shared by all replicators, and has as many
+            threads as the most any of them asked for. */
+        unsigned parserThreads() const;
+
+        PipelineStage waiting, parsing, inserting;
+
+        struct Stats {
+            PipelineStage::Stats waiting, parsing, inserting;
+            unsigned parserThreads;
+        };
+
+        Stats stats() const;
+    };
+
+} }
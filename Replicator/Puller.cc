@@ -23,6 +23,8 @@
 #include "Inserter.hh"
 #include "IncomingRev.hh"
 #include "ReplicatorTuning.hh"
+#include "FlowControl.hh"
+#include "PullPipeline.hh"
 #include "Error.hh"
 #include "Increment.hh"
 #include "StringUtil.hh"
@@ -38,6 +40,7 @@ namespace litecore { namespace repl {
 
     Puller::Puller(Replicator *replicator)
     :Delegate(replicator, "Pull")
+    ,_pipeline(replicator->pullPipeline())
     ,_inserter(new Inserter(replicator))
     ,_revFinder(new RevFinder(replicator, this))
     ,_provisionallyHandledRevs(this, &Puller::_revsWereProvisionallyHandled)
@@ -69,7 +72,7 @@ namespace litecore { namespace repl {
             msg["since"_sl] = sinceStr;
         if (_options.pull == kC4Continuous)
             msg["continuous"_sl] = "true"_sl;
-        msg["batch"_sl] = tuning::kChangesBatchSize;
+        msg["batch"_sl] = replicator()->flowControl()->changesBatchSize();
 
         if (_skipDeleted)
             msg["activeOnly"_sl] = "true"_sl;
@@ -154,7 +157,8 @@ namespace litecore { namespace repl {
                      SPLAT(msg->property("id"_sl)), _waitingRevMessages.size()+1);
             if (_waitingRevMessages.empty())
                 Signpost::begin(Signpost::revsBackPressure);
-            _waitingRevMessages.push_back(move(msg));
+            _pipeline->waiting.enqueued();
+            _waitingRevMessages.emplace_back(move(msg), PipelineStage::now());
         }
     }
 
@@ -200,10 +204,13 @@ namespace litecore { namespace repl {
         while (connected() && _activeIncomingRevs < tuning::kMaxActiveIncomingRevs
                && _unfinishedIncomingRevs < tuning::kMaxIncomingRevs
                && !_waitingRevMessages.empty()) {
-            auto msg = _waitingRevMessages.front();
+            auto [msg, queuedAt] = _waitingRevMessages.front();
             _waitingRevMessages.pop_front();
             if (_waitingRevMessages.empty())
                 Signpost::end(Signpost::revsBackPressure);
+            auto startedAt = PipelineStage::now();
+            _pipeline->waiting.started(queuedAt, startedAt);
+            _pipeline->waiting.finished(startedAt);
             startIncomingRev(msg);
         }
     }
@@ -22,6 +22,7 @@
 #include "ReplicatorTypes.hh"
 #include "RemoteSequenceSet.hh"
 #include "Batcher.hh"
+#include "PullPipeline.hh"
 #include <deque>
 
 namespace litecore { namespace repl {
@@ -79,10 +80,12 @@ namespace litecore { namespace repl {
         bool _fatalError {false};           // Have I gotten a fatal error?
 
         RemoteSequenceSet _missingSequences; // Known sequences I need to pull
-        std::deque<Retained<blip::MessageIn>> _waitingRevMessages;     // Queued 'rev' messages
+        std::deque<std::pair<Retained<blip::MessageIn>, PipelineStage::time>>
+                                            _waitingRevMessages;     // Queued 'rev' messages
         mutable std::vector<Retained<IncomingRev>> _spareIncomingRevs;   // Cache of IncomingRevs
         actor::ActorCountBatcher<Puller> _provisionallyHandledRevs;
         actor::ActorBatcher<Puller,IncomingRev> _returningRevs;
+        std::shared_ptr<PullPipeline> _pipeline;
         Retained<Inserter> _inserter;
         mutable Retained<RevFinder> _revFinder;
         unsigned _pendingRevMessages {0};   // # of 'rev' msgs expected but not yet being processed
@@ -17,6 +17,7 @@
 //
 
 #include "Pusher.hh"
+#include "FlowControl.hh"
 #include "DBAccess.hh"
 #include "ReplicatorTuning.hh"
 #include "BLIP.hh"
@@ -30,8 +31,8 @@ using namespace litecore::blip;
 namespace litecore::repl {
 
     void Pusher::maybeSendMoreRevs() {
-        while (_revisionsInFlight < tuning::kMaxRevsInFlight
-                   && _revisionBytesAwaitingReply <= tuning::kMaxRevBytesAwaitingReply
+        while (_revisionsInFlight < _flowControl->maxRevsInFlight()
+                   && _revisionBytesAwaitingReply <= _flowControl->maxRevBytesAwaitingReply()
                    && !_revQueue.empty()) {
             Retained<RevToSend> first = move(_revQueue.front());
             _revQueue.pop_front();
@@ -41,8 +42,8 @@ namespace litecore::repl {
         }
 //        if (!_revQueue.empty())
 //            logVerbose("Throttling sending revs; _revisionsInFlight=%u/%u, _revisionBytesAwaitingReply=%llu/%u",
-//                       _revisionsInFlight, tuning::kMaxRevsInFlight,
-//                       _revisionBytesAwaitingReply, tuning::kMaxRevBytesAwaitingReply);
+//                       _revisionsInFlight, _flowControl->maxRevsInFlight(),
+//                       _revisionBytesAwaitingReply, _flowControl->maxRevBytesAwaitingReply());
     }
 
 
@@ -53,7 +54,7 @@ namespace litecore::repl {
 
         logVerbose("Sending rev %.*s %.*s (seq #%" PRIu64 ") [%d/%d]",
                    SPLAT(request->docID), SPLAT(request->revID), request->sequence,
-                   _revisionsInFlight, tuning::kMaxRevsInFlight);
+                   _revisionsInFlight, _flowControl->maxRevsInFlight());
 
         // Get the document & revision:
         C4Error c4err;
@@ -106,6 +107,13 @@ namespace litecore::repl {
                 msg.jsonBody().writeRaw(delta);
             } else if (root.empty()) {
                 msg.write("{}"_sl);
+            } else if (request->fleeceOK && !sendLegacyAttachments) {
+                // The peer can take the body as Fleece, sparing it a JSON parse. It doesn't have
+                // our SharedKeys, so the body is re-encoded without them:
+                msg["fleece"_sl] = "1"_sl;
+                Encoder bodyEncoder;
+                bodyEncoder.writeValue(root);
+                msg.write(bodyEncoder.finish());
             } else {
                 auto &bodyEncoder = msg.jsonBody();
                 if (sendLegacyAttachments)
@@ -154,10 +162,20 @@ namespace litecore::repl {
                          SPLAT(rev->docID), SPLAT(rev->revID), rev->sequence);
                 decrement(_revisionsInFlight);
                 increment(_revisionBytesAwaitingReply, progress.bytesSent);
+                rev->replyWaitStart = _flowControl->now();
                 maybeSendMoreRevs();
                 break;
             case MessageProgress::kComplete: {
                 decrement(_revisionBytesAwaitingReply, progress.bytesSent);
+                if (rev->replyWaitStart > 0) {
+                    double now = _flowControl->now();
+                    if (_flowControl->revAcknowledged(progress.bytesSent,
+                                                      now - rev->replyWaitStart, now))
+                        logVerbose("Push window is now %u revs, %zu bytes",
+                                   _flowControl->maxRevsInFlight(),
+                                   _flowControl->maxRevBytesAwaitingReply());
+                    rev->replyWaitStart = 0;
+                }
                 bool synced = !progress.reply->isError();
                 bool completed = true;
                 enum {kNoRetry, kRetryLater, kRetryNow} retry = kNoRetry;
@@ -237,8 +255,11 @@ namespace litecore::repl {
         // Find an ancestor revision known to the server:
         C4RevisionFlags ancestorFlags = 0;
         Dict ancestor;
-        if (request->remoteAncestorRevID)
+        alloc_slice ancestorRevID;
+        if (request->remoteAncestorRevID) {
             ancestor = DBAccess::getDocRoot(doc, request->remoteAncestorRevID, &ancestorFlags);
+            ancestorRevID = request->remoteAncestorRevID;
+        }
 
         if(ancestorFlags & kRevDeleted)
             return delta;
@@ -246,13 +267,25 @@ namespace litecore::repl {
         if (!ancestor && request->ancestorRevIDs) {
             for (auto revID : *request->ancestorRevIDs) {
                 ancestor = DBAccess::getDocRoot(doc, revID, &ancestorFlags);
-                if (ancestor)
+                if (ancestor) {
+                    ancestorRevID = revID;
                     break;
+                }
             }
         }
         if (ancestor.empty())
             return delta;
 
+        // Another replicator of this database may already have computed this delta:
+        DeltaCache &cache = _db->deltaCache();
+        if (auto cached = cache.get(request->docID, ancestorRevID, request->revID,
+                                    sendLegacyAttachments); cached) {
+            logDebug("Using cached delta of '%.*s' #%.*s from #%.*s (%zu bytes)",
+                     SPLAT(request->docID), SPLAT(request->revID), SPLAT(ancestorRevID),
+                     cached->size);
+            return *cached;
+        }
+
         Doc legacyOld, legacyNew;
         if (sendLegacyAttachments) {
             // If server needs legacy attachment layout, transform the bodies:
@@ -272,7 +305,10 @@ namespace litecore::repl {
 
         delta = FLCreateJSONDelta(ancestor, root);
         if (!delta || delta.size > revisionSize * 1.2)
-            return {};          // Delta failed, or is (probably) bigger than body; don't use
+            delta = nullslice;  // Delta failed, or is (probably) bigger than body; don't use
+        cache.put(request->docID, ancestorRevID, request->revID, sendLegacyAttachments, delta);
+        if (!delta)
+            return delta;
 
         if (willLog(LogLevel::Verbose)) {
             alloc_slice old (ancestor.toJSON());
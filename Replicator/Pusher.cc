@@ -20,6 +20,7 @@
 #include "Pusher.hh"
 #include "DBAccess.hh"
 #include "ReplicatorTuning.hh"
+#include "FlowControl.hh"
 #include "Error.hh"
 #include "Increment.hh"
 #include "StringUtil.hh"
@@ -38,6 +39,7 @@ namespace litecore { namespace repl {
     ,_continuous(_options.push == kC4Continuous)
     ,_checkpointer(checkpointer)
     ,_changesFeed(*this, _options, *_db, &checkpointer)
+    ,_flowControl(replicator->flowControl())
     {
         if (_options.push <= kC4Passive) {
             // Passive replicator always sends "changes"
@@ -302,6 +304,8 @@ namespace litecore { namespace repl {
         if (!_deltasOK && reply->boolProperty("deltas"_sl)
                        && !_options.properties[kC4ReplicatorOptionDisableDeltas].asBool())
             _deltasOK = true;
+        if (!_fleeceOK && reply->boolProperty("fleece"_sl) && !_options.disableFleeceRevs())
+            _fleeceOK = true;
 
         // The response body consists of an array that parallels the `changes` array I sent:
         Array::iterator iResponse(reply->JSONBody().asArray());
@@ -309,6 +313,7 @@ namespace litecore { namespace repl {
             change->maxHistory = maxHistory;
             change->legacyAttachments = legacyAttachments;
             change->deltaOK = _deltasOK;
+            change->fleeceOK = _fleeceOK;
             bool queued = proposedChanges ? handleProposedChangeResponse(change, *iResponse)
                                           : handleChangeResponse(change, *iResponse);
             if (queued) {
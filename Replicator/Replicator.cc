@@ -19,6 +19,8 @@
 
 #include "Replicator.hh"
 #include "ReplicatorTuning.hh"
+#include "FlowControl.hh"
+#include "PullPipeline.hh"
 #include "Pusher.hh"
 #include "Puller.hh"
 #include "Checkpoint.hh"
@@ -66,6 +68,8 @@ namespace litecore { namespace repl {
             make_shared<DBAccess>(db, options.properties["disable_blob_support"_sl].asBool()),
             "Repl")
     ,_delegate(&delegate)
+    ,_flowControl(make_shared<FlowControl>(_options))
+    ,_pullPipeline(options.pull != kC4Disabled ? make_shared<PullPipeline>(_options) : nullptr)
     ,_connectionState(connection().state())
     ,_pushStatus(options.push == kC4Disabled ? kC4Stopped : kC4Busy)
     ,_pullStatus(options.pull == kC4Disabled ? kC4Stopped : kC4Busy)
@@ -449,6 +453,30 @@ namespace litecore { namespace repl {
         _connectionState = state;
 
         _checkpointer.stopAutosave();
+
+        auto flow = _flowControl->stats();
+        logInfo("Flow control: %u revs / %zu bytes in flight (rtt %.1fms, min %.1fms, %.0f bytes/sec); "
+                "insertion batches of %zu, delay %.1fms (commit %.1fms)",
+                flow.maxRevsInFlight, flow.maxRevBytesAwaitingReply, flow.revRoundTripTime * 1000,
+                flow.minRevRoundTripTime * 1000, flow.pushBytesPerSec, flow.insertionBatchSize,
+                flow.insertionDelay * 1000, flow.commitTime * 1000);
+        if (_pullPipeline) {
+            auto pipe = _pullPipeline->stats();
+            for (auto [name, stage] : {make_pair("waiting", pipe.waiting),
+                                       make_pair("parsing", pipe.parsing),
+                                       make_pair("inserting", pipe.inserting)}) {
+                logInfo("Pull %-9s: %6llu revs, avg wait %7.2fms, avg time %6.2fms, "
+                        "max queue %u", name, (unsigned long long)stage.count,
+                        stage.avgWaitTime * 1000, stage.avgProcessTime * 1000,
+                        stage.maxQueueDepth);
+            }
+        }
+        if (_pusher && _db) {
+            auto deltas = _db->deltaCache().stats();
+            logInfo("Delta cache: %llu hits, %llu misses; %zu deltas, %zu bytes",
+                    (unsigned long long)deltas.hits, (unsigned long long)deltas.misses,
+                    deltas.count, deltas.bytes);
+        }
         
         // Clear connection() and notify the other agents to do the same:
         _connectionClosed();
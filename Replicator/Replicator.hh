@@ -27,6 +27,8 @@
 
 namespace litecore { namespace repl {
 
+    class FlowControl;
+    class PullPipeline;
     class Pusher;
     class Puller;
     class ReplicatedRev;
@@ -100,6 +102,13 @@ namespace litecore { namespace repl {
 
         Checkpointer& checkpointer()            {return _checkpointer;}
 
+        /** The object that adjusts flow-control limits; its `stats` show the current values. */
+        const std::shared_ptr<FlowControl>& flowControl() const {return _flowControl;}
+
+        /** The stages that incoming revs pass through; its `stats` show their queues & latencies.
+            Null if not pulling. */
+        const std::shared_ptr<PullPipeline>& pullPipeline() const {return _pullPipeline;}
+
         void endedDocument(ReplicatedRev *d NONNULL);
         void onBlobProgress(const BlobProgress &progress) {
             enqueue(&Replicator::_onBlobProgress, progress);
@@ -171,6 +180,8 @@ namespace litecore { namespace repl {
         using ReplicatedRevBatcher = actor::ActorBatcher<Replicator, ReplicatedRev>;
         
         Delegate*         _delegate;                   // Delegate whom I report progress/errors to
+        std::shared_ptr<FlowControl> _flowControl;     // Adjusts flow-control limits
+        std::shared_ptr<PullPipeline> _pullPipeline;   // Parses incoming revs; pull stats
         Retained<Pusher>  _pusher;                     // Object that manages outgoing revs
         Retained<Puller>  _puller;                     // Object that manages incoming revs
         blip::Connection::State _connectionState;      // Current BLIP connection state
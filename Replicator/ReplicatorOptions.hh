@@ -77,6 +77,7 @@ namespace litecore { namespace repl {
         bool noOutgoingConflicts() const  {return properties[kC4ReplicatorOptionNoIncomingConflicts].asBool();}
         int progressLevel() const  {return (int)properties[kC4ReplicatorOptionProgressLevel].asInt();}
         bool disableDeltaSupport() const {return properties[kC4ReplicatorOptionDisableDeltas].asBool();}
+        bool disableFleeceRevs() const {return properties[kC4ReplicatorOptionDisableFleeceRevs].asBool();}
 
         /** Returns a string that uniquely identifies the remote database; by default its URL,
             or the 'remoteUniqueID' option if that's present (for P2P dbs without stable URLs.) */
@@ -125,6 +126,10 @@ namespace litecore { namespace repl {
             return setProperty(C4STR(kC4ReplicatorOptionDisableDeltas), true);
         }
 
+        Options& setNoFleeceRevs() {
+            return setProperty(C4STR(kC4ReplicatorOptionDisableFleeceRevs), true);
+        }
+
         explicit operator std::string() const;
     };
 
@@ -27,7 +27,9 @@ namespace litecore { namespace repl {
         each other, and changing them can have unexpected and counter-intuitive effects.
         Their behavior also varies with things like network speed, latency, and whether the
         peer is LiteCore or Sync Gateway.
-        I'm not sure the current values are optimal, but they've been tweaked a lot. --Jens */
+        I'm not sure the current values are optimal, but they've been tweaked a lot. --Jens
+       Some of them are only starting points, which FlowControl adjusts at runtime within the
+        limits given here; and some can be overridden by replicator options. */
     namespace tuning {
 
         using namespace std::chrono;
@@ -36,12 +38,27 @@ namespace litecore { namespace repl {
 
         /* Number of new revisions to accumulate in memory before inserting them into the DB.
            (Actually the queue may grow larger than this, since the insertion is triggered
-           asynchronously, and more revs may be added to the queue before it happens.) */
+           asynchronously, and more revs may be added to the queue before it happens.)
+           This is the initial value; FlowControl doubles it while commits dominate the insertion
+           time, and halves it when a transaction takes longer than kMaxInsertionBatchTime.
+           Option: kC4ReplicatorOptionInsertionBatchSize. */
         constexpr size_t kInsertionBatchSize = 100;
+        constexpr size_t kMinInsertionBatchSize = 20;
+        constexpr size_t kMaxInsertionBatchSize = 1000;
+
+        /* Longest desirable insertion transaction, in seconds. */
+        constexpr double kMaxInsertionBatchTime = 0.1;
+
+        /* Fraction of an insertion's time spent committing, above which batches grow. */
+        constexpr double kMaxCommitFraction = 0.25;
 
         /* How long revisions can stay in the queue before triggering insertion into the DB,
-           if the queue size hasn't reached kInsertionBatchSize yet. */
+           if the queue size hasn't reached kInsertionBatchSize yet.
+           This is the initial value; FlowControl sets it to twice the average commit time,
+           within the min/max below. Option: kC4ReplicatorOptionInsertionDelay. */
         constexpr auto kInsertionDelay = 20ms;
+        constexpr auto kMinInsertionDelay = 1ms;
+        constexpr auto kMaxInsertionDelay = 100ms;
 
         /* Minimum document body size that will be considered for delta compression.
             (This is the size of the Fleece encoding, which is usually smaller than the JSON.)
@@ -51,7 +68,8 @@ namespace litecore { namespace repl {
         //// Puller:
 
         /* Number of revisions the peer should include in a single `changes` / `proposeChanges`
-            message. (This is sent as a parameter in the puller's opening `subChanges` message.) */
+            message. (This is sent as a parameter in the puller's opening `subChanges` message.)
+            Option: kC4ReplicatorOptionChangesBatchSize. */
         constexpr unsigned kChangesBatchSize = 200;
 
         /* Maximum desirable number of incoming `rev` messages that aren't being handled yet.
@@ -68,6 +86,11 @@ namespace litecore { namespace repl {
            (and are thus holding onto the document bodies in memory.) */
         constexpr unsigned kMaxActiveIncomingRevs = 100;
 
+        /* Range of the number of threads that parse incoming revisions. By default there's one
+           for every two CPU cores. Option: kC4ReplicatorOptionParserThreads. */
+        constexpr unsigned kMinParserThreads = 2;
+        constexpr unsigned kMaxParserThreads = 16;
+
 
         //// Pusher:
 
@@ -83,12 +106,25 @@ namespace litecore { namespace repl {
             stop querying for more lists of changes. */
         constexpr unsigned kMaxRevsQueued = 600;
 
-        /* Max # of `rev` messages to be transmitting at once. */
+        /* Max # of `rev` messages to be transmitting at once.
+            This is the initial value; FlowControl raises it in proportion to the rev-bytes window,
+            up to kMaxRevsInFlightLimit. Option: kC4ReplicatorOptionMaxRevsInFlight. */
         constexpr unsigned kMaxRevsInFlight = 10;
+        constexpr unsigned kMaxRevsInFlightLimit = 100;
 
         /* Max desirable number of bytes of revisions that have been sent but not replied to
-            yet. This is limited to avoid flooding the peer with too much JSON data. */
+            yet. This is limited to avoid flooding the peer with too much JSON data.
+            This is the initial (and minimum) value; FlowControl raises it to twice the measured
+            bandwidth-delay product, up to kMaxRevBytesAwaitingReplyLimit.
+            Option: kC4ReplicatorOptionMaxRevBytesAwaitingReply. */
         constexpr unsigned kMaxRevBytesAwaitingReply = 2*1024*1024;
+        constexpr unsigned kMaxRevBytesAwaitingReplyLimit = 32*1024*1024;
+
+        /* Minimum time, in seconds, over which FlowControl measures the push rate. */
+        constexpr double kFlowSampleInterval = 0.1;
+
+        /* Period, in seconds, over which FlowControl tracks the minimum `rev` round-trip time. */
+        constexpr double kMinRTTWindow = 10.0;
 
         /* Number of changes to send in one "changes" msg */
         constexpr unsigned kDefaultChangeBatchSize = 200;
@@ -96,6 +132,11 @@ namespace litecore { namespace repl {
         /* Max history length to use, if "changes" response doesn't have one */
         constexpr unsigned kDefaultMaxHistory = 20;
 
+        /* Max bytes of deltas (and their keys) kept in a database's DeltaCache. The cache is
+            shared by all replicators of the database, so a delta is computed once no matter
+            how many peers pull it. */
+        constexpr size_t kDeltaCacheCapacity = 4*1024*1024;
+
 
         //// Replicator:
 
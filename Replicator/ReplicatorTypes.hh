@@ -22,6 +22,7 @@
 #include "c4.hh"
 #include "c4Private.h"
 #include "access_lock.hh"
+#include <chrono>
 #include <functional>
 #include <vector>
 
@@ -67,7 +68,9 @@ namespace litecore { namespace repl {
         bool            noConflicts {false};        // Server is in no-conflicts mode
         bool            legacyAttachments {false};  // Add _attachments property when sending
         bool            deltaOK {false};            // Can send a delta
+        bool            fleeceOK {false};           // Can send the body as Fleece
         int8_t          retryCount {0};             // Number of times this revision has been retried
+        double          replyWaitStart {0};         // When the 'rev' was sent (FlowControl::now)
 
         RevToSend(const C4DocumentInfo &info);
 
@@ -96,7 +99,8 @@ namespace litecore { namespace repl {
         Retained<IncomingRev>   owner;                  // Object that's processing this rev
         alloc_slice             deltaSrc;
         alloc_slice             deltaSrcRevID;          // Source revision if body is a delta
-        
+        std::chrono::steady_clock::time_point insertQueuedAt; // When it was given to the Inserter
+
         RevToInsert(IncomingRev* owner,
                     slice docID, slice revID,
                     slice historyBuf,
@@ -126,6 +126,10 @@ namespace litecore { namespace repl {
                 response["deltas"_sl] = "true"_sl;
                 _announcedDeltaSupport = true;
             }
+            if ( !_announcedFleeceSupport && !_options.disableFleeceRevs()) {
+                response["fleece"_sl] = "true"_sl;
+                _announcedFleeceSupport = true;
+            }
 
             Stopwatch st;
 
@@ -9,10 +9,18 @@
 #include "ReplicatorLoopbackTest.hh"
 #include "Worker.hh"
 #include "DBAccess.hh"
+#include "DeltaCache.hh"
+#include "FlowControl.hh"
+#include "IncomingRev.hh"
+#include "PullPipeline.hh"
 #include "Timer.hh"
 #include "c4Database.hh"
 #include "PrebuiltCopier.hh"
+#include "Stopwatch.hh"
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
 #include "betterassert.hh"
 #include "fleece/Mutable.hh"
 
@@ -1415,6 +1423,206 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "UnresolvedDocs", "[Push][Pull][Conflic
 }
 
 
+#pragma mark - FLOW CONTROL:
+
+
+TEST_CASE("Flow Control Push Window", "[Push]") {
+    FlowControl flow(Replicator::Options::pushing());
+    CHECK(flow.maxRevsInFlight() == tuning::kMaxRevsInFlight);
+    CHECK(flow.maxRevBytesAwaitingReply() == tuning::kMaxRevBytesAwaitingReply);
+
+    // Low latency: the default window is more than enough, so it stays put:
+    double now = 0;
+    for (int i = 0; i < 100; ++i) {
+        now += 0.001;
+        flow.revAcknowledged(10000, 0.001, now);
+    }
+    CHECK(flow.maxRevBytesAwaitingReply() == tuning::kMaxRevBytesAwaitingReply);
+    CHECK(flow.maxRevsInFlight() == tuning::kMaxRevsInFlight);
+
+    // High latency, with the window the limit: a full window is acked every round trip, so the
+    // window grows until it hits its limit:
+    for (int i = 0; i < 100; ++i) {
+        now += 0.5;
+        flow.revAcknowledged(flow.maxRevBytesAwaitingReply(), 0.5, now);
+    }
+    CHECK(flow.maxRevBytesAwaitingReply() == tuning::kMaxRevBytesAwaitingReplyLimit);
+    CHECK(flow.maxRevsInFlight() == tuning::kMaxRevsInFlightLimit);
+
+    auto stats = flow.stats();
+    CHECK(stats.maxRevBytesAwaitingReply == tuning::kMaxRevBytesAwaitingReplyLimit);
+    CHECK(stats.revRoundTripTime == Approx(0.5));
+    CHECK(stats.pushBytesPerSec > 0);
+}
+
+
+TEST_CASE("Flow Control Insertion", "[Pull]") {
+    FlowControl flow(Replicator::Options::pulling());
+    CHECK(flow.insertionBatchSize() == tuning::kInsertionBatchSize);
+    CHECK(flow.insertionDelay() == tuning::kInsertionDelay);
+
+    SECTION("Fast commits") {
+        // Partial batches and quick commits: don't wait long for more revs:
+        for (int i = 0; i < 10; ++i)
+            flow.batchInserted(10, 0.002, 0.0002);
+        CHECK(flow.insertionBatchSize() == tuning::kInsertionBatchSize);
+        CHECK(flow.insertionDelay() == tuning::kMinInsertionDelay);
+    }
+    SECTION("Slow commits") {
+        // Full batches dominated by the commit: make batches bigger and wait longer:
+        for (int i = 0; i < 10; ++i)
+            flow.batchInserted(flow.insertionBatchSize(), 0.05, 0.04);
+        CHECK(flow.insertionBatchSize() == tuning::kMaxInsertionBatchSize);
+        CHECK(flow.insertionDelay() > tuning::kInsertionDelay);
+        CHECK(flow.insertionDelay() <= tuning::kMaxInsertionDelay);
+        CHECK(flow.stats().commitTime == Approx(0.04));
+    }
+    SECTION("Long transactions") {
+        for (int i = 0; i < 10; ++i)
+            flow.batchInserted(flow.insertionBatchSize(), 0.5, 0.01);
+        CHECK(flow.insertionBatchSize() == tuning::kMinInsertionBatchSize);
+    }
+}
+
+
+TEST_CASE("Flow Control Options", "[Push][Pull]") {
+    auto options = Replicator::Options::pushpull();
+    options.setProperty(C4STR(kC4ReplicatorOptionMaxRevsInFlight), 3);
+    options.setProperty(C4STR(kC4ReplicatorOptionMaxRevBytesAwaitingReply), 100000);
+    options.setProperty(C4STR(kC4ReplicatorOptionChangesBatchSize), 50);
+    options.setProperty(C4STR(kC4ReplicatorOptionInsertionBatchSize), 10);
+    options.setProperty(C4STR(kC4ReplicatorOptionInsertionDelay), 5);
+    FlowControl flow(options);
+
+    // Limits set by options are never adjusted:
+    double now = 0;
+    for (int i = 0; i < 100; ++i) {
+        now += 0.5;
+        flow.revAcknowledged(flow.maxRevBytesAwaitingReply(), 0.5, now);
+        flow.batchInserted(flow.insertionBatchSize(), 0.05, 0.04);
+    }
+    CHECK(flow.maxRevsInFlight() == 3);
+    CHECK(flow.maxRevBytesAwaitingReply() == 100000);
+    CHECK(flow.changesBatchSize() == 50);
+    CHECK(flow.insertionBatchSize() == 10);
+    CHECK(flow.insertionDelay() == chrono::milliseconds(5));
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push With Flow Control Options", "[Push]") {
+    auto clientOpts = Replicator::Options::pushing(kC4OneShot);
+    clientOpts.setProperty(C4STR(kC4ReplicatorOptionMaxRevsInFlight), 1);
+    clientOpts.setProperty(C4STR(kC4ReplicatorOptionMaxRevBytesAwaitingReply), 1);
+    auto serverOpts = Replicator::Options::passive();
+    serverOpts.setProperty(C4STR(kC4ReplicatorOptionInsertionBatchSize), 1);
+
+    importJSONLines(sFixturesDir + "names_100.json");
+    _expectedDocumentCount = 100;
+    runReplicators(clientOpts, serverOpts);
+    compareDatabases();
+    validateCheckpoints(db, db2, "{\"local\":100}");
+}
+
+
+#pragma mark - PULL PIPELINE:
+
+
+TEST_CASE("Pull Pipeline Stage Counters", "[Pull]") {
+    PipelineStage stage;
+    auto t0 = PipelineStage::now();
+    stage.enqueued();
+    stage.enqueued();
+    stage.enqueued();
+    CHECK(stage.stats().queueDepth == 3);
+
+    stage.started(t0, t0 + chrono::milliseconds(10));
+    stage.started(t0, t0 + chrono::milliseconds(30));
+    stage.finished(PipelineStage::now(), 2);
+    auto stats = stage.stats();
+    CHECK(stats.count == 2);
+    CHECK(stats.queueDepth == 1);
+    CHECK(stats.maxQueueDepth == 3);
+    CHECK(stats.avgWaitTime == Approx(0.02));
+}
+
+
+TEST_CASE("Pull Pipeline Parser Threads", "[Pull]") {
+    auto options = Replicator::Options::pulling();
+    options.setProperty(C4STR(kC4ReplicatorOptionParserThreads), 3);
+    PullPipeline pipeline(options);
+    CHECK(pipeline.parserThreads() >= 3);
+
+    // Tasks run concurrently, on threads other than the caller's:
+    mutex m;
+    condition_variable cond;
+    set<thread::id> threads;
+    int remaining = 20;
+    for (int i = 0; i < 20; ++i) {
+        pipeline.parse([&] {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            unique_lock<mutex> lock(m);
+            threads.insert(this_thread::get_id());
+            if (--remaining == 0)
+                cond.notify_one();
+        });
+    }
+    unique_lock<mutex> lock(m);
+    REQUIRE(cond.wait_for(lock, chrono::seconds(10), [&]{return remaining == 0;}));
+    CHECK(threads.count(this_thread::get_id()) == 0);
+    CHECK(threads.size() > 1);
+}
+
+
+#pragma mark - FLEECE REVS:
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push Fleece Revs", "[Push]") {
+    auto clientOpts = Replicator::Options::pushing(kC4OneShot);
+    auto serverOpts = Replicator::Options::passive();
+    unsigned expectedFleeceRevs = 100;
+    SECTION("Fleece") {
+    }
+    SECTION("Disabled by sender") {
+        clientOpts.setNoFleeceRevs();
+        expectedFleeceRevs = 0;
+    }
+    SECTION("Disabled by receiver") {
+        serverOpts.setNoFleeceRevs();
+        expectedFleeceRevs = 0;
+    }
+
+    importJSONLines(sFixturesDir + "names_100.json");
+    _expectedDocumentCount = 100;
+    unsigned before = IncomingRev::gNumFleeceRevsReceived;
+    runReplicators(clientOpts, serverOpts);
+    CHECK(IncomingRev::gNumFleeceRevsReceived - before == expectedFleeceRevs);
+    compareDatabases();
+    validateCheckpoints(db, db2, "{\"local\":100}");
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push Fleece Revs Benchmark", "[Push][Perf][.slow]") {
+    constexpr unsigned kNumDocs = 12189;
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = kNumDocs;
+
+    for (int fleece = 0; fleece <= 1; ++fleece) {
+        auto clientOpts = Replicator::Options::pushing(kC4OneShot);
+        if (!fleece)
+            clientOpts.setNoFleeceRevs();
+        unsigned before = IncomingRev::gNumFleeceRevsReceived;
+        Stopwatch st;
+        runReplicators(clientOpts, Replicator::Options::passive());
+        double elapsed = st.elapsed();
+        CHECK(IncomingRev::gNumFleeceRevsReceived - before == (fleece ? kNumDocs : 0));
+        compareDatabases();
+        fprintf(stderr, "Pushing %u docs as %s took %.3f sec (%.1f us/doc)\n",
+                kNumDocs, (fleece ? "Fleece" : "JSON"), elapsed, elapsed / kNumDocs * 1.0e6);
+        deleteAndRecreateDB(db2);
+    }
+}
+
+
 #pragma mark - DELTA:
 
 
@@ -1499,6 +1707,97 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Delta Push+Push", "[Push][Delta]") {
 }
 
 
+TEST_CASE("Delta Cache", "[Push][Delta]") {
+    DeltaCache cache(1000);
+    CHECK(!cache.get("doc"_sl, "1-aa"_sl, "2-bb"_sl, false));
+
+    cache.put("doc"_sl, "1-aa"_sl, "2-bb"_sl, false, alloc_slice("{\"x\":1}"_sl));
+    cache.put("doc"_sl, "2-bb"_sl, "3-cc"_sl, false, nullslice);   // no delta worth using
+    auto delta = cache.get("doc"_sl, "1-aa"_sl, "2-bb"_sl, false);
+    REQUIRE(delta);
+    CHECK(*delta == "{\"x\":1}"_sl);
+    auto noDelta = cache.get("doc"_sl, "2-bb"_sl, "3-cc"_sl, false);
+    REQUIRE(noDelta);
+    CHECK(!*noDelta);
+    // Deltas with legacy `_attachments` are different:
+    CHECK(!cache.get("doc"_sl, "1-aa"_sl, "2-bb"_sl, true));
+
+    auto stats = cache.stats();
+    CHECK(stats.hits == 2);
+    CHECK(stats.misses == 2);
+    CHECK(stats.count == 2);
+    CHECK(stats.bytes > 0);
+
+    // Fill the cache; the least recently used entries are evicted:
+    cache.get("doc"_sl, "1-aa"_sl, "2-bb"_sl, false);
+    for (int i = 0; i < 20; ++i) {
+        string docID = format("other-%02d", i);
+        cache.put(slice(docID), "1-aa"_sl, "2-bb"_sl, false, alloc_slice(string(10, 'x')));
+    }
+    stats = cache.stats();
+    CHECK(stats.bytes <= 1000);
+    CHECK(stats.count < 22);
+    CHECK(!cache.get("doc"_sl, "2-bb"_sl, "3-cc"_sl, false));
+    CHECK(cache.get("other-19"_sl, "1-aa"_sl, "2-bb"_sl, false));
+
+    // A delta bigger than the whole cache isn't added:
+    cache.put("big"_sl, "1-aa"_sl, "2-bb"_sl, false, alloc_slice(string(2000, 'x')));
+    CHECK(!cache.get("big"_sl, "1-aa"_sl, "2-bb"_sl, false));
+
+    cache.setCapacity(0);
+    CHECK(cache.stats().count == 0);
+    CHECK(cache.stats().bytes == 0);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Delta Pull By Two Peers", "[Pull][Delta]") {
+    // Keep the server database's cache alive between replications:
+    auto cache = DeltaCache::forDatabase(string(alloc_slice(c4db_getPath(db2))));
+    auto serverOpts = Replicator::Options::passive();
+
+    // Push db --> db2:
+    importJSONLines(sFixturesDir + "names_100.json");
+    _expectedDocumentCount = 100;
+    runReplicators(Replicator::Options::pushing(kC4OneShot), serverOpts);
+    compareDatabases();
+
+    // Make a copy of db, a second client with the same revisions:
+    C4Error error;
+    alloc_slice path(c4db_getPath(db));
+    string peerName = format("peer%lld", chrono::milliseconds(time(nullptr)).count());
+    REQUIRE(c4db_copyNamed(path, slice(peerName), &dbConfig(), &error));
+
+    Log("-------- Mutate Docs In db2 --------");
+    mutationsForDelta(db2);
+
+    Log("-------- First Client Pulls From db2 --------");
+    _expectedDocumentCount = (100+6)/7;
+    auto before = cache->stats();
+    auto deltasBefore = DBAccess::gNumDeltasApplied.load();
+    runReplicators(Replicator::Options::pulling(kC4OneShot), serverOpts);
+    compareDatabases();
+    CHECK(DBAccess::gNumDeltasApplied - deltasBefore == 15);
+    auto after = cache->stats();
+    CHECK(after.misses - before.misses == 15);
+    CHECK(after.hits == before.hits);
+    CHECK(after.count == 15);
+
+    Log("-------- Second Client Pulls From db2 --------");
+    c4db_release(db);
+    db = c4db_openNamed(slice(peerName), &dbConfig(), &error);
+    REQUIRE(db);
+    before = after;
+    deltasBefore = DBAccess::gNumDeltasApplied.load();
+    runReplicators(Replicator::Options::pulling(kC4OneShot), serverOpts);
+    compareDatabases();
+    // The deltas are sent again, but db2 doesn't have to compute them again:
+    CHECK(DBAccess::gNumDeltasApplied - deltasBefore == 15);
+    after = cache->stats();
+    CHECK(after.hits - before.hits == 15);
+    CHECK(after.misses == before.misses);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Bigger Delta Push+Push", "[Push][Delta]") {
     static constexpr int kNumDocs = 100, kNumProps = 1000;
     auto serverOpts = Replicator::Options::passive();
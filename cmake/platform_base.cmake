@@ -37,24 +37,30 @@ function(set_litecore_source_base)
         LiteCore/Database/Database.cc
         LiteCore/Database/Document.cc
         LiteCore/Database/Housekeeper.cc
+        LiteCore/Database/IndexBuilder.cc
         LiteCore/Database/LeafDocument.cc
         LiteCore/Database/LegacyAttachments.cc
         LiteCore/Database/LiveQuerier.cc
         LiteCore/Database/PrebuiltCopier.cc
+        LiteCore/Database/ReaderPool.cc
         LiteCore/Database/SequenceTracker.cc
         LiteCore/Database/TreeDocument.cc
         LiteCore/Database/Upgrader.cc
         LiteCore/Query/IndexSpec.cc
         LiteCore/Query/PredictiveModel.cc
         LiteCore/Query/Query.cc
+        LiteCore/Query/QueryParser+Keyset.cc
+        LiteCore/Query/QueryParser+Partition.cc
         LiteCore/Query/QueryParser+Prediction.cc
         LiteCore/Query/QueryParser.cc
         LiteCore/Query/SQLiteDataFile+Indexes.cc
         LiteCore/Query/SQLiteFleeceEach.cc
         LiteCore/Query/SQLiteFleeceFunctions.cc
         LiteCore/Query/SQLiteFleeceUtil.cc
+        LiteCore/Query/SQLiteFTS5Extensions.cc
         LiteCore/Query/SQLiteFTSRankFunction.cc
         LiteCore/Query/SQLiteKeyStore+ArrayIndexes.cc
+        LiteCore/Query/SQLiteKeyStore+CoveringIndexes.cc
         LiteCore/Query/SQLiteKeyStore+FTSIndexes.cc
         LiteCore/Query/SQLiteKeyStore+Indexes.cc
         LiteCore/Query/SQLiteKeyStore+PredictiveIndexes.cc
@@ -89,9 +95,12 @@ function(set_litecore_source_base)
         Replicator/Checkpointer.cc
         Replicator/DatabaseCookies.cc
         Replicator/DBAccess.cc
+        Replicator/DeltaCache.cc
+        Replicator/FlowControl.cc
         Replicator/IncomingRev.cc
         Replicator/IncomingRev+Blobs.cc
         Replicator/Inserter.cc
+        Replicator/PullPipeline.cc
         Replicator/Puller.cc
         Replicator/Pusher.cc
         Replicator/Pusher+Attachments.cc